@@ -308,6 +308,19 @@
 #  define HAVE_XRR
 #endif
 
+/***************************************************************************
+ * MIT-SHM Shared Memory Support
+ *
+ * if you want the Grab command to read the screen through a shared memory
+ * segment (much faster on large TrueColor displays) and you have the Xext
+ * headers and library installed.  Falls back to XGetImage() on remote
+ * displays, or servers without the extension.
+ */
+
+#ifdef DOXSHM
+#  define HAVE_XSHM
+#endif
+
 /***************************************************************************
  * User definable filter support:
  *
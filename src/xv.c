@@ -140,7 +140,7 @@ static const char *histr, *lostr, *fgstr, *bgstr, *tmpstr;
 static const char *infogeom, *ctrlgeom, *gamgeom, *browgeom, *textgeom, *cmtgeom;
 static int userspecbrowgeom;
 static char *display, *whitestr, *blackstr;
-static char *rootfgstr, *rootbgstr, *imagebgstr, *visualstr;
+static char *rootfgstr, *rootbgstr, *imagebgstr, *visualstr, *filterstr;
 static char *monofontname, *flistName;
 #ifdef TV_L10N
 static char **misscharset, *defstr;
@@ -206,7 +206,7 @@ int main(int argc, char **argv)
   display = NULL;
   fgstr = bgstr = rootfgstr = rootbgstr = imagebgstr = NULL;
   histr = lostr = whitestr = blackstr = NULL;
-  visualstr = monofontname = flistName = NULL;
+  visualstr = filterstr = monofontname = flistName = NULL;
   winTitle = NULL;
 
   pic = egampic = epic = cpic = origPic = NULL;
@@ -227,6 +227,9 @@ int main(int argc, char **argv)
   cmapInGam = 0;
   grabDelay = 0;
   startGrab = 0;
+  recFrames = 0;
+  recDelay  = 1000;
+  recName   = (char *) NULL;
   showzoomcursor = 0;
   perfect = owncmap = stdcmap = rwcolor = 0;
 
@@ -283,10 +286,13 @@ int main(int argc, char **argv)
   ninstall = 0;  fixedaspect = 0;  noFreeCols = nodecor = 0;
   DEBUG = 0;  bwidth = 2;
   nolimits = useroot = clrroot = noqcheck = 0;
+  useoverview = 0;
   waitsec = waitsec_final = -1.0;  waitloop = 0;  automax = 0;
   rootMode = 0;  hsvmode = 0;
   rmodeset = gamset = cgamset = 0;
   nopos = limit2x = 0;
+  numThreads = 0;
+  poolSize = 128;  hugePages = 0;
   resetroot = 1;
   clearonload = 0;
   curstype = XC_top_left_arrow;
@@ -375,6 +381,15 @@ int main(int argc, char **argv)
   Init24to8();
 
 
+  /* '-batch' converts files without ever opening the display */
+  for (i=1; i<argc; i++) {
+    if (strcmp(argv[i], "-batch") == 0) {
+      if (PcdSize < 0) PcdSize = 1;     /* no dialog to ask with */
+      exit(BatchMain(argc, argv));
+    }
+  }
+
+
   /* handle user-specified resources and cmd-line arguments */
   parseResources(argc,argv);
   parseCmdLine(argc, argv);
@@ -654,6 +669,8 @@ int main(int argc, char **argv)
     if (clrroot) Quit(0);
   }
 
+  SweepClipboard();     /* clipboard segments that earlier xvs left behind */
+
 
   arrow     = XCreateFontCursor(theDisp,(u_int) curstype);
   cross     = XCreateFontCursor(theDisp,XC_crosshair);
@@ -1418,12 +1435,14 @@ static void parseResources(int argc, char **argv)
   if (rd_str ("gsGeometry"))     gsGeomStr   = def_str;
   if (rd_int ("gsResolution"))   gsRes       = def_int;
   if (rd_flag("hsvMode"))        hsvmode     = def_int;
+  if (rd_flag("hugePages"))      hugePages   = def_int;
   if (rd_str ("highlight"))      histr       = def_str;
   if (rd_str ("iconGeometry"))   icongeom    = def_str;
   if (rd_flag("iconic"))         startIconic = def_int;
   if (rd_str ("imageBackground")) imagebgstr = def_str;
   if (rd_str ("infoGeometry"))   infogeom    = def_str;
   if (rd_flag("infoMap"))        imap        = def_int;
+  if (rd_flag("linearLight"))    linearLight = def_int;
   if (rd_flag("loadBrowse"))     browseMode  = def_int;
   if (rd_str ("lowlight"))       lostr       = def_str;
 #ifdef MACBINARY
@@ -1448,12 +1467,14 @@ static void parseResources(int argc, char **argv)
   if (rd_flag("forcegeom]"))     forcegeom   = def_int;
   if (rd_flag("noqcheck"))       noqcheck    = def_int;
   if (rd_flag("nostat"))         nostat      = def_int;
+  if (rd_flag("overview"))       useoverview = def_int;
   if (rd_flag("ownCmap"))        owncmap     = def_int;
   if (rd_flag("perfect"))        perfect     = def_int;
 #ifdef HAVE_PIC2
   if (rd_flag("pic2split"))      pic2split   = def_int;
 #endif
   if (rd_flag("popupKludge"))    winCtrPosKludge = def_int;
+  if (rd_int ("poolSize"))       poolSize    = abs(def_int);
   if (rd_str ("print"))          strncpy(printCmd, def_str,
 					 (size_t) PRINTCMDLEN);
   if (rd_flag("pscompress"))     pscomp      = def_int;
@@ -1467,7 +1488,9 @@ static void parseResources(int argc, char **argv)
   if (rd_flag("rwColor"))        rwcolor     = def_int;
   if (rd_flag("saveNormal"))     savenorm    = def_int;
   if (rd_str ("searchDirectory"))  strcpy(searchdir, def_str);
+  if (rd_str ("smoothFilter"))   filterstr   = def_str;
   if (rd_str ("textviewGeometry")) textgeom  = def_str;
+  if (rd_int ("threads"))        numThreads  = abs(def_int);
   if (rd_flag("useStdCmap"))     stdcmap     = def_int;
   if (rd_str ("visual"))         visualstr   = def_str;
 #ifdef VS_ADJUST
@@ -1658,6 +1681,9 @@ static void parseCmdLine(int argc, char **argv)
     else if (!argcmp(argv[i],"-fixpix",5,1,&do_fixpix_smooth)); /* dithering */
 #endif
 
+    else if (!argcmp(argv[i],"-filter",4,0,&pm))           /* smooth filter */
+      { if (++i<argc) filterstr = argv[i]; }
+
     else if (!argcmp(argv[i],"-flist",3,0,&pm))            /* file list */
       { if (++i<argc) flistName = argv[i]; }
 
@@ -1704,6 +1730,8 @@ static void parseCmdLine(int argc, char **argv)
 
     else if (!argcmp(argv[i],"-hsv",   3,1,&hsvmode));     /* hsvmode */
 
+    else if (!argcmp(argv[i],"-hugepages",3,1,&hugePages)); /* huge pages */
+
     else if (!argcmp(argv[i],"-icgeometry",4,0,&pm))       /* icon geometry */
       { if (++i<argc) icongeom = argv[i]; }
 
@@ -1718,6 +1746,7 @@ static void parseCmdLine(int argc, char **argv)
       { if (++i<argc) imagebgstr = argv[i]; }
 
     else if (!argcmp(argv[i],"-lbrowse",3,1,&browseMode)); /* browse mode */
+    else if (!argcmp(argv[i],"-linear",3,1,&linearLight)); /* linear light */
 
     else if (!argcmp(argv[i],"-lo",3,0,&pm))	           /* lowlight */
       { if (++i<argc) lostr = argv[i]; }
@@ -1776,6 +1805,7 @@ static void parseCmdLine(int argc, char **argv)
     else if (!argcmp(argv[i],"-noresetroot",5,1,&resetroot)); /* reset root */
     else if (!argcmp(argv[i],"-norm",      5,1,&autonorm));   /* norm */
     else if (!argcmp(argv[i],"-nostat",    4,1,&nostat));     /* nostat */
+    else if (!argcmp(argv[i],"-overview",  3,1,&useoverview)); /* overviews */
     else if (!argcmp(argv[i],"-owncmap",   2,1,&owncmap));    /* own cmap */
 #ifdef HAVE_PCD
     else if (!argcmp(argv[i],"-pcd",       4,0,&pm))         /* pcd with size */
@@ -1788,6 +1818,9 @@ static void parseCmdLine(int argc, char **argv)
     else if (!argcmp(argv[i],"-pkludge",   3,1,&winCtrPosKludge));
     else if (!argcmp(argv[i],"-poll",      3,1,&polling));    /* chk mod? */
 
+    else if (!argcmp(argv[i],"-poolsize",4,0,&pm))    /* buffer pool MB */
+      { if (++i<argc) poolSize = abs(atoi(argv[i])); }
+
     else if (!argcmp(argv[i],"-preset",3,0,&pm))      /* preset */
       { if (++i<argc) preset=abs(atoi(argv[i])); }
 
@@ -1798,6 +1831,14 @@ static void parseCmdLine(int argc, char **argv)
     else if (!argcmp(argv[i],"-random", 4,1,&randomShow)); /* random */
     else if (!argcmp(argv[i],"-raw",    4,1,&autoraw));    /* force raw */
 
+    else if (!argcmp(argv[i],"-record",4,0,&pm)) {     /* record frames */
+      if (i<argc-3) {
+	recFrames = atoi(argv[++i]);
+	recDelay  = atoi(argv[++i]);
+	recName   = argv[++i];
+      }
+    }
+
     else if (!argcmp(argv[i],"-rbg",3,0,&pm))      /* root background color */
       { if (++i<argc) rootbgstr = argv[i]; }
 
@@ -1833,6 +1874,9 @@ static void parseCmdLine(int argc, char **argv)
     else if (!argcmp(argv[i],"-tgeometry",2,0,&pm))	   /* textview geom */
       { if (++i<argc) textgeom = argv[i]; }
 
+    else if (!argcmp(argv[i],"-threads",3,0,&pm))	   /* threads */
+      { if (++i<argc) numThreads = abs(atoi(argv[i])); }
+
     else if (!argcmp(argv[i],"-vflip",3,1,&autovflip));	   /* vflip */
     else if (!argcmp(argv[i],"-viewonly",4,1,&viewonly));  /* viewonly */
 
@@ -1926,6 +1970,23 @@ static void verifyArgs(void)
     grabDelay = 0;
   }
 
+  if (recFrames && !GrabSeqName(recName, 1, (char *) NULL, (size_t) 0)) {
+    fprintf(stderr,"Invalid '-record' file name template ignored.\n");
+    fprintf(stderr,"  (It needs exactly one '%%d', as in 'frame%%03d.ppm')\n");
+    recFrames = 0;
+  }
+
+  if (recFrames < 0 || recDelay < 0) {
+    fprintf(stderr,"Invalid '-record' frame count or delay ignored.\n");
+    recFrames = 0;
+  }
+
+  if (filterstr && (smoothFilter = SmoothFilterNum(filterstr)) < 0) {
+    fprintf(stderr,"Invalid '-filter' type '%s' ignored.\n", filterstr);
+    fprintf(stderr,"  (Valid types:  xv, box, bilinear, mitchell, lanczos)\n");
+    smoothFilter = SF_XV;
+  }
+
   if (preset<0 || preset>4) {
     fprintf(stderr,"Invalid default preset value (%d) ignored.\n", preset);
     fprintf(stderr,"  (Valid values:  1, 2, 3, 4)\n");
@@ -2000,6 +2061,7 @@ static void cmdSyntax(int i)
   printoption("[-/+8]");
   printoption("[-/+acrop]");
   printoption("[-aspect w:h]");
+  printoption("[-batch -format fmt [options] filename ...]");
   printoption("[-best24]");
   printoption("[-bg color]");
   printoption("[-black color]");
@@ -2029,6 +2091,7 @@ static void cmdSyntax(int i)
   printoption("[-drift dx dy]");
   printoption("[-expand exp | hexp:vexp]");
   printoption("[-fg color]");
+  printoption("[-filter xv|box|bilinear|mitchell|lanczos]");
   printoption("[-/+fixed]");
 #ifdef ENABLE_FIXPIX_SMOOTH
   printoption("[-/+fixpix]");
@@ -2045,12 +2108,14 @@ static void cmdSyntax(int i)
   printoption("[-hi color]");
   printoption("[-/+hist]");
   printoption("[-/+hsv]");
+  printoption("[-/+hugepages]");
   printoption("[-ibg color]");  /* GRR 19980314 */
   printoption("[-icgeometry geom]");
   printoption("[-/+iconic]");
   printoption("[-igeometry geom]");
   printoption("[-/+imap]");
   printoption("[-/+lbrowse]");
+  printoption("[-/+linear]");
   printoption("[-lo color]");
   printoption("[-/+loadclear]");
 #ifdef MACBINARY
@@ -2081,6 +2146,7 @@ static void cmdSyntax(int i)
   printoption("[-/+noresetroot]");
   printoption("[-/+norm]");
   printoption("[-/+nostat]");
+  printoption("[-/+overview]");
   printoption("[-/+owncmap]");
 #ifdef HAVE_PCD
   printoption("[-pcd size(0=192*128,1,2,3,4=3072*2048)]");
@@ -2091,11 +2157,13 @@ static void cmdSyntax(int i)
 #endif
   printoption("[-/+pkludge]");
   printoption("[-/+poll]");
+  printoption("[-poolsize MB]");
   printoption("[-preset #]");
   printoption("[-quick24]");
   printoption("[-/+quit]");
   printoption("[-/+random]");
   printoption("[-/+raw]");
+  printoption("[-record frames msec template]");
   printoption("[-rbg color]");
   printoption("[-rfg color]");
   printoption("[-/+rgb]");
@@ -2110,6 +2178,7 @@ static void cmdSyntax(int i)
   printoption("[-/+startgrab]");
   printoption("[-/+stdcmap]");
   printoption("[-tgeometry geom]");
+  printoption("[-threads int]");
   printoption("[-/+vflip]");
   printoption("[-/+viewonly]");
   printoption("[-visual type]");
@@ -2228,11 +2297,13 @@ static int openPic(int filenum)
 
   /* if we're not loading next or prev page in a multi-page doc, kill off
      page files */
-  if (strlen(pageBaseName) && filenum!=OP_PAGEDN && filenum!=OP_PAGEUP)
+  if ((strlen(pageBaseName) || strlen(pageDocName)) &&
+      filenum!=OP_PAGEDN && filenum!=OP_PAGEUP)
     killpage = 1;
 
 
-  if (strlen(pageBaseName) && (filenum==OP_PAGEDN || filenum==OP_PAGEUP)) {
+  if ((strlen(pageBaseName) || strlen(pageDocName)) &&
+      (filenum==OP_PAGEDN || filenum==OP_PAGEUP)) {
     if      (filenum==OP_PAGEUP && curPage>0)          curPage--;
     else if (filenum==OP_PAGEDN && curPage<numPages-1) curPage++;
     else    {
@@ -2241,6 +2312,13 @@ static int openPic(int filenum)
       return 0;
     }
 
+    if (strlen(pageDocName)) {
+      /* no page files:  the loader renders page 'curPage' of the doc itself */
+      strncpy(filename, pageDocName, sizeof(filename)-1);
+      fullname = filename;
+      goto HAVE_FILENAME;
+    }
+
     snprintf(filename, sizeof(filename)-1, "%s%d", pageBaseName, curPage+1);
     fullname = filename;
     goto HAVE_FILENAME;
@@ -2255,6 +2333,7 @@ static int openPic(int filenum)
 
     if (killpage) {      /* kill old page files, if any */
       KillPageFiles(pageBaseName, numPages);
+      KillPageDoc();
       pageBaseName[0] = '\0';
       numPages = 1;
       curPage = 0;
@@ -2270,6 +2349,7 @@ static int openPic(int filenum)
 
     if (killpage) {      /* kill old page files, if any */
       KillPageFiles(pageBaseName, numPages);
+      KillPageDoc();
       pageBaseName[0] = '\0';
       numPages = 1;
       curPage = 0;
@@ -2293,6 +2373,7 @@ static int openPic(int filenum)
 
     if (killpage) {      /* kill old page files, if any */
       KillPageFiles(pageBaseName, numPages);
+      KillPageDoc();
       pageBaseName[0] = '\0';
       numPages = 1;
       curPage = 0;
@@ -2622,6 +2703,7 @@ ms_auto_no:
   /* kill old page files, if any */
   if (killpage) {
     KillPageFiles(pageBaseName, numPages);
+    KillPageDoc();
     pageBaseName[0] = '\0';
     numPages = 1;
     curPage = 0;
@@ -2657,6 +2739,10 @@ ms_auto_no:
       free(pinfo.pic);
     }
     pinfo.pic = (byte *) NULL;
+    if (pinfo.deep) {
+      free(pinfo.deep);
+    }
+    pinfo.deep = (u_short *) NULL;
     if (pinfo.comment) {
       free(pinfo.comment);
     }
@@ -2677,6 +2763,30 @@ ms_auto_no:
 
   state824 = 0;
 
+  /* the full-precision samples of a 16-bit image can only be developed
+     into a 24-bit pic, so a greyscale image that has them is made 24-bit,
+     too.  Unless we're locked into 8-bit mode, in which case they go */
+  if (pinfo.deep) {
+    if (conv24MB.flags[CONV24_LOCK] && picType == PIC8) {
+      free(pinfo.deep);
+      pinfo.deep = (u_short *) NULL;
+    }
+    else if (pinfo.type != PIC24) {
+      byte *pic24;
+      pic24 = Conv8to24(pinfo.pic, pinfo.w, pinfo.h,
+			pinfo.r, pinfo.g, pinfo.b);
+      if (pic24) {
+	free(pinfo.pic);
+	pinfo.pic  = pic24;
+	pinfo.type = PIC24;
+      }
+      else {
+	free(pinfo.deep);
+	pinfo.deep = (u_short *) NULL;
+      }
+    }
+  }
+
   /* if we're locked into a mode, do appropriate conversion */
   if (conv24MB.flags[CONV24_LOCK]) {  /* locked */
     if (pinfo.type==PIC24 && picType==PIC8) {           /* 24 -> 8 bit */
@@ -2712,6 +2822,10 @@ ms_auto_no:
       free(pinfo.comment);
     }
     pinfo.comment = (char *) NULL;
+    if (pinfo.deep) {
+      free(pinfo.deep);
+    }
+    pinfo.deep = (u_short *) NULL;
     Warning();
     goto FAILED;
   }
@@ -2726,6 +2840,15 @@ ms_auto_no:
     numPages = pinfo.numpages;
     curPage = 0;
   }
+#ifdef HAVE_GSAPI
+  else if (filetype == RFT_PS && pinfo.numpages > 1 && !strlen(pageDocName)) {
+    /* LoadPS() renders pages straight from the document, so keep it around */
+    strncpy(pageDocName, filename, sizeof(pageDocName)-1);
+    pageDocTemp = (fullname && strcmp(fullname, filename)!=0);
+    numPages = pinfo.numpages;
+    curPage = 0;
+  }
+#endif
 
   ignoreConfigs = 1;
 
@@ -2763,6 +2886,14 @@ ms_auto_no:
     bMap[i] = pinfo.b[i];
   }
 
+  /* keep the full-precision samples, if any.  (not with -rv, which
+     inverts 'pic' in place, so it can't be developed from them) */
+  if (revvideo && pinfo.deep) {
+    free(pinfo.deep);
+    pinfo.deep = (u_short *) NULL;
+  }
+  DeepTake(&pinfo);
+
 
 
   AlgInit();
@@ -2780,7 +2911,8 @@ ms_auto_no:
 
 
   /* if we read a /tmp file, delete it.  won't be needing it any more */
-  if (fullname && strcmp(fullname,filename)!=0) unlink(filename);
+  if (fullname && strcmp(fullname,filename)!=0 &&
+      strcmp(filename, pageDocName)!=0) unlink(filename);
 
 
   SetISTR(ISTR_INFO, "%s", formatStr);
@@ -3272,7 +3404,7 @@ int ReadFileType(char *fname)
       rv = RFT_PDSVICAR;
 #endif
 
-#ifdef GS_PATH   /* Ghostscript handles both PostScript and PDF */
+#if defined(GS_PATH) || defined(HAVE_GSAPI)   /* Ghostscript handles both PostScript and PDF */
   else if (strncmp((char *) magicno, "%!",     (size_t) 2)==0 ||
 	   strncmp((char *) magicno, "\004%!", (size_t) 3)==0 ||
            strncmp((char *) magicno, "%PDF",   (size_t) 4)==0) rv = RFT_PS;
@@ -3356,6 +3488,9 @@ int ReadPicFile(char *fname, int ftype, PICINFO *pinfo, int quick)
   pinfo->numpages = 1;
   pinfo->pagebname[0] = '\0';
 
+  /* ... and only a few keep more than 8 bits per sample */
+  pinfo->deep = (u_short *) NULL;
+
   switch (ftype) {
   case RFT_GIF:     rv = LoadGIF   (fname, pinfo);         break;
   case RFT_PM:      rv = LoadPM    (fname, pinfo);         break;
@@ -3412,7 +3547,7 @@ int ReadPicFile(char *fname, int ftype, PICINFO *pinfo, int quick)
   case RFT_G3:      rv = LoadG3    (fname, pinfo);         break;
 #endif
 
-#ifdef GS_PATH
+#if defined(GS_PATH) || defined(HAVE_GSAPI)
   case RFT_PS:      rv = LoadPS    (fname, pinfo, quick);  break;
 #endif
 
@@ -3445,9 +3580,50 @@ int ReadPicFile(char *fname, int ftype, PICINFO *pinfo, int quick)
 #endif
 
   }
+
+  /* icons and the like have no use for the full-precision samples */
+  if (pinfo->deep && (quick || !rv)) {
+    free(pinfo->deep);
+    pinfo->deep = (u_short *) NULL;
+  }
+
   return rv;
 }
 
+
+/********************************/
+int OverviewSize(int w, int h, int quick, int *ow, int *oh)
+{
+  /* for loaders of files that carry reduced-resolution copies of the image
+     (TIFF overviews, JPEG 2000 resolution levels).  Given the full size of
+     the image, returns '0' if the full-resolution image should be loaded,
+     or '1' and the smallest size that will do (*ow x *oh) if a smaller copy
+     will look just as good:  a 'quick' load only needs icon-sized pixels,
+     and, with '-overview', a picture bigger than maxWIDE x maxHIGH is going
+     to be shrunk to fit anyway.  That's opt-in, as the overview becomes
+     'pic', and zooming, cropping and saving all work from it */
+
+  if (quick) {
+    *ow = QUICKWIDE;  *oh = QUICKHIGH;
+    return 1;
+  }
+
+  if (!useoverview || !maxWIDE || !maxHIGH) return 0;
+  if (w <= (int) maxWIDE && h <= (int) maxHIGH) return 0;
+
+  /* the size it'll get shrunk to, keeping the aspect ratio */
+  if ((double) w * maxHIGH > (double) h * maxWIDE) {
+    *ow = maxWIDE;
+    *oh = (int) (((double) h * maxWIDE) / w);
+  }
+  else {
+    *oh = maxHIGH;
+    *ow = (int) (((double) w * maxHIGH) / h);
+  }
+
+  return 1;
+}
+
 /********************************/
 char *QuoteFileName(char *safe_name, const char *orig_name, int max_len)
 {
@@ -3690,6 +3866,20 @@ void KillPageFiles(char *bname, int numpages)
 }
 
 
+/********************************/
+void KillPageDoc(void)
+{
+  /* forgets the document whose pages are being rendered on demand (see
+     LoadPS()), deleting it if it was only a decompressed temp file */
+
+  if (strlen(pageDocName) == 0) return;
+
+  if (pageDocTemp) unlink(pageDocName);
+  pageDocName[0] = '\0';
+  pageDocTemp = 0;
+}
+
+
 /********************************/
 void NewPicGetColors(int donorm, int dohist)
 {
@@ -4598,7 +4788,7 @@ void HandleDispMode(void)
       strcpy(fnam, tmp);
 
       /* if we're viewing a multi-page doc, add page # to title */
-      if (strlen(pageBaseName) && numPages>1) {
+      if ((strlen(pageBaseName) || strlen(pageDocName)) && numPages>1) {
 	char foo[64];
 	sprintf(foo, "  Page %d of %d", curPage+1, numPages);
 	strcat(fnam, foo);
@@ -4669,7 +4859,7 @@ void HandleDispMode(void)
     }
 
 
-
+    FreeRootTiles();    /* no use in a window, and they'd go stale */
     useroot = 0;
   }
 
@@ -501,6 +501,14 @@
 
 #define DBLCLICKTIME 400           /* double-click speed in milliseconds */
 
+/* Minimum size compression when doing a 'quick' image load.  (Of course, if
+   the image *is* smaller than this, you'll get whatever size it actually is.)
+   This is currently hardcoded to be twice the size of a schnauzer icon, as
+   the schnauzer's the only thing that does a quick load... */
+
+#define QUICKWIDE (160*dpiMult)
+#define QUICKHIGH (120*dpiMult)
+
 #ifdef DOJPEG
 #  define HAVE_JPEG
 #endif
@@ -509,6 +517,10 @@
 #  define HAVE_JP2K
 #endif
 
+#ifdef DOOPENJPEG
+#  define HAVE_OPENJPEG
+#endif
+
 #ifdef DOTIFF
 #  define HAVE_TIFF
 #endif
@@ -525,6 +537,14 @@
 #  define HAVE_G3
 #endif
 
+#ifdef DOGSAPI
+#  define HAVE_GSAPI
+#endif
+
+#ifdef DOTHREADS
+#  define HAVE_PTHREADS
+#endif
+
 #ifndef TRUE
 #  define TRUE 1
 #endif
@@ -829,6 +849,17 @@
 #define EM_DITH   1
 #define EM_SMOOTH 2
 
+/* values 'smoothFilter' can take:  the kernel Smooth24() resizes with */
+#define SF_XV       0     /* xv's own (area-average / bilinear) */
+#define SF_BOX      1
+#define SF_BILINEAR 2
+#define SF_MITCHELL 3
+#define SF_LANCZOS  4     /* Lanczos-3 */
+#define SF_MAX      5
+
+/* white, in the linear-light values LightTables() maps to */
+#define LINMAX      (255 << 6)
+
 
 /* things EventLoop() can return (0 and above reserved for 'goto pic#') */
 #define QUIT      -1   /* exit immediately  */
@@ -890,13 +921,19 @@
 #define DMB_DITH     1
 #define DMB_SMOOTH   2
 #define DMB_SEP1     3     /* ---- separator */
-#define DMB_COLRW    4
-#define DMB_SEP2     5     /* ---- separator */
-#define DMB_COLNORM  6
-#define DMB_COLPERF  7
-#define DMB_COLOWNC  8
-#define DMB_COLSTDC  9
-#define DMB_MAX      10
+#define DMB_FILTXV   4     /* DMB_FILTXV + SF_* */
+#define DMB_FILTBOX  5
+#define DMB_FILTBIL  6
+#define DMB_FILTMIT  7
+#define DMB_FILTLAN  8
+#define DMB_SEP2     9     /* ---- separator */
+#define DMB_COLRW    10
+#define DMB_SEP3     11    /* ---- separator */
+#define DMB_COLNORM  12
+#define DMB_COLPERF  13
+#define DMB_COLOWNC  14
+#define DMB_COLSTDC  15
+#define DMB_MAX      16
 
 
 /* selections in rootMB */
@@ -944,7 +981,9 @@
 #define ALG_PIXEL     10
 #define ALG_SPREAD    11
 #define ALG_MEDIAN    12
-#define ALG_MAX       13
+#define ALG_LOCALEQ   13
+#define ALG_LEVELS    14
+#define ALG_MAX       15
 
 /* FLmask algorithms */
 #define MSK_NONE	0
@@ -1185,6 +1224,10 @@ typedef struct { byte *pic;                  /* image data */
 
 		 int   numpages;             /* # of page files, if >1 */
 		 char  pagebname[64];        /* basename of page files */
+
+		 u_short *deep;              /* unreduced samples, or NULL */
+		 int   deepSpp;              /* samples per pixel, 1 or 3 */
+		 int   deepMax;              /* white, in 'deep' */
 	       } PICINFO;
 
 #define MAX_GHANDS 16   /* maximum # of GRAF handles */
@@ -1302,6 +1345,8 @@ WHERE int            xlocale;		    /* true if Xlib supports locale */
 
 WHERE int            numPages, curPage;     /* for multi-page files */
 WHERE char           pageBaseName[64];      /* basename for multi-page files */
+WHERE char           pageDocName[MAXPATHLEN]; /* doc w/ pages made on demand */
+WHERE int            pageDocTemp;           /* pageDocName is a temp file */
 
 WHERE byte          *cpic;         /* cropped version of pic */
 WHERE int           cWIDE, cHIGH,  /* size of cropped region */
@@ -1312,6 +1357,12 @@ WHERE byte          *epic;         /* expanded version of cpic */
                                    /* this is converted to 'theImage' */
 WHERE int           eWIDE, eHIGH;  /* size of epic */
 
+WHERE int           numThreads;    /* worker threads to use (0 = #cpus) */
+WHERE int           poolSize;      /* MB of idle image buffers to keep */
+WHERE int           hugePages;     /* put big image buffers in huge pages */
+WHERE int           smoothFilter;  /* SF_* kernel for smooth resizes */
+WHERE int           linearLight;   /* average pixels in linear light */
+
 WHERE byte          *egampic;      /* expanded, gammified cpic
 				      (only used in 24-bit mode) */
 
@@ -1401,6 +1452,7 @@ WHERE int           bwidth,        /* border width of created windows */
 				      (a WM that will does install CMaps */
                     useroot,       /* true if we should draw in rootW */
 		    nolimits,	   /* No limits on picture size */
+		    useoverview,   /* may load an overview of a too-big image */
 		    resetroot,     /* true if we should clear in window mode */
                     noqcheck,      /* true if we should NOT do QuickCheck */
                     epicMode,      /* either SMOOTH, DITH, or RAW */
@@ -1412,7 +1464,10 @@ WHERE int           bwidth,        /* border width of created windows */
                     nopos,         /* if true, don't set PPosition, USPosition hints */
                     xerrcode,      /* errorcode of last X error */
                     grabDelay,     /* # of seconds to sleep at start of Grab */
-                    startGrab;     /* start immediate grab ? */
+                    startGrab,     /* start immediate grab ? */
+                    recFrames,     /* # of frames to record after a Grab */
+                    recDelay;      /* msec between recorded frames */
+WHERE char         *recName;       /* printf() template for their names */
 
 WHERE int           state824;      /* displays warning when going 8->24 */
 
@@ -1637,9 +1692,11 @@ WHERE int           mgcsfxUp;      /* is mgcsfxW mapped, or what? */
 void  SendSelection        PARM((Atom, Window, Atom, Atom, Time, char const *));
 int   ReadFileType         PARM((char *));
 int   ReadPicFile          PARM((char *, int, PICINFO *, int));
+int   OverviewSize         PARM((int, int, int, int *, int *));
 char *QuoteFileName        PARM((char *, const char *, int));
 int   UncompressFile       PARM((char *, char *, int));
 void  KillPageFiles        PARM((char *, int));
+void  KillPageDoc          PARM((void));
 #ifdef MACBINARY
 int   RemoveMacbinary      PARM((char *, char *));
 #endif
@@ -1671,6 +1728,10 @@ void AlgInit               PARM((void));
 void DoAlg                 PARM((int));
 
 
+/*************************** XVBATCH.C ***************************/
+int  BatchMain             PARM((int, char **));
+
+
 /*************************** XVBROWSE.C ************************/
 void CreateBrowse          PARM((const char *, int, const char *, const char *,
 				 const char *, const char *));
@@ -1685,6 +1746,8 @@ void SetBrowStr            PARM((const char *));
 void RegenBrowseIcons      PARM((void));
 void BRDeletedFile         PARM((char *));
 void BRCreatedFile         PARM((char *));
+int  BrowseFD              PARM((void));
+void BrowseInotify         PARM((void));
 
 
 /**************************** XVBUTT.C ***************************/
@@ -1788,6 +1851,7 @@ void DoImgClear            PARM((void));
 void DoImgPaste            PARM((void));
 
 void SaveToClip            PARM((byte *));
+void SweepClipboard        PARM((void));
 void InitSelection         PARM((void));
 int  HaveSelection         PARM((void));
 int  GetSelType            PARM((void));
@@ -1868,6 +1932,7 @@ void GetSaveSize           PARM((int *, int *));
 
 void InitPoll              PARM((void));
 int  CheckPoll             PARM((int));
+int  PollFD                PARM((void));
 void DIRDeletedFile        PARM((char *));
 void DIRCreatedFile        PARM((char *));
 FILE *pic2_OpenOutFile     PARM((char *, int *));
@@ -1915,6 +1980,7 @@ void GamSetAutoApply       PARM((int));
 /**************************** XVGRAB.C ***************************/
 int Grab                   PARM((void));
 int LoadGrab               PARM((PICINFO *));
+int GrabSeqName            PARM((const char *, int, char *, size_t));
 
 
 /**************************** XVGRAF.C ***************************/
@@ -1930,6 +1996,7 @@ void   Graf2Str            PARM((GRAF_STATE *, char *));
 int    Str2Graf            PARM((GRAF_STATE *, const char *));
 void   GetGrafState        PARM((GRAF *, GRAF_STATE *));
 int    SetGrafState        PARM((GRAF *, GRAF_STATE *));
+double GrafFunc            PARM((GRAF *, double));
 void   InitSpline          PARM((int *, int *, int, double *));
 double EvalSpline          PARM((int *, int *, double *, int, double));
 
@@ -1951,6 +2018,9 @@ void Flip                  PARM((int));
 void FlipPic               PARM((byte *, int, int, int));
 void InstallNewPic         PARM((void));
 void DrawEpic              PARM((void));
+void UpdatePicRect         PARM((int, int, int, int));
+int  DrawViewport          PARM((int, int, int, int));
+byte *EpicRect             PARM((int, int, int, int));
 void KillOldPics           PARM((void));
 
 byte *FSDither             PARM((byte *, int, int, int,
@@ -2056,6 +2126,7 @@ int   PUCheckEvent         PARM((XEvent *));
 
 /**************************** XVROOT.C ****************************/
 void MakeRootPic           PARM((void));
+void FreeRootTiles         PARM((void));
 void ClearRoot             PARM((void));
 void SaveRootInfo          PARM((void));
 void KillOldRootInfo       PARM((void));
@@ -2082,6 +2153,15 @@ byte *SmoothResize         PARM((byte *, int, int, int, int, byte *, byte *,
 byte *Smooth24             PARM((byte *, int, int, int, int, int,
 				 byte *, byte *, byte *));
 
+byte *SmoothMip            PARM((byte *, int, int, int, int, int,
+				 byte *, byte *, byte *));
+void  FreeMips             PARM((void));
+
+byte *Resample24           PARM((byte *, int, int, int, int, int,
+				 byte *, byte *, byte *, int, int));
+int   SmoothFilterNum      PARM((const char *));
+int   LightTables          PARM((int, u_short **, byte **));
+
 byte *DoColorDither        PARM((byte *, byte *, int, int, byte *, byte *,
 				 byte *, byte *, byte *, byte *, int));
 
@@ -2089,6 +2169,39 @@ byte *Do332ColorDither     PARM((byte *, byte *, int, int, byte *, byte *,
 				 byte *, byte *, byte *, byte *, int));
 
 
+/*************************** XVPOOL.C ***************************/
+byte *PoolAlloc            PARM((size_t));
+void  PoolFree             PARM((void *));
+void  PoolTrim             PARM((void));
+void  PoolStats            PARM((FILE *));
+
+
+/*************************** XVDEEP.C ***************************/
+void  DeepTake             PARM((PICINFO *));
+void  FreeDeep             PARM((void));
+void  DeepStale            PARM((void));
+int   DeepValid            PARM((void));
+int   DeepGetLevels        PARM((int *, int *, double *));
+void  DeepDevelop          PARM((int, int, double));
+int   DeepGetWindow        PARM((double *, double *));
+int   DeepSetWindow        PARM((double, double));
+int   DeepNorm             PARM((void));
+void  DeepKeepOrig         PARM((void));
+int   DeepHoldOrig         PARM((void));
+void  DeepRestoreOrig      PARM((void));
+void  DeepRotate           PARM((int));
+void  DeepFlip             PARM((int));
+int   DeepGammify          PARM((byte *, GRAF *, GRAF *, GRAF *, GRAF *));
+
+
+/*************************** XVTHREAD.C ***************************/
+int  ParallelWorkers       PARM((int));
+void ParallelRun           PARM((int, void (*)(void *, int), void *));
+int  ParallelNext          PARM((int *, int));
+void ParallelLock          PARM((void));
+void ParallelUnlock        PARM((void));
+
+
 /*************************** XVTEXT.C ************************/
 void CreateTextWins        PARM((const char *, const char *));
 int  TextView              PARM((const char *));
@@ -2181,6 +2294,8 @@ void CreateJPEGW           PARM((void));
 void JPEGDialog            PARM((int));
 int  JPEGCheckEvent        PARM((XEvent *));
 void JPEGSaveParams        PARM((char *, int));
+int  JPEGBatchSave         PARM((FILE *, byte *, int, int, int, byte *,
+				 byte *, byte *, int, int, char *, int));
 void VersionInfoJPEG       PARM((void));		/* GRR 19980605 */
 
 /**************************** XVMAG.C ***************************/
@@ -2261,6 +2376,8 @@ void CreatePNGW            PARM((void));
 void PNGDialog             PARM((int));
 int  PNGCheckEvent         PARM((XEvent *));
 void PNGSaveParams         PARM((char *, int));
+int  PNGBatchSave          PARM((FILE *, byte *, int, int, int, byte *,
+				 byte *, byte *, int, int, char *, int));
 void VersionInfoPNG        PARM((void));		/* GRR 19980605 */
 
 /**************************** XVPS.C ****************************/
@@ -26,8 +26,13 @@ static void FineRotate     PARM((int));
 static void Pixelize       PARM((void));
 static void Spread         PARM((void));
 static void MedianFilter   PARM((void));
+static void LocalEqualize  PARM((void));
+static void Levels         PARM((void));
 
 void saveOrigPic    PARM((void));
+static void keepOrigPic    PARM((int));
+static int  changedRect    PARM((byte *, byte *, int, int,
+				 int *, int *, int *, int *));
 
 static void doBlurConvolv  PARM((byte *,int,int,byte *, int,int,int,int, int));
 static void doSharpConvolv PARM((byte *,int,int,byte *, int,int,int,int, int));
@@ -42,6 +47,12 @@ static void doPixel        PARM((byte *,int,int,byte *, int,int,int,int,
 static void doSpread       PARM((byte *,int,int,byte *, int,int,int,int,
 				 int, int));
 static void doMedianFilter PARM((byte *,int,int,byte *, int,int,int,int, int));
+static void doLocalEq      PARM((byte *,int,int,byte *, int,int,int,int,
+				 int, int));
+static void doLevels       PARM((byte *,int,int,byte *, int,int,int,int,
+				 int, int, double));
+static void leqTileWorker  PARM((void *, int));
+static void leqPixWorker   PARM((void *, int));
 static void add2bb         PARM((int *, int *, int *, int *, int, int));
 static void rotXfer        PARM((int, int, double *,double *,
 				 double,double, double));
@@ -57,6 +68,20 @@ void        printUTime     PARM((const char *));
 static byte origrmap[256], origgmap[256], origbmap[256];
 
 
+/* shared state for the doLocalEq() workers */
+typedef struct { byte *pic24, *results;
+		 int   w;                 /* width of pic24 and results */
+		 int   sx, sy, sw, sh;    /* area being equalized */
+		 int   ntx, nty;          /* tiles across and down */
+		 int   limit;             /* contrast limit, x mean bin height */
+		 byte *maps;              /* 256-entry intensity map per tile */
+		 int  *txi, *txw;         /* per column:  left tile, weight */
+		 int   nunits, next;      /* ParallelNext() counter */
+	       } LEQPAR;
+
+#define LEQBAND 16                /* rows per unit of work */
+
+
 #undef TIMING_TEST
 
 #ifdef TIMING_TEST
@@ -113,6 +138,8 @@ void DoAlg(int anum)
   case ALG_PIXEL:     Pixelize();     	break;
   case ALG_SPREAD:    Spread();       	break;
   case ALG_MEDIAN:    MedianFilter(); 	break;
+  case ALG_LOCALEQ:   LocalEqualize();	break;
+  case ALG_LEVELS:    Levels();       	break;
   }
 
   algMB.dim[ALG_NONE] = (origPic == (byte *) NULL);
@@ -124,19 +151,21 @@ void DoAlg(int anum)
 /************************/
 static void NoAlg(void)
 {
-  int i;
+  int i, deep;
 
   /* restore original picture */
   if (!origPic) return;  /* none to restore */
 
   WaitCursor();
 
+  deep = DeepHoldOrig();  /* keep the 16-bit master, if it made origPic */
   KillOldPics();   /* toss the old pic/cpic/epic/theImage away */
 
   picType = origPicType;
   Set824Menus(picType);
 
   pic = origPic;  origPic = NULL;
+  if (deep) DeepRestoreOrig();
 
   if (picType == PIC8) {
     for (i=0; i<256; i++) {
@@ -547,6 +576,124 @@ static void MedianFilter(void)
 }
 
 
+/************************/
+static void LocalEqualize(void)
+{
+  /* contrast-limited adaptive histogram equalization.  Each tile of the
+     selection gets its own equalization curve, with each histogram bin
+     clipped at 'limit' times the average bin height (so flat areas don't
+     turn into noise), and every pixel is remapped through the curves of
+     the four nearest tiles, bilinearly blended */
+
+  byte              *pic24, *tmpPic;
+  int                i, sx,sy,sw,sh, tsize, limit;
+  static const char *labels[] = { "\nOk", "\033Cancel" };
+  char               txt[256];
+  static char        buf[64] = { '6', '4', ' ', '3', '\0' };
+
+  sprintf(txt, "Local Equalize:\n\n%s\n%s",
+	  "Enter tile size, in image pixels, and contrast limit",
+	  "(ex. '64', '64 3')");
+
+  i = GetStrPopUp(txt, labels, 2, buf, 64, "0123456789 ", 1);
+  if (i==1 || strlen(buf)==0) return;
+
+  limit = 3;
+  i = sscanf(buf, "%d %d", &tsize, &limit);
+
+  if (i<1 || tsize<8 || limit<1) {
+    ErrPopUp("Error:  The tile size must be at least 8, and the limit at least 1.",
+	     "\nOh!");
+    return;
+  }
+
+  WaitCursor();
+
+  if (HaveSelection()) GetSelRCoords(&sx,&sy,&sw,&sh);
+  else { sx = 0;  sy = 0;  sw = pWIDE;  sh = pHIGH; }
+  CropRect2Rect(&sx,&sy,&sw,&sh, 0,0,pWIDE,pHIGH);
+
+  SetISTR(ISTR_INFO, "Equalizing %s in %dx%d tiles...",
+	  (HaveSelection() ? "selection" : "image"), tsize, tsize);
+
+  if (start24bitAlg(&pic24, &tmpPic)) return;
+  bcopy((char *) pic24, (char *) tmpPic, (size_t) (pWIDE*pHIGH*3));
+
+  doLocalEq(pic24, pWIDE,pHIGH, tmpPic, sx,sy,sw,sh, tsize, limit);
+
+  end24bitAlg(pic24, tmpPic);
+}
+
+
+/************************/
+static void Levels(void)
+{
+  /* maps 'lo' and below to black, 'hi' and up to white, and spreads the
+     values in between along a gamma curve.  A 16-bit image that hasn't
+     been edited is redeveloped from its full-precision samples instead,
+     in their own range.  Either way, Undo All takes it back */
+
+  byte              *pic24, *tmpPic;
+  int                i, sx,sy,sw,sh, lo,hi, maxv, deep;
+  double             gam;
+  static const char *labels[] = { "\nOk", "\033Cancel" };
+  char               txt[256];
+  static char        buf[64];
+
+  maxv = (HaveSelection()) ? 0 : DeepGetLevels(&lo, &hi, &gam);
+  deep = (maxv > 0);
+  if (!deep) { maxv = 255;  lo = 0;  hi = 255;  gam = 1.0; }
+  sprintf(buf, "%d %d %g", lo, hi, gam);
+
+  sprintf(txt, "Levels:\n\n%s (0-%d),\n%s",
+	  "Enter black point, white point", maxv,
+	  "and optionally gamma (ex. '16 235', '16 235 1.2')");
+
+  i = GetStrPopUp(txt, labels, 2, buf, 64, "0123456789. ", 1);
+  if (i==1 || strlen(buf)==0) return;
+
+  gam = 1.0;
+  i = sscanf(buf, "%d %d %lf", &lo, &hi, &gam);
+
+  if (i<2 || lo<0 || hi>maxv || hi<=lo || gam<=0.0) {
+    sprintf(txt, "Error:  %s 0 and %d, %s",
+	    "The black and white points must be between", maxv,
+	    "black first, and the gamma must be above 0.");
+    ErrPopUp(txt, "\nOh!");
+    return;
+  }
+
+  WaitCursor();
+
+  if (deep) {
+    SetISTR(ISTR_INFO, "Developing levels %d-%d, gamma %g...", lo, hi, gam);
+    keepOrigPic(1);
+    DeepDevelop(lo, hi, gam);
+
+    GenerateCpic();
+    WaitCursor();
+    GenerateEpic(eWIDE, eHIGH);
+    DrawEpic();
+    SetCursors(-1);
+    return;
+  }
+
+  if (HaveSelection()) GetSelRCoords(&sx,&sy,&sw,&sh);
+  else { sx = 0;  sy = 0;  sw = pWIDE;  sh = pHIGH; }
+  CropRect2Rect(&sx,&sy,&sw,&sh, 0,0,pWIDE,pHIGH);
+
+  SetISTR(ISTR_INFO, "Setting levels of %s to %d-%d, gamma %g...",
+	  (HaveSelection() ? "selection" : "image"), lo, hi, gam);
+
+  if (start24bitAlg(&pic24, &tmpPic)) return;
+  bcopy((char *) pic24, (char *) tmpPic, (size_t) (pWIDE*pHIGH*3));
+
+  doLevels(pic24, pWIDE,pHIGH, tmpPic, sx,sy,sw,sh, lo, hi, gam);
+
+  end24bitAlg(pic24, tmpPic);
+}
+
+
 
 /************************/
 static void doBlurConvolv(byte *pic24, int w, int h, byte *results, int selx, int sely, int selw, int selh, int n)
@@ -555,17 +702,19 @@ static void doBlurConvolv(byte *pic24, int w, int h, byte *results, int selx, in
   /* convolves with an n*n array, consisting of only 1's.
      Operates on rectangular region 'selx,sely,selw,selh' (in pic coords)
      Region is guaranteed to be completely within pic boundaries
-     'n' must be odd */
+     'n' must be odd.  Averages in linear light if 'linearLight' is set */
 
   register byte *p24;
-  register int   rsum,gsum,bsum;
-  byte          *rp;
+  double         rsum,gsum,bsum;    /* n*n*LINMAX can overflow an int */
+  byte          *rp, *fl;
+  u_short       *tl;
   int            x,y,x1,y1,count,n2;
 
 
   printUTime("start of blurConvolv");
 
   n2 = n/2;
+  LightTables(linearLight, &tl, &fl);
 
   for (y=sely; y<sely+selh; y++) {
     ProgressMeter(sely, (sely+selh)-1, y, "Blur");
@@ -585,9 +734,9 @@ static void doBlurConvolv(byte *pic24, int w, int h, byte *results, int selx, in
 
 	  for (x1=x-n2; x1<=x+n2; x1++) {
 	    if (x1>=selx && x1<selx+selw) {
-	      rsum += *p24++;
-	      gsum += *p24++;
-	      bsum += *p24++;
+	      rsum += tl[*p24++];
+	      gsum += tl[*p24++];
+	      bsum += tl[*p24++];
 	      count++;
 	    }
 	    else p24 += 3;
@@ -595,17 +744,9 @@ static void doBlurConvolv(byte *pic24, int w, int h, byte *results, int selx, in
 	}
       }
 
-      rsum = rsum / count;
-      gsum = gsum / count;
-      bsum = bsum / count;
-
-      RANGE(rsum,0,255);
-      RANGE(gsum,0,255);
-      RANGE(bsum,0,255);
-
-      *rp++ = (byte) rsum;
-      *rp++ = (byte) gsum;
-      *rp++ = (byte) bsum;
+      *rp++ = fl[(int) (rsum / count)];
+      *rp++ = fl[(int) (gsum / count)];
+      *rp++ = fl[(int) (bsum / count)];
     }
   }
 
@@ -979,38 +1120,42 @@ static void doBlend(byte *pic24, int w, int h, byte *results, int selx, int sely
      color of all the pixels on the edge of the rect, stores this in the
      center, and for each pixel in the rect, replaces it with a weighted
      average of the center color, and the color on the edge that intersects
-     a line drawn from the center to the point */
+     a line drawn from the center to the point.  The averages are in linear
+     light if 'linearLight' is set */
 
-  byte  *p24;
-  int    i,x,y;
-  int    cx,cy,cR,cG,cB;
-  int    ex,ey,eR,eG,eB;
-  int    dx,dy,r,g,b;
-  double rf,gf,bf, slope,dslope, d,d1, ratio;
+  byte    *p24, *fl;
+  u_short *tl;
+  int      i,x,y, white;
+  int      cx,cy,cR,cG,cB;
+  int      ex,ey,eR,eG,eB;
+  int      dx,dy,r,g,b;
+  double   rf,gf,bf, slope,dslope, d,d1, ratio;
 
   if (selw<3 || selh<3) return;        /* too small to blend */
 
   printUTime("start of blend");
 
+  white = LightTables(linearLight, &tl, &fl);
+
   /*** COMPUTE COLOR OF CENTER POINT ***/
 
   i = 0;  rf = gf = bf = 0.0;
   for (x=selx; x<selx+selw; x++) {
     p24 = pic24 + (sely*w + x) * 3;
-    rf += (double) p24[0];  gf += (double) p24[1];  bf += (double) p24[2];
+    rf += tl[p24[0]];  gf += tl[p24[1]];  bf += tl[p24[2]];
     i++;
 
     p24 = pic24 + ((sely+selh-1)*w + x) * 3;
-    rf += (double) p24[0];  gf += (double) p24[1];  bf += (double) p24[2];
+    rf += tl[p24[0]];  gf += tl[p24[1]];  bf += tl[p24[2]];
     i++;
   }
   for (y=sely; y<sely+selh; y++) {
     p24 = pic24 + (y*w + selx) * 3;
-    rf += (double) p24[0];  gf += (double) p24[1];  bf += (double) p24[2];
+    rf += tl[p24[0]];  gf += tl[p24[1]];  bf += tl[p24[2]];
     i++;
 
     p24 = pic24 + (y*w + (selx+selw-1)) * 3;
-    rf += (double) p24[0];  gf += (double) p24[1];  bf += (double) p24[2];
+    rf += tl[p24[0]];  gf += tl[p24[1]];  bf += tl[p24[2]];
     i++;
   }
 
@@ -1057,7 +1202,7 @@ static void doBlend(byte *pic24, int w, int h, byte *results, int selx, int sely
 
       /* fetch color of ex,ey */
       p24 = pic24 + (ey*w + ex) * 3;
-      eR = p24[0];  eG=p24[1];  eB=p24[2];
+      eR = tl[p24[0]];  eG = tl[p24[1]];  eB = tl[p24[2]];
 
       /* compute new color for x,y */
       if (dx==0 && dy==0) { r=cR;  g=cG;  b=cB; }
@@ -1065,14 +1210,14 @@ static void doBlend(byte *pic24, int w, int h, byte *results, int selx, int sely
 	r = cR + (int) ((eR-cR) * ratio);
 	g = cG + (int) ((eG-cG) * ratio);
 	b = cB + (int) ((eB-cB) * ratio);
-	RANGE(r,0,255);
-	RANGE(g,0,255);
-	RANGE(b,0,255);
+	RANGE(r,0,white);
+	RANGE(g,0,white);
+	RANGE(b,0,white);
       }
 
       /* and stuff it... */
       p24 = results + (y*w + x) * 3;
-      p24[0] = (byte) r;  p24[1] = (byte) g;  p24[2] = (byte) b;
+      p24[0] = fl[r];  p24[1] = fl[g];  p24[2] = fl[b];
     }
   }
 
@@ -1304,14 +1449,20 @@ static void doPixel(byte *pic24, int w, int h, byte *results, int selx, int sely
 {
   XV_UNUSED(h);
   /* runs 'pixelization' algorithm.  replaces each pixX-by-pixY region
-     (smaller on edges) with the average color within that region */
+     (smaller on edges) with the average color within that region
+     (in linear light, if 'linearLight' is set) */
 
-  byte  *pp;
-  int    nwide, nhigh, i,j, x,y, x1,y1, stx,sty;
-  int    nsum, rsum, gsum, bsum;
+  byte    *pp, *fl;
+  u_short *tl;
+  int      nwide, nhigh, i,j, x,y, x1,y1, stx,sty, nsum;
+  double   rsum, gsum, bsum;    /* pixX*pixY*LINMAX can overflow an int */
+  byte     r, g, b;
 
   printUTime("start of pixelize");
 
+  LightTables(linearLight, &tl, &fl);
+  r = g = b = 0;
+
   /* center grid on selection */
   nwide = (selw + pixX-1) / pixX;
   nhigh = (selh + pixY-1) / pixY;
@@ -1327,20 +1478,21 @@ static void doPixel(byte *pic24, int w, int h, byte *results, int selx, int sely
     for (j=0; j<nwide; j++, x+=pixX) {
 
       /* COMPUTE AVERAGE COLOR FOR RECT:[x,y,pixX,pixY] */
-      nsum = rsum = gsum = bsum = 0;
+      nsum = 0;  rsum = gsum = bsum = 0.0;
       for (y1=y; y1<y+pixY; y1++) {
 	pp = pic24 + (y1 * w + x) * 3;
 	for (x1=x; x1<x+pixX; x1++) {
 	  if (PTINRECT(x1,y1, selx,sely,selw,selh)) {
 	    nsum++;
-	    rsum += *pp++;  gsum += *pp++;  bsum += *pp++;
+	    rsum += tl[*pp++];  gsum += tl[*pp++];  bsum += tl[*pp++];
 	  }
 	}
       }
 
       if (nsum>0) {   /* just to be safe... */
-	rsum /= nsum;  gsum /= nsum;  bsum /= nsum;
-	RANGE(rsum,0,255);  RANGE(gsum,0,255);  RANGE(bsum,0,255);
+	r = fl[(int) (rsum / nsum)];
+	g = fl[(int) (gsum / nsum)];
+	b = fl[(int) (bsum / nsum)];
       }
 
 
@@ -1351,7 +1503,7 @@ static void doPixel(byte *pic24, int w, int h, byte *results, int selx, int sely
 	pp = results + (y1 * w + x) * 3;
 	for (x1=x; x1<x+pixX; x1++, pp+=3) {
 	  if (PTINRECT(x1,y1, selx,sely,selw,selh)) {
-	    pp[0] = (byte) rsum;  pp[1] = (byte) gsum;  pp[2] = (byte) bsum;
+	    pp[0] = r;  pp[1] = g;  pp[2] = b;
 	  }
 	}
       }
@@ -1542,6 +1694,206 @@ static void doMedianFilter(byte *pic24, int w, int h, byte *results, int selx, i
 }
 
 
+/************************/
+static void doLocalEq(byte *pic24, int w, int h, byte *results, int selx, int sely, int selw, int selh, int tsize, int limit)
+{
+  /* the guts of LocalEqualize().  First builds the per-tile curves, then
+     remaps the pixels, handing tiles and then bands of rows out to
+     ParallelRun() workers.  Works on the intensity (max of r,g,b), and
+     scales r,g,b to match, so hues are left alone.
+     Operates on rectangular region 'selx,sely,selw,selh' (in pic coords) */
+
+  LEQPAR lp;
+  int    x, i, c0, c1, cx;
+
+  XV_UNUSED(h);
+  printUTime("start of doLocalEq");
+
+  lp.pic24 = pic24;  lp.results = results;  lp.w = w;
+  lp.sx = selx;  lp.sy = sely;  lp.sw = selw;  lp.sh = selh;
+  lp.limit = limit;
+
+  lp.ntx = (selw + tsize/2) / tsize;  RANGE(lp.ntx, 1, 256);
+  lp.nty = (selh + tsize/2) / tsize;  RANGE(lp.nty, 1, 256);
+
+  lp.maps = (byte *) malloc((size_t) lp.ntx * lp.nty * 256);
+  lp.txi  = (int *)  malloc((size_t) selw * sizeof(int));
+  lp.txw  = (int *)  malloc((size_t) selw * sizeof(int));
+  if (!lp.maps || !lp.txi || !lp.txw) FatalError("out of memory in doLocalEq");
+
+  /* for each column, the tile whose center is at or left of it, and how
+     far (0..256) it is toward the next one.  Centers are in half-pixels */
+  for (x=0, i=0; x<selw; x++) {
+    cx = 2*x + 1;
+    while (i < lp.ntx-1 &&
+	   cx >= (int) ((2L*(i+1)+1) * selw / lp.ntx)) i++;
+
+    c0 = (int) ((2L*i+1) * selw / lp.ntx);
+    c1 = (int) ((2L*i+3) * selw / lp.ntx);
+
+    lp.txi[x] = i;
+    if (cx <= c0 || i == lp.ntx-1) lp.txw[x] = 0;
+    else lp.txw[x] = ((cx - c0) * 256) / (c1 - c0);
+  }
+
+  WaitCursor();
+  lp.nunits = lp.ntx * lp.nty;  lp.next = 0;
+  ParallelRun(ParallelWorkers(lp.nunits), leqTileWorker, (void *) &lp);
+
+  WaitCursor();
+  lp.nunits = (selh + LEQBAND - 1) / LEQBAND;  lp.next = 0;
+  ParallelRun(ParallelWorkers(lp.nunits), leqPixWorker, (void *) &lp);
+
+  free(lp.maps);  free(lp.txi);  free(lp.txw);
+  printUTime("end of doLocalEq");
+}
+
+
+/************************/
+static void leqTileWorker(void *data, int worker)
+{
+  /* ParallelRun() worker:  builds the clipped equalization curve of one
+     tile at a time */
+
+  LEQPAR *lp = (LEQPAR *) data;
+  int     t, tx, ty, x0, x1, y0, y1, x, y, v, i;
+  long    hist[256], n, clip, excess, cdf;
+  byte   *p, *map;
+
+  XV_UNUSED(worker);
+
+  while ((t = ParallelNext(&lp->next, lp->nunits)) >= 0) {
+    tx = t % lp->ntx;  ty = t / lp->ntx;
+    x0 = lp->sx + (int) ((long)  tx    * lp->sw / lp->ntx);
+    x1 = lp->sx + (int) ((long) (tx+1) * lp->sw / lp->ntx);
+    y0 = lp->sy + (int) ((long)  ty    * lp->sh / lp->nty);
+    y1 = lp->sy + (int) ((long) (ty+1) * lp->sh / lp->nty);
+
+    for (i=0; i<256; i++) hist[i] = 0;
+
+    for (y=y0; y<y1; y++) {
+      p = lp->pic24 + ((size_t) y * lp->w + x0) * 3;
+      for (x=x0; x<x1; x++, p+=3) {
+	v = p[0];
+	if (p[1] > v) v = p[1];
+	if (p[2] > v) v = p[2];
+	hist[v]++;
+      }
+    }
+
+    n = (long) (x1-x0) * (y1-y0);
+    if (n < 1) n = 1;
+
+    /* clip the histogram, and spread what was clipped off over all bins.
+       counts are in 1/256ths of a pixel, so the average bin is 'n' high,
+       and small tiles don't round the limit away */
+    clip = lp->limit * n;
+
+    for (i=0, excess=0; i<256; i++) {
+      hist[i] *= 256;
+      if (hist[i] > clip) { excess += hist[i] - clip;  hist[i] = clip; }
+    }
+    for (i=0; i<256; i++) hist[i] += excess / 256;
+    for (i=0; i < excess % 256; i++) hist[(i * 256) / (excess % 256)]++;
+
+    map = lp->maps + (size_t) t * 256;
+    for (i=0, cdf=0; i<256; i++) {
+      cdf += hist[i];
+      map[i] = (byte) ((cdf * 255 + n*128) / (n*256));
+    }
+  }
+}
+
+
+/************************/
+static void leqPixWorker(void *data, int worker)
+{
+  /* ParallelRun() worker:  remaps LEQBAND rows at a time, blending the
+     curves of the four tiles around each pixel */
+
+  LEQPAR *lp = (LEQPAR *) data;
+  int     band, y, y1, x, v, nv, ty, wy, wx, cy, c0, c1, top, bot;
+  byte   *p, *rp, *m00, *m01, *m10, *m11;
+  size_t  ts;
+
+  XV_UNUSED(worker);
+
+  while ((band = ParallelNext(&lp->next, lp->nunits)) >= 0) {
+    y  = band * LEQBAND;
+    y1 = y + LEQBAND;
+    if (y1 > lp->sh) y1 = lp->sh;
+
+    for ( ; y<y1; y++) {
+      /* the tile row whose center is at or above this row, and the weight
+	 of the one below it.  as for columns, in doLocalEq() */
+      cy = 2*y + 1;
+      for (ty=0; ty < lp->nty-1 &&
+	         cy >= (int) ((2L*(ty+1)+1) * lp->sh / lp->nty); ty++);
+      c0 = (int) ((2L*ty+1) * lp->sh / lp->nty);
+      c1 = (int) ((2L*ty+3) * lp->sh / lp->nty);
+      if (cy <= c0 || ty == lp->nty-1) wy = 0;
+      else wy = ((cy - c0) * 256) / (c1 - c0);
+
+      p  = lp->pic24   + ((size_t) (lp->sy + y) * lp->w + lp->sx) * 3;
+      rp = lp->results + ((size_t) (lp->sy + y) * lp->w + lp->sx) * 3;
+
+      for (x=0; x<lp->sw; x++, p+=3) {
+	ts  = (size_t) (ty * lp->ntx + lp->txi[x]) * 256;
+	m00 = lp->maps + ts;
+	m01 = (lp->txw[x]) ? m00 + 256 : m00;
+	m10 = (wy) ? m00 + lp->ntx * 256 : m00;
+	m11 = (wy) ? m01 + lp->ntx * 256 : m01;
+	wx  = lp->txw[x];
+
+	v = p[0];
+	if (p[1] > v) v = p[1];
+	if (p[2] > v) v = p[2];
+
+	top = m00[v] * (256 - wx) + m01[v] * wx;
+	bot = m10[v] * (256 - wx) + m11[v] * wx;
+	nv  = (top * (256 - wy) + bot * wy + 32768) >> 16;
+
+	if (v == 0) { *rp++ = nv;  *rp++ = nv;  *rp++ = nv; }
+	else {
+	  *rp++ = (p[0] * nv + v/2) / v;
+	  *rp++ = (p[1] * nv + v/2) / v;
+	  *rp++ = (p[2] * nv + v/2) / v;
+	}
+      }
+    }
+  }
+}
+
+
+/************************/
+static void doLevels(byte *pic24, int w, int h, byte *results, int selx, int sely, int selw, int selh, int lo, int hi, double gam)
+{
+  /* maps each component of the selected area through the levels curve,
+     putting the result in 'results' */
+
+  byte   lut[256], *p, *rp;
+  int    i, x, y, v;
+  double invg;
+
+  XV_UNUSED(h);
+
+  invg = 1.0 / gam;
+  for (i=0; i<256; i++) {
+    if      (i <= lo) v = 0;
+    else if (i >= hi) v = 255;
+    else v = (int) (255.0 * pow((double) (i - lo) / (hi - lo), invg) + 0.5);
+    lut[i] = (byte) v;
+  }
+
+  for (y=sely; y<sely+selh; y++) {
+    if ((y & 63) == 0) WaitCursor();
+    p  = pic24   + ((size_t) y * w + selx) * 3;
+    rp = results + ((size_t) y * w + selx) * 3;
+    for (x=0; x<selw*3; x++) *rp++ = lut[*p++];
+  }
+}
+
+
 #ifdef FOO
 /***********************************************/
 static void intsort(a, n)
@@ -1601,6 +1953,21 @@ void end24bitAlg(byte *pic24, byte *outPic)
 {
   /* given pic24, and outPic, which has the new 24-bit image, installs it */
 
+  int x,y,w,h;
+
+  if (picType == PIC24 && theImage) {
+    /* nothing to requantize, so only the area that the algorithm actually
+       changed (usually the selection) has to be regenerated and redrawn */
+    keepOrigPic(0);
+    x = y = w = h = 0;
+    changedRect(pic24, outPic, pWIDE, pHIGH, &x, &y, &w, &h);
+    bcopy((char *) outPic, (char *) pic24, (size_t) (pWIDE*pHIGH*3));
+    free(outPic);
+
+    if (w && h) UpdatePicRect(x, y, w, h);
+    SetCursors(-1);
+    return;
+  }
 
   saveOrigPic();  /* also kills pic/cpic/epic/egampic/theImage, NOT pic24 */
 
@@ -1633,16 +2000,34 @@ void saveOrigPic(void)
      Also, frees all pics, (except 'pic', if we're in PIC24 mode) */
 
 
-  int i;
-
   FreeEpic();
-  if (cpic && cpic != pic) free(cpic);
+  FreeMips();
+  if (cpic && cpic != pic) PoolFree(cpic);
   xvDestroyImage(theImage);
   theImage = NULL;
   cpic = NULL;
 
+  keepOrigPic(0);
+
+  if (picType != PIC24) {  /* kill pic, as well */
+    if (pic) free(pic);
+    pic = NULL;
+  }
+}
+
+
+/************************/
+static void keepOrigPic(int redevelop)
+{
+  /* the backup half of saveOrigPic().  leaves cpic, epic and theImage
+     alone.  'redevelop' is set if 'pic' is only going to be redeveloped
+     from its 16-bit master, so the master still describes it afterwards */
+
+  int i;
+
   if (!origPic) {
-    /* make a backup copy of 'pic' */
+    /* make a backup copy of 'pic' (which may be the master's, too) */
+    DeepKeepOrig();
     origPic = (byte *) malloc((size_t)(pWIDE*pHIGH*((picType==PIC8) ? 1 : 3)));
     if (!origPic) FatalError("out of memory in 'saveOrigPic()'");
     bcopy((char *) pic, (char *) origPic,
@@ -1659,10 +2044,40 @@ void saveOrigPic(void)
     }
   }
 
+  if (!redevelop) DeepStale();   /* 'pic' is about to stop matching it */
+}
 
-  if (picType != PIC24) {  /* kill pic, as well */
-    if (pic) free(pic);
-    pic = NULL;
+
+/************************/
+static int changedRect(byte *pic1, byte *pic2, int w, int h,
+		       int *rx, int *ry, int *rw, int *rh)
+{
+  /* finds the bounding box of the pixels that differ between two w*h
+     24-bit images.  Returns '0' (and leaves rx,ry,rw,rh alone) if they're
+     identical */
+
+  byte  *p1, *p2;
+  int    y, i, x0, x1, y0, y1;
+  size_t bpl;
+
+  bpl = (size_t) w * 3;
+  x0 = w;  x1 = -1;  y0 = h;  y1 = -1;
+
+  for (y=0, p1=pic1, p2=pic2; y<h; y++, p1+=bpl, p2+=bpl) {
+    if (!memcmp(p1, p2, bpl)) continue;
+
+    if (y0 > y) y0 = y;
+    y1 = y;
+
+    for (i=0; p1[i] == p2[i]; i++);
+    if (x0 > i/3) x0 = i/3;
+    for (i=(int) bpl-1; p1[i] == p2[i]; i--);
+    if (x1 < i/3) x1 = i/3;
   }
+
+  if (y1 < 0) return 0;
+
+  *rx = x0;  *ry = y0;  *rw = x1-x0+1;  *rh = y1-y0+1;
+  return 1;
 }
 
@@ -0,0 +1,556 @@
+/*
+ * xvbatch.c - headless batch conversion ('xv -batch ...')
+ *
+ *  Contains:
+ *            int BatchMain(argc, argv)
+ *
+ * Converts a list of files without ever opening the display:  each file is
+ * loaded with ReadPicFile(), optionally cropped, resized and color-reduced,
+ * and written with one of the Write*() routines.  Files are independent, so
+ * several are converted at once, each in its own child process.  (The
+ * loaders are reentrant, but the image buffer pool, the conversion settings
+ * and FatalError() are process-wide, and a file that crashes its loader
+ * only takes itself down.)
+ *
+ * Formats whose writers live entirely inside a dialog box (TIFF, PostScript,
+ * JPEG 2000, ...) aren't offered here.
+ */
+
+#include "copyright.h"
+
+#include "xv.h"
+
+#include <sys/wait.h>
+
+
+typedef struct {
+  const char *name;      /* as given to '-format' */
+  const char *ext;       /* suffix for the output files */
+  int         fmt;       /* F_* save format */
+  int         col;       /* F_* color type it implies, or -1 */
+} BFMT;
+
+static BFMT bfmts[] = {
+  { "gif",    "gif",  F_GIF,      -1 },
+#ifdef HAVE_PNG
+  { "png",    "png",  F_PNG,      -1 },
+#endif
+#ifdef HAVE_JPEG
+  { "jpeg",   "jpg",  F_JPEG,     -1 },
+  { "jpg",    "jpg",  F_JPEG,     -1 },
+#endif
+#ifdef HAVE_WEBP
+  { "webp",   "webp", F_WEBP,     -1 },
+#endif
+  { "ppm",    "ppm",  F_PBMRAW,   -1 },
+  { "pgm",    "pgm",  F_PBMRAW,   F_GREYSCALE },
+  { "pbm",    "pbm",  F_PBMRAW,   F_BWDITHER },
+  { "pnm",    "pnm",  F_PBMRAW,   -1 },
+  { "xbm",    "xbm",  F_XBM,      F_BWDITHER },
+  { "xpm",    "xpm",  F_XPM,      -1 },
+  { "bmp",    "bmp",  F_BMP,      -1 },
+  { "sunras", "ras",  F_SUNRAS,   -1 },
+  { "iris",   "rgb",  F_IRIS,     -1 },
+  { "targa",  "tga",  F_TARGA,    -1 },
+  { "fits",   "fits", F_FITS,     -1 },
+  { "pm",     "pm",   F_PM,       -1 },
+  { "zx",     "scr",  F_ZX,       -1 },
+  { "wbmp",   "wbmp", F_WBMP,     F_BWDITHER },
+#ifdef HAVE_MAG
+  { "mag",    "mag",  F_MAG,      -1 },
+#endif
+#ifdef HAVE_PIC
+  { "pic",    "pic",  F_PIC,      -1 },
+#endif
+#ifdef HAVE_MAKI
+  { "maki",   "mki",  F_MAKI,     -1 },
+#endif
+#ifdef HAVE_PI
+  { "pi",     "pi",   F_PI,       -1 },
+#endif
+  { NULL,     NULL,   0,          -1 }
+};
+
+
+typedef struct {
+  BFMT  *fmt;
+  char  *outdir;                 /* NULL:  next to the input file */
+  int    cx, cy, cw, ch;         /* crop rectangle, cw==0 if none */
+  int    rw, rh;                 /* resize to, 0,0 if none */
+  double expx, expy;             /* expand by, 0.0 if none */
+  int    ncols;                  /* reduce to this many colors, 0 if not */
+  int    col;                    /* forced F_* color type, or -1 */
+  int    quality;                /* JPEG quality / PNG level, -1 = default */
+} BOPTS;
+
+
+static void batchSyntax  PARM((void));
+static int  batchFile    PARM((BOPTS *, char *));
+static int  batchWrite   PARM((BOPTS *, FILE *, char *, byte *, int, int, int,
+                               byte *, byte *, byte *, int, int, char *));
+static void batchOutName PARM((BOPTS *, char *, char *, size_t));
+static int  batchReap    PARM((void));
+
+
+
+/***************************************************/
+int BatchMain(int argc, char **argv)
+{
+  /* called from main() in place of the usual X startup when '-batch' is on
+     the command line.  returns the exit status:  0 if every file converted */
+
+  BOPTS  bo;
+  BFMT  *bf;
+  char **files;
+  int    i, nfiles, nrun, nfail, maxrun;
+  pid_t  pid;
+
+  bzero((char *) &bo, sizeof(bo));
+  bo.col = -1;  bo.quality = -1;
+
+  files = (char **) malloc(argc * sizeof(char *));
+  if (!files) FatalError("can't malloc file list in BatchMain()");
+  nfiles = 0;
+
+  for (i=1; i<argc; i++) {
+    if      (!strcmp(argv[i], "-batch")) continue;
+    else if (!strcmp(argv[i], "-format") && i+1<argc) {
+      i++;
+      for (bf=bfmts; bf->name && strcasecmp(bf->name, argv[i]); bf++);
+      if (!bf->name) {
+	fprintf(stderr, "%s: can't write '%s' files in batch mode\n",
+		cmd, argv[i]);
+	batchSyntax();
+	return 1;
+      }
+      bo.fmt = bf;
+    }
+    else if (!strcmp(argv[i], "-o") && i+1<argc)        bo.outdir = argv[++i];
+    else if (!strcmp(argv[i], "-crop") && i+4<argc) {
+      bo.cx = atoi(argv[++i]);  bo.cy = atoi(argv[++i]);
+      bo.cw = atoi(argv[++i]);  bo.ch = atoi(argv[++i]);
+    }
+    else if (!strcmp(argv[i], "-resize") && i+2<argc) {
+      bo.rw = atoi(argv[++i]);  bo.rh = atoi(argv[++i]);
+    }
+    else if (!strcmp(argv[i], "-expand") && i+1<argc) {
+      i++;
+      if (index(argv[i], ':')) {
+	if (sscanf(argv[i], "%lf:%lf", &bo.expx, &bo.expy) != 2)
+	  bo.expx = bo.expy = 0.0;
+      }
+      else bo.expx = bo.expy = atof(argv[i]);
+    }
+    else if (!strcmp(argv[i], "-filter") && i+1<argc) {
+      if ((smoothFilter = SmoothFilterNum(argv[++i])) < 0) {
+	fprintf(stderr, "%s: unknown filter '%s'\n", cmd, argv[i]);
+	batchSyntax();
+	return 1;
+      }
+    }
+    else if (!strcmp(argv[i], "-linear"))              linearLight = 1;
+    else if (!strcmp(argv[i], "-ncols") && i+1<argc)    bo.ncols = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-grey") ||
+	     !strcmp(argv[i], "-gray"))                bo.col = F_GREYSCALE;
+    else if (!strcmp(argv[i], "-mono"))                bo.col = F_BWDITHER;
+    else if (!strcmp(argv[i], "-quality") && i+1<argc)  bo.quality = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-threads") && i+1<argc)  numThreads = abs(atoi(argv[++i]));
+    else if (!strcmp(argv[i], "-quick24"))             conv24 = CONV24_FAST;
+    else if (!strcmp(argv[i], "-slow24"))              conv24 = CONV24_SLOW;
+    else if (!strcmp(argv[i], "-best24"))              conv24 = CONV24_BEST;
+    else if (argv[i][0] == '-' && argv[i][1]) {
+      fprintf(stderr, "%s: unknown or incomplete batch option '%s'\n",
+	      cmd, argv[i]);
+      batchSyntax();
+      return 1;
+    }
+    else files[nfiles++] = argv[i];
+  }
+
+  if (!bo.fmt || !nfiles || bo.cw < 0 || bo.ch < 0 || bo.rw < 0 ||
+      bo.rh < 0 || bo.expx < 0.0 || bo.expy < 0.0 ||
+      bo.ncols < 0 || bo.ncols > 256) {
+    batchSyntax();
+    return 1;
+  }
+
+  if (bo.col < 0) bo.col = bo.fmt->col;
+
+
+  /* one child process per file, up to 'maxrun' of them at a time.  when
+     more than one is running, each child sticks to a single thread */
+
+  maxrun = ParallelWorkers(nfiles);
+  nrun = nfail = 0;
+
+  for (i=0; i<nfiles; i++) {
+    if (maxrun > 1) {
+      while (nrun >= maxrun) { nfail += batchReap();  nrun--; }
+
+      fflush(stdout);  fflush(stderr);
+      pid = fork();
+      if (pid == 0) {
+	numThreads = 1;
+	exit(batchFile(&bo, files[i]));
+      }
+      if (pid > 0) { nrun++;  continue; }
+    }
+
+    /* only one worker wanted, or fork() failed:  do it right here */
+    nfail += batchFile(&bo, files[i]);
+  }
+
+  while (nrun > 0) { nfail += batchReap();  nrun--; }
+
+  if (nfail) fprintf(stderr, "%s: %d of %d file%s not converted\n",
+		     cmd, nfail, nfiles, (nfiles==1) ? "" : "s");
+
+  free(files);
+  return (nfail) ? 1 : 0;
+}
+
+
+/***************************************************/
+static void batchSyntax(void)
+{
+  BFMT *bf;
+
+  fprintf(stderr, "Usage:\n");
+  fprintf(stderr, "  %s -batch -format fmt [-o dir] [-crop x y w h]\n", cmd);
+  fprintf(stderr, "     [-resize w h | -expand exp | hexp:vexp] [-filter type]\n");
+  fprintf(stderr, "     [-linear] [-ncols #]");
+  fprintf(stderr, " [-grey | -mono] [-quick24 | -slow24 | -best24]\n");
+  fprintf(stderr, "     [-quality #] [-threads #] filename ...\n\n");
+  fprintf(stderr, "  '-resize' keeps the aspect ratio if either size is 0.\n");
+  fprintf(stderr, "  '-filter' is xv, box, bilinear, mitchell or lanczos.\n");
+  fprintf(stderr, "  '-linear' resizes in linear light.\n");
+  fprintf(stderr, "  '-quality' is the JPEG quality or the PNG compression level.\n\n");
+
+  fprintf(stderr, "  Formats:");
+  for (bf=bfmts; bf->name; bf++) fprintf(stderr, " %s", bf->name);
+  fprintf(stderr, "\n");
+}
+
+
+/***************************************************/
+static int batchReap(void)
+{
+  /* waits for one child.  returns '1' if it failed */
+
+  int status;
+
+  while (wait(&status) < 0) {
+    if (errno != EINTR) return 1;
+  }
+
+  return (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : 1;
+}
+
+
+/***************************************************/
+static int batchFile(BOPTS *bo, char *fname)
+{
+  /* converts one file.  returns '0' on success, '1' on failure */
+
+  PICINFO  pinfo;
+  FILE    *fp;
+  char     loadname[MAXPATHLEN], uncname[128], outname[MAXPATHLEN];
+  byte    *pic, *pic2, *rp, *gp, *bp;
+  byte     r2[256], g2[256], b2[256];
+  int      ftype, ptype, w, h, nc, col, rv, bperpix, i;
+  int      x, y, cw, ch, dw, dh;
+
+  strncpy(loadname, fname, sizeof(loadname) - 1);
+  loadname[sizeof(loadname) - 1] = '\0';
+  uncname[0] = '\0';
+
+  ftype = ReadFileType(loadname);
+  if (ftype == RFT_COMPRESS || ftype == RFT_BZIP2 || ftype == RFT_XZ) {
+    if (UncompressFile(loadname, uncname, ftype)) {
+      strcpy(loadname, uncname);
+      ftype = ReadFileType(loadname);
+    }
+    else ftype = RFT_ERROR;
+  }
+
+  if (ftype == RFT_ERROR || ftype == RFT_UNKNOWN) {
+    fprintf(stderr, "%s: %s:  %s\n", cmd, fname,
+	    (ftype == RFT_ERROR) ? "couldn't read file" : "unknown format");
+    if (uncname[0]) unlink(uncname);
+    return 1;
+  }
+
+  bzero((char *) &pinfo, sizeof(PICINFO));
+  rv = ReadPicFile(loadname, ftype, &pinfo, 0);
+  if (uncname[0]) unlink(uncname);
+
+  if (!rv || !pinfo.pic) {
+    fprintf(stderr, "%s: %s:  couldn't load image\n", cmd, fname);
+    return 1;
+  }
+
+  /* only the first page of multi-page files (PostScript, etc.) is kept */
+  if (pinfo.numpages > 1) KillPageFiles(pinfo.pagebname, pinfo.numpages);
+
+  /* and only the 8-bit version of 16-bit images */
+  if (pinfo.deep) free(pinfo.deep);
+  pinfo.deep = (u_short *) NULL;
+
+  pic = pinfo.pic;  ptype = pinfo.type;  w = pinfo.w;  h = pinfo.h;
+  rp = pinfo.r;  gp = pinfo.g;  bp = pinfo.b;  nc = 256;
+  bperpix = (ptype == PIC24) ? 3 : 1;
+
+  col = pinfo.colType;
+  if (col == F_REDUCED) col = F_FULLCOLOR;
+
+
+  /* crop */
+  if (bo->cw > 0 && bo->ch > 0) {
+    x = bo->cx;  y = bo->cy;  cw = bo->cw;  ch = bo->ch;
+    CropRect2Rect(&x, &y, &cw, &ch, 0, 0, w, h);
+
+    if (cw > 0 && ch > 0 && (cw != w || ch != h)) {
+      pic2 = (byte *) malloc((size_t) cw * ch * bperpix);
+      if (!pic2) FatalError("couldn't malloc cropped image (batch)");
+
+      for (i=0; i<ch; i++)
+	bcopy((char *) pic + ((size_t) (y+i) * w + x) * bperpix,
+	      (char *) pic2 + (size_t) i * cw * bperpix,
+	      (size_t) cw * bperpix);
+
+      free(pic);  pic = pic2;  w = cw;  h = ch;
+    }
+  }
+
+
+  /* resize.  Smooth24() always hands back a 24-bit image, from PoolAlloc(),
+     so from here on 'pic' is freed with PoolFree() */
+  dw = w;  dh = h;
+  if (bo->rw > 0 || bo->rh > 0) {
+    dw = bo->rw;  dh = bo->rh;
+    if (!dw) dw = (int) ((double) w * dh / h + 0.5);
+    if (!dh) dh = (int) ((double) h * dw / w + 0.5);
+  }
+  else if (bo->expx > 0.0) {
+    dw = (int) (w * bo->expx + 0.5);
+    dh = (int) (h * bo->expy + 0.5);
+  }
+  if (dw < 1) dw = 1;
+  if (dh < 1) dh = 1;
+
+  if (dw != w || dh != h) {
+    pic2 = Smooth24(pic, ptype == PIC24, w, h, dw, dh, rp, gp, bp);
+    if (!pic2) FatalError("couldn't malloc resized image (batch)");
+
+    free(pic);  pic = pic2;  ptype = PIC24;  w = dw;  h = dh;
+    if (col == F_BWDITHER) col = F_GREYSCALE;   /* it's got greys now */
+  }
+
+
+  /* color reduction */
+  if (bo->col == F_BWDITHER) {
+    pic2 = FSDither(pic, ptype, w, h, rp, gp, bp, 0, 1);
+    if (!pic2) FatalError("couldn't malloc dithered image (batch)");
+
+    PoolFree(pic);  pic = pic2;  ptype = PIC8;
+    r2[0] = g2[0] = b2[0] = 0;
+    r2[1] = g2[1] = b2[1] = 255;
+    rp = r2;  gp = g2;  bp = b2;  nc = 2;
+  }
+
+  else if (bo->ncols > 0) {
+    if (ptype == PIC8) {
+      pic2 = Conv8to24(pic, w, h, rp, gp, bp);
+      if (!pic2) FatalError("couldn't malloc 24-bit image (batch)");
+      PoolFree(pic);  pic = pic2;  ptype = PIC24;
+    }
+
+    pic2 = Conv24to8(pic, w, h, bo->ncols, r2, g2, b2);
+    if (!pic2) FatalError("couldn't malloc 8-bit image (batch)");
+
+    PoolFree(pic);  pic = pic2;  ptype = PIC8;
+    rp = r2;  gp = g2;  bp = b2;  nc = bo->ncols;
+  }
+
+  if (bo->col >= 0) col = bo->col;
+
+
+  /* and write it out */
+  batchOutName(bo, fname, outname, sizeof(outname));
+  if (!strcmp(outname, fname)) {
+    fprintf(stderr, "%s: %s:  won't overwrite the input file\n", cmd, fname);
+    rv = 1;
+  }
+  else if ((fp = fopen(outname, "w")) == NULL) {
+    fprintf(stderr, "%s: %s:  %s\n", cmd, outname, ERRSTR(errno));
+    rv = 1;
+  }
+  else {
+    picComments     = pinfo.comment;
+    picExifInfo     = pinfo.exifInfo;
+    picExifInfoSize = pinfo.exifInfoSize;
+
+    rv = batchWrite(bo, fp, outname, pic, ptype, w, h, rp, gp, bp, nc, col,
+		    pinfo.comment);
+
+    if (fflush(fp) == EOF || ferror(fp)) rv = 1;
+    if (fclose(fp) == EOF) rv = 1;
+
+    if (rv) {
+      fprintf(stderr, "%s: %s:  write failed\n", cmd, outname);
+      unlink(outname);
+    }
+    else if (DEBUG) fprintf(stderr, "%s: %s -> %s\n", cmd, fname, outname);
+
+    picComments = (char *) NULL;  picExifInfo = (byte *) NULL;
+    picExifInfoSize = 0;
+  }
+
+  PoolFree(pic);
+  if (pinfo.comment)  free(pinfo.comment);
+  if (pinfo.exifInfo) free(pinfo.exifInfo);
+
+  return (rv) ? 1 : 0;
+}
+
+
+/***************************************************/
+static int batchWrite(BOPTS *bo, FILE *fp, char *outname, byte *pic, int ptype, int w, int h, byte *rp, byte *gp, byte *bp, int nc, int col, char *comment)
+{
+  /* returns '0' on success, like the Write*() functions */
+
+  int rv;
+
+  switch (bo->fmt->fmt) {
+#ifdef HAVE_PNG
+  case F_PNG:
+    rv = PNGBatchSave(fp, pic, ptype, w, h, rp, gp, bp, nc, col, outname,
+		      bo->quality);
+    break;
+#endif
+
+#ifdef HAVE_JPEG
+  case F_JPEG:
+    rv = JPEGBatchSave(fp, pic, ptype, w, h, rp, gp, bp, nc, col, outname,
+		       bo->quality);
+    break;
+#endif
+
+#ifdef HAVE_WEBP
+  case F_WEBP:
+    rv = WriteWEBP  (fp, pic, ptype, w, h, rp, gp, bp, nc, col);
+    break;
+#endif
+
+  case F_GIF:
+    rv = WriteGIF   (fp, pic, ptype, w, h, rp, gp, bp, nc, col, comment);
+    break;
+
+  case F_PM:
+    rv = WritePM    (fp, pic, ptype, w, h, rp, gp, bp, nc, col, comment);
+    break;
+
+  case F_PBMRAW:
+    rv = WritePBM   (fp, pic, ptype, w, h, rp, gp, bp, nc, col, 1, comment);
+    break;
+
+  case F_XBM:
+    rv = WriteXBM   (fp, pic, w, h, rp, gp, bp, outname);
+    break;
+
+  case F_SUNRAS:
+    rv = WriteSunRas(fp, pic, ptype, w, h, rp, gp, bp, nc, col, 0);
+    break;
+
+  case F_BMP:
+    rv = WriteBMP   (fp, pic, ptype, w, h, rp, gp, bp, nc, col);
+    break;
+
+  case F_WBMP:
+    rv = WriteWBMP  (fp, pic, ptype, w, h, rp, gp, bp, nc, col);
+    break;
+
+  case F_IRIS:
+    rv = WriteIRIS  (fp, pic, ptype, w, h, rp, gp, bp, nc, col);
+    break;
+
+  case F_TARGA:
+    rv = WriteTarga (fp, pic, ptype, w, h, rp, gp, bp, nc, col);
+    break;
+
+  case F_XPM:
+    rv = WriteXPM   (fp, pic, ptype, w, h, rp, gp, bp, nc, col, outname,
+		     comment);
+    break;
+
+  case F_FITS:
+    rv = WriteFITS  (fp, pic, ptype, w, h, rp, gp, bp, nc, col, comment);
+    break;
+
+  case F_ZX:
+    rv = WriteZX    (fp, pic, ptype, w, h, rp, gp, bp, nc, col, comment);
+    break;
+
+#ifdef HAVE_MAG
+  case F_MAG:
+    rv = WriteMAG   (fp, pic, ptype, w, h, rp, gp, bp, nc, col, comment);
+    break;
+#endif
+
+#ifdef HAVE_PIC
+  case F_PIC:
+    rv = WritePIC   (fp, pic, ptype, w, h, rp, gp, bp, nc, col, comment);
+    break;
+#endif
+
+#ifdef HAVE_MAKI
+  case F_MAKI:
+    rv = WriteMAKI  (fp, pic, ptype, w, h, rp, gp, bp, nc, col);
+    break;
+#endif
+
+#ifdef HAVE_PI
+  case F_PI:
+    rv = WritePi    (fp, pic, ptype, w, h, rp, gp, bp, nc, col, comment);
+    break;
+#endif
+
+  default:
+    rv = 1;
+    break;
+  }
+
+  return rv;
+}
+
+
+/***************************************************/
+static void batchOutName(BOPTS *bo, char *fname, char *outname, size_t len)
+{
+  /* builds 'outdir/basename.ext' (or 'dir-of-fname/basename.ext'),
+     dropping the input file's suffix, and any compression suffix too */
+
+  const char *base;
+  char        stem[MAXPATHLEN], *sp;
+  int         dlen;
+
+  base = BaseName(fname);
+  strncpy(stem, base, sizeof(stem) - 1);
+  stem[sizeof(stem) - 1] = '\0';
+
+  sp = rindex(stem, '.');
+  if (sp && sp != stem &&
+      (!strcmp(sp, ".gz") || !strcmp(sp, ".Z") || !strcmp(sp, ".z") ||
+       !strcmp(sp, ".bz2") || !strcmp(sp, ".xz"))) {
+    *sp = '\0';
+    sp = rindex(stem, '.');
+  }
+  if (sp && sp != stem) *sp = '\0';
+
+  if (bo->outdir)
+    snprintf(outname, len, "%s/%s.%s", bo->outdir, stem, bo->fmt->ext);
+  else {
+    dlen = (int) (base - fname);
+    snprintf(outname, len, "%.*s%s.%s", dlen, fname, stem, bo->fmt->ext);
+  }
+}
@@ -37,8 +37,6 @@
 #  error XV's BMP code requires 32-bit unsigned integer type, but u_int isn't
 #endif
 
-static long filesize;
-
 static int   loadBMP1   PARM((FILE *, byte *, u_int, u_int, int));
 static int   loadBMP4   PARM((FILE *, byte *, u_int, u_int, u_int, int));
 static int   loadBMP8   PARM((FILE *, byte *, u_int, u_int, u_int, int));
@@ -70,6 +68,7 @@ int LoadBMP(char *fname, PICINFO *pinfo)
   u_int      npixels;
   u_int      colormask[3];
   int        biHeight;
+  long       filesize;
   char       buf[512], rgb_bits[16];
   const char *cmpstr, *bname;
   byte       *pic24, *pic8;
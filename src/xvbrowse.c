@@ -12,6 +12,8 @@
  *      int  BrowseDelWin(Window);
  *      void SetBrowStr(char *);
  *      void RegenBrowseIcons();
+ *      int  BrowseFD();
+ *      void BrowseInotify();
  *
  */
 
@@ -24,6 +26,13 @@
 typedef unsigned int mode_t;  /* file mode bits */
 #endif
 
+#ifdef __linux__
+#  include <sys/inotify.h>
+#  define HAVE_INOTIFY
+#  define BR_INOMASK (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | \
+		      IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF)
+#endif
+
 #ifndef MAX
 #  define MAX(a,b) (((a)>(b))?(a):(b))   /* used only for wheelmouse support */
 #endif
@@ -276,6 +285,8 @@ typedef struct {  Window        win, iconW;
 		  char         *str;
 		  int           siz, len;
 		  time_t        lst;
+
+		  int           inoWD;     /* inotify watch on 'path', or -1 */
 		} BROWINFO;
 
 
@@ -291,6 +302,7 @@ static BROWINFO binfo[MAXBRWIN];
 static Pixmap   bfIcons[BF_MAX], trashPix;
 static int      hasBeenSized = 0;
 static int      haveWindows  = 0;
+static int      brInoFD      = -1;   /* shared by all the browsers */
 
 static unsigned long browfg, browbg, browhi, browlo;
 
@@ -326,12 +338,24 @@ static int  cdBrow           PARM((BROWINFO *));
 static void scanDir          PARM((BROWINFO *));
 static void copyDirInfo      PARM((BROWINFO *, BROWINFO *));
 static void endScan          PARM((BROWINFO *, int));
+static void refreshList      PARM((BROWINFO *, int));
 static void scanFile         PARM((BROWINFO *, BFIL *, char *));
+static void statFile         PARM((BROWINFO *, BFIL *, int));
 static void sortBFList       PARM((BROWINFO *));
 static int  bfnamCmp         PARM((const void *, const void *));
 static void rescanDir        PARM((BROWINFO *));
 static int  namcmp           PARM((const void *, const void *));
 static void freeBfList       PARM((BROWINFO *br));
+static void freeBfil         PARM((BFIL *));
+#ifdef HAVE_INOTIFY
+static void brWatch          PARM((BROWINFO *));
+static void brUnwatch        PARM((BROWINFO *));
+static int  brFileEvent      PARM((BROWINFO *, char *, u_int));
+static int  brFindFile       PARM((BROWINFO *, char *));
+static void brRemoveFile     PARM((BROWINFO *, int));
+static void brInsertFile     PARM((BROWINFO *, char *));
+static void brUpdateFile     PARM((BROWINFO *, int));
+#endif
 static char **getDirEntries  PARM((const char *, int *, int));
 static void computeScrlVals  PARM((BROWINFO *, int *, int *));
 static void genSelectedIcons PARM((BROWINFO *));
@@ -552,6 +576,7 @@ void CreateBrowse(const char *geom, int userspec, const char *fgstr, const char
     br->bfLen        = 0;
     br->dispstr[0]   = '\0';
     br->ndirs        = 0;
+    br->inoWD        = -1;
     sprintf(br->path, BOGUSPATH);
 
     br->lastIconClicked = -1;
@@ -734,6 +759,9 @@ static void closeBrowse(BROWINFO *br)
 
   /* free all info for this browse window */
   freeBfList(br);
+#ifdef HAVE_INOTIFY
+  brUnwatch(br);
+#endif
   sprintf(br->path, BOGUSPATH);
 
   /* turn on 'open new window' command doodads */
@@ -1170,6 +1198,95 @@ void BRCreatedFile(char *name)
 }
 
 
+/***************************************************************/
+int BrowseFD(void)
+{
+  /* returns a descriptor that becomes readable when something changes in
+     a directory that one of the browsers is showing, or -1.  EventLoop()
+     sleeps on it, and calls BrowseInotify() when it fires */
+
+#ifdef HAVE_INOTIFY
+  int i;
+
+  if (brInoFD >= 0) {
+    for (i=0; i<MAXBRWIN; i++) {
+      if (binfo[i].vis && binfo[i].inoWD >= 0) return brInoFD;
+    }
+  }
+#endif
+  return -1;
+}
+
+
+/***************************************************************/
+void BrowseInotify(void)
+{
+  /* pulls pending inotify events, and applies them to the bfList of each
+     browser watching the directory in question:  a name that appears is
+     scanFile()'d and inserted in sorted position, a name that goes away is
+     dropped, and a file that's been rewritten is re-stat()ed where it is,
+     and loses its (now stale) icon.  Nothing else in the directory is
+     looked at */
+
+#ifdef HAVE_INOTIFY
+  union {                           /* keeps the buffer suitably aligned */
+    struct inotify_event ev;
+    char                 buf[4096];
+  } u;
+  const struct inotify_event *ev;
+  ssize_t   len;
+  char     *p;
+  int       i, changed[MAXBRWIN], oldlen[MAXBRWIN], overflow;
+  char      savedir[MAXPATHLEN+1];
+  BROWINFO *br;
+
+  if (brInoFD < 0) return;
+
+  for (i=0; i<MAXBRWIN; i++) { changed[i] = 0;  oldlen[i] = binfo[i].bfLen; }
+  overflow = 0;
+  savedir[0] = '\0';
+
+  while ((len = read(brInoFD, u.buf, sizeof(u.buf))) > 0) {
+    for (p = u.buf;  p < u.buf + len;
+	 p += sizeof(struct inotify_event) + ev->len) {
+      ev = (const struct inotify_event *) p;
+
+      if (ev->mask & IN_Q_OVERFLOW) { overflow = 1;  continue; }
+
+      for (i=0; i<MAXBRWIN; i++) {
+	br = &binfo[i];
+	if (br->inoWD < 0 || br->inoWD != ev->wd) continue;
+
+	if (ev->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) {
+	  br->inoWD = -1;               /* directory itself is gone */
+	  continue;
+	}
+	if (!ev->len) continue;
+
+	/* scanFile() wants names relative to the browser's directory */
+	if (!savedir[0]) xv_getwd(savedir, sizeof(savedir));
+	if (chdir(br->path)) continue;
+
+	if (brFileEvent(br, (char *) ev->name, ev->mask)) changed[i] = 1;
+      }
+    }
+  }
+
+  if (savedir[0] && chdir(savedir)) { /* nothing useful to do about it */ }
+
+  for (i=0; i<MAXBRWIN; i++) {
+    br = &binfo[i];
+    if (overflow && br->inoWD >= 0) rescanDir(br);
+    else if (changed[i]) {
+      br->lastIconClicked = -1;
+      refreshList(br, oldlen[i]);
+      changedNumLit(br, -1, 0);
+    }
+  }
+#endif
+}
+
+
 /**************************************************************/
 /***                    INTERNAL FUNCTIONS                  ***/
 /**************************************************************/
@@ -2963,6 +3080,10 @@ static void copyDirInfo(BROWINFO *srcbr, BROWINFO *dstbr)
 	     (u_int) dstbr->iwHigh, True);
   SCSetRange(&dstbr->scrl, 0, maxv, dstbr->scrl.val, page);
 
+#ifdef HAVE_INOTIFY
+  brWatch(dstbr);
+#endif
+
   SetCursors(-1);
 }
 
@@ -3178,11 +3299,24 @@ static void endScan(BROWINFO *br, int oldnum)
 {
   /* called at end of scanDir() and rescanDir() */
 
-  int maxv, page;
-  int w,h;
-
   setBrowStr(br,"");
   sortBFList(br);
+  refreshList(br, oldnum);
+
+#ifdef HAVE_INOTIFY
+  brWatch(br);
+#endif
+}
+
+
+/***************************************************************/
+static void refreshList(BROWINFO *br, int oldnum)
+{
+  /* redisplays the file count and icon window after bfList has changed
+     length.  bfList must already be in sorted order */
+
+  int maxv, page;
+  int w,h;
 
   eraseNumfiles(br, oldnum);
   drawNumfiles(br);
@@ -3212,20 +3346,32 @@ static void scanFile(BROWINFO *br, BFIL *bf, char *name)
   /* given a pointer to an empty BFIL structure, and a filename,
      loads up the BFIL structure appropriately */
 
-  struct stat    st;
-
   /* copy name */
   bf->name = (char *) malloc(strlen(name) + 1);
 
   if (!bf->name) FatalError("ran out of memory for bf->name");
   strcpy(bf->name, name);
 
+  bf->lit = 0;
+  statFile(br, bf, 1);
+}
+
+
+/***************************************************************/
+static void statFile(BROWINFO *br, BFIL *bf, int dothumb)
+{
+  /* fills in everything but the 'name' and 'lit' fields of bf, from the
+     file itself and (if 'dothumb') its thumbnail file.  Any icon bf had
+     must already have been freed */
+
+  struct stat    st;
+
   /* default icon values.  (in case 'stat' doesn't work) */
-  bf->ftype  = BF_FILE;
+  bf->ftype   = BF_FILE;
   bf->w = br_file_width;  bf->h = br_file_height;
-  bf->pimage = (byte *) NULL;
-  bf->ximage = (XImage *) NULL;
-  bf->lit    = 0;
+  bf->imginfo = (char *) NULL;
+  bf->pimage  = (byte *) NULL;
+  bf->ximage  = (XImage *) NULL;
 
 
   if (stat(bf->name, &st)==0) {
@@ -3247,7 +3393,7 @@ static void scanFile(BROWINFO *br, BFIL *bf, char *name)
   }
 
 
-  loadThumbFile(br, bf);
+  if (dothumb) loadThumbFile(br, bf);
 
 
   if (bf->ftype == BF_FILE || bf->ftype == BF_EXE) {
@@ -3460,10 +3606,7 @@ static void rescanDir(BROWINFO *br)
 	bcopy((char *) bf, (char *) &(newbflist[n++]),  sizeof(BFIL));
       }
       else {              /* in deleted list.  free all data for this entry */
-	if (bf->name)    free(bf->name);
-	if (bf->imginfo) free(bf->imginfo);
-	if (bf->pimage)  free(bf->pimage);
-	if (bf->ximage)  xvDestroyImage(bf->ximage);
+	freeBfil(bf);
       }
     }
 
@@ -3502,11 +3645,7 @@ static void freeBfList(BROWINFO *br)
   if (br->bfList) {
     for (i=0, bf=br->bfList; i<br->bfLen; i++,bf++) {
       if ((i & 0x3f) == 0) WaitCursor();
-
-      if (bf->name)    free(bf->name);
-      if (bf->imginfo) free(bf->imginfo);
-      if (bf->pimage)  free(bf->pimage);
-      if (bf->ximage)  xvDestroyImage(bf->ximage);
+      freeBfil(bf);
     }
 
     free(br->bfList);
@@ -3518,6 +3657,193 @@ static void freeBfList(BROWINFO *br)
 }
 
 
+/***************************************************************/
+static void freeBfil(BFIL *bf)
+{
+  if (bf->name)    free(bf->name);
+  if (bf->imginfo) free(bf->imginfo);
+  if (bf->pimage)  PoolFree(bf->pimage);
+  if (bf->ximage)  xvDestroyImage(bf->ximage);
+}
+
+
+#ifdef HAVE_INOTIFY
+/***************************************************************/
+static void brWatch(BROWINFO *br)
+{
+  /* points br's inotify watch at br->path.  (the kernel hands back the
+     same watch descriptor for a directory that's already being watched,
+     so browsers showing the same directory end up sharing one) */
+
+  int wd;
+
+  if (brInoFD < 0) {
+    brInoFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (brInoFD < 0) return;
+  }
+
+#ifdef AUTO_EXPAND
+  if (Isvdir(br->path)) { brUnwatch(br);  return; }
+#endif
+
+  wd = inotify_add_watch(brInoFD, br->path, BR_INOMASK);
+  if (wd != br->inoWD) brUnwatch(br);
+  br->inoWD = wd;
+  if (DEBUG) fprintf(stderr,"brWatch: '%s' -> wd %d\n", br->path, wd);
+}
+
+
+/***************************************************************/
+static void brUnwatch(BROWINFO *br)
+{
+  int i;
+
+  if (br->inoWD < 0) return;
+
+  for (i=0; i<MAXBRWIN; i++) {
+    if (&binfo[i] != br && binfo[i].inoWD == br->inoWD) break;
+  }
+  if (i == MAXBRWIN) inotify_rm_watch(brInoFD, br->inoWD);  /* last user */
+  br->inoWD = -1;
+}
+
+
+/***************************************************************/
+static int brFileEvent(BROWINFO *br, char *name, u_int mask)
+{
+  /* applies a single inotify event on 'name' to br's bfList.  the cwd is
+     br->path.  returns '1' if bfList changed */
+
+  int i;
+
+  /* same filtering as scanDir() */
+  if (strcmp(name, ".")==0 || strcmp(name, "..")==0 ||
+      strcmp(name, THUMBDIR)==0 || strcmp(name, THUMBDIRNAME)==0 ||
+      (!br->showhidden && name[0] == '.')) return 0;
+
+  i = brFindFile(br, name);
+
+  if (mask & (IN_DELETE | IN_MOVED_FROM)) {
+    if (i < 0) return 0;
+    brRemoveFile(br, i);
+    return 1;
+  }
+
+  if (i >= 0) {
+    if (!(mask & (IN_CLOSE_WRITE | IN_MOVED_TO))) return 0;
+    brUpdateFile(br, i);          /* contents changed:  take a fresh look */
+    return 1;
+  }
+
+  brInsertFile(br, name);
+  return 1;
+}
+
+
+/***************************************************************/
+static int brFindFile(BROWINFO *br, char *name)
+{
+  /* returns the index of 'name' in br's (sorted) bfList, or -1.  As
+     directories sort ahead of everything else, and 'name' could be
+     either, looks for it in both halves */
+
+  BFIL  key;
+  int   lo, hi, mid, c, pass;
+
+  bzero((char *) &key, sizeof(BFIL));
+  key.name = name;
+
+  for (pass=0; pass<2; pass++) {
+    key.ftype = (pass==0) ? BF_DIR : BF_FILE;
+
+    lo = 0;  hi = br->bfLen - 1;
+    while (lo <= hi) {
+      mid = (lo + hi) / 2;
+      c = bfnamCmp(&key, &br->bfList[mid]);
+      if      (c < 0) hi = mid - 1;
+      else if (c > 0) lo = mid + 1;
+      else return mid;
+    }
+  }
+  return -1;
+}
+
+
+/***************************************************************/
+static void brRemoveFile(BROWINFO *br, int num)
+{
+  BFIL *bf;
+
+  bf = &(br->bfList[num]);
+  if (bf->lit) br->numlit--;
+  freeBfil(bf);
+
+  bcopy((char *) (bf+1), (char *) bf,
+	(size_t) (br->bfLen - num - 1) * sizeof(BFIL));
+  br->bfLen--;
+}
+
+
+/***************************************************************/
+static void brInsertFile(BROWINFO *br, char *name)
+{
+  /* scanFile()s 'name', and slots it into bfList at its sorted position */
+
+  BFIL  newbf, *bflist;
+  int   lo, hi, mid;
+
+  bzero((char *) &newbf, sizeof(BFIL));
+  scanFile(br, &newbf, name);
+
+  bflist = (BFIL *) realloc(br->bfList, (br->bfLen + 1) * sizeof(BFIL));
+  if (!bflist) FatalError("couldn't grow bfList in brInsertFile()");
+  br->bfList = bflist;
+
+  lo = 0;  hi = br->bfLen;          /* find first entry that sorts after */
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (bfnamCmp(&bflist[mid], &newbf) <= 0) lo = mid + 1;
+    else hi = mid;
+  }
+
+  bcopy((char *) &bflist[lo], (char *) &bflist[lo+1],
+	(size_t) (br->bfLen - lo) * sizeof(BFIL));
+  bflist[lo] = newbf;
+  br->bfLen++;
+}
+
+
+/***************************************************************/
+static void brUpdateFile(BROWINFO *br, int num)
+{
+  /* entry 'num' of bfList has been rewritten:  re-stat()s it, and drops
+     its icon, which no longer shows what's in the file.  (Its thumbnail
+     file is just as stale, so that isn't reloaded either;  'Update' will
+     make a new one.)  Keeps the name and selection, and the entry's place
+     in bfList, unless it has become, or stopped being, a directory */
+
+  BFIL *bf;
+  char *name;
+  int   wasdir;
+
+  bf = &(br->bfList[num]);
+  wasdir = (bf->ftype == BF_DIR);
+
+  if (bf->imginfo) free(bf->imginfo);
+  if (bf->pimage)  PoolFree(bf->pimage);
+  if (bf->ximage)  xvDestroyImage(bf->ximage);
+  statFile(br, bf, 0);
+
+  if (wasdir != (bf->ftype == BF_DIR)) {      /* sorts somewhere else now */
+    name = bf->name;  bf->name = (char *) NULL;
+    brRemoveFile(br, num);
+    brInsertFile(br, name);
+    free(name);
+  }
+}
+#endif
+
+
 static int namcmp(const void *p1, const void *p2)
 {
   char **s1, **s2;
@@ -3678,7 +4004,7 @@ static void genIcon(BROWINFO *br, BFIL *bf)
 
   /* free any old info in 'bf' */
   if (bf->imginfo) free          (bf->imginfo);
-  if (bf->pimage)  free          (bf->pimage);
+  if (bf->pimage)  PoolFree      (bf->pimage);
   if (bf->ximage)  xvDestroyImage(bf->ximage);
 
   bf->imginfo = (char *)   NULL;
@@ -3939,7 +4265,7 @@ ms_auto_no:
   /* dither 24-bit icon into 8-bit icon (using 3/3/2 cmap) */
   icon8 = DoColorDither(icon24, NULL, iwide, ihigh, NULL, NULL, NULL,
 			browR, browG, browB, 256);
-  if (!icon8) { bf->ftype = BF_FILE;  free(icon24); free(pinfo.pic); return; }
+  if (!icon8) { bf->ftype = BF_FILE;  PoolFree(icon24); free(pinfo.pic); return; }
 
   writeThumbFile(br, bf, icon8, iwide, ihigh, str);
 
@@ -3958,7 +4284,7 @@ ms_auto_no:
   bf->ximage = Pic8ToXImage(icon8, (u_int) iwide, (u_int) ihigh, browcols,
 			    browR, browG, browB);
 
-  free(icon24);
+  PoolFree(icon24);
   free(pinfo.pic);
 }
 
@@ -92,6 +92,12 @@ static const char *dispMList[] = { "Raw\tr",
 				   "Dithered\td",
 				   "Smooth\ts",
 				   MBSEP,
+				   "xv filter",
+				   "Box filter",
+				   "Bilinear filter",
+				   "Mitchell filter",
+				   "Lanczos-3 filter",
+				   MBSEP,
 				   "Read/Write Colors",
 				   MBSEP,
 				   "Normal Colors",
@@ -144,7 +150,9 @@ static const char *algMList[] = { "Undo All\t\244u",
 				  "Clear Rotate...\t\244T",
 				  "Pixelize...\t\244p",
 				  "Spread...\t\244S",
-				  "DeSpeckle...\t\244k"};
+				  "DeSpeckle...\t\244k",
+				  "Local Equalize...\t\244q",
+				  "Levels...\t\244L"};
 
 static const char *sizeMList[] = { "Normal\tn",
 				   "Max Size\tm",
@@ -510,6 +518,7 @@ void CreateCtrl(const char *geom)
 
   dispMB.flags[DMB_COLRW] = (allocMode == AM_READWRITE);
   dispMB.flags[colorMapMode + DMB_COLNORM - CM_NORMAL] = 1;
+  dispMB.flags[DMB_FILTXV + smoothFilter] = 1;
 
   conv24MB.flags[conv24] = 1;
 
@@ -12,8 +12,13 @@
  *      static byte *getSelection     ();
  *      static byte *getFromClip      ();
  *             void  SaveToClip       (data);
+ *             void  SweepClipboard   ();
  *      static void  clearSelectedArea();
  *      static void  makeClipFName    ();
+ *      static int   shmToClip        (data, len);
+ *      static byte *shmFromClip      ();
+ *      static void  shmClipClear     ();
+ *      static void  shmClipSweep     (keep);
  *      static int   countcols24      (byte *, int,int, int,int,int,int));
  *      static int   countNewCols     (byte*, int, int, byte*, int,
  *                                     int, int, int, int);
@@ -57,6 +62,17 @@
 
 #define CLIPPROP   "XV_CLIPBOARD"
 
+#ifdef XV_HAVE_SHM_OPEN
+#  include <sys/mman.h>
+
+/* on a local display, the clipboard data goes in a POSIX shared memory
+   segment instead, and this property just says where:  "host name len" */
+#  define CLIPSHMPROP "XV_CLIPSHM"
+
+/* where the segments show up as files, if anywhere */
+#  define SHMDIR      "/dev/shm"
+#endif
+
 
 
 /***
@@ -69,6 +85,14 @@ static byte *getSelection      PARM((void));
 static byte *getFromClip       PARM((void));
 static void clearSelectedArea  PARM((void));
 static void makeClipFName      PARM((void));
+#ifdef XV_HAVE_SHM_OPEN
+static int  shmToClip          PARM((byte *, int));
+static byte *shmFromClip       PARM((void));
+static void shmClipClear       PARM((void));
+static int  shmClipProp        PARM((char *, char *, int *));
+static int  shmClipPrefix      PARM((char *));
+static void shmClipSweep       PARM((const char *));
+#endif
 static int  countcols24        PARM((byte *, int, int, int, int, int, int));
 static int  countNewCols       PARM((byte *, int, int, byte *, int,
 				     int, int, int, int));
@@ -126,6 +150,11 @@ int PasteAllowed(void)
   clipAtom = XInternAtom(theDisp, CLIPPROP, True);
   if (clipAtom != None) return 1;   /* clipboard property exists: can paste */
 
+#ifdef XV_HAVE_SHM_OPEN
+  clipAtom = XInternAtom(theDisp, CLIPSHMPROP, True);
+  if (clipAtom != None) return 1;
+#endif
+
 
   /* barring that, see if the CLIPFILE exists. if so, we can paste */
   if (!clipfname) makeClipFName();
@@ -450,11 +479,7 @@ static void doPaste(byte *cimg)
     free(dpic);
 
     if (newcols) InstallNewPic();      /* does color reallocation, etc. */
-    else {
-      GenerateCpic();
-      GenerateEpic(eWIDE, eHIGH);
-      DrawEpic();
-    }
+    else UpdatePicRect(dx, dy, dw, dh);
   }
 
 
@@ -524,7 +549,7 @@ static void doPaste(byte *cimg)
 	  }
 	}
       }
-      free(dpic);
+      PoolFree(dpic);
     }
 
 
@@ -555,9 +580,7 @@ static void doPaste(byte *cimg)
     }
 
 
-    GenerateCpic();
-    GenerateEpic(eWIDE, eHIGH);
-    DrawEpic();
+    UpdatePicRect(dx, dy, dw, dh);
   }
 
 
@@ -739,8 +762,15 @@ static byte *getFromClip(void)
   if (forceClipFile) {                           /* remove property, if any */
     clipAtom = XInternAtom(theDisp, CLIPPROP, True);
     if (clipAtom != None) XDeleteProperty(theDisp, rootW, clipAtom);
+#ifdef XV_HAVE_SHM_OPEN
+    shmClipClear();
+#endif
   }
 
+#ifdef XV_HAVE_SHM_OPEN
+  data = shmFromClip();
+  if (data) return data;
+#endif
 
   clipAtom = XInternAtom(theDisp, CLIPPROP, True);             /* find prop */
   if (clipAtom != None) {
@@ -874,6 +904,10 @@ void SaveToClip(byte *cimg)
     if (clipAtom != None) XDeleteProperty(theDisp, rootW, clipAtom);
   }
 
+#ifdef XV_HAVE_SHM_OPEN
+  if (shmToClip(cimg, len)) return;
+  shmClipClear();                     /* don't leave an older clip there */
+#endif
 
   if (!forceClipFile) {
     clipAtom = XInternAtom(theDisp, CLIPPROP, False);  /* find or make prop */
@@ -951,9 +985,7 @@ static void clearSelectedArea(void)
     }
   }
 
-  GenerateCpic();
-  GenerateEpic(eWIDE,eHIGH);
-  DrawEpic();        /* redraws selection, also */
+  UpdatePicRect(x,y,w,h);
 }
 
 
@@ -976,6 +1008,255 @@ static void makeClipFName(void)
 }
 
 
+#ifdef XV_HAVE_SHM_OPEN
+/********************************************/
+static int shmToClip(byte *cimg, int len)
+{
+  /* puts the clipboard data in a new shared memory segment, and names it
+     in the CLIPSHMPROP property.  Only done when the display is local, so
+     every xv that can see the property is on this machine.  Each clip gets
+     a segment of its own, so one that's being read is never truncated;
+     the previous ones are unlinked (they live on until they're unmapped).
+     returns '1' on success, '0' if the caller should use the old ways */
+
+  static int    seq = 0;
+  Atom          shmAtom, clipAtom;
+  char          host[256], prefix[64], name[128], oname[256], str[512];
+  int           fd, olen;
+  byte         *p;
+
+  if (forceClipFile || !shmClipPrefix(prefix)) return 0;
+
+  if (gethostname(host, sizeof(host) - 1) != 0) return 0;
+  host[sizeof(host) - 1] = '\0';
+
+  sprintf(name, "/%s%ld.%d", prefix, (long) getpid(), seq++);
+
+  fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0) return 0;
+
+  if (ftruncate(fd, (off_t) len) != 0) {
+    close(fd);  shm_unlink(name);
+    return 0;
+  }
+
+  p = (byte *) mmap(NULL, (size_t) len, PROT_READ | PROT_WRITE, MAP_SHARED,
+		    fd, (off_t) 0);
+  close(fd);
+  if (p == (byte *) MAP_FAILED) { shm_unlink(name);  return 0; }
+
+  bcopy((char *) cimg, (char *) p, (size_t) len);
+  munmap((void *) p, (size_t) len);
+
+  shmAtom = XInternAtom(theDisp, CLIPSHMPROP, False);
+  if (shmAtom == None) { shm_unlink(name);  return 0; }
+
+  /* the last clip, if it was made on this machine */
+  if (shmClipProp(str, oname, &olen) && strcmp(str, host) == 0 &&
+      strcmp(oname, name) != 0) shm_unlink(oname);
+
+  sprintf(str, "%s %s %d", host, name, len);
+  XChangeProperty(theDisp, rootW, shmAtom, XA_STRING, 8, PropModeReplace,
+		  (byte *) str, (int) strlen(str));
+
+  shmClipSweep(name);                 /* and any strays */
+
+  /* and the data property is now out of date */
+  clipAtom = XInternAtom(theDisp, CLIPPROP, True);
+  if (clipAtom != None) XDeleteProperty(theDisp, rootW, clipAtom);
+
+  return 1;
+}
+
+
+/********************************************/
+static byte *shmFromClip(void)
+{
+  /* if CLIPSHMPROP names a segment on this machine, returns a malloc'd
+     copy of its contents.  returns NULL if it doesn't, or the segment's
+     gone, so the caller can try the other ways */
+
+  char         host[256], phost[256], name[256];
+  int          fd, len;
+  struct stat  st;
+  byte        *p, *data;
+
+  if (!shmClipProp(phost, name, &len)) return (byte *) NULL;
+
+  if (gethostname(host, sizeof(host) - 1) != 0) return (byte *) NULL;
+  host[sizeof(host) - 1] = '\0';
+  if (strcmp(host, phost) != 0) return (byte *) NULL;
+
+  fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) return (byte *) NULL;
+
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t) len) {
+    close(fd);
+    return (byte *) NULL;
+  }
+
+  p = (byte *) mmap(NULL, (size_t) len, PROT_READ, MAP_SHARED, fd, (off_t) 0);
+  close(fd);
+  if (p == (byte *) MAP_FAILED) return (byte *) NULL;
+
+  data = (byte *) malloc((size_t) len);
+  if (!data) {
+    munmap((void *) p, (size_t) len);
+    ErrPopUp("Insufficient memory to retrieve clipboard!", "\nShucks!");
+    return (byte *) NULL;
+  }
+
+  bcopy((char *) p, (char *) data, (size_t) len);
+  munmap((void *) p, (size_t) len);
+
+  /* must agree with the length recorded in the data itself */
+  if (((int)  data[CIMG_LEN + 0]        |
+       ((int) data[CIMG_LEN + 1] << 8)  |
+       ((int) data[CIMG_LEN + 2] << 16) |
+       ((int) data[CIMG_LEN + 3] << 24)) != len) {
+    free(data);
+    return (byte *) NULL;
+  }
+
+  return data;
+}
+
+
+/********************************************/
+static void shmClipClear(void)
+{
+  /* removes CLIPSHMPROP, and unlinks its segment if it's on this machine */
+
+  Atom shmAtom;
+  char host[256], phost[256], name[256];
+  int  len;
+
+  shmAtom = XInternAtom(theDisp, CLIPSHMPROP, True);
+  if (shmAtom == None) return;
+
+  if (shmClipProp(phost, name, &len) &&
+      gethostname(host, sizeof(host) - 1) == 0) {
+    host[sizeof(host) - 1] = '\0';
+    if (strcmp(host, phost) == 0) shm_unlink(name);
+  }
+
+  XDeleteProperty(theDisp, rootW, shmAtom);
+  shmClipSweep((char *) NULL);
+}
+
+
+/********************************************/
+static int shmClipProp(char *host, char *name, int *len)
+{
+  /* reads and parses CLIPSHMPROP.  'host' and 'name' must hold 256 chars.
+     returns '0' if there isn't one, or it doesn't make sense */
+
+  Atom          shmAtom, actType;
+  int           i, actFormat, rv;
+  unsigned long nitems, nleft;
+  char         *data;
+
+  shmAtom = XInternAtom(theDisp, CLIPSHMPROP, True);
+  if (shmAtom == None) return 0;
+
+  data = (char *) NULL;
+  i = XGetWindowProperty(theDisp, rootW, shmAtom, 0L, 128L, False, XA_STRING,
+			 &actType, &actFormat, &nitems, &nleft,
+			 (unsigned char **) &data);
+  if (i != Success || !data) return 0;
+
+  rv = (actType == XA_STRING && actFormat == 8 &&
+	sscanf(data, "%255s %255s %d", host, name, len) == 3 &&
+	name[0] == '/' && *len > CIMG_PIC24);
+
+  XFree((void *) data);
+  return rv;
+}
+
+
+/********************************************/
+static int shmClipPrefix(char *prefix)
+{
+  /* the start of the names of this user's clipboard segments for this
+     display:  "xvclip.uid.display.", followed by the pid of the xv that
+     made it, and a sequence number.  'prefix' must hold 64 chars.
+     returns '0' if the display isn't local, and segments aren't used */
+
+  const char *dname, *colon;
+
+  dname = DisplayString(theDisp);
+  if (!dname || (dname[0] != ':' && dname[0] != '/' &&
+		 strncmp(dname, "unix:", (size_t) 5) != 0)) return 0;
+
+  colon = strrchr(dname, ':');
+  sprintf(prefix, "xvclip.%ld.%d.", (long) getuid(),
+	  colon ? atoi(colon + 1) : 0);
+  return 1;
+}
+
+
+/********************************************/
+static void shmClipSweep(const char *keep)
+{
+  /* unlinks this user's segments for this display, other than 'keep' and
+     the one CLIPSHMPROP names, that were made by this xv or by one that's
+     no longer running.  That catches the ones orphaned when the property
+     goes away behind xv's back:  the X server restarting, or some other
+     client replacing it.  Only works where the segments can be listed,
+     in SHMDIR;  elsewhere, orphans last until the next reboot */
+
+  DIR           *dirp;
+#ifdef NODIRENT
+  struct direct *dp;
+#else
+  struct dirent *dp;
+#endif
+  char           prefix[64], host[256], phost[256], pname[256], name[320];
+  size_t         plen;
+  long           pid;
+  int            len;
+
+  if (!shmClipPrefix(prefix)) return;
+  plen = strlen(prefix);
+
+  if (gethostname(host, sizeof(host) - 1) != 0) return;
+  host[sizeof(host) - 1] = '\0';
+  if (!shmClipProp(phost, pname, &len) || strcmp(host, phost) != 0)
+    pname[0] = '\0';
+
+  dirp = opendir(SHMDIR);
+  if (!dirp) return;
+
+  while ((dp = readdir(dirp)) != NULL) {
+    if (strncmp(dp->d_name, prefix, plen) != 0) continue;
+
+    snprintf(name, sizeof(name), "/%s", dp->d_name);
+    if ((keep && strcmp(name, keep) == 0) || strcmp(name, pname) == 0)
+      continue;
+
+    pid = atol(dp->d_name + plen);
+    if (pid == (long) getpid() ||
+	(pid > 0 && kill((pid_t) pid, 0) != 0 && errno == ESRCH))
+      shm_unlink(name);
+  }
+
+  closedir(dirp);
+}
+#endif /* XV_HAVE_SHM_OPEN */
+
+
+/********************************************/
+void SweepClipboard(void)
+{
+  /* called at startup:  gets rid of any clipboard segments that earlier
+     xvs left behind, and that nothing can paste from any more */
+
+#ifdef XV_HAVE_SHM_OPEN
+  shmClipSweep((char *) NULL);
+#endif
+}
+
+
 
 
 
@@ -0,0 +1,543 @@
+/*
+ * xvdeep.c - keeps the full-precision samples of 16-bit images
+ *
+ *  Contains:
+ *            void DeepTake(pinfo)
+ *            void FreeDeep()
+ *            void DeepStale()
+ *            int  DeepValid()
+ *            int  DeepGetLevels(&lo, &hi, &gam)
+ *            void DeepDevelop(lo, hi, gam)
+ *            int  DeepGetWindow(&wlo, &whi)
+ *            int  DeepSetWindow(wlo, whi)
+ *            int  DeepNorm()
+ *            void DeepKeepOrig()
+ *            int  DeepHoldOrig()
+ *            void DeepRestoreOrig()
+ *            void DeepRotate(dir)
+ *            void DeepFlip(dir)
+ *            int  DeepGammify(outpic, igraf, rgraf, ggraf, bgraf)
+ *
+ * 'pic' is always 8 bits per sample.  When a loader reads an image with
+ * more bits than that (16-bit PNG, PNM with maxval > 255, 16-bit PDS), it
+ * can also hand back the samples it read, unreduced, in pinfo->deep.
+ * That 'master' is kept here, next to 'pic', and while it still describes
+ * 'pic' (same size, 24-bit mode, not edited since), 'pic' is 'developed'
+ * from it:  each sample goes through the levels set with Levels (black
+ * point, white point, gamma) and then through the color editor's Norm
+ * window (the part of that range that's stretched to black..white).  So
+ * Norm, Levels, and the color editor's curves lose no precision, and the
+ * file doesn't have to be read again.
+ *
+ * The master stops describing 'pic' as soon as 'pic' is changed by
+ * anything that doesn't know about it (algorithms, painting, pasting,
+ * 8/24-bit switches, loading another image).  If it still describes
+ * origPic, the picture that Undo All goes back to, it's kept for that,
+ * otherwise it's freed.  Rotations and whole-image flips are applied to
+ * it as well.
+ */
+
+#include "copyright.h"
+
+#include "xv.h"
+
+static u_short *deepPic = (u_short *) NULL;
+static int      deepW, deepH;      /* size of deepPic */
+static int      deepSpp;           /* samples per pixel:  1 (grey) or 3 */
+static int      deepMax;           /* white */
+static int      forPic, forOrig;   /* 'pic', origPic developed from it */
+static int      holdOrig;          /* keep it through the next FreeDeep() */
+
+typedef struct { int    lo, hi;    /* levels:  black and white points */
+		 double gam;       /*   and gamma */
+		 double wlo, whi;  /* Norm window, as fractions of lo..hi */
+	       } DEEPDEV;
+
+static DEEPDEV  picDev;            /* how 'pic' was developed */
+static DEEPDEV  origDev;           /* how origPic was */
+
+static double  *devTable    PARM((DEEPDEV *));
+static void     develop     PARM((void));
+
+
+/***************************************************/
+void DeepTake(PICINFO *pinfo)
+{
+  /* makes pinfo->deep the master copy of the just-installed 'pic', if it
+     can be one.  pinfo->deep is NULL afterwards, either way */
+
+  holdOrig = 0;
+  FreeDeep();
+
+  if (!pinfo->deep) return;
+
+  if (picType != PIC24 || pinfo->w != pWIDE || pinfo->h != pHIGH ||
+      (pinfo->deepSpp != 1 && pinfo->deepSpp != 3) || pinfo->deepMax < 1) {
+    free(pinfo->deep);
+    pinfo->deep = (u_short *) NULL;
+    return;
+  }
+
+  deepPic = pinfo->deep;
+  deepW   = pinfo->w;
+  deepH   = pinfo->h;
+  deepSpp = pinfo->deepSpp;
+  deepMax = pinfo->deepMax;
+  forPic  = 1;
+
+  picDev.lo  = 0;    picDev.hi  = deepMax;  picDev.gam = 1.0;
+  picDev.wlo = 0.0;  picDev.whi = 1.0;
+
+  pinfo->deep = (u_short *) NULL;
+}
+
+
+/***************************************************/
+void FreeDeep(void)
+{
+  /* throws the master away.  Unless DeepHoldOrig() asked for it to be kept
+     for Undo All, in which case it just stops describing 'pic' */
+
+  if (holdOrig) { forPic = 0;  return; }
+
+  if (deepPic) free(deepPic);
+  deepPic = (u_short *) NULL;
+  forPic = forOrig = 0;
+}
+
+
+/***************************************************/
+void DeepStale(void)
+{
+  /* called when 'pic' has been changed by something other than developing.
+     The master is kept only if Undo All can still use it */
+
+  forPic = 0;
+  if (!forOrig) FreeDeep();
+}
+
+
+/***************************************************/
+int DeepValid(void)
+{
+  /* returns '1' if 'pic' can be (re)developed from the master */
+
+  return (deepPic && forPic && pic && picType == PIC24 &&
+	  deepW == pWIDE && deepH == pHIGH);
+}
+
+
+/***************************************************/
+int DeepGetLevels(int *lo, int *hi, double *gam)
+{
+  /* returns the levels 'pic' was last developed with, and the master's
+     white level.  Returns '0' if there's no usable master */
+
+  if (!DeepValid()) return 0;
+
+  *lo = picDev.lo;  *hi = picDev.hi;  *gam = picDev.gam;
+  return deepMax;
+}
+
+
+/***************************************************/
+void DeepDevelop(int lo, int hi, double gam)
+{
+  /* redevelops 'pic' from the master with new levels:  'lo' and below
+     become black, 'hi' and up become white, and the rest is spread between
+     them along a gamma 'gam' curve (before the Norm window is applied).
+     Doesn't regenerate cpic/epic;  that's up to the caller */
+
+  if (!DeepValid()) return;
+
+  if (lo < 0) lo = 0;
+  if (hi > deepMax) hi = deepMax;
+  if (hi <= lo) hi = lo + 1;
+  if (gam <= 0.0) gam = 1.0;
+
+  picDev.lo = lo;  picDev.hi = hi;  picDev.gam = gam;
+  develop();
+}
+
+
+/***************************************************/
+int DeepGetWindow(double *wlo, double *whi)
+{
+  /* returns the Norm window 'pic' was last developed with.  Returns '0'
+     (and the full window) if there's no usable master */
+
+  if (!DeepValid()) { *wlo = 0.0;  *whi = 1.0;  return 0; }
+
+  *wlo = picDev.wlo;  *whi = picDev.whi;
+  return 1;
+}
+
+
+/***************************************************/
+int DeepSetWindow(double wlo, double whi)
+{
+  /* redevelops 'pic' from the master with a new Norm window, if it differs
+     from the current one.  Returns '1' if 'pic' was changed.  Doesn't
+     regenerate cpic/epic;  that's up to the caller */
+
+  if (!DeepValid()) return 0;
+
+  if (wlo < 0.0) wlo = 0.0;
+  if (whi > 1.0) whi = 1.0;
+  if (whi <= wlo) { wlo = 0.0;  whi = 1.0; }
+
+  if (wlo == picDev.wlo && whi == picDev.whi) return 0;
+
+  picDev.wlo = wlo;  picDev.whi = whi;
+  develop();
+  return 1;
+}
+
+
+/***************************************************/
+int DeepNorm(void)
+{
+  /* sets the Norm window to the range of the master's levels that's
+     actually used, so its darkest sample becomes black and its brightest
+     white.  Returns '1' if 'pic' was redeveloped */
+
+  u_short *sp;
+  long     n;
+  int      minv, maxv;
+  double  *tab, wlo, whi;
+
+  if (!DeepValid()) return 0;
+
+  minv = deepMax;  maxv = 0;
+  n = (long) deepW * deepH * deepSpp;
+  for (sp=deepPic; n>0; n--, sp++) {
+    if (*sp < minv) minv = *sp;
+    if (*sp > maxv) maxv = *sp;
+  }
+  if (maxv > deepMax) maxv = deepMax;
+
+  /* where those land in the levels' range, before any window */
+  picDev.wlo = 0.0;  picDev.whi = 1.0;
+  tab = devTable(&picDev);
+  wlo = tab[minv] / 255.0;  whi = tab[maxv] / 255.0;
+  free(tab);
+
+  if (whi <= wlo) { wlo = 0.0;  whi = 1.0; }
+
+  picDev.wlo = wlo;  picDev.whi = whi;
+  develop();
+  return 1;
+}
+
+
+/***************************************************/
+void DeepKeepOrig(void)
+{
+  /* called when 'pic' is being copied to origPic.  If the master describes
+     'pic', it now describes origPic, too */
+
+  if (!deepPic) return;
+
+  forOrig = forPic;
+  origDev = picDev;
+}
+
+
+/***************************************************/
+int DeepHoldOrig(void)
+{
+  /* called by Undo All, before it tosses 'pic' and puts origPic in its
+     place.  Returns '1' if the master describes origPic, in which case it
+     is kept through the KillOldPics() that comes first.  DeepRestoreOrig()
+     must be called once origPic is 'pic' again */
+
+  holdOrig = (deepPic && forOrig);
+  return holdOrig;
+}
+
+
+/***************************************************/
+void DeepRestoreOrig(void)
+{
+  /* origPic is 'pic' again:  it's described by the master, with the levels
+     it was developed with.  The color editor's Norm window isn't undone by
+     Undo All, so 'pic' is redeveloped if that has changed since */
+
+  double wlo, whi;
+
+  if (!holdOrig) return;
+  holdOrig = 0;
+
+  wlo = picDev.wlo;  whi = picDev.whi;
+  picDev  = origDev;
+  forPic  = 1;
+  forOrig = 0;
+
+  DeepSetWindow(wlo, whi);
+}
+
+
+/***************************************************/
+void DeepRotate(int dir)
+{
+  /* rotates the master 90 degrees clockwise (dir=0) or counter-clockwise,
+     as RotatePic() does to 'pic' (and origPic) */
+
+  u_short *rot, *dp, *sp;
+  int      x, y, k, w, h, spp;
+
+  if (!deepPic) return;
+
+  w = deepW;  h = deepH;  spp = deepSpp;
+
+  rot = (u_short *) malloc((size_t) w * h * spp * sizeof(u_short));
+  if (!rot) { FreeDeep();  return; }     /* not fatal.  just lose it */
+
+  dp = rot;
+  if (dir==0) {
+    for (x=0; x<w; x++)
+      for (y=h-1; y>=0; y--) {
+	sp = deepPic + ((size_t) y * w + x) * spp;
+	for (k=0; k<spp; k++) *dp++ = sp[k];
+      }
+  }
+  else {
+    for (x=w-1; x>=0; x--)
+      for (y=0; y<h; y++) {
+	sp = deepPic + ((size_t) y * w + x) * spp;
+	for (k=0; k<spp; k++) *dp++ = sp[k];
+      }
+  }
+
+  free(deepPic);
+  deepPic = rot;
+  deepW = h;  deepH = w;
+}
+
+
+/***************************************************/
+void DeepFlip(int dir)
+{
+  /* flips the master horizontally (dir=0) or vertically (dir!=0), as
+     FlipPic() does to 'pic'.  origPic isn't flipped, so the master no
+     longer describes it */
+
+  u_short *p1, *p2, t;
+  int      x, y, k, w, h, spp;
+  size_t   bpl;
+
+  if (!deepPic) return;
+
+  forOrig = 0;
+  if (!forPic) { FreeDeep();  return; }
+
+  w = deepW;  h = deepH;  spp = deepSpp;
+  bpl = (size_t) w * spp;
+
+  if (dir==0) {
+    for (y=0; y<h; y++) {
+      p1 = deepPic + y * bpl;
+      p2 = p1 + bpl - spp;
+      for (x=0; x<w/2; x++, p1+=spp, p2-=spp)
+	for (k=0; k<spp; k++) { t = p1[k];  p1[k] = p2[k];  p2[k] = t; }
+    }
+  }
+  else {
+    for (y=0; y<h/2; y++) {
+      p1 = deepPic + y * bpl;
+      p2 = deepPic + (h-1-y) * bpl;
+      for (x=0; x<(int) bpl; x++) { t = p1[x];  p1[x] = p2[x];  p2[x] = t; }
+    }
+  }
+}
+
+
+/***************************************************/
+int DeepGammify(byte *outpic, GRAF *igraf, GRAF *rgraf, GRAF *ggraf, GRAF *bgraf)
+{
+  /* GammifyPic24() of 'pic', done from the master instead:  develops each
+     sample without rounding it, and applies the color editor's Intensity
+     curve and its R, G and B curves to that, so a gamma (or any other
+     curve) loses none of the master's precision.  The Intensity curve is
+     applied to the HSV 'value', as GammifyPic24() does.  Only handles
+     those curves;  the caller checks that the other HSV controls are
+     idle.  Returns '0' if it couldn't do it */
+
+  double  *dev, *ifn, *ctab[3], v, sc, x;
+  byte    *lut[3], *op;
+  u_short *sp;
+  GRAF    *cgraf[3];
+  int      i, k, imod, n, smax;
+  long     npix;
+
+#define CSTEPS 4096            /* curve table steps, for per-pixel lookups */
+
+  if (!DeepValid()) return 0;
+
+  cgraf[0] = rgraf;  cgraf[1] = ggraf;  cgraf[2] = bgraf;
+
+  for (i=0; i<256 && igraf->func[i]==i; i++);
+  imod = (i<256);
+
+  dev = devTable(&picDev);
+  n   = deepMax + 1;
+
+  WaitCursor();
+
+  if (!imod || deepSpp == 1) {
+    /* every output sample depends on one master sample:  straight lookups.
+       (a grey pixel's 'value' is its grey level) */
+
+    lut[0] = (byte *) malloc((size_t) n * 3);
+    if (!lut[0]) { free(dev);  return 0; }
+    lut[1] = lut[0] + n;  lut[2] = lut[1] + n;
+
+    for (i=0; i<n; i++) {
+      v = dev[i];
+      if (imod) v = GrafFunc(igraf, v);
+      for (k=0; k<3; k++) lut[k][i] = (byte) floor(GrafFunc(cgraf[k], v) + 0.5);
+    }
+
+    sp = deepPic;  op = outpic;
+    npix = (long) deepW * deepH;
+    if (deepSpp == 1) {
+      for ( ; npix>0; npix--, sp++) {
+	*op++ = lut[0][*sp];  *op++ = lut[1][*sp];  *op++ = lut[2][*sp];
+      }
+    }
+    else {
+      for ( ; npix>0; npix--) {
+	*op++ = lut[0][*sp++];  *op++ = lut[1][*sp++];  *op++ = lut[2][*sp++];
+      }
+    }
+
+    free(lut[0]);
+    free(dev);
+    return 1;
+  }
+
+
+  /* color, and the Intensity curve is in use:  it scales each pixel by
+     curve(value) / value, which keeps its hue and saturation.  Near-black
+     pixels are made grey, as GammifyPic24() does */
+
+  ifn = (double *) malloc((size_t) n * sizeof(double));
+  ctab[0] = (double *) malloc((size_t) (CSTEPS+1) * 3 * sizeof(double));
+  if (!ifn || !ctab[0]) {
+    if (ifn) free(ifn);
+    if (ctab[0]) free(ctab[0]);
+    free(dev);
+    return 0;
+  }
+  ctab[1] = ctab[0] + CSTEPS+1;  ctab[2] = ctab[1] + CSTEPS+1;
+
+  for (i=0; i<n; i++) ifn[i] = GrafFunc(igraf, dev[i]);
+  for (k=0; k<3; k++)
+    for (i=0; i<=CSTEPS; i++)
+      ctab[k][i] = GrafFunc(cgraf[k], (255.0 * i) / CSTEPS);
+
+  sp = deepPic;  op = outpic;
+  for (npix = (long) deepW * deepH; npix>0; npix--, sp+=3) {
+    smax = sp[0];
+    if (sp[1] > smax) smax = sp[1];
+    if (sp[2] > smax) smax = sp[2];
+    if (smax > deepMax) smax = deepMax;
+
+    v = dev[smax];
+    sc = (v > 16.0) ? ifn[smax] / v : 0.0;
+
+    for (k=0; k<3; k++) {
+      if (sc > 0.0) x = dev[(sp[k] > deepMax) ? deepMax : sp[k]] * sc;
+      else x = ifn[smax];
+
+      /* the R, G or B curve, interpolated from its table */
+      x = x * CSTEPS / 255.0;
+      if (x <= 0.0) x = ctab[k][0];
+      else if (x >= CSTEPS) x = ctab[k][CSTEPS];
+      else {
+	i = (int) x;
+	x = ctab[k][i] + (x - i) * (ctab[k][i+1] - ctab[k][i]);
+      }
+
+      *op++ = (byte) floor(x + 0.5);
+    }
+  }
+
+  free(ctab[0]);
+  free(ifn);
+  free(dev);
+  return 1;
+
+#undef CSTEPS
+}
+
+
+/***************************************************/
+static double *devTable(DEEPDEV *dd)
+{
+  /* returns a malloc'd table of what each master sample value develops
+     into, unrounded (0.0 - 255.0) */
+
+  double *tab, invg, wide, u;
+  int     i;
+
+  tab = (double *) malloc(((size_t) deepMax + 1) * sizeof(double));
+  if (!tab) FatalError("couldn't malloc 'tab' in devTable()");
+
+  invg = 1.0 / dd->gam;
+  wide = dd->whi - dd->wlo;
+
+  for (i=0; i<=deepMax; i++) {
+    if      (i <= dd->lo) u = 0.0;
+    else if (i >= dd->hi) u = 1.0;
+    else if (dd->gam == 1.0) u = (double) (i - dd->lo) / (dd->hi - dd->lo);
+    else u = pow((double) (i - dd->lo) / (dd->hi - dd->lo), invg);
+
+    u = (u - dd->wlo) / wide;
+    if (u < 0.0) u = 0.0;
+    if (u > 1.0) u = 1.0;
+    tab[i] = u * 255.0;
+  }
+
+  return tab;
+}
+
+
+/***************************************************/
+static void develop(void)
+{
+  /* rewrites 'pic' from the master, as 'picDev' says */
+
+  double  *tab;
+  byte    *lut, *pp;
+  u_short *sp;
+  int      i, v;
+  long     n;
+
+  tab = devTable(&picDev);
+
+  lut = (byte *) malloc((size_t) deepMax + 1);
+  if (!lut) FatalError("couldn't malloc 'lut' in develop()");
+  for (i=0; i<=deepMax; i++) lut[i] = (byte) floor(tab[i] + 0.5);
+  free(tab);
+
+  WaitCursor();
+
+  sp = deepPic;  pp = pic;
+  n  = (long) deepW * deepH;
+
+  if (deepSpp == 1) {
+    for ( ; n>0; n--, pp+=3) {
+      v = *sp++;
+      pp[0] = pp[1] = pp[2] = lut[(v > deepMax) ? deepMax : v];
+    }
+  }
+  else {
+    for (n *= 3; n>0; n--) {
+      v = *sp++;
+      *pp++ = lut[(v > deepMax) ? deepMax : v];
+    }
+  }
+
+  free(lut);
+}
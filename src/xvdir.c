@@ -19,6 +19,8 @@
  *
  *   InitPoll()             -  called whenever a file is first loaded
  *   CheckPoll(int)         -  checks to see whether we should reload
+ *   PollFD()               -  fd that becomes readable when CheckPoll() has
+ *                             something to look at, or -1
  */
 
 #include "copyright.h"
@@ -33,6 +35,11 @@
 #include <pwd.h>       /* for getpwnam() prototype and passwd struct */
 #endif
 
+#ifdef __linux__
+#  include <sys/inotify.h>
+#  define HAVE_INOTIFY
+#endif
+
 
 #define DEF_DIRWIDE (350*dpiMult)  /* initial size of directory window */
 #define DEF_DIRHIGH (400*dpiMult)
@@ -1674,6 +1681,14 @@ int DoSave(void)
   WaitCursor();
 
   thepic = GenSavePic(&ptype, &w, &h, &pfree, &nc, &rp, &gp, &bp);
+  if (!thepic) {
+    ErrPopUp("Not enough memory to build the image to save.\n\n"
+	     "Try saving it at 'normal size', or just a selection of it.",
+	     "\nBummer!");
+    SetCursors(-1);
+    dbut[S_BOK].lit = 0;  BTRedraw(&dbut[S_BOK]);
+    return -1;
+  }
 
   fp = OpenOutFile(fullname);
   if (!fp) {
@@ -2526,7 +2541,9 @@ static byte *handleNormSel(int *pptype, int *pwide, int *phigh, int *pfree)
    * whole cpic or epic.
    *
    * if selection does not intersect cpic/epic, returns cpic/epic
-   * NEVER RETURNS NULL
+   *
+   * returns NULL if epic only exists a viewport at a time, and there isn't
+   * enough memory to expand the part of it that's wanted
    */
 
   byte *thepic;
@@ -2537,8 +2554,7 @@ static byte *handleNormSel(int *pptype, int *pwide, int *phigh, int *pfree)
   if (savenormCB.val) { thepic = cpic;  pw = cWIDE;  ph = cHIGH; }
                  else { thepic = epic;  pw = eWIDE;  ph = eHIGH; }
 
-  *pwide = pw;  *phigh = ph;
-
+  slx = sly = 0;  slw = pw;  slh = ph;
 
   if (saveselCB.active && saveselCB.val && HaveSelection()) {
     GetSelRCoords(&slx, &sly, &slw, &slh);    /* in 'pic' coords */
@@ -2553,6 +2569,9 @@ static byte *handleNormSel(int *pptype, int *pwide, int *phigh, int *pfree)
 	thepic = XVGetSubImage(pic, *pptype, pWIDE,pHIGH, slx, sly, slw, slh);
 	*pfree = 1;
       }
+
+      *pwide = slw;  *phigh = slh;
+      return thepic;
     }
     else {                                    /* convert sel -> epic coords */
       int x1,x2,y1,y2;
@@ -2564,14 +2583,19 @@ static byte *handleNormSel(int *pptype, int *pwide, int *phigh, int *pfree)
       CropRect2Rect(&slx, &sly, &slw, &slh, 0,0,pw,ph);
 
       if (slw<1 || slh<1) { slx = sly = 0;  slw=pw;  slh=ph; }
-
-      if (slx!=0 || sly!=0 || slw!=pw || slh!=ph) {
-	thepic = XVGetSubImage(thepic, *pptype, pw, ph, slx, sly, slw, slh);
-	*pfree = 1;
-      }
     }
+  }
+
+  *pwide = slw;  *phigh = slh;
 
-    *pwide = slw;  *phigh = slh;
+  if (!thepic) {            /* epic only exists a viewport at a time */
+    thepic = EpicRect(slx, sly, slw, slh);     /* just the part we want */
+    if (!thepic) return NULL;
+    *pfree = 1;
+  }
+  else if (slx!=0 || sly!=0 || slw!=pw || slh!=ph) {
+    thepic = XVGetSubImage(thepic, *pptype, pw, ph, slx, sly, slw, slh);
+    *pfree = 1;
   }
 
   return thepic;
@@ -2587,12 +2611,16 @@ byte *GenSavePic(int *ptypeP, int *wP, int *hP, int *freeP, int *ncP, byte **rma
    * to use rmapP, gmapP, bmapP.
    *
    * if freeP is set, image can safely be freed after it is saved
+   *
+   * returns NULL if there isn't enough memory to build the image, in which
+   * case the save should be abandoned, and the user told why
    */
 
   byte *pic1, *pic2;
   int   ptype, w, h, pfree;
 
   pic1 = handleNormSel(&ptype, &w, &h, &pfree);
+  if (!pic1) return NULL;
 
   pic2 = handleBWandReduced(pic1, ptype, w,h, MBWhich(&colMB),
 			      ncP, rmapP, gmapP, bmapP);
@@ -2664,6 +2692,19 @@ static struct stat origStat, lastStat;
 static int haveStat = 0, haveLastStat = 0;
 static time_t lastchgtime;
 
+#ifdef HAVE_INOTIFY
+/* where the kernel can tell us, we watch the file's directory for
+   IN_CLOSE_WRITE (writer finished) and IN_MOVED_TO (new file renamed into
+   place) on the file's name, and reload the moment one arrives instead of
+   waiting for size/mtime to settle.  The directory is watched rather than
+   the file so that replace-by-rename keeps working. */
+static int  inoFD = -1, inoWD = -1;
+static char inoName[MAXPATHLEN];
+
+static void pollWatch     PARM((const char *));
+static int  pollInotify   PARM((void));
+#endif
+
 
 /****************************/
 void InitPoll(void)
@@ -2684,6 +2725,10 @@ void InitPoll(void)
 			 (long)origStat.st_size, (long)origStat.st_mtime);
     }
   }
+
+#ifdef HAVE_INOTIFY
+  pollWatch(haveStat ? namelist[curname] : (char *) NULL);
+#endif
 }
 
 
@@ -2698,6 +2743,23 @@ int CheckPoll(int del)
   struct stat st;
   time_t nowT;
 
+#ifdef HAVE_INOTIFY
+  if (inoWD >= 0) {
+    if (!pollInotify()) return 0;
+
+    /* writer's done with it.  remember what it looks like now, so that the
+       stat() fallback has the right baseline if the watch ever goes away */
+    if (curname>=0 && curname<numnames &&
+	stat(namelist[curname], &st)==0) {
+      if (st.st_size == 0) return 0;         /* truncated, not yet rewritten */
+      bcopy((char *) &st, (char *) &origStat, sizeof(struct stat));
+      haveStat = 1;
+    }
+    haveLastStat = 0;  lastchgtime = 0;
+    return 1;
+  }
+#endif
+
   time(&nowT);
 
   if (haveStat && curname>=0 && curname<numnames &&
@@ -2733,6 +2795,90 @@ int CheckPoll(int del)
 }
 
 
+/****************************/
+int PollFD(void)
+{
+  /* returns a descriptor that becomes readable when the polled file may
+     have changed, for EventLoop() to sleep on.  -1 if there isn't one, in
+     which case CheckPoll() has to be called periodically */
+
+#ifdef HAVE_INOTIFY
+  if (inoWD >= 0) return inoFD;
+#endif
+  return -1;
+}
+
+
+#ifdef HAVE_INOTIFY
+/****************************/
+static void pollWatch(const char *fname)
+{
+  /* (re)points the inotify watch at 'fname's directory.  NULL drops it.
+     on any failure we're left without a watch, and CheckPoll() goes back
+     to stat()ing */
+
+  char dir[MAXPATHLEN];
+  const char *slash;
+  size_t dlen;
+
+  if (inoFD >= 0 && inoWD >= 0) inotify_rm_watch(inoFD, inoWD);
+  inoWD = -1;
+
+  if (!fname || strlen(fname) >= MAXPATHLEN) return;
+
+  if (inoFD < 0) {
+    inoFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inoFD < 0) return;
+  }
+
+  slash = strrchr(fname, '/');
+  if (!slash) strcpy(dir, ".");
+  else {
+    dlen = (slash == fname) ? 1 : (size_t) (slash - fname);
+    strncpy(dir, fname, dlen);
+    dir[dlen] = '\0';
+  }
+  strcpy(inoName, slash ? slash+1 : fname);
+
+  inoWD = inotify_add_watch(inoFD, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+  if (DEBUG) fprintf(stderr,"InitPoll: inotify watch on '%s' for '%s': %d\n",
+		     dir, inoName, inoWD);
+
+  /* anything queued for the previous file is no longer interesting */
+  if (inoWD >= 0) pollInotify();
+}
+
+
+/****************************/
+static int pollInotify(void)
+{
+  /* drains the inotify queue.  returns '1' if any of it was about our file */
+
+  union {                           /* keeps the buffer suitably aligned */
+    struct inotify_event ev;
+    char                 buf[4096];
+  } u;
+  const struct inotify_event *ev;
+  ssize_t len;
+  char   *p;
+  int     hit = 0;
+
+  while ((len = read(inoFD, u.buf, sizeof(u.buf))) > 0) {
+    for (p = u.buf;  p < u.buf + len;
+	 p += sizeof(struct inotify_event) + ev->len) {
+      ev = (const struct inotify_event *) p;
+      if (ev->mask & IN_Q_OVERFLOW) hit = 1;     /* lost track:  reload */
+      else if (ev->wd != inoWD) continue;        /* left over from old watch */
+      else if (ev->mask & IN_IGNORED) inoWD = -1;   /* directory went away */
+      else if (ev->len && strcmp(ev->name, inoName)==0) hit = 1;
+    }
+  }
+
+  return hit;
+}
+#endif
+
+
 /***************************************************************/
 void DIRDeletedFile(char *name)
 {
@@ -23,6 +23,14 @@
 
 #include "xv.h"
 
+#include <time.h>          /* clock_gettime() */
+
+#ifdef __linux__
+#  include <stdint.h>
+#  include <sys/timerfd.h>
+#  define HAVE_TIMERFD
+#endif
+
 #include "bits/dropper"
 #include "bits/dropperm"
 #include "bits/pen"
@@ -34,6 +42,7 @@ static int   rotatesLeft = 0;
 static int   origcropx, origcropy, origcropvalid=0;
 static int   canstartwait;
 static int   frominterrupt = 0;
+static int   dirtyx0, dirtyy0, dirtyx1, dirtyy1;  /* painted area of pic */
 static char *xevPriSel = NULL;
 static Time  lastEventTime;
 static Cursor dropper = 0, pen = 0, blur = 0;
@@ -69,9 +78,13 @@ static void   BlurPaint        PARM((void));
 static int    highbit          PARM((u_long));
 static u_long RGBToXColor      PARM((int, int, int));
 static void   blurPixel        PARM((int, int));
+static void   addDirty         PARM((int, int));
 
 static void   annotatePic      PARM((void));
 
+static double nowMsec          PARM((void));
+static int    waitEvent        PARM((double, int *, int));
+
 static int    debkludge_offx;
 static int    debkludge_offy;
 
@@ -88,15 +101,15 @@ extern XtAppContext context;
 int EventLoop(void)
 /****************/
 {
+  /* rather than napping in Timer() and sleep() between looks at the
+     X queue, the 'real-time' cases (-wait, -poll, blinking the selection)
+     each keep a deadline on a monotonic clock, and we block in select()
+     on the X connection until an event arrives or the earliest deadline
+     comes due.  Nothing runs while we're idle. */
+
   XEvent event;
-  int    retval,done,waiting;
-#ifdef USE_TICKS
-  clock_t waitsec_ticks=0L, orgtime_ticks=0L, curtime_ticks;
-  clock_t elapsed_ticks=0L, remaining_interval;
-  clock_t clock_ticks = sysconf(_SC_CLK_TCK);
-#else
-  time_t orgtime=0L, curtime;
-#endif
+  int    retval,done,waiting,fds[2],ready;
+  double now, waitdeadline, blinkdeadline, polldeadline, deadline;
 
 
 #ifndef NOSIGNAL
@@ -123,6 +136,7 @@ int EventLoop(void)
      going to be getting Expose/Configure events on the root window */
 
   done = retval = waiting = canstartwait = 0;
+  waitdeadline = blinkdeadline = polldeadline = 0.0;
 
   if (useroot) canstartwait = 1;
   else if (mainW) {           /* if mainW iconified, start wait now */
@@ -139,19 +153,15 @@ int EventLoop(void)
       /* we wanna wait, we can wait, we haven't started waiting yet, and
 	 all pending events (ie, drawing the image the first time)
 	 have been dealt with:  START WAITING */
-#ifdef USE_TICKS
-      waitsec_ticks = (clock_t)(waitsec * clock_ticks);
-      orgtime_ticks = times(NULL);  /* unclear if NULL valid, but OK on Linux */
-#else
-      orgtime = time(NULL);
-#endif
+      waitdeadline = nowMsec() + waitsec * 1000.0;
       waiting = 1;
     }
 
 
     /* if there's an XEvent pending *or* we're not doing anything
        in real-time (polling, flashing the selection, etc.) get next event */
-    if ((waitsec<0.0 && !polling && !HaveSelection()) || XPending(theDisp)>0)
+    if ((waitsec<0.0 && !polling && !HaveSelection() && BrowseFD()<0) ||
+	XPending(theDisp)>0)
     {
 #ifndef NOSIGNAL
       XtAppNextEvent(context, &event);
@@ -161,46 +171,41 @@ int EventLoop(void)
       retval = HandleEvent(&event,&done);
     }
 
-    else {                      /* no events.  check wait status */
-      if (HaveSelection()) {
+    else {                      /* no events.  run whatever has come due */
+      now = nowMsec();
+
+      if (waitsec>=0.0 && waiting && now >= waitdeadline)
+	return waitloop? NEXTLOOP : NEXTQUIT;
+
+      if (HaveSelection() && now >= blinkdeadline) {
 	DrawSelection(0);
 	DrawSelection(1);
 	XFlush(theDisp);
-	Timer(200);             /* milliseconds */
+	blinkdeadline = now + 200.0;    /* milliseconds */
       }
 
-      if (polling) {
+      if (polling && now >= polldeadline) {
 	if (CheckPoll(2)) return POLLED;
-	else if (!XPending(theDisp)) sleep(1);
+	polldeadline = now + 1000.0;
       }
 
-      if (waitsec>=0.0 && waiting) {
-#ifdef USE_TICKS
-        curtime_ticks = times(NULL);   /* value in ticks */
-        if (curtime_ticks < orgtime_ticks) {
-          /* clock ticks rolled over:  need to correct for that (i.e.,
-           *  curtime_ticks is presumably quite small, while orgtime_ticks
-           *  should be close to LONG_MAX, so do math accordingly--any way
-           *  to check whether clock_t is *not* a signed long?) */
-          elapsed_ticks = curtime_ticks + (LONG_MAX - orgtime_ticks);
-        } else
-          elapsed_ticks = curtime_ticks - orgtime_ticks;
-        remaining_interval = waitsec_ticks - elapsed_ticks;
-        if (remaining_interval >= (clock_t)(1 * clock_ticks))
-          sleep(1);
-        else {
-          /* less than one second remaining:  do delay in msec, then return */
-          Timer((remaining_interval * 1000L) / clock_ticks);  /* can't overflow */
-          return waitloop? NEXTLOOP : NEXTQUIT;
-        }
-#else
-        curtime = time(NULL);          /* value in seconds */
-	if (curtime - orgtime < (time_t)waitsec)
-          sleep(1);
-	else
-          return waitloop? NEXTLOOP : NEXTQUIT;
-#endif
-      }
+      /* sleep until the next X event or the earliest pending deadline.
+	 if the polled file can be watched, its fd wakes us instead of the
+	 once-a-second stat().  the schnauzers' directory watch, if any,
+	 can wake us too */
+      fds[0] = polling ? PollFD() : -1;
+      fds[1] = BrowseFD();
+
+      deadline = -1.0;
+      if (waitsec>=0.0 && waiting) deadline = waitdeadline;
+      if (HaveSelection() && (deadline < 0.0 || blinkdeadline < deadline))
+	deadline = blinkdeadline;
+      if (polling && fds[0] < 0 && (deadline < 0.0 || polldeadline < deadline))
+	deadline = polldeadline;
+
+      ready = waitEvent(deadline, fds, 2);
+      if (ready & 1) polldeadline = 0.0;     /* check the file right away */
+      if (ready & 2) BrowseInotify();
     }
   }  /* while (!done) */
 
@@ -211,6 +216,106 @@ int EventLoop(void)
 }
 
 
+/****************/
+static double nowMsec(void)
+/****************/
+{
+  /* milliseconds on a clock that doesn't jump when someone sets the date */
+
+#ifdef CLOCK_MONOTONIC
+  struct timespec ts;
+
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+    return (double) ts.tv_sec * 1000.0 + (double) ts.tv_nsec / 1000000.0;
+#endif
+  {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double) tv.tv_sec * 1000.0 + (double) tv.tv_usec / 1000.0;
+  }
+}
+
+
+/****************/
+static int waitEvent(double deadline, int *extra, int nextra)
+/****************/
+{
+  /* blocks until the X connection or one of the 'nextra' descriptors in
+     'extra' (entries <0 are ignored) becomes readable, or 'deadline' (a
+     nowMsec() value; <0 means 'none') passes.  returns a mask with bit 'i'
+     set if extra[i] is readable.  Where timerfd exists, the
+     deadline is an absolute CLOCK_MONOTONIC timer watched alongside the
+     X fd, so it fires exactly on schedule rather than after a select()
+     timeout that was computed a little while ago.  Signals just make us
+     return early, and EventLoop() sorts things out. */
+
+  fd_set         fds;
+  int            i, xfd, maxfd, ready;
+  struct timeval tv, *tvp;
+  double         ms;
+#ifdef HAVE_TIMERFD
+  static int     tfd = -2;
+  struct itimerspec its;
+  uint64_t       expirations;
+#endif
+
+  XFlush(theDisp);
+  if (XPending(theDisp)) return 0;
+
+  xfd = ConnectionNumber(theDisp);
+  FD_ZERO(&fds);
+  FD_SET(xfd, &fds);
+  maxfd = xfd;
+  for (i=0; i<nextra; i++) {
+    if (extra[i] < 0) continue;
+    FD_SET(extra[i], &fds);
+    if (extra[i] > maxfd) maxfd = extra[i];
+  }
+  tvp = (struct timeval *) NULL;
+
+#ifdef HAVE_TIMERFD
+  if (tfd == -2)
+    tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+  if (tfd >= 0 && deadline >= 0.0) {
+    bzero((char *) &its, sizeof(its));
+    its.it_value.tv_sec  = (time_t) (deadline / 1000.0);
+    its.it_value.tv_nsec = (long) ((deadline - (double) its.it_value.tv_sec
+				    * 1000.0) * 1000000.0);
+    if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0)
+      its.it_value.tv_nsec = 1;     /* all-zero would disarm it */
+
+    if (timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL) == 0) {
+      FD_SET(tfd, &fds);
+      if (tfd > maxfd) maxfd = tfd;
+      deadline = -1.0;              /* the timerfd has it covered */
+    }
+  }
+#endif
+
+  if (deadline >= 0.0) {
+    ms = deadline - nowMsec();
+    if (ms < 0.0) ms = 0.0;
+    tv.tv_sec  = (long) (ms / 1000.0);
+    tv.tv_usec = (long) ((ms - (double) tv.tv_sec * 1000.0) * 1000.0);
+    tvp = &tv;
+  }
+
+  if (select(maxfd + 1, XV_FDTYPE &fds, XV_FDTYPE NULL, XV_FDTYPE NULL,
+	     tvp) <= 0) return 0;
+
+#ifdef HAVE_TIMERFD
+  if (tfd >= 0 && FD_ISSET(tfd, &fds))
+    if (read(tfd, &expirations, sizeof(expirations)) < 0) { /* drained */ }
+#endif
+
+  for (i=ready=0; i<nextra; i++) {
+    if (extra[i] >= 0 && FD_ISSET(extra[i], &fds)) ready |= (1<<i);
+  }
+  return ready;
+}
+
+
 
 /****************/
 int HandleEvent(XEvent *event, int *donep)
@@ -1024,6 +1129,18 @@ static void SelectDispMB(int i)
     SetCursors(-1);
   }
 
+  else if (i>=DMB_FILTXV && i<=DMB_FILTLAN && !dispMB.flags[i]) {
+    smoothFilter = i - DMB_FILTXV;
+    for (i=DMB_FILTXV; i<=DMB_FILTLAN; i++)
+      dispMB.flags[i] = (i - DMB_FILTXV == smoothFilter);
+
+    if (epicMode == EM_SMOOTH) {    /* show it off */
+      GenerateEpic(eWIDE, eHIGH);
+      DrawEpic();
+      SetCursors(-1);
+    }
+  }
+
   else if (i==DMB_COLRW) {   /* toggle rw on/off */
     dispMB.flags[i] = !dispMB.flags[i];
     allocMode = (dispMB.flags[i]) ? AM_READWRITE : AM_READONLY;
@@ -1779,7 +1896,7 @@ static void handleKeyEvent(XEvent *event, int *donep, int *retvalp)
 
       ck = CursorKey(ks, shift, 0);
       if (ck==CK_PAGEUP || (ck==CK_UP && shift && !but[BCROP].active)) {
-	if (strlen(pageBaseName) && numPages>1) {
+	if ((strlen(pageBaseName) || strlen(pageDocName)) && numPages>1) {
 	  done = 1;  retval = OP_PAGEUP;
 	}
 	else XBell(theDisp,0);
@@ -1787,14 +1904,14 @@ static void handleKeyEvent(XEvent *event, int *donep, int *retvalp)
 
       else if (ck==CK_PAGEDOWN ||
 	       (ck==CK_DOWN && shift && !but[BCROP].active)) {
-	if (strlen(pageBaseName) && numPages>1) {
+	if ((strlen(pageBaseName) || strlen(pageDocName)) && numPages>1) {
 	  done = 1;  retval = OP_PAGEDN;
 	}
 	else XBell(theDisp,0);
       }
 
       else if (buf[0] == 'p' && stlen>0) {
-	if (strlen(pageBaseName) && numPages>1) {
+	if ((strlen(pageBaseName) || strlen(pageDocName)) && numPages>1) {
 	  int                i,j, okay;
 	  char               buf[64], txt[512];
 	  static const char *labels[] = { "\nOk", "\033Cancel" };
@@ -1939,6 +2056,7 @@ static void handleKeyEvent(XEvent *event, int *donep, int *retvalp)
       else if (ks==XK_m) DoAlg(ALG_TINF);
       else if (ks==XK_o) DoAlg(ALG_OIL);
       else if (ks==XK_k) DoAlg(ALG_MEDIAN);
+      else if (ks==XK_q) DoAlg(ALG_LOCALEQ);
 
       else if ((ks==XK_B  || (ks==XK_b && shift)) && HaveSelection())
 	                                        DoAlg(ALG_BLEND);
@@ -1947,6 +2065,8 @@ static void handleKeyEvent(XEvent *event, int *donep, int *retvalp)
 
       else if (ks==XK_S || (ks==XK_s && shift)) DoAlg(ALG_SPREAD);
 
+      else if (ks==XK_L || (ks==XK_l && shift)) DoAlg(ALG_LEVELS);
+
       else if (ks==XK_t || ks==XK_T) {
 	if (ctrl || shift || ks==XK_T)          DoAlg(ALG_ROTATE);
         else                                    DoAlg(ALG_ROTATECLR);
@@ -2284,6 +2404,8 @@ void DrawWindow(int x, int y, int w, int h)
   if (x+w < eWIDE) w++;  /* add one for broken servers (?) */
   if (y+h < eHIGH) h++;
 
+  if (DrawViewport(x,y,w,h)) return;   /* theImage is just the visible bit */
+
   if (theImage)
     XPutImage(theDisp,mainW,theGC,theImage,x,y,x,y, (u_int) w, (u_int) h);
   else
@@ -2939,6 +3061,7 @@ static void Paint(void)
 
   state = 0;
   line = lx = ly = seenRelease = 0;
+  dirtyx0 = dirtyy0 = 0;  dirtyx1 = dirtyy1 = -1;
 
   while (state<100) {
     if (!XQueryPointer(theDisp,mainW,&rW,&cW,&rx,&ry,&x,&y,&mask)) continue;
@@ -3044,11 +3167,9 @@ static void Paint(void)
 	       | KeyReleaseMask | ColormapChangeMask
 	       | EnterWindowMask | LeaveWindowMask );
 
-  GenerateCpic();
-  WaitCursor();
-  GenerateEpic(eWIDE,eHIGH);
-  WaitCursor();
-  DrawEpic();        /* redraws selection, also */
+  /* regen just the part of cpic/epic/theImage that was painted on */
+  if (dirtyx1 >= dirtyx0)
+    UpdatePicRect(dirtyx0, dirtyy0, dirtyx1-dirtyx0+1, dirtyy1-dirtyy0+1);
   SetCursors(-1);
 }
 
@@ -3070,6 +3191,7 @@ static void paintPixel(int x, int y)
     byte *pp = pic + (y * pWIDE + x) * 3;
     pp[0] = clearR;  pp[1] = clearG;  pp[2] = clearB;
   }
+  addDirty(x,y);
 
   /* visual feedback */
   CoordP2E(x,   y,   &ex,  &ey);
@@ -3202,6 +3324,7 @@ static void BlurPaint(void)
 
 
   done1 = dragging = ox = oy = 0;
+  dirtyx0 = dirtyy0 = 0;  dirtyx1 = dirtyy1 = -1;
   while (1) {
     if (!XQueryPointer(theDisp,mainW,&rW,&cW,&rx,&ry,&x,&y,&mask)) continue;
     if (done1 && !(mask & ShiftMask)) break;    /* Shift released */
@@ -3241,16 +3364,32 @@ static void BlurPaint(void)
 	       | KeyReleaseMask | ColormapChangeMask
 	       | EnterWindowMask | LeaveWindowMask );
 
-  GenerateCpic();
-  WaitCursor();
-  GenerateEpic(eWIDE,eHIGH);
-  WaitCursor();
-  DrawEpic();        /* redraws selection, also */
+  /* regen just the part of cpic/epic/theImage that was painted on */
+  if (dirtyx1 >= dirtyx0)
+    UpdatePicRect(dirtyx0, dirtyy0, dirtyx1-dirtyx0+1, dirtyy1-dirtyy0+1);
   SetCursors(-1);
 }
 
 
 
+/***********************/
+static void addDirty(int x, int y)
+{
+  /* grows the painted-on area (dirtyx0,dirtyy0 - dirtyx1,dirtyy1, in pic
+     coords) to include pixel x,y.  empty when dirtyx1 < dirtyx0 */
+
+  if (dirtyx1 < dirtyx0) {
+    dirtyx0 = dirtyx1 = x;  dirtyy0 = dirtyy1 = y;
+    return;
+  }
+
+  if (x < dirtyx0) dirtyx0 = x;
+  if (x > dirtyx1) dirtyx1 = x;
+  if (y < dirtyy0) dirtyy0 = y;
+  if (y > dirtyy1) dirtyy1 = y;
+}
+
+
 /***********************/
 static int highbit(long unsigned int ul)
 {
@@ -3397,6 +3536,7 @@ static void blurPixel(int x, int y)
     pp = pic + (y * pWIDE + x) * 3;
     pp[0] = ar;  pp[1] = ag;  pp[2] = ab;
   }
+  addDirty(x,y);
 
   /* visual feedback */
   CoordP2E(x,   y,   &ex,  &ey);
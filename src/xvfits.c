@@ -31,20 +31,18 @@ typedef struct {
   long int  ndata;       /* number of elements in data */
   long int  cpos;        /* current position in data file */
   char     *comment;     /* malloc'ed comment string, or NULL if none */
+  char      block[BLOCKSIZE];   /* header block workspace */
+  char      error[45];          /* rdcard()'s 'keyword not found' message */
 } FITS;
 
 
-/* block workspace of BLOCKSIZE bytes */
-static char *fits_block=NULL;
-
-
 static       int   splitfits PARM((byte *, char *, int, int, int, char *));
 static const char *ftopen3d  PARM((FITS *, char *, int *, int *, int *, int *));
 static       void  ftclose   PARM((FITS *));
 static       int   ftgbyte   PARM((FITS *, byte *, int));
 static const char *rdheader  PARM((FITS *));
 static const char *wrheader  PARM((FILE *, int, int, char *));
-static const char *rdcard    PARM((char *, const char *, DATTYPE, long int *));
+static const char *rdcard    PARM((FITS *, char *, const char *, DATTYPE, long int *));
 static       void  wrcard    PARM((char *, const char *, DATTYPE, int, char *));
 static       int   ftgdata   PARM((FITS *, void *, int));
 static       void  ftfixdata PARM((FITS *, void *, int));
@@ -64,11 +62,6 @@ int LoadFITS(char *fname, PICINFO *pinfo, int quick)
   const char *error;
   char  basename[64];
 
-  if (fits_block == NULL) {
-    fits_block = (char *) malloc((size_t) BLOCKSIZE);
-    if (!fits_block) FatalError("Insufficient memory for FITS block buffer");
-  }
-
   error = ftopen3d(&fs, fname, &nx, &ny, &nz, &bitpix);
   if (error) {
     SetISTR(ISTR_WARNING, "%s", error);
@@ -166,11 +159,6 @@ int WriteFITS(FILE *fp, byte *pic, int ptype, int w, int h, byte *rmap, byte *gm
 
   XV_UNUSED(colorstyle);
 
-  if (!fits_block) {
-    fits_block = (char *) malloc((size_t) BLOCKSIZE);
-    if (!fits_block) FatalError("Insufficient memory for FITS block buffer");
-  }
-
   error = wrheader(fp, w, h, comment);
   if (error) {
     SetISTR(ISTR_WARNING, "%s", error);
@@ -294,7 +282,7 @@ static const char *wrheader(FILE *fp, int nx, int ny, char *comment)
 {
   /* Writes a minimalist FITS file header */
 
-  char *block = fits_block, *bp;
+  char  block[BLOCKSIZE], *bp;
   int   i, j, lenhist;
   char  history[80];
 
@@ -412,7 +400,7 @@ static const char *rdheader(FITS *fs)
 
   int i, j, res, commlen, commsize;
   char name[32];
-  char *block=fits_block, *p;
+  char *block=fs->block, *p;
   const char *error;
   long int val;         /* the value */
 
@@ -425,13 +413,13 @@ static const char *rdheader(FITS *fs)
   i = 0;
 
   /* read SIMPLE key */
-  error = rdcard(block, "SIMPLE", T_LOG, &val);
+  error = rdcard(fs, block, "SIMPLE", T_LOG, &val);
   if (error) return error;
   if (val == 0) return "Not a SIMPLE FITS file";
   i++;
 
   /* read BITPIX key */
-  error = rdcard(&block[80], "BITPIX", T_INT, &val);
+  error = rdcard(fs, &block[80], "BITPIX", T_INT, &val);
   if (error) return error;
 
   if (val != 8 && val != 16 && val != 32 && val != 64 && val != -32 &&
@@ -444,7 +432,7 @@ static const char *rdheader(FITS *fs)
   i++;
 
   /* read NAXIS key */
-  error = rdcard(&block[2*80], "NAXIS", T_INT, &val);
+  error = rdcard(fs, &block[2*80], "NAXIS", T_INT, &val);
   if (error) return error;
   if (val < 0 || val > 999) return "Bad NAXIS value in FITS file";
   if (val == 0)             return "FITS file does not contain an image";
@@ -463,7 +451,7 @@ static const char *rdheader(FITS *fs)
     }
 
     sprintf(name, "NAXIS%d", j+1);
-    error = rdcard(&block[i*80], name, T_INT, &val);
+    error = rdcard(fs, &block[i*80], name, T_INT, &val);
     if (error)    return error;
     if (val < 0)  return "Bad NAXISn value in FITS file";
     if (val == 0) return "FITS file does not contain an image";
@@ -572,7 +560,7 @@ static void wrcard(char *card, const char *name, DATTYPE dtype /* type of value
 
 
 /************************************/
-static const char *rdcard(char *card, const char *name, DATTYPE dtype /* type of value */, long int *kvalue)
+static const char *rdcard(FITS *fs, char *card, const char *name, DATTYPE dtype /* type of value */, long int *kvalue)
 {
   /* Read a header record, from the 80 byte buffer card.
    * the keyword name must match 'name'; and parse its value according to
@@ -588,7 +576,6 @@ static const char *rdcard(char *card, const char *name, DATTYPE dtype /* type of
 
   int         i, ptr;
   char        namestr[9];
-  static char error[45];
 
   bcopy(card, namestr, (size_t) 8);
 
@@ -596,8 +583,8 @@ static const char *rdcard(char *card, const char *name, DATTYPE dtype /* type of
   namestr[i+1] = '\0';
 
   if (strcmp(namestr, name) != 0) {
-    sprintf(error, "Keyword %s not found in FITS file", name);
-    return error;
+    sprintf(fs->error, "Keyword %s not found in FITS file", name);
+    return fs->error;
   }
 
 
@@ -729,22 +716,13 @@ static void ftfixdata(FITS *fs, void *buffer, int nelem)
   /* convert from IEE 754 single precision to native form */
   else if (fs->bitpix == -32) {
     int j, k, expo;
-    static float *exps=NULL;
-
-    if (exps == NULL) {
-      exps = (float *)malloc(256 * sizeof(float));
-      if (exps == NULL) FatalError("Insufficient memory for exps store");
-      exps[150] = 1.;
-      for (i=151; i < 256; i++) exps[i] = 2.*exps[i-1];
-      for (i=149; i >= 0; i--) exps[i] = 0.5*exps[i+1];
-    }
 
     for (i=0; i < n; i++, ptr+=4) {
       k = (int)*ptr;
       j = ((int)ptr[1] << 16) | ((int)ptr[2] << 8) | (int)ptr[3];
       expo = ((k & 127) << 1) | (j >> 23);
       if ((expo | j) == 0) *(float *)ptr = 0.;
-      else *(float *)ptr = exps[expo]*(float)(j | 0x800000);
+      else *(float *)ptr = (float) ldexp((double) (j | 0x800000), expo-150);
       if (k & 128) *(float *)ptr = - *(float *)ptr;
     }
 
@@ -754,15 +732,6 @@ static void ftfixdata(FITS *fs, void *buffer, int nelem)
   else if (fs->bitpix == -64) {
     int expo, k, l;
     unsigned int j;
-    static double *exps=NULL;
-
-    if (exps == NULL) {
-      exps = (double *)malloc(2048 * sizeof(double));
-      if (exps == NULL) FatalError("Insufficient memory for exps store");
-      exps[1075] = 1.;
-      for (i=1076; i < 2048; i++) exps[i] = 2.*exps[i-1];
-      for (i=1074; i >= 0; i--) exps[i] = 0.5*exps[i+1];
-    }
 
     for (i=0; i < n; i++, ptr+=8) {
       k = (int)*ptr;
@@ -771,8 +740,8 @@ static void ftfixdata(FITS *fs, void *buffer, int nelem)
       l = ((int)ptr[5] << 16) | ((int)ptr[6] << 8) | (int)ptr[7];
       expo = ((k & 127) << 4) | (j >> 28);
       if ((expo | j | l) == 0) *(double *)ptr = 0.;
-      else *(double *)ptr = exps[expo] * (16777216. *
-		         (double)((j&0x0FFFFFFF)|0x10000000) + (double)l);
+      else *(double *)ptr = ldexp(16777216. *
+		         (double)((j&0x0FFFFFFF)|0x10000000) + (double)l, expo-1075);
       if (k & 128) *(double *)ptr = - *(double *)ptr;
     }
   }
@@ -36,14 +36,6 @@
 #define MAXCOLS 1728
 #define MAXROWS 4300	/* up to two pages long */
 
-static int endoffile;
-static int eols;
-static int rawzeros;
-static int shdata;
-static int shbit;
-static int kludge;
-static int reversebits;
-
 #define WHASHA 3510
 #define WHASHB 1178
 
@@ -51,14 +43,26 @@ static int reversebits;
 #define BHASHB 2695
 
 #define HASHSIZE 1021
-static tableentry* whash[HASHSIZE];
-static tableentry* bhash[HASHSIZE];
+
+/* the decoder's state, kept per call so that several files can be read
+   at once */
+typedef struct {
+    int endoffile;
+    int eols;
+    int rawzeros;
+    int shdata;
+    int shbit;
+    int kludge;
+    int reversebits;
+    tableentry* whash[HASHSIZE];
+    tableentry* bhash[HASHSIZE];
+} G3DEC;
 
 static int addtohash ARGS(( tableentry* hash[], tableentry* te, int n, int a, int b ));
 static tableentry* hashfind ARGS(( tableentry* hash[], int length, int code, int a, int b ));
-static int getfaxrow ARGS(( FILE* inf, int row, byte* bitrow ));
-static void skiptoeol ARGS(( FILE* file ));
-static int rawgetbit ARGS(( FILE* file ));
+static int getfaxrow ARGS(( G3DEC* gd, FILE* inf, int row, byte* bitrow ));
+static void skiptoeol ARGS(( G3DEC* gd, FILE* file ));
+static int rawgetbit ARGS(( G3DEC* gd, FILE* file ));
 
 extern int lowresfax;
 extern int highresfax;
@@ -70,14 +74,15 @@ LoadG3 (char *fname, PICINFO *pinfo)
     int rows, last_allocated_row, cols, row, col, i;
     byte* bytes[MAXROWS];
     byte* bp;
+    G3DEC g3dec, *gd = &g3dec;
 
-    endoffile = 0;
-    eols = 0;
-    rawzeros = 0;
-    shdata = 0;
-    shbit = 0;
-    kludge = 0;
-    reversebits = 0;
+    gd->endoffile = 0;
+    gd->eols = 0;
+    gd->rawzeros = 0;
+    gd->shdata = 0;
+    gd->shbit = 0;
+    gd->kludge = 0;
+    gd->reversebits = 0;
 
     pinfo->pic = (byte *) NULL;
     pinfo->comment = (char *) NULL;
@@ -89,31 +94,31 @@ LoadG3 (char *fname, PICINFO *pinfo)
 	return 0;
 	}
 
-    eols = 0;
+    gd->eols = 0;
 
     SetISTR(ISTR_INFO,"Loading Fax(G3) hash tables ...");
 
-    if ( kludge )
+    if ( gd->kludge )
 	{
 	/* Skip extra lines to get in sync. */
-	skiptoeol( fp );
-	skiptoeol( fp );
-	skiptoeol( fp );
+	skiptoeol( gd, fp );
+	skiptoeol( gd, fp );
+	skiptoeol( gd, fp );
 	}
-    skiptoeol( fp );
+    skiptoeol( gd, fp );
     for ( i = 0; i < HASHSIZE; ++i )
-	whash[i] = bhash[i] = (tableentry*) 0;
-    if (addtohash( whash, twtable, TABSIZE(twtable), WHASHA, WHASHB ))
+	gd->whash[i] = gd->bhash[i] = (tableentry*) 0;
+    if (addtohash( gd->whash, twtable, TABSIZE(twtable), WHASHA, WHASHB ))
 	return 0;
-    if (addtohash( whash, mwtable, TABSIZE(mwtable), WHASHA, WHASHB ))
+    if (addtohash( gd->whash, mwtable, TABSIZE(mwtable), WHASHA, WHASHB ))
 	return 0;
-    if (addtohash( whash, extable, TABSIZE(extable), WHASHA, WHASHB ))
+    if (addtohash( gd->whash, extable, TABSIZE(extable), WHASHA, WHASHB ))
 	return 0;
-    if (addtohash( bhash, tbtable, TABSIZE(tbtable), BHASHA, BHASHB ))
+    if (addtohash( gd->bhash, tbtable, TABSIZE(tbtable), BHASHA, BHASHB ))
 	return 0;
-    if (addtohash( bhash, mbtable, TABSIZE(mbtable), BHASHA, BHASHB ))
+    if (addtohash( gd->bhash, mbtable, TABSIZE(mbtable), BHASHA, BHASHB ))
 	return 0;
-    if (addtohash( bhash, extable, TABSIZE(extable), BHASHA, BHASHB ))
+    if (addtohash( gd->bhash, extable, TABSIZE(extable), BHASHA, BHASHB ))
 	return 0;
  
     SetISTR(ISTR_INFO,"Reading Fax(G3) image...");
@@ -125,8 +130,8 @@ LoadG3 (char *fname, PICINFO *pinfo)
 	if ((bytes[rows] = (byte*) 
                malloc(MAXCOLS * sizeof(byte))) == (byte*) NULL)
 	    return 0;
-	col = getfaxrow( fp, rows, bytes[rows] );
-	if ( endoffile )
+	col = getfaxrow( gd, fp, rows, bytes[rows] );
+	if ( gd->endoffile )
 	    break;
 	if ( col > cols )
 	    cols = col;
@@ -207,7 +212,7 @@ hashfind(tableentry **hash, int length, int code, int a, int b)
 }
 
 static int
-getfaxrow(FILE *inf, int row, byte *bitrow)
+getfaxrow(G3DEC *gd, FILE *inf, int row, byte *bitrow)
 {
 	int col;
 	byte* bP;
@@ -218,25 +223,25 @@ getfaxrow(FILE *inf, int row, byte *bitrow)
 	for ( col = 0, bP = bitrow; col < MAXCOLS; ++col, ++bP )
 	    *bP = WHITE;
 	col = 0;
-	rawzeros = 0;
+	gd->rawzeros = 0;
 	curlen = 0;
 	curcode = 0;
 	color = 1;
 	count = 0;
-	while (!endoffile) {
+	while (!gd->endoffile) {
 		if (col >= MAXCOLS) {
-			skiptoeol(inf);
+			skiptoeol(gd, inf);
 			return (col); 
 		}
 		do {
-			if (rawzeros >= 11) {
-				nextbit = rawgetbit(inf);
+			if (gd->rawzeros >= 11) {
+				nextbit = rawgetbit(gd, inf);
 				if (nextbit) {
 					if (col == 0)
 						/* XXX should be 6 */
-						endoffile = (++eols == 3);
+						gd->endoffile = (++gd->eols == 3);
 					else
-						eols = 0;
+						gd->eols = 0;
 #ifdef notdef
 					if (col && col < 1728)
 						SetISTR(ISTR_WARNING,
@@ -246,7 +251,7 @@ getfaxrow(FILE *inf, int row, byte *bitrow)
 					return (col); 
 				}
 			} else
-				nextbit = rawgetbit(inf);
+				nextbit = rawgetbit(gd, inf);
 			curcode = (curcode<<1) + nextbit;
 			curlen++;
 		} while (curcode <= 0);
@@ -254,17 +259,17 @@ getfaxrow(FILE *inf, int row, byte *bitrow)
 			SetISTR(ISTR_WARNING,
 	  "bad code word at row %d, col %d (len %d code 0x%x), skipping to EOL",
 			    row, col, curlen, curcode, 0 );
-			skiptoeol(inf);
+			skiptoeol(gd, inf);
 			return (col);
 		}
 		if (color) {
 			if (curlen < 4)
 				continue;
-			te = hashfind(whash, curlen, curcode, WHASHA, WHASHB);
+			te = hashfind(gd->whash, curlen, curcode, WHASHA, WHASHB);
 		} else {
 			if (curlen < 2)
 				continue;
-			te = hashfind(bhash, curlen, curcode, BHASHA, BHASHB);
+			te = hashfind(gd->bhash, curlen, curcode, BHASHA, BHASHB);
 		}
 		if (!te)
 			continue;
@@ -307,47 +312,47 @@ getfaxrow(FILE *inf, int row, byte *bitrow)
 }
 
 static void
-skiptoeol(FILE *file)
+skiptoeol(G3DEC *gd, FILE *file)
 {
-    while ( rawzeros < 11 )
-	(void) rawgetbit( file );
+    while ( gd->rawzeros < 11 )
+	(void) rawgetbit( gd, file );
     for ( ; ; )
 	{
-	if ( rawgetbit( file ) )
+	if ( rawgetbit( gd, file ) )
 	    break;
 	}
     }
 
 static int
-rawgetbit(FILE *file)
+rawgetbit(G3DEC *gd, FILE *file)
 {
     int b;
 
-    if ( ( shbit & 0xff ) == 0 )
+    if ( ( gd->shbit & 0xff ) == 0 )
 	{
-	shdata = getc( file );
-	if ( shdata == EOF ) {
+	gd->shdata = getc( file );
+	if ( gd->shdata == EOF ) {
 	    char errmsg[64];
-	    sprintf(errmsg, "LoadG3: EOF / read error at line %d", eols);
+	    sprintf(errmsg, "LoadG3: EOF / read error at line %d", gd->eols);
             FatalError(errmsg);
 	    return 0;
 	    }
-	shbit = reversebits ? 0x01 : 0x80;
+	gd->shbit = gd->reversebits ? 0x01 : 0x80;
 	}
-    if ( shdata & shbit )
+    if ( gd->shdata & gd->shbit )
 	{
-	rawzeros = 0;
+	gd->rawzeros = 0;
 	b = 1;
 	}
     else
 	{
-	rawzeros++;
+	gd->rawzeros++;
 	b = 0;
 	}
-    if ( reversebits )
-	shbit <<= 1;
+    if ( gd->reversebits )
+	gd->shbit <<= 1;
     else
-	shbit >>= 1;
+	gd->shbit >>= 1;
     return b;
     }
 #endif /* HAVE_G3 */
@@ -85,6 +85,7 @@ struct gamstate { struct hmap hmap[N_HMAP];
 		  int wht_stval, wht_satval, wht_enab;
 		  int satval;
 		  GRAF_STATE istate, rstate, gstate, bstate;
+		  double deeplo, deephi;   /* a 16-bit master's Norm window */
 		};
 
 static struct gamstate undo[MAXUNDO], preset[4], defstate;
@@ -92,6 +93,43 @@ static struct gamstate *defLoadState;
 
 static int uptr, uhead, utail;
 
+static int newpic_kludge = 0;   /* NewCMap():  'pic' is about to be redone */
+
+
+/* everything the GammifyPic24() per-pixel transform depends on.  workers
+   use this copy rather than the controls, and the 3D LUT is only rebuilt
+   when it changes */
+typedef struct { int  hremap[360];
+		 byte ifunc[256], rfunc[256], gfunc[256], bfunc[256];
+		 int  whtst, whtsat;     /* hue,sat given to NOHUE pixels */
+		 int  whtmod;            /* 1 if they're given one */
+		 int  satadj;            /* added to every saturation */
+		 int  hsvmod;            /* 0 if only the R,G,B grafs matter */
+	       } GAMXFORM;
+
+typedef struct { GAMXFORM *gx;
+		 byte     *src, *dst;    /* image in, image out */
+		 long      npix;
+		 byte     *lut;          /* 3D LUT to use, or NULL */
+		 int       nunits, next; /* ParallelNext() counter */
+		 int       failed;
+	       } GAMPAR;
+
+#define GAMUNIT  (32 * 1024)         /* pixels per unit of parallel work */
+#define LUTPIX   (1L << 24)          /* every possible 24-bit color */
+#define LUTMIN   (LUTPIX / 2)        /* smallest image worth building for */
+
+typedef struct { byte     *src;          /* pixels to histogram */
+		 long      npix;
+		 int       is24;
+		 int      *rgb;          /* PIC8: colormap entry -> intensity */
+		 int      *hists;        /* 256 bins for each worker */
+		 int       nunits, next; /* ParallelNext() counter */
+	       } HISTPAR;
+
+static byte    *gamLUT = (byte *) NULL;   /* LUTPIX rgb triples */
+static GAMXFORM gamLUTx;                  /* settings gamLUT was built for */
+
 typedef struct huedial {
 		 Window win;      /* window that dial exists in */
 		 int    x,y;      /* coordinates of center of dial */
@@ -121,6 +159,7 @@ static int    hremap[360];
 
 static int    defAutoApply;
 static int    hsvnonlinear = 0;
+static int    previewing   = 0;   /* a drag preview is on the screen */
 
 static void printUTime       PARM((const char *));
 
@@ -137,6 +176,9 @@ static int  deladdCell       PARM((int, int));
 static void doCmd            PARM((int));
 static void SetHSVmode       PARM((void));
 static void applyGamma       PARM((int));
+static int  canDrag          PARM((void));
+static void previewGamma     PARM((void));
+static void endPreview       PARM((void));
 static void calcHistEQ       PARM((int *, int *, int *));
 static void saveGamState     PARM((void));
 static void gamUndo          PARM((void));
@@ -144,6 +186,7 @@ static void gamRedo          PARM((void));
 static void ctrls2gamstate   PARM((struct gamstate *));
 static void gamstate2ctrls   PARM((struct gamstate *));
 static void rndCols          PARM((void));
+static void deepRedraw       PARM((void));
 static void saveCMap         PARM((struct cmapstate *));
 static void restoreCMap      PARM((struct cmapstate *));
 static void parseResources   PARM((void));
@@ -168,6 +211,11 @@ static void dials2hmap       PARM((void));
 static void hmap2dials       PARM((void));
 static void build_hremap     PARM((void));
 
+static void gamXform         PARM((byte *, byte *, long, GAMXFORM *));
+static void gamWorker        PARM((void *, int));
+static void lutWorker        PARM((void *, int));
+static void histWorker       PARM((void *, int));
+
 
 
 #define CMAPF_WIDE (212 * dpiMult)
@@ -431,7 +479,7 @@ void CreateGam(const char *geom, double gam, double rgam, double ggam, double bg
 
 
   parseResources();
-  CBSetActive(&dragCB, (allocMode == AM_READWRITE));
+  CBSetActive(&dragCB, canDrag());
 
   /* deal with passed in [r,g,b]gam values.  If <0.0, ignore them */
   if (gam>=0.0) {
@@ -674,6 +722,8 @@ int GamCheckEvent(XEvent *xev)
       else rv = 0;
     }
     else rv = 0;
+
+    endPreview();    /* a drag may have ended without changing anything */
   }
 
 
@@ -737,6 +787,7 @@ static void changedGam(void)
   computeHSVlinear();
   saveGamState();
   if (autoCB.val) applyGamma(0);
+  endPreview();
 }
 
 
@@ -839,7 +890,9 @@ void NewCMap(void)
   if (resetCB.val) {            /* auto-reset gamma controls */
     i = autoCB.val;
     if (i) autoCB.val = 0;      /* must NOT apply changes! */
+    newpic_kludge = 1;
     gamstate2ctrls(defLoadState);
+    newpic_kludge = 0;
     autoCB.val = i;
   }
 
@@ -861,7 +914,7 @@ void RedrawCMap(void)
 {
   int i;
 
-  CBSetActive(&dragCB, (allocMode == AM_READWRITE));
+  CBSetActive(&dragCB, canDrag());
 
   XSetLineAttributes(theDisp, theGC, 0, LineSolid, CapButt, JoinMiter);
   XSetForeground(theDisp, theGC, infofg);
@@ -1424,6 +1477,7 @@ static void doCmd(int cmd)
 
 	       if (gbut[G_BSET].lit) {
 		 ctrls2gamstate(ptr);
+		 ptr->deeplo = 0.0;  ptr->deephi = 1.0;   /* not this image's */
 		 gbut[G_BSET].lit = 0;
 		 BTRedraw(&gbut[G_BSET]);
 	       }
@@ -1590,7 +1644,7 @@ static void applyGamma(int cmapchange)
   int i,j;
   byte oldr[256], oldg[256], oldb[256];
 
-  if (!pic || !epic) return;   /* called before image exists.  ignore */
+  if (!pic || (!epic && !theImage)) return;   /* called before image exists */
 
   if (picType == PIC8) {
     /* save current 'desired' colormap */
@@ -1657,61 +1711,173 @@ static void applyGamma(int cmapchange)
     }
   }
 
+  previewing = 0;
   DrawEpic();
   SetCursors(-1);
 }
 
 
+#define PREVPIX (128 * 1024)   /* max pixels in a drag preview */
+
 /*********************/
-static void calcHistEQ(int *histeq, int *rminv, int *rmaxv)
+static int canDrag(void)
+{
+  /* returns '1' if the 'auto-apply while dragging' checkbox makes sense:
+     either colors can be changed in place (R/W color cells), or the visual
+     is TrueColor/DirectColor, where previewGamma() can draw a quick proxy */
+
+  if (allocMode == AM_READWRITE) return 1;
+  return (theVisual->class == TrueColor || theVisual->class == DirectColor);
+}
+
+
+/*********************/
+static void previewGamma(void)
 {
-  int i, maxv, topbin, hist[256], rgb[256];
-  byte *ep;
-  unsigned long total;
+  /* called while dragging.  draws roughly what applyGamma() would, but
+     from a copy of the displayed image that's been subsampled down to no
+     more than PREVPIX pixels, and blown back up to window size.  Nothing
+     (pic, epic, the colormap, theImage) is changed.  The real thing is done
+     by changedGam() when the drag is finished */
+
+  int     i, step, pw, ph, x, y, bperpix;
+  byte    rm[256], gm[256], bm[256];
+  byte   *prox, *gprox, *full, *pp, *sp, *dp;
+  XImage *xim;
+
+  if (!pic || !epic || !theImage || useroot) return;
+
+  for (step=1; (long) ((eWIDE+step-1)/step) * ((eHIGH+step-1)/step) > PREVPIX;
+       step++);
+  pw = (eWIDE + step - 1) / step;
+  ph = (eHIGH + step - 1) / step;
 
   if (picType == PIC8) {
-    for (i=0; i<256; i++) {
-      hist[i] = 0;
-      rgb[i] = MONO(rcmap[i],gcmap[i],bcmap[i]);
-    }
+    /* what GammifyColors() would make of the colormap, without keeping it.
+       the 8-bit image is sampled from cpic, as epic may be dithered */
+    byte          orm[256], ogm[256], obm[256];
+    unsigned long ocols[256];
 
-    /* compute intensity histogram */
-    if (epic) for (i=eWIDE*eHIGH,ep=epic; i>0; i--, ep++) hist[rgb[*ep]]++;
-         else for (i=pWIDE*pHIGH,ep=pic;  i>0; i--, ep++) hist[rgb[*ep]]++;
+    bcopy((char *) rMap, (char *) orm, sizeof(orm));
+    bcopy((char *) gMap, (char *) ogm, sizeof(ogm));
+    bcopy((char *) bMap, (char *) obm, sizeof(obm));
+    bcopy((char *) cols, (char *) ocols, sizeof(ocols));
 
-    /* compute minv/maxv values */
-    for (i=0; i<256 && !hist[i]; i++);
-    *rminv = i;
+    GammifyColors();
+    bcopy((char *) rMap, (char *) rm, sizeof(rm));
+    bcopy((char *) gMap, (char *) gm, sizeof(gm));
+    bcopy((char *) bMap, (char *) bm, sizeof(bm));
 
-    for (i=255; i>0 && !hist[i]; i--);
-    *rmaxv = i;
+    bcopy((char *) orm, (char *) rMap, sizeof(orm));
+    bcopy((char *) ogm, (char *) gMap, sizeof(ogm));
+    bcopy((char *) obm, (char *) bMap, sizeof(obm));
+    bcopy((char *) ocols, (char *) cols, sizeof(ocols));
   }
 
-  else {  /* PIC24 */
-    int v,minv,maxv;
+  prox = (byte *) malloc((size_t) pw * ph * 3);
+  if (!prox) return;
 
-    for (i=0; i<256; i++) hist[i] = 0;
-
-    minv = 255;  maxv = 0;
-    if (epic) {
-      for (i=0,ep=epic; i<eWIDE*eHIGH; i++,ep+=3) {
-	v = MONO(ep[0],ep[1],ep[2]);
-	if (v<minv) minv = v;
-	if (v>maxv) maxv = v;
-	hist[v]++;
+  for (y=0, pp=prox; y<ph; y++) {
+    if (picType == PIC8) {
+      sp = cpic + (size_t) ((cHIGH * (long) (y*step)) / eHIGH) * cWIDE;
+      for (x=0; x<pw; x++) {
+	i = sp[(cWIDE * (long) (x*step)) / eWIDE];
+	*pp++ = rm[i];  *pp++ = gm[i];  *pp++ = bm[i];
       }
     }
     else {
-      for (i=0,ep=pic; i<pWIDE*pHIGH; i++,ep+=3) {
-	v = MONO(ep[0],ep[1],ep[2]);
-	if (v<minv) minv = v;
-	if (v>maxv) maxv = v;
-	hist[v]++;
+      sp = epic + (size_t) y * step * eWIDE * 3;
+      for (x=0; x<pw; x++, sp += step*3) {
+	*pp++ = sp[0];  *pp++ = sp[1];  *pp++ = sp[2];
       }
     }
+  }
+
+  gprox = (picType == PIC24) ? GammifyPic24(prox, pw, ph) : (byte *) NULL;
+  if (gprox) { free(prox);  prox = gprox; }
+
+
+  /* blow it back up to eWIDE*eHIGH, and draw it */
+  full = (byte *) malloc((size_t) eWIDE * eHIGH * 3);
+  if (!full) { free(prox);  return; }
+
+  bperpix = 3;
+  for (y=0, dp=full; y<eHIGH; y++) {
+    sp = prox + (size_t) (y/step) * pw * bperpix;
+    for (x=0; x<eWIDE; x++) {
+      pp = sp + (x/step) * bperpix;
+      *dp++ = pp[0];  *dp++ = pp[1];  *dp++ = pp[2];
+    }
+  }
+  free(prox);
+
+  xim = Pic24ToXImage(full, (u_int) eWIDE, (u_int) eHIGH);
+  free(full);
+  if (!xim) return;
+
+  XPutImage(theDisp, mainW, theGC, xim, 0,0, 0,0, (u_int) eWIDE, (u_int) eHIGH);
+  if (HaveSelection()) DrawSelection(0);
+  XFlush(theDisp);
+  xvDestroyImage(xim);
+
+  previewing = 1;
+}
+
+
+/*********************/
+static void endPreview(void)
+{
+  /* if a drag preview was left on the screen (ie, it wasn't replaced by
+     the real thing), puts the real image back */
 
-    *rminv = minv;  *rmaxv = maxv;
+  if (!previewing) return;
+  previewing = 0;
+
+  if (theImage && !useroot) {
+    DrawWindow(0, 0, eWIDE, eHIGH);
+    if (HaveSelection()) DrawSelection(0);
   }
+}
+
+
+/*********************/
+static void calcHistEQ(int *histeq, int *rminv, int *rmaxv)
+{
+  int i, w, nw, maxv, topbin, hist[256], rgb[256];
+  unsigned long total, count;
+  HISTPAR hp;
+
+  /* histogram the displayed image (or 'pic', if there isn't a whole epic).
+     every worker fills in its own set of bins, which are added up after */
+
+  hp.is24 = (picType == PIC24);
+  if (epic) { hp.src = epic;  hp.npix = (long) eWIDE * eHIGH; }
+       else { hp.src = pic;   hp.npix = (long) pWIDE * pHIGH; }
+
+  if (!hp.is24) {
+    for (i=0; i<256; i++) rgb[i] = MONO(rcmap[i],gcmap[i],bcmap[i]);
+  }
+  hp.rgb = rgb;
+
+  hp.nunits = (int) ((hp.npix + GAMUNIT - 1) / GAMUNIT);  hp.next = 0;
+  nw = ParallelWorkers(hp.nunits);
+  hp.hists = (int *) calloc((size_t) nw * 256, sizeof(int));
+  if (!hp.hists) FatalError("out of memory in calcHistEQ()");
+
+  ParallelRun(nw, histWorker, (void *) &hp);
+
+  for (i=0; i<256; i++) {
+    hist[i] = 0;
+    for (w=0; w<nw; w++) hist[i] += hp.hists[w*256 + i];
+  }
+  free(hp.hists);
+
+  /* compute minv/maxv values */
+  for (i=0; i<256 && !hist[i]; i++);
+  *rminv = (i<256) ? i : 255;
+
+  for (i=255; i>0 && !hist[i]; i--);
+  *rmaxv = i;
 
   if (DEBUG) {
     fprintf(stderr,"intensity histogram:  ");
@@ -1720,9 +1886,12 @@ static void calcHistEQ(int *histeq, int *rminv, int *rmaxv)
   }
 
   /* compute histeq curve */
+  for (i=0, count=0; i<256; i++) count += hist[i];
+  if (!count) count = 1;
+
   total = topbin = 0;
   for (i=0; i<256; i++) {
-    histeq[i] = (total * 255) / ((unsigned long) eWIDE * eHIGH);
+    histeq[i] = (total * 255) / count;
     if (hist[i]) topbin = i;
     total += hist[i];
   }
@@ -1743,6 +1912,35 @@ static void calcHistEQ(int *histeq, int *rminv, int *rmaxv)
 }
 
 
+/*********************/
+static void histWorker(void *data, int worker)
+{
+  /* ParallelRun() worker:  adds GAMUNIT-pixel pieces of the image to this
+     worker's own intensity histogram */
+
+  HISTPAR *hp = (HISTPAR *) data;
+  int     *hist;
+  byte    *sp;
+  long     i, n;
+  int      unit;
+
+  hist = hp->hists + worker * 256;
+
+  while ((unit = ParallelNext(&hp->next, hp->nunits)) >= 0) {
+    i = (long) unit * GAMUNIT;
+    n = hp->npix - i;
+    if (n > GAMUNIT) n = GAMUNIT;
+
+    if (hp->is24) {
+      for (sp = hp->src + i*3; n; n--, sp+=3) hist[MONO(sp[0],sp[1],sp[2])]++;
+    }
+    else {
+      for (sp = hp->src + i;   n; n--, sp++)  hist[hp->rgb[*sp]]++;
+    }
+  }
+}
+
+
 /*********************/
 void DoHistEq(void)
 {
@@ -1775,7 +1973,14 @@ void DoNorm(void)
 
   minv = 255;  maxv = 0;
 
-  if (picType == PIC8) {
+  if (DeepNorm()) {
+    /* stretched the full-precision samples instead, and leave the curve
+       straight.  (the stretch is part of the gamstate, so Undo and Reset
+       take it back) */
+    deepRedraw();
+    minv = 0;  maxv = 255;
+  }
+  else if (picType == PIC8) {
     for (i=0; i<numcols; i++) {
       v = MONO(rcmap[i],gcmap[i],bcmap[i]);
       if (v<minv) minv = v;
@@ -1991,6 +2196,8 @@ static void ctrls2gamstate(struct gamstate *gs)
   GetGrafState(&rGraf,  &gs->rstate);
   GetGrafState(&gGraf,  &gs->gstate);
   GetGrafState(&bGraf,  &gs->bstate);
+
+  DeepGetWindow(&gs->deeplo, &gs->deephi);
 }
 
 
@@ -2052,6 +2259,12 @@ static void gamstate2ctrls(struct gamstate *gs)
   if (SetGrafState(&gGraf,   &gs->gstate)) changed++;
   if (SetGrafState(&bGraf,   &gs->bstate)) changed++;
 
+  /* a 16-bit image's Norm window is developed right into 'pic' */
+  if (DeepSetWindow(gs->deeplo, gs->deephi)) {
+    if (!newpic_kludge) deepRedraw();
+    changed++;
+  }
+
   if (changed) changedGam();
 }
 
@@ -2117,6 +2330,22 @@ static void gamRedo(void)
 
 
 
+/*********************/
+static void deepRedraw(void)
+{
+  /* 'pic' has been redeveloped from its 16-bit master.  Rebuilds cpic and
+     epic from it, and redraws.  (it's 24-bit, so the colors don't change) */
+
+  if (!pic || !theImage) return;     /* not displayed yet */
+
+  GenerateCpic();
+  WaitCursor();
+  GenerateEpic(eWIDE, eHIGH);
+  DrawEpic();
+}
+
+
+
 /*********************/
 static void rndCols(void)
 {
@@ -2366,7 +2595,8 @@ static void dragGamma (void)
 
   if (dragCB.val && dragCB.active) {
     hsvnonlinear = 1;   /* force HSV calculations during drag */
-    applyGamma(0);
+    if (allocMode == AM_READWRITE) applyGamma(0);
+                              else previewGamma();
   }
 }
 
@@ -2383,7 +2613,8 @@ static void dragHueDial(void)
     dials2hmap();
     build_hremap();
     hsvnonlinear = 1;   /* force HSV calculations during drag */
-    applyGamma(0);
+    if (allocMode == AM_READWRITE) applyGamma(0);
+                              else previewGamma();
   }
 }
 
@@ -3138,51 +3369,63 @@ byte *GammifyPic24(byte *pic24, int wide, int high)
   /* applies HSV/RGB modifications to each pixel in given 24-bit image.
      creates and returns a new picture, or NULL on failure.
      Also, checks to see if the result will be the same as the input, and
-     if so, also returns NULL, as a time-saving maneuver */
+     if so, also returns NULL, as a time-saving maneuver.
 
-  byte *pp, *op;
-  int   i,j;
-  int   rv, gv, bv;
-  byte *outpic;
-  int   min, max, del, h, s, v;
-  int   f, p, q, t, vs100, vsf10000;
-  int   hsvmod, rgbmod;
+     Each output pixel only depends on the input pixel's r,g,b, so for big
+     images (and whenever the controls haven't changed since it was made)
+     the transform is looked up in a full 256x256x256 table, which gives
+     exactly the same results as computing it.  Either way, the work is
+     split among ParallelRun() workers */
+
+  byte    *outpic;
+  int      i, hsvother;
+  GAMXFORM gx;
+  GAMPAR   gp;
 
   outpic = (byte *) NULL;
   if (!enabCB.val) return outpic;              /* mods turned off */
 
   printUTime("start of GammifyPic24");
 
-  /* check for HSV/RGB control linearity */
+  /* take a snapshot of the controls, checking for linearity as we go */
 
-  hsvmod = rgbmod = 0;
+  bzero((char *) &gx, sizeof(GAMXFORM));
+  hsvother = 0;                      /* HSV mods besides the intensity graf */
 
   /* check HUE remapping */
-  for (i=0; i<360 && hremap[i] == i; i++);
-  if (i!=360) hsvmod++;
+  for (i=0; i<360; i++) {
+    gx.hremap[i] = hremap[i];
+    if (hremap[i] != i) gx.hsvmod = hsvother = 1;
+  }
 
-  if (whtHD.enabCB.val && whtHD.satval) hsvmod++;
+  if (whtHD.enabCB.val && whtHD.satval) gx.hsvmod = 1;
+  if (whtHD.enabCB.val && (whtHD.stval || whtHD.satval)) {
+    gx.whtmod = 1;  gx.whtst = whtHD.stval;  gx.whtsat = whtHD.satval;
+  }
 
-  if (satDial.val != 0.0) hsvmod++;
+  gx.satadj = (int) satDial.val;
+  if (satDial.val != 0.0) gx.hsvmod = 1;
+  if (gx.whtmod || gx.satadj) hsvother = 1;
 
   /* check intensity graf */
   for (i=0; i<256; i++) {
-    if (intGraf.func[i] != i) break;
+    gx.ifunc[i] = intGraf.func[i];
+    if (intGraf.func[i] != i) gx.hsvmod = 1;
   }
-  if (i<256) hsvmod++;
-
 
   /* check R,G,B grafs simultaneously */
   for (i=0; i<256; i++) {
-    if (rGraf.func[i] != i ||
-	gGraf.func[i] != i ||
-	bGraf.func[i] != i) break;
+    gx.rfunc[i] = rGraf.func[i];
+    gx.gfunc[i] = gGraf.func[i];
+    gx.bfunc[i] = bGraf.func[i];
   }
-  if (i<256) rgbmod++;
-
-
-  if (!hsvmod && !rgbmod) return outpic;  /* apparently, it's linear */
+  for (i=0; i<256 && gx.rfunc[i] == i && gx.gfunc[i] == i &&
+	            gx.bfunc[i] == i; i++);
 
+  if (!gx.hsvmod && i==256) {          /* apparently, it's linear */
+    if (gamLUT) { free(gamLUT);  gamLUT = (byte *) NULL; }
+    return outpic;
+  }
 
 
   WaitCursor();
@@ -3192,14 +3435,123 @@ byte *GammifyPic24(byte *pic24, int wide, int high)
   outpic = (byte *) malloc((size_t) wide * high * 3);
   if (!outpic) return outpic;
 
-  pp = pic24;  op = outpic;
-  for (i=wide * high; i; i--) {
+  /* if this is 'pic', and it was developed from a 16-bit master, the
+     curves can be applied to the master's samples instead */
+  if (pic24 == pic && !hsvother &&
+      DeepGammify(outpic, &intGraf, &rGraf, &gGraf, &bGraf)) {
+    printUTime("end of GammifyPic24");
+    return outpic;
+  }
+
+  gp.gx = &gx;  gp.npix = (long) wide * high;  gp.failed = 0;
+
+
+  /* the R,G,B grafs alone are just three 1-D lookups, but the HSV mods are
+     worth a 3D LUT, if it's going to get used enough */
+
+  gp.lut = (byte *) NULL;
+  if (gx.hsvmod) {
+    if (gamLUT && !bcmp((char *) &gx, (char *) &gamLUTx, sizeof(GAMXFORM)))
+      gp.lut = gamLUT;
 
-    if ((i&0x7fff)==0) WaitCursor();
+    else if (gp.npix >= LUTMIN) {
+      if (!gamLUT) gamLUT = (byte *) malloc((size_t) LUTPIX * 3);
+      if (gamLUT) {
+	if (DEBUG) fprintf(stderr,"GammifyPic24: building 3D LUT\n");
+	gp.dst = gamLUT;  gp.nunits = 256;  gp.next = 0;
+	ParallelRun(ParallelWorkers(gp.nunits), lutWorker, (void *) &gp);
+
+	if (gp.failed) { free(gamLUT);  gamLUT = (byte *) NULL; }
+	else {
+	  gamLUTx = gx;
+	  gp.lut  = gamLUT;
+	}
+	WaitCursor();
+      }
+    }
+  }
+
+  gp.src = pic24;  gp.dst = outpic;
+  gp.nunits = (int) ((gp.npix + GAMUNIT - 1) / GAMUNIT);  gp.next = 0;
+  ParallelRun(ParallelWorkers(gp.nunits), gamWorker, (void *) &gp);
+
+  printUTime("end of GammifyPic24");
 
+  return outpic;
+}
+
+
+/*********************/
+static void gamWorker(void *data, int worker)
+{
+  /* ParallelRun() worker:  does GAMUNIT-pixel pieces of the image */
+
+  GAMPAR *gp = (GAMPAR *) data;
+  byte   *sp, *dp, *lp;
+  long    i, n;
+  int     unit;
+
+  XV_UNUSED(worker);
+
+  while ((unit = ParallelNext(&gp->next, gp->nunits)) >= 0) {
+    i  = (long) unit * GAMUNIT;
+    n  = gp->npix - i;
+    if (n > GAMUNIT) n = GAMUNIT;
+    sp = gp->src + i * 3;
+    dp = gp->dst + i * 3;
+
+    if (gp->lut) {
+      for ( ; n; n--, sp+=3) {
+	lp = gp->lut + ((((size_t) sp[0] << 16) | (sp[1] << 8) | sp[2]) * 3);
+	*dp++ = lp[0];  *dp++ = lp[1];  *dp++ = lp[2];
+      }
+    }
+    else gamXform(sp, dp, n, gp->gx);
+  }
+}
+
+
+/*********************/
+static void lutWorker(void *data, int worker)
+{
+  /* ParallelRun() worker:  fills in the 3D LUT, one 'red' plane at a time,
+     by running every color in the plane through gamXform() */
+
+  GAMPAR *gp = (GAMPAR *) data;
+  byte   *plane, *pp;
+  int     r, g, b;
+
+  XV_UNUSED(worker);
+
+  plane = (byte *) malloc((size_t) 256 * 256 * 3);
+  if (!plane) { gp->failed = 1;  return; }
+
+  while ((r = ParallelNext(&gp->next, gp->nunits)) >= 0) {
+    for (g=0, pp=plane; g<256; g++)
+      for (b=0; b<256; b++) { *pp++ = r;  *pp++ = g;  *pp++ = b; }
+
+    gamXform(plane, gp->dst + (size_t) r * 256 * 256 * 3, 256L * 256, gp->gx);
+  }
+
+  free(plane);
+}
+
+
+/*********************/
+static void gamXform(byte *pp, byte *op, long npix, GAMXFORM *gx)
+{
+  /* the GammifyPic24() per-pixel transform.  runs 'npix' pixels from pp to
+     op.  may be called from a worker thread, so only looks at 'gx' */
+
+  int   j;
+  int   rv, gv, bv;
+  int   min, max, del, h, s, v;
+  int   f, p, q, t, vs100, vsf10000;
+
+  for ( ; npix; npix--) {
     rv = *pp++;  gv = *pp++;  bv = *pp++;
 
-    if (hsvmod) {
+    if (gx->hsvmod) {
       /* convert RGB to HSV */
       /* the HSV computed will be int's ranging -1..359, 0..100, 0..255 */
 
@@ -3235,19 +3587,19 @@ byte *GammifyPic24(byte *pic24, int wide, int high)
       if (v <= 16) s = 0;
 
       /* apply intGraf.func[] function to 'v' (the intensity) */
-      v = intGraf.func[v];
+      v = gx->ifunc[v];
 
       /* do Hue remapping */
-      if (h>=0) h = hremap[h];
+      if (h>=0) h = gx->hremap[h];
       else {  /* NOHUE */
-	if (whtHD.enabCB.val && (whtHD.stval || whtHD.satval)) {
-	  h = whtHD.stval;
-	  s = whtHD.satval;
+	if (gx->whtmod) {
+	  h = gx->whtst;
+	  s = gx->whtsat;
 	}
       }
 
       /* apply satDial value to s */
-      s = s + (int)satDial.val;
+      s = s + gx->satadj;
       if (s<  0) s =   0;
       if (s>100) s = 100;
 
@@ -3282,14 +3634,10 @@ byte *GammifyPic24(byte *pic24, int wide, int high)
     }   /* if hsvmod */
 
 
-    *op++ = rGraf.func[rv];
-    *op++ = gGraf.func[gv];
-    *op++ = bGraf.func[bv];
+    *op++ = gx->rfunc[rv];
+    *op++ = gx->gfunc[gv];
+    *op++ = gx->bfunc[bv];
   }
-
-  printUTime("end of GammifyPic24");
-
-  return outpic;
 }
 
 
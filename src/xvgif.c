@@ -27,8 +27,8 @@
 
 typedef int boolean;
 
-#define NEXTBYTE (*dataptr++)
-#define SKIPBYTE (dataptr++)	/* quiet some compiler warnings */
+#define NEXTBYTE (*gd->dataptr++)
+#define SKIPBYTE (gd->dataptr++)	/* quiet some compiler warnings */
 #define EXTENSION     0x21
 #define IMAGESEP      0x2c	/* a.k.a. Image Descriptor */
 #define TRAILER       0x3b
@@ -37,18 +37,20 @@ typedef int boolean;
 
 
 
-static FILE *fp;
+/* everything the decoder keeps between calls lives in a GIFDEC, so
+   several images can be decoded at once */
+typedef struct {
+  FILE *fp;
 
-static int
-    BitOffset = 0,		/* Bit Offset of next code */
-    XC = 0, YC = 0,		/* Output X and Y coords of current pixel */
-    Pass = 0,			/* Used by output routine if interlaced pic */
-    OutCount = 0,		/* Decompressor output 'stack count' */
+  int
+    BitOffset,			/* Bit Offset of next code */
+    XC, YC,			/* Output X and Y coords of current pixel */
+    Pass,			/* Used by output routine if interlaced pic */
+    OutCount,			/* Decompressor output 'stack count' */
     RWidth, RHeight,		/* screen dimensions */
     Width, Height,		/* image dimensions */
     LeftOfs, TopOfs,		/* image offset */
     BitsPerPixel,		/* Bits per pixel, read from GIF header */
-/*  BytesPerScanline,	*/	/* bytes per scanline in output raster */
     ColorMapSize,		/* number of colors */
     Background,			/* background color */
     Transparent,		/* transparent color (GRR 19980314) */
@@ -69,22 +71,30 @@ static int
     GlobalColorMapSize,		/*   (ditto)  */
     GlobalBitMask;		/*   (ditto)  */
 
+  boolean Interlace, HasGlobalColormap;
 
-static boolean Interlace, HasGlobalColormap;
+  byte   *RawGIF;		/* The heap array to hold it, raw */
+  byte   *Raster;		/* The raster data stream, unblocked */
+  byte   *pic8;
+  size_t  rasterSize;
 
-static byte *RawGIF;		/* The heap array to hold it, raw */
-static byte *Raster;		/* The raster data stream, unblocked */
-static byte *pic8;
-static size_t rasterSize;
+      /* The hash table used by the decompressor */
+  int     Prefix[4096];
+  int     Suffix[4096];
 
-    /* The hash table used by the decompressor */
-static int Prefix[4096];
-static int Suffix[4096];
+      /* An output array used by the decompressor */
+  int     OutCode[4097];
 
-    /* An output array used by the decompressor */
-static int OutCode[4097];
+  int     gif89;
+
+  long int    filesize;
+  const char *bname;
+  byte       *dataptr;
+
+  byte   *iptr;			/* doInterlace() output position */
+  int     oldYC;
+} GIFDEC;
 
-static int gif89 = 0;
 static const char *id87 = "GIF87a";
 static const char *id89 = "GIF89a";
 
@@ -95,15 +105,12 @@ static int const EGApalette[16][3] = {
   {255,100,100}, {255,100,255}, {255,255,100}, {255,255,255} };
 
 
-static int   readImage   PARM((PICINFO *));
-static int   readCode    PARM((void));
-static void  doInterlace PARM((int));
-static int   gifError    PARM((PICINFO *, const char *));
-static void  gifWarning  PARM((const char *));
-
-static long int    filesize;
-static const char *bname;
-static byte       *dataptr;
+static int   loadGIF     PARM((GIFDEC *, char *, PICINFO *));
+static int   readImage   PARM((GIFDEC *, PICINFO *));
+static int   readCode    PARM((GIFDEC *));
+static void  doInterlace PARM((GIFDEC *, int));
+static int   gifError    PARM((GIFDEC *, PICINFO *, const char *));
+static void  gifWarning  PARM((GIFDEC *, const char *));
 
 
 /*****************************/
@@ -112,6 +119,22 @@ int LoadGIF(char *fname, PICINFO *pinfo)
 {
   /* returns '1' if successful */
 
+  GIFDEC *gd;
+  int     rv;
+
+  gd = (GIFDEC *) calloc((size_t) 1, sizeof(GIFDEC));
+  if (!gd) FatalError("LoadGIF: not enough memory for decoder state");
+
+  rv = loadGIF(gd, fname, pinfo);
+
+  free(gd);
+  return rv;
+}
+
+
+/*****************************/
+static int loadGIF(GIFDEC *gd, char *fname, PICINFO *pinfo)
+{
   register byte  ch, *origptr;
   register int   i, block;
   int            aspect;
@@ -119,73 +142,73 @@ int LoadGIF(char *fname, PICINFO *pinfo)
   byte r[256], g[256], b[256];
 
   /* initialize variables */
-  BitOffset = XC = YC = OutCount = 0;
-  Pass = -1;
-  RawGIF = Raster = pic8 = NULL;
-  gif89 = 0;
-  Transparent = -1;
+  gd->BitOffset = gd->XC = gd->YC = gd->OutCount = 0;
+  gd->Pass = gd->oldYC = -1;
+  gd->RawGIF = gd->Raster = gd->pic8 = NULL;
+  gd->gif89 = 0;
+  gd->Transparent = -1;
 
   pinfo->pic     = (byte *) NULL;
   pinfo->comment = (char *) NULL;
   pinfo->numpages= 0;
 
-  bname = BaseName(fname);
-  fp = xv_fopen(fname,"r");
-  if (!fp) return ( gifError(pinfo, "can't open file") );
+  gd->bname = BaseName(fname);
+  gd->fp = xv_fopen(fname,"r");
+  if (!gd->fp) return ( gifError(gd, pinfo, "can't open file") );
 
 
   /* find the size of the file */
-  fseek(fp, 0L, 2);
-  filesize = ftell(fp);
-  fseek(fp, 0L, 0);
+  fseek(gd->fp, 0L, 2);
+  gd->filesize = ftell(gd->fp);
+  fseek(gd->fp, 0L, 0);
 
-  if (filesize > (2147483647L - 256))
-    return( gifError(pinfo, "GIF file size is too large") );
+  if (gd->filesize > (2147483647L - 256))
+    return( gifError(gd, pinfo, "GIF file size is too large") );
 
   /* the +256's are so we can read truncated GIF files without fear of
      segmentation violation */
-  if (!(dataptr = RawGIF = (byte *) calloc((size_t) filesize+256, (size_t) 1)))
+  if (!(gd->dataptr = gd->RawGIF = (byte *) calloc((size_t) gd->filesize+256, (size_t) 1)))
     FatalError("LoadGIF: not enough memory to read GIF file");
 
-  rasterSize = filesize+256;
-  if (!(Raster = (byte *) calloc(rasterSize, (size_t) 1)))
+  gd->rasterSize = gd->filesize+256;
+  if (!(gd->Raster = (byte *) calloc(gd->rasterSize, (size_t) 1)))
     FatalError("LoadGIF: not enough memory to read GIF file");
 
-  if (fread(dataptr, (size_t) filesize, (size_t) 1, fp) != 1)
-    return( gifError(pinfo, "GIF data read failed") );
-  fclose(fp);
+  if (fread(gd->dataptr, (size_t) gd->filesize, (size_t) 1, gd->fp) != 1)
+    return( gifError(gd, pinfo, "GIF data read failed") );
+  fclose(gd->fp);
 
-  origptr = dataptr;
+  origptr = gd->dataptr;
 
-  if      (strncmp((char *) dataptr, id87, (size_t) 6)==0) gif89 = 0;
-  else if (strncmp((char *) dataptr, id89, (size_t) 6)==0) gif89 = 1;
-  else    return( gifError(pinfo, "not a GIF file"));
+  if      (strncmp((char *) gd->dataptr, id87, (size_t) 6)==0) gd->gif89 = 0;
+  else if (strncmp((char *) gd->dataptr, id89, (size_t) 6)==0) gd->gif89 = 1;
+  else    return( gifError(gd, pinfo, "not a GIF file"));
 
-  dataptr += 6;
+  gd->dataptr += 6;
 
   /* Get variables from the GIF screen descriptor */
 
   ch = NEXTBYTE;
-  RWidth = ch + 0x100 * NEXTBYTE;	/* screen dimensions... not used. */
+  gd->RWidth = ch + 0x100 * NEXTBYTE;	/* screen dimensions... not used. */
   ch = NEXTBYTE;
-  RHeight = ch + 0x100 * NEXTBYTE;
-  if (DEBUG) fprintf(stderr,"GIF89 logical screen = %d x %d\n",RWidth,RHeight);
+  gd->RHeight = ch + 0x100 * NEXTBYTE;
+  if (DEBUG) fprintf(stderr,"GIF89 logical screen = %d x %d\n",gd->RWidth,gd->RHeight);
 
   ch = NEXTBYTE;
-  HasGlobalColormap = ((ch & COLORMAPMASK) ? True : False);
+  gd->HasGlobalColormap = ((ch & COLORMAPMASK) ? True : False);
 
   /* GRR 20070318:  fix decoding bug when global and local color-table sizes
    *                differ */
-  GlobalBitsPerPixel = BitsPerPixel = (ch & 7) + 1;
-  GlobalColorMapSize = ColorMapSize = numcols = 1 << BitsPerPixel;
-  GlobalBitMask = BitMask = ColorMapSize - 1;
+  gd->GlobalBitsPerPixel = gd->BitsPerPixel = (ch & 7) + 1;
+  gd->GlobalColorMapSize = gd->ColorMapSize = 1 << gd->BitsPerPixel;
+  gd->GlobalBitMask = gd->BitMask = gd->ColorMapSize - 1;
 
-  Background = NEXTBYTE;		/* background color... not used. */
+  gd->Background = NEXTBYTE;		/* background color... not used. */
 
   aspect = NEXTBYTE;
   if (aspect) {
 #if 0
-    if (!gif89) return(gifError(pinfo,"corrupt GIF file (screen descriptor)"));
+    if (!gd->gif89) return(gifError(gd, pinfo,"corrupt GIF file (screen descriptor)"));
     else normaspect = (float) (aspect + 15) / 64.0;   /* gif89 aspect ratio */
 #else
     normaspect = (float) (aspect + 15) / 64.0;   /* gif89 aspect ratio */
@@ -198,8 +221,8 @@ int LoadGIF(char *fname, PICINFO *pinfo)
 
   /* Read in global colormap. */
 
-  if (HasGlobalColormap)
-    for (i=0; i<ColorMapSize; i++) {
+  if (gd->HasGlobalColormap)
+    for (i=0; i<gd->ColorMapSize; i++) {
       r[i] = NEXTBYTE;
       g[i] = NEXTBYTE;
       b[i] = NEXTBYTE;
@@ -220,8 +243,8 @@ int LoadGIF(char *fname, PICINFO *pinfo)
 
   if (DEBUG > 1) {
     fprintf(stderr,"  global color table%s:\n",
-      HasGlobalColormap? "":" (repeated EGA palette)");
-    for (i=0; i<ColorMapSize; i++) {
+      gd->HasGlobalColormap? "":" (repeated EGA palette)");
+    for (i=0; i<gd->ColorMapSize; i++) {
       fprintf(stderr,"    (%3d  %02x,%02x,%02x)\n", i, pinfo->r[i],
         pinfo->g[i], pinfo->b[i]);
     }
@@ -277,7 +300,7 @@ int LoadGIF(char *fname, PICINFO *pinfo)
 	byte *ptr1, *cmt, *cmt1, *sp;
 
 	cmtlen = 0;
-	ptr1 = dataptr;      /* remember start of comments */
+	ptr1 = gd->dataptr;      /* remember start of comments */
 
 	/* figure out length of comment */
 	do {
@@ -325,7 +348,7 @@ int LoadGIF(char *fname, PICINFO *pinfo)
 	int j,sbsize,ch;
 	int tgLeft, tgTop, tgWidth, tgHeight, cWidth, cHeight, fg, bg;
 
-	SetISTR(ISTR_INFO, "%s:  %s", bname,
+	SetISTR(ISTR_INFO, "%s:  %s", gd->bname,
 		"PlainText extension found in GIF file.  Ignored.");
 
 	sbsize   = NEXTBYTE;
@@ -362,7 +385,7 @@ int LoadGIF(char *fname, PICINFO *pinfo)
 
 	if (DEBUG) fprintf(stderr,"Graphic Control extension\n\n");
 
-	SetISTR(ISTR_INFO, "%s:  %s", bname,
+	SetISTR(ISTR_INFO, "%s:  %s", gd->bname,
 		"Graphic Control Extension ignored.");
 
 	/* read (and ignore) data sub-blocks, unless compositing with
@@ -371,14 +394,14 @@ int LoadGIF(char *fname, PICINFO *pinfo)
 	  j = 0;
 	  sbsize = NEXTBYTE;
 	  /* GRR 19980314:  get transparent index out of block */
-	  if (have_imagebg && sbsize == 4 && Transparent < 0) {
+	  if (have_imagebg && sbsize == 4 && gd->Transparent < 0) {
 	    byte packed_fields = NEXTBYTE;
 
 	    j++;
 	    SKIPBYTE;  j++;
 	    SKIPBYTE;  j++;
 	    if (packed_fields & 1) {
-	      Transparent = NEXTBYTE;
+	      gd->Transparent = NEXTBYTE;
 	      j++;
 	    }
 	  }
@@ -409,7 +432,7 @@ int LoadGIF(char *fname, PICINFO *pinfo)
 
 	SetISTR(ISTR_INFO,
 		"%s:  Unknown extension 0x%02x in GIF file.  Ignored.",
-		bname, fn);
+		gd->bname, fn);
 
 	/* read (and ignore) data sub-blocks */
 	do {
@@ -423,9 +446,10 @@ int LoadGIF(char *fname, PICINFO *pinfo)
     else if (block == IMAGESEP) {
       if (DEBUG) fprintf(stderr, "imagesep (page=%d)\n", pinfo->numpages+1);
       if (DEBUG) fprintf(stderr, "  at start: offset=0x%lx\n",
-                         (unsigned long)(dataptr-RawGIF));
+                         (unsigned long)(gd->dataptr-gd->RawGIF));
 
-      BitOffset = XC = YC = Pass = OutCount = 0;
+      gd->BitOffset = gd->XC = gd->YC = gd->Pass = gd->OutCount = 0;
+      gd->oldYC = -1;
 
       if (pinfo->numpages > 0) {   /* do multipage stuff */
 	if (pinfo->numpages == 1) {    /* first time only... */
@@ -439,39 +463,39 @@ int LoadGIF(char *fname, PICINFO *pinfo)
            *  (though all appended-number ones do); ergo, open for reading (see
            *  if it's there), close, and explicitly unlink() if necessary */
           /* GRR 20070506:  could/should call KillPageFiles() (xv.c) instead */
-	  fp = xv_fopen(pinfo->pagebname, "r");
-	  if (fp) {
-	    fclose(fp);
+	  gd->fp = xv_fopen(pinfo->pagebname, "r");
+	  if (gd->fp) {
+	    fclose(gd->fp);
 	    unlink(pinfo->pagebname);  /* no errors during testing */
 	  }
 	}
 	sprintf(tmpname, "%s%d", pinfo->pagebname, pinfo->numpages);
-	fp = xv_fopen(tmpname, "w");
-	if (!fp) {
+	gd->fp = xv_fopen(tmpname, "w");
+	if (!gd->fp) {
 	  ErrPopUp("LoadGIF: Unable to open temp file", "\nDang!");
 	  return 0;
 	}
-	if (WriteGIF(fp, pinfo->pic, pinfo->type, pinfo->w, pinfo->h, pinfo->r,
-		 pinfo->g, pinfo->b, numcols, pinfo->colType, NULL)) {
-	  fclose(fp);
+	if (WriteGIF(gd->fp, pinfo->pic, pinfo->type, pinfo->w, pinfo->h, pinfo->r,
+		 pinfo->g, pinfo->b, gd->ColorMapSize, pinfo->colType, NULL)) {
+	  fclose(gd->fp);
 	  ErrPopUp("LoadGIF: Error writing temp file", "\nBummer!");
 	  return 0;
 	}
-	fclose(fp);
+	fclose(gd->fp);
 	free(pinfo->pic);
 	pinfo->pic = (byte *) NULL;
-	if (HasGlobalColormap) {
+	if (gd->HasGlobalColormap) {
 	  memcpy(pinfo->r, r, sizeof r);
 	  memcpy(pinfo->g, g, sizeof g);
 	  memcpy(pinfo->b, b, sizeof b);
 	}
-        BitsPerPixel = GlobalBitsPerPixel;
-        numcols = ColorMapSize = GlobalColorMapSize;
-        BitMask = GlobalBitMask;
+        gd->BitsPerPixel = gd->GlobalBitsPerPixel;
+        gd->ColorMapSize = gd->GlobalColorMapSize;
+        gd->BitMask = gd->GlobalBitMask;
       }
-      if (readImage(pinfo)) ++pinfo->numpages;
+      if (readImage(gd, pinfo)) ++pinfo->numpages;
       if (DEBUG) fprintf(stderr, "  at end:   offset=0x%lx\n",
-                         (unsigned long)(dataptr-RawGIF));
+                         (unsigned long)(gd->dataptr-gd->RawGIF));
     }
 
 
@@ -486,12 +510,12 @@ int LoadGIF(char *fname, PICINFO *pinfo)
       if (DEBUG) fprintf(stderr,"block type 0x%02x  ", block);
 
       /* don't mention bad block if file was trunc'd, as it's all bogus */
-      if ((dataptr - origptr) < filesize) {
+      if ((gd->dataptr - origptr) < gd->filesize) {
 	sprintf(str, "Unknown block type (0x%02x) at offset 0x%lx",
-		block, (unsigned long)(dataptr - origptr) - 1);
+		block, (unsigned long)(gd->dataptr - origptr) - 1);
 
-	if (!pinfo->numpages) return gifError(pinfo, str);
-	else gifWarning(str);
+	if (!pinfo->numpages) return gifError(gd, pinfo, str);
+	else gifWarning(gd, str);
       }
 
       break;
@@ -500,28 +524,28 @@ int LoadGIF(char *fname, PICINFO *pinfo)
     if (DEBUG) fprintf(stderr,"\n");
   }
 
-  free(RawGIF);	 RawGIF = NULL;
-  free(Raster);  Raster = NULL;
+  free(gd->RawGIF);	 gd->RawGIF = NULL;
+  free(gd->Raster);  gd->Raster = NULL;
 
   if (!pinfo->numpages)
-     return( gifError(pinfo, "no image data found in GIF file") );
+     return( gifError(gd, pinfo, "no image data found in GIF file") );
   if (pinfo->numpages > 1) {
     /* write the last page temp file */
     int numpages = pinfo->numpages;
     char *comment = pinfo->comment;
     sprintf(tmpname, "%s%d", pinfo->pagebname, pinfo->numpages);
-    fp = xv_fopen(tmpname, "w");
-    if (!fp) {
+    gd->fp = xv_fopen(tmpname, "w");
+    if (!gd->fp) {
       ErrPopUp("LoadGIF: Unable to open temp file", "\nDang!");
       return 0;
     }
-    if (WriteGIF(fp, pinfo->pic, pinfo->type, pinfo->w, pinfo->h, pinfo->r,
-		 pinfo->g, pinfo->b, numcols, pinfo->colType, NULL)) {
-      fclose(fp);
+    if (WriteGIF(gd->fp, pinfo->pic, pinfo->type, pinfo->w, pinfo->h, pinfo->r,
+		 pinfo->g, pinfo->b, gd->ColorMapSize, pinfo->colType, NULL)) {
+      fclose(gd->fp);
       ErrPopUp("LoadGIF: Error writing temp file", "\nBummer!");
       return 0;
     }
-    fclose(fp);
+    fclose(gd->fp);
     free(pinfo->pic);
     pinfo->pic = (byte *) NULL;
 
@@ -537,7 +561,7 @@ int LoadGIF(char *fname, PICINFO *pinfo)
 
 
 /********************************************/
-static int readImage(PICINFO *pinfo)
+static int readImage(GIFDEC *gd, PICINFO *pinfo)
 {
   register byte ch, ch1, *ptr1, *picptr;
   int           i, npixels, maxpixels;
@@ -548,31 +572,31 @@ static int readImage(PICINFO *pinfo)
   /* read in values from the image descriptor */
 
   ch = NEXTBYTE;
-  LeftOfs = ch + 0x100 * NEXTBYTE;
+  gd->LeftOfs = ch + 0x100 * NEXTBYTE;
   ch = NEXTBYTE;
-  TopOfs  = ch + 0x100 * NEXTBYTE;
+  gd->TopOfs  = ch + 0x100 * NEXTBYTE;
   ch = NEXTBYTE;
-  Width   = ch + 0x100 * NEXTBYTE;
+  gd->Width   = ch + 0x100 * NEXTBYTE;
   ch = NEXTBYTE;
-  Height  = ch + 0x100 * NEXTBYTE;
+  gd->Height  = ch + 0x100 * NEXTBYTE;
 
-  Misc = NEXTBYTE;
-  Interlace = ((Misc & INTERLACEMASK) ? True : False);
-  HasLocalColormap = ((Misc & COLORMAPMASK) ? True : False);
+  gd->Misc = NEXTBYTE;
+  gd->Interlace = ((gd->Misc & INTERLACEMASK) ? True : False);
+  HasLocalColormap = ((gd->Misc & COLORMAPMASK) ? True : False);
 
   if (HasLocalColormap) {
-    BitsPerPixel = (Misc & 7) + 1;
-    ColorMapSize = numcols = 1 << BitsPerPixel;  /* GRR 20070318 */
-    BitMask = ColorMapSize - 1;
+    gd->BitsPerPixel = (gd->Misc & 7) + 1;
+    gd->ColorMapSize = 1 << gd->BitsPerPixel;  /* GRR 20070318 */
+    gd->BitMask = gd->ColorMapSize - 1;
     if (DEBUG) fprintf(stderr,"  local color table, %d bits (%d entries)\n",
-      (Misc&7)+1, ColorMapSize);
-    for (i=0; i<ColorMapSize; i++) {
+      (gd->Misc&7)+1, gd->ColorMapSize);
+    for (i=0; i<gd->ColorMapSize; i++) {
       pinfo->r[i] = NEXTBYTE;
       pinfo->g[i] = NEXTBYTE;
       pinfo->b[i] = NEXTBYTE;
     }
     if (DEBUG > 1) {
-      for (i=0; i<ColorMapSize; i++) {
+      for (i=0; i<gd->ColorMapSize; i++) {
         fprintf(stderr,"    (%3d  %02x,%02x,%02x)\n", i, pinfo->r[i],
           pinfo->g[i], pinfo->b[i]);
       }
@@ -580,21 +604,21 @@ static int readImage(PICINFO *pinfo)
   }
 
 
-  if (!HasGlobalColormap && !HasLocalColormap) {
+  if (!gd->HasGlobalColormap && !HasLocalColormap) {
     /* no global or local colormap */
-    SetISTR(ISTR_WARNING, "%s:  %s", bname,
+    SetISTR(ISTR_WARNING, "%s:  %s", gd->bname,
 	    "No colormap in this GIF file.  Assuming EGA colors.");
   }
 
 
   /* GRR 19980314 */
   /* need not worry about size of EGA palette:  full 256 colors */
-  if (have_imagebg && Transparent >= 0 &&
-      Transparent < ((Misc&0x80)? (1 << ((Misc&7)+1)) : ColorMapSize) )
+  if (have_imagebg && gd->Transparent >= 0 &&
+      gd->Transparent < ((gd->Misc&0x80)? (1 << ((gd->Misc&7)+1)) : gd->ColorMapSize) )
   {
-    pinfo->r[Transparent] = (imagebgR >> 8);
-    pinfo->g[Transparent] = (imagebgG >> 8);
-    pinfo->b[Transparent] = (imagebgB >> 8);
+    pinfo->r[gd->Transparent] = (imagebgR >> 8);
+    pinfo->g[gd->Transparent] = (imagebgG >> 8);
+    pinfo->b[gd->Transparent] = (imagebgB >> 8);
   }
 
 
@@ -603,11 +627,11 @@ static int readImage(PICINFO *pinfo)
    * and compute decompressor constant values, based on this code size.
    */
 
-  CodeSize = NEXTBYTE;
+  gd->CodeSize = NEXTBYTE;
 
-  ClearCode = (1 << CodeSize);
-  EOFCode = ClearCode + 1;
-  FreeCode = FirstFree = ClearCode + 2;
+  gd->ClearCode = (1 << gd->CodeSize);
+  gd->EOFCode = gd->ClearCode + 1;
+  gd->FreeCode = gd->FirstFree = gd->ClearCode + 2;
 
   /* The GIF spec has it that the code size is the code size used to
    * compute the above values is the code size given in the file, but the
@@ -615,10 +639,10 @@ static int readImage(PICINFO *pinfo)
    * the file plus one. (thus the ++).
    */
 
-  CodeSize++;
-  InitCodeSize = CodeSize;
-  MaxCode = (1 << CodeSize);
-  ReadMask = MaxCode - 1;
+  gd->CodeSize++;
+  gd->InitCodeSize = gd->CodeSize;
+  gd->MaxCode = (1 << gd->CodeSize);
+  gd->ReadMask = gd->MaxCode - 1;
 
 
 
@@ -628,12 +652,12 @@ static int readImage(PICINFO *pinfo)
    * data stream, which makes life much easier for readCode().
    */
 
-  ptr1 = Raster;
+  ptr1 = gd->Raster;
   do {
     ch = ch1 = NEXTBYTE;
     while (ch--) { *ptr1 = NEXTBYTE; ptr1++; }
-    if ((dataptr - RawGIF) > filesize) {
-      SetISTR(ISTR_WARNING,"%s:  %s", bname,
+    if ((gd->dataptr - gd->RawGIF) > gd->filesize) {
+      SetISTR(ISTR_WARNING,"%s:  %s", gd->bname,
 	      "This GIF file seems to be truncated.  Winging it.");
       break;
     }
@@ -644,16 +668,16 @@ static int readImage(PICINFO *pinfo)
 
   if (DEBUG) {
     fprintf(stderr,"LoadGIF: image is %dx%d, %d bits, %sinterlaced\n",
-	    Width, Height, BitsPerPixel, Interlace ? "" : "non-");
+	    gd->Width, gd->Height, gd->BitsPerPixel, gd->Interlace ? "" : "non-");
   }
 
 
   /* Allocate the 'pic' */
-  maxpixels = Width*Height;  /* 65535*65535 max (but everything is int) */
-  if (Width <= 0 || Height <= 0 || maxpixels/Width != Height)
-    return( gifError(pinfo, "image dimensions out of range") );
-  picptr = pic8 = (byte *) malloc((size_t) maxpixels);
-  if (!pic8) FatalError("LoadGIF: couldn't malloc 'pic8'");
+  maxpixels = gd->Width*gd->Height;  /* 65535*65535 max (but everything is int) */
+  if (gd->Width <= 0 || gd->Height <= 0 || maxpixels/gd->Width != gd->Height)
+    return( gifError(gd, pinfo, "image dimensions out of range") );
+  picptr = gd->pic8 = (byte *) malloc((size_t) maxpixels);
+  if (!gd->pic8) FatalError("LoadGIF: couldn't malloc 'pic8'");
 
 
 
@@ -661,41 +685,41 @@ static int readImage(PICINFO *pinfo)
    * One obvious enhancement is to add checking for corrupt files here.
    */
 
-  Code = readCode();
-  while (Code != EOFCode) {
+  gd->Code = readCode(gd);
+  while (gd->Code != gd->EOFCode) {
     /* Clear code sets everything back to its initial value, then reads the
      * immediately subsequent code as uncompressed data.
      */
 
-    if (Code == ClearCode) {
-      CodeSize = InitCodeSize;
-      MaxCode = (1 << CodeSize);
-      ReadMask = MaxCode - 1;
-      FreeCode = FirstFree;
-      Code = readCode();
-      CurCode = OldCode = Code;
-      FinChar = CurCode & BitMask;
-      if (!Interlace) *picptr++ = FinChar;
-         else doInterlace(FinChar);
+    if (gd->Code == gd->ClearCode) {
+      gd->CodeSize = gd->InitCodeSize;
+      gd->MaxCode = (1 << gd->CodeSize);
+      gd->ReadMask = gd->MaxCode - 1;
+      gd->FreeCode = gd->FirstFree;
+      gd->Code = readCode(gd);
+      gd->CurCode = gd->OldCode = gd->Code;
+      gd->FinChar = gd->CurCode & gd->BitMask;
+      if (!gd->Interlace) *picptr++ = gd->FinChar;
+         else doInterlace(gd, gd->FinChar);
       npixels++;
     }
     else {
       /* If not a clear code, must be data: save same as CurCode and InCode */
 
       /* if we're at maxcode and didn't get a clear, stop loading */
-      if (FreeCode>=4096) { /* printf("freecode blew up\n"); */
+      if (gd->FreeCode>=4096) { /* printf("freecode blew up\n"); */
 			    break; }
 
-      CurCode = InCode = Code;
+      gd->CurCode = gd->InCode = gd->Code;
 
       /* If greater or equal to FreeCode, not in the hash table yet;
        * repeat the last character decoded
        */
 
-      if (CurCode >= FreeCode) {
-	CurCode = OldCode;
-	if (OutCount > 4096) {  /* printf("outcount1 blew up\n"); */ break; }
-	OutCode[OutCount++] = FinChar;
+      if (gd->CurCode >= gd->FreeCode) {
+	gd->CurCode = gd->OldCode;
+	if (gd->OutCount > 4096) {  /* printf("outcount1 blew up\n"); */ break; }
+	gd->OutCode[gd->OutCount++] = gd->FinChar;
       }
 
       /* Unless this code is raw data, pursue the chain pointed to by CurCode
@@ -703,68 +727,68 @@ static int readImage(PICINFO *pinfo)
        * associated output code on the output queue.
        */
 
-      while (CurCode >= ClearCode) {  /* Joe Zbiciak fix, 20070621 */
-	if (OutCount > 4096) break;   /* corrupt file */
-	OutCode[OutCount++] = Suffix[CurCode];
-	CurCode = Prefix[CurCode];
+      while (gd->CurCode >= gd->ClearCode) {  /* Joe Zbiciak fix, 20070621 */
+	if (gd->OutCount > 4096) break;   /* corrupt file */
+	gd->OutCode[gd->OutCount++] = gd->Suffix[gd->CurCode];
+	gd->CurCode = gd->Prefix[gd->CurCode];
       }
 
-      if (OutCount > 4096) { /* printf("outcount blew up\n"); */ break; }
+      if (gd->OutCount > 4096) { /* printf("outcount blew up\n"); */ break; }
 
       /* The last code in the chain is treated as raw data. */
 
-      FinChar = CurCode & BitMask;
-      OutCode[OutCount++] = FinChar;
+      gd->FinChar = gd->CurCode & gd->BitMask;
+      gd->OutCode[gd->OutCount++] = gd->FinChar;
 
       /* Now we put the data out to the Output routine.
        * It's been stacked LIFO, so deal with it that way...
        */
 
       /* safety thing:  prevent exceeding range of 'pic8' */
-      if (npixels + OutCount > maxpixels) OutCount = maxpixels-npixels;
+      if (npixels + gd->OutCount > maxpixels) gd->OutCount = maxpixels-npixels;
 
-      npixels += OutCount;
-      if (!Interlace) for (i=OutCount-1; i>=0; i--) *picptr++ = OutCode[i];
-                else  for (i=OutCount-1; i>=0; i--) doInterlace(OutCode[i]);
-      OutCount = 0;
+      npixels += gd->OutCount;
+      if (!gd->Interlace) for (i=gd->OutCount-1; i>=0; i--) *picptr++ = gd->OutCode[i];
+                else  for (i=gd->OutCount-1; i>=0; i--) doInterlace(gd, gd->OutCode[i]);
+      gd->OutCount = 0;
 
       /* Build the hash table on-the-fly. No table is stored in the file. */
 
-      Prefix[FreeCode] = OldCode;
-      Suffix[FreeCode] = FinChar;
-      OldCode = InCode;
+      gd->Prefix[gd->FreeCode] = gd->OldCode;
+      gd->Suffix[gd->FreeCode] = gd->FinChar;
+      gd->OldCode = gd->InCode;
 
       /* Point to the next slot in the table.  If we exceed the current
        * MaxCode value, increment the code size unless it's already 12.  If it
        * is, do nothing: the next code decompressed better be CLEAR
        */
 
-      FreeCode++;
-      if (FreeCode >= MaxCode) {
-	if (CodeSize < 12) {
-	  CodeSize++;
-	  MaxCode *= 2;
-	  ReadMask = (1 << CodeSize) - 1;
+      gd->FreeCode++;
+      if (gd->FreeCode >= gd->MaxCode) {
+	if (gd->CodeSize < 12) {
+	  gd->CodeSize++;
+	  gd->MaxCode *= 2;
+	  gd->ReadMask = (1 << gd->CodeSize) - 1;
 	}
       }
     }
-    Code = readCode();
+    gd->Code = readCode(gd);
     if (npixels >= maxpixels) break;
   }
 
   if (npixels != maxpixels) {
-    SetISTR(ISTR_WARNING,"%s:  %s", bname,
+    SetISTR(ISTR_WARNING,"%s:  %s", gd->bname,
 	    "This GIF file seems to be truncated.  Winging it.");
-    if (!Interlace)  /* clear->EOBuffer */
-      bzero((char *) pic8+npixels,
+    if (!gd->Interlace)  /* clear->EOBuffer */
+      bzero((char *) gd->pic8+npixels,
 	      (size_t) (maxpixels-npixels<0 ? 0 : maxpixels-npixels));
   }
 
   /* fill in the PICINFO structure */
 
-  pinfo->pic     = pic8;
-  pinfo->w       = Width;
-  pinfo->h       = Height;
+  pinfo->pic     = gd->pic8;
+  pinfo->w       = gd->Width;
+  pinfo->h       = gd->Height;
   pinfo->type    = PIC8;
   pinfo->frmType = F_GIF;
   pinfo->colType = F_FULLCOLOR;
@@ -773,11 +797,11 @@ static int readImage(PICINFO *pinfo)
 
   sprintf(pinfo->fullInfo,
 	  "GIF%s, %d bit%s per pixel, %sinterlaced.  (%ld bytes)",
- 	  (gif89) ? "89" : "87", BitsPerPixel,
-	  (BitsPerPixel==1) ? "" : "s",
- 	  Interlace ? "" : "non-", filesize);
+ 	  (gd->gif89) ? "89" : "87", gd->BitsPerPixel,
+	  (gd->BitsPerPixel==1) ? "" : "s",
+ 	  gd->Interlace ? "" : "non-", gd->filesize);
 
-  sprintf(pinfo->shrtInfo, "%dx%d GIF%s.",Width,Height,(gif89) ? "89" : "87");
+  sprintf(pinfo->shrtInfo, "%dx%d GIF%s.",gd->Width,gd->Height,(gd->gif89) ? "89" : "87");
 
   /* pinfo.comment gets handled in main LoadGIF() block-reader */
 
@@ -794,68 +818,67 @@ static int readImage(PICINFO *pinfo)
  * bring the desired code to the bottom, then mask it off and return it.
  */
 
-static int readCode(void)
+static int readCode(GIFDEC *gd)
 {
   int RawCode, ByteOffset;
 
-  ByteOffset = BitOffset / 8;
-  if (ByteOffset >= rasterSize-2)
+  ByteOffset = gd->BitOffset / 8;
+  if (ByteOffset >= gd->rasterSize-2)
   	return 0;
-  RawCode = Raster[ByteOffset] + (Raster[ByteOffset + 1] << 8);
-  if (CodeSize >= 8)
-    RawCode += ( ((int) Raster[ByteOffset + 2]) << 16);
-  RawCode >>= (BitOffset % 8);
-  BitOffset += CodeSize;
+  RawCode = gd->Raster[ByteOffset] + (gd->Raster[ByteOffset + 1] << 8);
+  if (gd->CodeSize >= 8)
+    RawCode += ( ((int) gd->Raster[ByteOffset + 2]) << 16);
+  RawCode >>= (gd->BitOffset % 8);
+  gd->BitOffset += gd->CodeSize;
 
-  return(RawCode & ReadMask);
+  return(RawCode & gd->ReadMask);
 }
 
 
 /***************************/
-static void doInterlace(int Index)
+static void doInterlace(GIFDEC *gd, int Index)
 {
-  static byte *ptr = NULL;
-  static int   oldYC = -1;
-
-  if (Pass == -1) {  /* first time through - init stuff */
-    oldYC = -1;
-    Pass = 0;
+  if (gd->Pass == -1) {  /* first time through - init stuff */
+    gd->oldYC = -1;
+    gd->Pass = 0;
   }
 
-  if (oldYC != YC) {  ptr = pic8 + YC * Width;  oldYC = YC; }
+  if (gd->oldYC != gd->YC) {
+    gd->iptr = gd->pic8 + gd->YC * gd->Width;  gd->oldYC = gd->YC;
+  }
 
-  if (YC<Height)
-    *ptr++ = Index;
+  if (gd->YC<gd->Height)
+    *gd->iptr++ = Index;
 
   /* Update the X-coordinate, and if it overflows, update the Y-coordinate */
 
-  if (++XC == Width) {
+  if (++gd->XC == gd->Width) {
 
     /* deal with the interlace as described in the GIF
      * spec.  Put the decoded scan line out to the screen if we haven't gone
      * past the bottom of it
      */
 
-    XC = 0;
+    gd->XC = 0;
 
-    switch (Pass) {
+    switch (gd->Pass) {
     case 0:
-      YC += 8;
-      if (YC >= Height) { Pass++; YC = 4; }
+      gd->YC += 8;
+      if (gd->YC >= gd->Height) { gd->Pass++; gd->YC = 4; }
       break;
 
     case 1:
-      YC += 8;
-      if (YC >= Height) { Pass++; YC = 2; }
+      gd->YC += 8;
+      if (gd->YC >= gd->Height) { gd->Pass++; gd->YC = 2; }
       break;
 
     case 2:
-      YC += 4;
-      if (YC >= Height) { Pass++; YC = 1; }
+      gd->YC += 4;
+      if (gd->YC >= gd->Height) { gd->Pass++; gd->YC = 1; }
       break;
 
     case 3:
-      YC += 2;  break;
+      gd->YC += 2;  break;
 
     default:
       break;
@@ -866,17 +889,17 @@ static void doInterlace(int Index)
 
 
 /*****************************/
-static int gifError(PICINFO *pinfo, const char *st)
+static int gifError(GIFDEC *gd, PICINFO *pinfo, const char *st)
 {
-  gifWarning(st);
+  gifWarning(gd, st);
 
-  if (RawGIF != NULL) free(RawGIF);
-  if (Raster != NULL) free(Raster);
+  if (gd->RawGIF != NULL) free(gd->RawGIF);
+  if (gd->Raster != NULL) free(gd->Raster);
 
   if (pinfo->pic) free(pinfo->pic);
   if (pinfo->comment) free(pinfo->comment);
 
-  if (pic8 && pic8 != pinfo->pic) free(pic8);
+  if (gd->pic8 && gd->pic8 != pinfo->pic) free(gd->pic8);
 
   pinfo->pic = (byte *) NULL;
   pinfo->comment = (char *) NULL;
@@ -886,9 +909,9 @@ static int gifError(PICINFO *pinfo, const char *st)
 
 
 /*****************************/
-static void gifWarning(const char *st)
+static void gifWarning(GIFDEC *gd, const char *st)
 {
-  SetISTR(ISTR_WARNING,"%s:  %s", bname, st);
+  SetISTR(ISTR_WARNING,"%s:  %s", gd->bname, st);
 }
 
 
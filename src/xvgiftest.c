@@ -0,0 +1,271 @@
+/*
+ * xvgiftest.c - checks, and times, the GIF encoder
+ *
+ *  usage:  xvgiftest [-size w h] [-passes n] [file ...]
+ *
+ * Encodes a few made-up 8-bit images (noise, a smooth gradient, big flat
+ * blocks, and a two-color image), plus any image files named on the
+ * command line, with WriteGIF(), decodes each result with LoadGIF(), and
+ * checks that every pixel came back the same color.  Each image is
+ * encoded 'passes' times, and the fastest of those is reported, in
+ * megapixels per second, along with the size of the GIF.
+ *
+ * Exits 0 if every image survived the round trip, 1 otherwise.
+ *
+ * Built from xv's own object files, with xv.c's main() renamed out of the
+ * way, so it tests exactly the code that xv runs.
+ */
+
+#include "copyright.h"
+
+#include "xv.h"
+
+#include <time.h>
+
+#undef main     /* xv.c's is xv_main() in this program */
+
+
+/* the made-up images */
+#define GT_NOISE     0
+#define GT_GRADIENT  1
+#define GT_BLOCKS    2
+#define GT_TWOCOLOR  3
+#define GT_NKINDS    4
+
+static const char *gtNames[GT_NKINDS] = {
+  "noise", "gradient", "blocks", "twocolor" };
+static const int   gtCols[GT_NKINDS]  = { 256, 256, 16, 2 };
+
+
+typedef struct {
+  const char *name;
+  byte       *pic;               /* PIC8 */
+  int         w, h;
+  byte        r[256], g[256], b[256];
+  int         numcols;
+} GTIMAGE;
+
+
+int           main       PARM((int, char **));
+static void   gtMake     PARM((GTIMAGE *, int, int, int));
+static int    gtLoad     PARM((GTIMAGE *, char *));
+static int    gtRun      PARM((GTIMAGE *, int, char *));
+static double gtMsec     PARM((void));
+static void   gtSyntax   PARM((void));
+
+
+/*******************************************/
+int main(int argc, char **argv)
+{
+  GTIMAGE  gi;
+  char     fname[MAXPATHLEN];
+  int      i, w, h, passes, nbad, kind;
+
+  cmd = (char *) "xvgiftest";
+  tmpdir = (char *) getenv("TMPDIR");
+  if (!tmpdir) tmpdir = (char *) "/tmp";
+
+  w = 1024;  h = 768;  passes = 3;
+
+  for (i=1; i<argc && argv[i][0] == '-'; i++) {
+    if (!strcmp(argv[i], "-size") && i+2<argc) {
+      w = atoi(argv[++i]);  h = atoi(argv[++i]);
+      if (w < 1 || h < 1) { gtSyntax();  return 1; }
+    }
+    else if (!strcmp(argv[i], "-passes") && i+1<argc) {
+      passes = atoi(argv[++i]);
+      if (passes < 1) passes = 1;
+    }
+    else { gtSyntax();  return 1; }
+  }
+
+  sprintf(fname, "%s/xvgiftest%d.gif", tmpdir, (int) getpid());
+  nbad = 0;
+
+  for (kind=0; kind<GT_NKINDS; kind++) {
+    gtMake(&gi, kind, w, h);
+    nbad += gtRun(&gi, passes, fname);
+  }
+
+  for ( ; i<argc; i++) {
+    if (!gtLoad(&gi, argv[i])) {
+      printf("%-24s  skipped\n", argv[i]);
+      continue;
+    }
+    nbad += gtRun(&gi, passes, fname);
+  }
+
+  unlink(fname);
+  return (nbad ? 1 : 0);
+}
+
+
+/*******************************************/
+static void gtMake(GTIMAGE *gi, int kind, int w, int h)
+{
+  /* builds one of the made-up test images */
+
+  u_int  seed;
+  byte  *pp;
+  int    i, x, y, numcols, run;
+
+  numcols  = gtCols[kind];
+  gi->name = gtNames[kind];
+  gi->w = w;  gi->h = h;  gi->numcols = numcols;
+  gi->pic  = (byte *) malloc((size_t) w * h);
+  if (!gi->pic) FatalError("can't malloc test image");
+
+  for (i=0; i<numcols; i++) {
+    gi->r[i] = (byte) (i * 255 / (numcols-1));
+    gi->g[i] = (byte) (255 - gi->r[i]);
+    gi->b[i] = (byte) (i * 37);
+  }
+
+  seed = 12345;  run = 0;
+  for (y=0, pp=gi->pic; y<h; y++) {
+    for (x=0; x<w; x++, pp++) {
+      seed = seed * 1103515245 + 12345;
+
+      switch (kind) {
+      case GT_NOISE:
+	*pp = (byte) (seed >> 16);
+	break;
+
+      case GT_GRADIENT:                 /* lightly dithered */
+	*pp = (byte) (((x + y) / 4 + ((seed >> 16) & 1)) & 255);
+	break;
+
+      case GT_BLOCKS:                   /* 32x32 */
+	*pp = (byte) (((x / 32) * 7 + (y / 32) * 3) & 15);
+	break;
+
+      case GT_TWOCOLOR:                 /* runs of 16 or so pixels */
+	if (((seed >> 16) & 15) == 0) run = !run;
+	*pp = (byte) run;
+	break;
+      }
+    }
+  }
+}
+
+
+/*******************************************/
+static int gtLoad(GTIMAGE *gi, char *fname)
+{
+  /* loads an image file to encode.  returns '1' if it worked */
+
+  PICINFO  pinfo;
+  byte    *pic8;
+  int      ftype;
+
+  /* skips the same files xvloadtest does, for the same reasons */
+  ftype = ReadFileType(fname);
+  if (ftype == RFT_ERROR || ftype == RFT_UNKNOWN ||
+      ftype == RFT_PS    || ftype == RFT_COMPRESS ||
+      ftype == RFT_BZIP2 || ftype == RFT_XZ) return 0;
+
+  bzero((char *) &pinfo, sizeof(PICINFO));
+  if (!ReadPicFile(fname, ftype, &pinfo, (ftype == RFT_PCD)) || !pinfo.pic) {
+    if (pinfo.pic) free(pinfo.pic);
+    return 0;
+  }
+  if (pinfo.numpages > 1) KillPageFiles(pinfo.pagebname, pinfo.numpages);
+
+  if (pinfo.type == PIC24) {
+    pic8 = Conv24to8(pinfo.pic, pinfo.w, pinfo.h, 256,
+		     pinfo.r, pinfo.g, pinfo.b);
+    free(pinfo.pic);
+    if (!pic8) FatalError("can't convert test image to 8 bits");
+    pinfo.pic = pic8;
+  }
+
+  if (pinfo.comment)  free(pinfo.comment);
+  if (pinfo.exifInfo) free(pinfo.exifInfo);
+  if (pinfo.deep)     free(pinfo.deep);
+
+  gi->name = BaseName(fname);
+  gi->pic  = pinfo.pic;
+  gi->w    = pinfo.w;  gi->h = pinfo.h;
+  gi->numcols = 256;
+  bcopy((char *) pinfo.r, (char *) gi->r, sizeof(gi->r));
+  bcopy((char *) pinfo.g, (char *) gi->g, sizeof(gi->g));
+  bcopy((char *) pinfo.b, (char *) gi->b, sizeof(gi->b));
+  return 1;
+}
+
+
+/*******************************************/
+static int gtRun(GTIMAGE *gi, int passes, char *fname)
+{
+  /* encodes 'gi' 'passes' times, then checks the result.  Frees gi->pic.
+     returns '1' if the GIF didn't decode to the same image */
+
+  PICINFO  pinfo;
+  FILE    *fp;
+  double   t, best;
+  long     size, npix;
+  int      i, bad;
+  byte    *pp, *op;
+
+  npix = (long) gi->w * gi->h;
+  best = 0.0;  size = 0;
+
+  for (i=0; i<passes; i++) {
+    fp = fopen(fname, "w");
+    if (!fp) FatalError("can't create temporary GIF file");
+
+    t = gtMsec();
+    WriteGIF(fp, gi->pic, PIC8, gi->w, gi->h, gi->r, gi->g, gi->b,
+	     gi->numcols, F_FULLCOLOR, NULL);
+    t = gtMsec() - t;
+
+    size = ftell(fp);
+    fclose(fp);
+    if (i == 0 || t < best) best = t;
+  }
+
+  bzero((char *) &pinfo, sizeof(PICINFO));
+  bad = !LoadGIF(fname, &pinfo) || !pinfo.pic || pinfo.type != PIC8 ||
+        pinfo.w != gi->w || pinfo.h != gi->h;
+
+  for (i=0, pp=gi->pic, op=pinfo.pic; !bad && i<npix; i++, pp++, op++) {
+    if (gi->r[*pp] != pinfo.r[*op] || gi->g[*pp] != pinfo.g[*op] ||
+	gi->b[*pp] != pinfo.b[*op]) bad = 1;
+  }
+
+  printf("%-24s  %5dx%-5d %3d colors  %9ld bytes  %7.1f Mpixels/s  %s\n",
+	 gi->name, gi->w, gi->h, gi->numcols, size,
+	 (best > 0.0) ? (double) npix / best / 1000.0 : 0.0,
+	 bad ? "MISMATCH" : "ok");
+
+  if (pinfo.pic)     free(pinfo.pic);
+  if (pinfo.comment) free(pinfo.comment);
+  free(gi->pic);  gi->pic = NULL;
+  return bad;
+}
+
+
+/*******************************************/
+static double gtMsec(void)
+{
+  /* wall-clock time in milliseconds */
+
+#ifdef CLOCK_MONOTONIC
+  struct timespec ts;
+
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+    return (double) ts.tv_sec * 1000.0 + (double) ts.tv_nsec / 1000000.0;
+#endif
+  {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double) tv.tv_sec * 1000.0 + (double) tv.tv_usec / 1000.0;
+  }
+}
+
+
+/*******************************************/
+static void gtSyntax(void)
+{
+  fprintf(stderr, "usage:  %s [-size w h] [-passes n] [file ...]\n", cmd);
+}
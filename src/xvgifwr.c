@@ -38,24 +38,10 @@
 
 #include "xv.h"
 
-typedef long int        count_int;
-
-static int  Width, Height;
-static int  curx, cury;
-static long CountDown;
-static int  Interlace;
+#include <stdint.h>
 
 static void putword     PARM((int, FILE *));
-static void xv_compress PARM((int, FILE *, byte *, int));
-static void output      PARM((int));
-static void cl_block    PARM((void));
-static void cl_hash     PARM((count_int));
-static void char_init   PARM((void));
-static void char_out    PARM((int));
-static void flush_char  PARM((void));
-
-
-static byte pc2nc[256];
+static void xv_compress PARM((int, FILE *, byte *, int, byte *));
 
 
 /*************************************************************/
@@ -64,9 +50,10 @@ int WriteGIF(FILE *fp, byte *pic, int ptype, int w, int h, byte *rmap, byte *gma
 {
   int   RWidth, RHeight;
   int   LeftOfs, TopOfs;
-  int   ColorMapSize, InitCodeSize, Background, BitsPerPixel;
+  int   ColorMapSize, InitCodeSize, Background, BitsPerPixel, Interlace;
   int   i,j,nc;
   byte *pic8;
+  byte  pc2nc[256];                        /* pic colors -> gif colors */
   byte  rtemp[256],gtemp[256],btemp[256];  /* for 24-bit to 8-bit conversion */
   byte  r1[256],g1[256],b1[256];           /* for duplicated-color remapping */
 
@@ -114,17 +101,13 @@ int WriteGIF(FILE *fp, byte *pic, int ptype, int w, int h, byte *rmap, byte *gma
 
   ColorMapSize = 1 << BitsPerPixel;
 
-  RWidth  = Width  = w;
-  RHeight = Height = h;
+  RWidth  = w;
+  RHeight = h;
   LeftOfs = TopOfs = 0;
 
-  CountDown = w * h;    /* # of pixels we'll be doing */
-
   if (BitsPerPixel <= 1) InitCodeSize = 2;
                     else InitCodeSize = BitsPerPixel;
 
-  curx = cury = 0;
-
   if (!fp) {
     fprintf(stderr,  "WriteGIF: file not open for writing\n" );
     if (ptype == PIC24) free(pic8);
@@ -191,13 +174,13 @@ int WriteGIF(FILE *fp, byte *pic, int ptype, int w, int h, byte *rmap, byte *gma
   /* Write the Image header */
   putword(LeftOfs, fp);
   putword(TopOfs,  fp);
-  putword(Width,   fp);
-  putword(Height,  fp);
+  putword(w,       fp);
+  putword(h,       fp);
   if (Interlace) fputc(0x40, fp);   /* Use Global Colormap, maybe Interlace */
             else fputc(0x00, fp);
 
   fputc(InitCodeSize, fp);
-  xv_compress(InitCodeSize+1, fp, pic8, w*h);
+  xv_compress(InitCodeSize+1, fp, pic8, w*h, pc2nc);
 
   fputc(0,fp);                      /* Write out a Zero-length packet (EOF) */
   fputc(';',fp);                    /* Write GIF file terminator */
@@ -224,361 +207,213 @@ static void putword(int w, FILE *fp)
 
 /***********************************************************************/
 
+/*
+ * LZW encoder.
+ *
+ * Same code stream as the classic compress(1)-derived encoder this file
+ * used to carry (variable-width codes up to XV_BITS, a Clear code as soon
+ * as the table fills), so output is byte-for-byte what it always was, but:
+ *
+ *   - the string table is a small open-addressed hash of (prefix,char)
+ *     keys stamped with a 'generation', so a Clear costs a counter bump
+ *     instead of wiping the table;
+ *   - codes go into a 64-bit accumulator and leave it four bytes at a time;
+ *   - data sub-blocks are assembled in memory and fwrite()n in bulk.
+ *
+ * All state lives in a GIFENC, so nothing here is shared between calls.
+ */
 
-static unsigned long cur_accum = 0;
-static int           cur_bits = 0;
-
-
-
-
-#define min(a,b)        ((a>b) ? b : a)
-
-#define XV_BITS	12    /* BITS was already defined on some systems */
-#define MSDOS	1
-
-#define HSIZE  5003            /* 80% occupancy */
-
-typedef unsigned char   char_type;
+#define XV_BITS     12              /* max bits/code (BITS is taken on some
+				       systems) */
+#define MAXCODE(n)  ((1 << (n)) - 1)
 
+#define HT_BITS     13              /* 8192 slots for < 4096 strings */
+#define HT_SIZE     (1 << HT_BITS)
+#define HT_KEYBITS  20              /* 12-bit prefix code + 8-bit char */
+#define HT_MAXGEN   ((1 << (32 - HT_KEYBITS)) - 1)
 
-static int n_bits;                    /* number of bits/code */
-static int maxbits = XV_BITS;         /* user settable max # bits/code */
-static int maxcode;                   /* maximum code, given n_bits */
-static int maxmaxcode = 1 << XV_BITS; /* NEVER generate this */
+#define PKT_LEN     254             /* data bytes per GIF sub-block */
+#define OUTBUF_SIZE (64 * (PKT_LEN + 1))
 
-#define MAXCODE(n_bits)     ( (1 << (n_bits)) - 1)
+typedef struct {
+  FILE         *fp;
 
-static  count_int      htab [HSIZE];
-static  unsigned short codetab [HSIZE];
-#define HashTabOf(i)   htab[i]
-#define CodeTabOf(i)   codetab[i]
+  u_int         htkey[HT_SIZE];     /* key | generation<<HT_KEYBITS */
+  u_short       htcode[HT_SIZE];
+  u_int         gen;
 
-static int hsize = HSIZE;            /* for dynamic table sizing */
+  int           init_bits, n_bits, maxcode;
+  int           clear_code, eof_code, free_ent;
 
-/*
- * To save much memory, we overlay the table used by xv_compress() with those
- * used by decompress().  The tab_prefix table is the same size and type
- * as the codetab.  The tab_suffix table needs 2**BITS characters.  We
- * get this from the beginning of htab.  The output stack uses the rest
- * of htab, and contains characters.  There is plenty of room for any
- * possible stack (stack used to be 8000 characters).
- */
+  uint64_t      accum;              /* pending output bits, LSB first */
+  int           nacc;
 
-#define tab_prefixof(i) CodeTabOf(i)
-#define tab_suffixof(i)        ((char_type *)(htab))[i]
-#define de_stack               ((char_type *)&tab_suffixof(1<<XV_BITS))
+  byte          out[OUTBUF_SIZE];   /* finished sub-blocks */
+  int           outlen;
+  int           pktstart, pktlen;   /* sub-block being filled */
+} GIFENC;
 
-static int free_ent = 0;                  /* first unused entry */
+static void gifPutCode    PARM((GIFENC *, int));
+static void gifPutByte    PARM((GIFENC *, int));
+static void gifFlushBits  PARM((GIFENC *));
+static void gifFlushOut   PARM((GIFENC *, int));
+static void gifClearTable PARM((GIFENC *));
 
-/*
- * block compression parameters -- after all codes are used up,
- * and compression rate changes, start over.
- */
-static int clear_flg = 0;
 
-static long int in_count = 1;            /* length of input */
-static long int out_count = 0;           /* # of codes output (for debugging) */
+/********************************************************/
+static void xv_compress(int init_bits, FILE *outfile, byte *data, int len,
+			byte *pc2nc)
+{
+  GIFENC  *ge;
+  u_int    key, tag, slot;
+  int      ent, c;
 
-/*
- * compress stdin to stdout
- *
- * Algorithm:  use open addressing double hashing (no chaining) on the
- * prefix code / next character combination.  We do a variant of Knuth's
- * algorithm D (vol. 3, sec. 6.4) along with G. Knott's relatively-prime
- * secondary probe.  Here, the modular division first probe is gives way
- * to a faster exclusive-or manipulation.  Also do block compression with
- * an adaptive reset, whereby the code table is cleared when the compression
- * ratio decreases, but after the table fills.  The variable-length output
- * codes are re-sized at this point, and a special CLEAR code is generated
- * for the decompressor.  Late addition:  construct the table according to
- * file size for noticeable speed improvement on small files.  Please direct
- * questions about this implementation to ames!jaw.
- */
+  if (len <= 0) return;
 
-static int g_init_bits;
-static FILE *g_outfile;
+  ge = (GIFENC *) calloc((size_t) 1, sizeof(GIFENC));
+  if (!ge) FatalError("out of memory in WriteGIF()");
 
-static int ClearCode;
-static int EOFCode;
+  ge->fp         = outfile;
+  ge->init_bits  = init_bits;
+  ge->n_bits     = init_bits;
+  ge->maxcode    = MAXCODE(init_bits);
+  ge->clear_code = 1 << (init_bits - 1);
+  ge->eof_code   = ge->clear_code + 1;
+  ge->free_ent   = ge->clear_code + 2;
+  ge->gen        = 1;
+  ge->pktstart   = 0;
+  ge->outlen     = 1;               /* room for the first length byte */
 
+  gifPutCode(ge, ge->clear_code);
 
-/********************************************************/
-static void xv_compress(int init_bits, FILE *outfile, byte *data, int len)
-{
-  register long fcode;
-  register int i = 0;
-  register int c;
-  register int ent;
-  register int disp;
-  register int hsize_reg;
-  register int hshift;
-
-  /*
-   * Set up the globals:  g_init_bits - initial number of bits
-   *                      g_outfile   - pointer to output file
-   */
-  g_init_bits = init_bits;
-  g_outfile   = outfile;
-
-  /* initialize 'compress' globals */
-  maxbits = XV_BITS;
-  maxmaxcode = 1<<XV_BITS;
-  bzero((char *) htab,    sizeof(htab));
-  bzero((char *) codetab, sizeof(codetab));
-  hsize = HSIZE;
-  free_ent = 0;
-  clear_flg = 0;
-  in_count = 1;
-  out_count = 0;
-  cur_accum = 0;
-  cur_bits = 0;
-
-
-  /*
-   * Set up the necessary values
-   */
-  out_count = 0;
-  clear_flg = 0;
-  in_count = 1;
-  maxcode = MAXCODE(n_bits = g_init_bits);
-
-  ClearCode = (1 << (init_bits - 1));
-  EOFCode = ClearCode + 1;
-  free_ent = ClearCode + 2;
-
-  char_init();
   ent = pc2nc[*data++];  len--;
 
-  hshift = 0;
-  for ( fcode = (long) hsize;  fcode < 65536L; fcode *= 2L )
-    hshift++;
-  hshift = 8 - hshift;                /* set hash code range bound */
-
-  hsize_reg = hsize;
-  cl_hash( (count_int) hsize_reg);            /* clear hash table */
-
-  output(ClearCode);
-
   while (len) {
     c = pc2nc[*data++];  len--;
-    in_count++;
-
-    fcode = (long) ( ( (long) c << maxbits) + ent);
-    i = (((int) c << hshift) ^ ent);    /* xor hashing */
-
-    if ( HashTabOf (i) == fcode ) {
-      ent = CodeTabOf (i);
-      continue;
-    }
 
-    else if ( (long)HashTabOf (i) < 0 )      /* empty slot */
-      goto nomatch;
+    key  = ((u_int) ent << 8) | (u_int) c;
+    tag  = key | (ge->gen << HT_KEYBITS);
+    slot = (key * 2654435761U) >> (32 - HT_BITS);
 
-    disp = hsize_reg - i;           /* secondary hash (after G. Knott) */
-    if ( i == 0 )
-      disp = 1;
+    while (ge->htkey[slot] != tag &&
+	   (ge->htkey[slot] >> HT_KEYBITS) == ge->gen)
+      slot = (slot + 1) & (HT_SIZE - 1);
 
-probe:
-    if ( (i -= disp) < 0 )
-      i += hsize_reg;
-
-    if ( HashTabOf (i) == fcode ) {
-      ent = CodeTabOf (i);
+    if (ge->htkey[slot] == tag) {   /* string's in the table:  extend it */
+      ent = ge->htcode[slot];
       continue;
     }
 
-    if ( (long)HashTabOf (i) >= 0 )
-      goto probe;
-
-nomatch:
-    output(ent);
-    out_count++;
+    gifPutCode(ge, ent);
     ent = c;
 
-    if ( free_ent < maxmaxcode ) {
-      CodeTabOf (i) = free_ent++; /* code -> hashtable */
-      HashTabOf (i) = fcode;
+    if (ge->free_ent < (1 << XV_BITS)) {
+      ge->htkey[slot]  = tag;
+      ge->htcode[slot] = (u_short) ge->free_ent++;
     }
-    else
-      cl_block();
+    else gifClearTable(ge);
   }
 
-  /* Put out the final code */
-  output(ent);
-  out_count++;
-  output(EOFCode);
-}
+  gifPutCode(ge, ent);
+  gifPutCode(ge, ge->eof_code);
 
+  gifFlushBits(ge);
+  if (ge->pktlen) ge->out[ge->pktstart] = (byte) ge->pktlen;
+  else ge->outlen--;                /* unused length byte */
+  gifFlushOut(ge, 1);
+  fflush(outfile);
 
-/*****************************************************************
- * TAG( output )
- *
- * Output the given code.
- * Inputs:
- *      code:   A n_bits-bit integer.  If == -1, then EOF.  This assumes
- *              that n_bits =< (long)wordsize - 1.
- * Outputs:
- *      Outputs code to the file.
- * Assumptions:
- *      Chars are 8 bits long.
- * Algorithm:
- *      Maintain a BITS character long buffer (so that 8 codes will
- * fit in it exactly).  Use the VAX insv instruction to insert each
- * code in turn.  When the buffer fills up empty it and start over.
- */
+  free(ge);
+}
 
-static
-unsigned long masks[] = { 0x0000, 0x0001, 0x0003, 0x0007, 0x000F,
-                                  0x001F, 0x003F, 0x007F, 0x00FF,
-                                  0x01FF, 0x03FF, 0x07FF, 0x0FFF,
-                                  0x1FFF, 0x3FFF, 0x7FFF, 0xFFFF };
 
-static void output(int code)
+/********************************************************/
+static void gifPutCode(GIFENC *ge, int code)
 {
-  cur_accum &= masks[cur_bits];
-
-  if (cur_bits > 0)
-    cur_accum |= ((long)code << cur_bits);
-  else
-    cur_accum = code;
-
-  cur_bits += n_bits;
-
-  while( cur_bits >= 8 ) {
-    char_out( (int) (cur_accum & 0xff) );
-    cur_accum >>= 8;
-    cur_bits -= 8;
+  /* appends an n_bits-wide code, then widens n_bits if the next entry
+     won't fit (or resets it after a Clear) */
+
+  ge->accum |= (uint64_t) code << ge->nacc;
+  ge->nacc  += ge->n_bits;
+
+  if (ge->nacc >= 32) {
+    gifPutByte(ge, (int) (ge->accum       & 0xff));
+    gifPutByte(ge, (int) (ge->accum >>  8 & 0xff));
+    gifPutByte(ge, (int) (ge->accum >> 16 & 0xff));
+    gifPutByte(ge, (int) (ge->accum >> 24 & 0xff));
+    ge->accum >>= 32;
+    ge->nacc   -= 32;
   }
 
-  /*
-   * If the next entry is going to be too big for the code size,
-   * then increase it, if possible.
-   */
-
-  if (free_ent > maxcode || clear_flg) {
-
-    if( clear_flg ) {
-      maxcode = MAXCODE (n_bits = g_init_bits);
-      clear_flg = 0;
-    }
-    else {
-      n_bits++;
-      if ( n_bits == maxbits )
-	maxcode = maxmaxcode;
-      else
-	maxcode = MAXCODE(n_bits);
-    }
+  if (code == ge->clear_code) {
+    ge->n_bits  = ge->init_bits;
+    ge->maxcode = MAXCODE(ge->init_bits);
+  }
+  else if (ge->free_ent > ge->maxcode && ge->n_bits < XV_BITS) {
+    ge->n_bits++;
+    ge->maxcode = (ge->n_bits == XV_BITS) ? (1 << XV_BITS)
+					  : MAXCODE(ge->n_bits);
   }
+}
 
-  if( code == EOFCode ) {
-    /* At EOF, write the rest of the buffer */
-    while( cur_bits > 0 ) {
-      char_out( (int)(cur_accum & 0xff) );
-      cur_accum >>= 8;
-      cur_bits -= 8;
-    }
 
-    flush_char();
+/********************************************************/
+static void gifPutByte(GIFENC *ge, int c)
+{
+  /* adds a byte to the current sub-block, closing it off at PKT_LEN */
 
-    fflush( g_outfile );
+  ge->out[ge->outlen++] = (byte) c;
 
-#ifdef FOO
-    if( ferror( g_outfile ) )
-      FatalError("unable to write GIF file");
-#endif
+  if (++ge->pktlen == PKT_LEN) {
+    ge->out[ge->pktstart] = (byte) PKT_LEN;
+    ge->pktstart = ge->outlen++;    /* length byte for the next one */
+    ge->pktlen   = 0;
+    if (ge->outlen > OUTBUF_SIZE - (PKT_LEN + 1)) gifFlushOut(ge, 0);
   }
 }
 
 
-/********************************/
-static void cl_block (void)             /* table clear for block compress */
+/********************************************************/
+static void gifFlushBits(GIFENC *ge)
 {
-  /* Clear out the hash table */
-
-  cl_hash ( (count_int) hsize );
-  free_ent = ClearCode + 2;
-  clear_flg = 1;
+  /* pads the last partial byte out with zeroes */
 
-  output(ClearCode);
+  while (ge->nacc > 0) {
+    gifPutByte(ge, (int) (ge->accum & 0xff));
+    ge->accum >>= 8;
+    ge->nacc   -= 8;
+  }
+  ge->accum = 0;  ge->nacc = 0;
 }
 
 
-/********************************/
-static void cl_hash(register count_int hsize)          /* reset code table */
+/********************************************************/
+static void gifFlushOut(GIFENC *ge, int final)
 {
-  register count_int *htab_p = htab+hsize;
-  register long i;
-  register long m1 = -1;
-
-  i = hsize - 16;
-  do {                            /* might use Sys V memset(3) here */
-    *(htab_p-16) = m1;
-    *(htab_p-15) = m1;
-    *(htab_p-14) = m1;
-    *(htab_p-13) = m1;
-    *(htab_p-12) = m1;
-    *(htab_p-11) = m1;
-    *(htab_p-10) = m1;
-    *(htab_p-9) = m1;
-    *(htab_p-8) = m1;
-    *(htab_p-7) = m1;
-    *(htab_p-6) = m1;
-    *(htab_p-5) = m1;
-    *(htab_p-4) = m1;
-    *(htab_p-3) = m1;
-    *(htab_p-2) = m1;
-    *(htab_p-1) = m1;
-    htab_p -= 16;
-  } while ((i -= 16) >= 0);
-
-  for ( i += 16; i > 0; i-- )
-    *--htab_p = m1;
-}
+  /* writes out the completed sub-blocks, keeping the one being filled
+     unless this is the 'final' flush */
 
+  int keep;
 
-/******************************************************************************
- *
- * GIF Specific routines
- *
- ******************************************************************************/
-
-/*
- * Number of characters so far in this 'packet'
- */
-static int a_count;
+  keep = final ? 0 : ge->outlen - ge->pktstart;
 
-/*
- * Set up the 'byte output' routine
- */
-static void char_init(void)
-{
-	a_count = 0;
+  fwrite(ge->out, (size_t) 1, (size_t) (ge->outlen - keep), ge->fp);
+  if (keep) memmove(ge->out, ge->out + ge->pktstart, (size_t) keep);
+  ge->pktstart = 0;
+  ge->outlen   = keep;
 }
 
-/*
- * Define the storage for the packet accumulator
- */
-static char accum[ 256 ];
 
-/*
- * Add a character to the end of the current packet, and if it is 254
- * characters, flush the packet to disk.
- */
-static void char_out(int c)
+/********************************************************/
+static void gifClearTable(GIFENC *ge)
 {
-  accum[ a_count++ ] = c;
-  if( a_count >= 254 )
-    flush_char();
-}
+  /* table's full:  send a Clear, and start over with an empty table */
 
-/*
- * Flush the packet to disk, and reset the accumulator
- */
-static void flush_char(void)
-{
-  if( a_count > 0 ) {
-    fputc(a_count, g_outfile );
-    fwrite(accum, (size_t) 1, (size_t) a_count, g_outfile );
-    a_count = 0;
+  gifPutCode(ge, ge->clear_code);
+  ge->free_ent = ge->clear_code + 2;
+
+  if (++ge->gen > HT_MAXGEN) {      /* stamps wrapped:  really clear it */
+    bzero((char *) ge->htkey, sizeof(ge->htkey));
+    ge->gen = 1;
   }
 }
@@ -6,6 +6,7 @@
  *  Contains:
  *     int Grab()             - handles the GRAB command
  *     int LoadGrab();        - 'loads' the pic from the last succesful Grab
+ *     int GrabSeqName();     - checks/expands the '-record' name template
  *
  */
 
@@ -14,6 +15,12 @@
 #define NEEDSTIME
 #include "xv.h"
 
+#ifdef HAVE_XSHM
+#  include <sys/ipc.h>
+#  include <sys/shm.h>
+#  include <X11/extensions/XShm.h>
+#endif
+
 /* Allow flexibility in use of buttons JPD */
 #define WINDOWGRABMASK Button1Mask  /* JPD prefers Button2Mask */
 #define RECTGTRACKMASK Button2Mask  /* JPD prefers Button1Mask*/
@@ -44,6 +51,24 @@ static int              hidewins = 0;
 static GC               rootGC;
 static struct rectlist *regrabList;
 
+#ifdef HAVE_XSHM
+static XShmSegmentInfo  shmInfo;
+static XImage          *shmImage = (XImage *) NULL;
+static Visual          *shmVisual;
+static int              shmAttached = 0;
+static int              shmState = 0;   /* 0: untried, 1: works, -1: doesn't */
+static int              shmFailed;
+#endif
+
+/* shared state for the unpackWorker()s */
+typedef struct { XImage *image;
+		 int     gx, gy;           /* where it goes in grabPic */
+		 int     ro, go, bo;       /* byte offsets of r,g,b in a pixel */
+		 int     nunits, next;     /* ParallelNext() counter */
+	       } UNPACKPAR;
+
+#define UNPACKROWS 64                  /* rows per unit of work */
+
 
 static void   flashrect           PARM((int, int, int, int, int));
 static void   startflash          PARM((void));
@@ -61,6 +86,21 @@ static int    convertImageAndStuff PARM((XImage *, XColor *, int,
 					 XWindowAttributes *,
 					 int,int,int,int));
 
+static void   unpack32            PARM((XImage *, int, int, int, int, int));
+static void   unpackWorker        PARM((void *, int));
+static XImage *getImage           PARM((Window, XWindowAttributes *,
+					int, int, int, int));
+static void   putImage            PARM((XImage *));
+static void   freeRegrabList      PARM((void));
+static void   recordRegion        PARM((void));
+
+#ifdef HAVE_XSHM
+static XImage *shmGetImage        PARM((Window, XWindowAttributes *,
+					int, int, int, int));
+static void   shmRelease          PARM((void));
+static int    shmErrorHandler     PARM((Display *, XErrorEvent *));
+#endif
+
 static int    RectIntersect       PARM((int,int,int,int, int,int,int,int));
 
 static int    CountColors24       PARM((byte *, int, int,
@@ -348,6 +388,8 @@ int Grab(void)
   if (!autograb) XGrabServer(theDisp);	 /* until we've done the grabImage */
   rv = grabRootRegion(ix, iy, iw, ih);   /* ungrabs the server & button */
 
+  if (rv && recFrames) recordRegion();
+
   SetCursors(-1);
 
  exit:
@@ -669,20 +711,14 @@ static int grabRootRegion(int x, int y, int w, int h)
   i = grabWinImage(rootW, XVisualIDFromVisual(xwa.visual), xwa.colormap,0);
 
   ungrabX();
+#ifdef HAVE_XSHM
+  shmRelease();
+#endif
 
   XBell(theDisp, 0);    /* beep twice at end of grab */
   XBell(theDisp, 0);
 
-  { /* free regrabList */
-    struct rectlist *rr, *tmprr;
-    rr = regrabList;
-    while (rr) {
-      tmprr = rr->next;
-      free((char *) rr);
-      rr = tmprr;
-    }
-    regrabList = (struct rectlist *) NULL;
-  }
+  freeRegrabList();
 
   if (i) {
     ErrPopUp("Warning: Problems occurred during grab.","\nWYSInWYG!");
@@ -828,14 +864,13 @@ static int grabWinImage(Window win, VisualID parentVid, Colormap parentCmap, int
     WaitCursor();
 
     xerrcode = 0;
-    image = XGetImage(theDisp, win, ix, iy, (u_int) gw, (u_int) gh,
-		      AllPlanes, ZPixmap);
+    image = getImage(win, &xwa, ix, iy, gw, gh);
     if (xerrcode || !image || !image->data) return 1;
 
     ncolors = getxcolors(&xwa, &colors);
     rv = convertImageAndStuff(image, colors, ncolors, &xwa,
 			      gx - gXOFF, gy - gYOFF, gw, gh);
-    XDestroyImage(image);   /* can't use xvDestroyImage: alloc'd by X! */
+    putImage(image);
     if (colors) free((char *) colors);
   }
 
@@ -974,6 +1009,17 @@ static int convertImageAndStuff(XImage *image, XColor *colors, int ncolors, XWin
   }
 
 
+  /* the usual case these days:  TrueColor, 32 bits per pixel, 8 bits per
+     component.  Each component is just a byte at a fixed offset */
+  if (visual->class == TrueColor && image->bits_per_pixel == 32 &&
+      (rmask >> rshift) == 0xff && (gmask >> gshift) == 0xff &&
+      (bmask >> bshift) == 0xff &&
+      !(rshift & 7) && !(gshift & 7) && !(bshift & 7)) {
+    unpack32(image, gx, gy, rshift, gshift, bshift);
+    return 0;
+  }
+
+
   bits_per_item  = image->bitmap_unit;
   bits_per_pixel = image->bits_per_pixel;
 
@@ -1115,6 +1161,326 @@ static int convertImageAndStuff(XImage *image, XColor *colors, int ncolors, XWin
 
 
 
+/**************************************/
+static void unpack32(XImage *image, int gx, int gy, int rshift, int gshift, int bshift)
+{
+  /* fast path of convertImageAndStuff():  copies a 32-bit TrueColor image
+     with 8-bit components into grabPic at gx,gy, in bands of rows handed
+     out to ParallelRun() workers */
+
+  UNPACKPAR up;
+
+  /* offsets of the components within each 4-byte pixel.  these depend only
+     on the image's byte order, not the machine's */
+  if (image->byte_order == LSBFirst) {
+    up.ro = rshift/8;  up.go = gshift/8;  up.bo = bshift/8;
+  }
+  else {
+    up.ro = 3 - rshift/8;  up.go = 3 - gshift/8;  up.bo = 3 - bshift/8;
+  }
+
+  up.image = image;  up.gx = gx;  up.gy = gy;
+  up.nunits = (image->height + UNPACKROWS - 1) / UNPACKROWS;
+  up.next   = 0;
+
+  ParallelRun(ParallelWorkers(up.nunits), unpackWorker, (void *) &up);
+}
+
+
+/**************************************/
+static void unpackWorker(void *data, int worker)
+{
+  UNPACKPAR *up = (UNPACKPAR *) data;
+  XImage    *image = up->image;
+  int        band, y, y1, x, w, ro, go, bo;
+  byte      *sp, *dp;
+
+  XV_UNUSED(worker);
+
+  w  = image->width;
+  ro = up->ro;  go = up->go;  bo = up->bo;
+
+  while ((band = ParallelNext(&up->next, up->nunits)) >= 0) {
+    y  = band * UNPACKROWS;
+    y1 = y + UNPACKROWS;
+    if (y1 > image->height) y1 = image->height;
+
+    for ( ; y<y1; y++) {
+      sp = (byte *) image->data + (size_t) y * image->bytes_per_line;
+      dp = grabPic + ((size_t) (y + up->gy) * gWIDE + up->gx) * 3;
+
+      if (ro==2 && go==1 && bo==0) {     /* BGRX, nearly everyone's.  constant
+					   offsets let the compiler vectorize */
+	for (x=0; x<w; x++, sp+=4, dp+=3) {
+	  dp[0] = sp[2];  dp[1] = sp[1];  dp[2] = sp[0];
+	}
+      }
+      else {
+	for (x=0; x<w; x++, sp+=4, dp+=3) {
+	  dp[0] = sp[ro];  dp[1] = sp[go];  dp[2] = sp[bo];
+	}
+      }
+    }
+  }
+}
+
+
+/**************************************/
+static XImage *getImage(Window win, XWindowAttributes *xwap, int x, int y, int w, int h)
+{
+  /* XGetImage(), or XShmGetImage() where that works.  The image must be
+     given back with putImage() */
+
+  XImage *image;
+
+#ifdef HAVE_XSHM
+  image = shmGetImage(win, xwap, x, y, w, h);
+  if (image) return image;
+#else
+  XV_UNUSED(xwap);
+#endif
+
+  image = XGetImage(theDisp, win, x, y, (u_int) w, (u_int) h,
+		    AllPlanes, ZPixmap);
+  return image;
+}
+
+
+/**************************************/
+static void putImage(XImage *image)
+{
+#ifdef HAVE_XSHM
+  if (image == shmImage) return;     /* kept for the next grab */
+#endif
+
+  XDestroyImage(image);   /* can't use xvDestroyImage: alloc'd by X! */
+}
+
+
+#ifdef HAVE_XSHM
+/**************************************/
+static XImage *shmGetImage(Window win, XWindowAttributes *xwap, int x, int y, int w, int h)
+{
+  /* reads the area through a MIT-SHM shared memory segment, which saves
+     pushing the whole thing through the X socket.  Only bothers with
+     TrueColor windows, which is where the big grabs happen.  The segment
+     is kept (until shmRelease()) so that recording the same area over and
+     over doesn't set it up every time.  Returns NULL if it didn't work,
+     and the caller should use XGetImage() instead */
+
+  XErrorHandler oldh;
+  int           ok;
+
+  if (shmState < 0 || xwap->visual->class != TrueColor) return NULL;
+  if (!shmState) shmState = (XShmQueryExtension(theDisp)) ? 1 : -1;
+  if (shmState < 0) return NULL;
+
+  if (shmImage && (shmImage->width != w || shmImage->height != h ||
+		   shmImage->depth != xwap->depth || shmVisual != xwap->visual))
+    shmRelease();
+
+  if (!shmImage) {
+    shmImage = XShmCreateImage(theDisp, xwap->visual, (u_int) xwap->depth,
+			       ZPixmap, (char *) NULL, &shmInfo,
+			       (u_int) w, (u_int) h);
+    if (!shmImage) return NULL;
+    shmVisual = xwap->visual;
+
+    shmInfo.shmid = shmget(IPC_PRIVATE,
+			   (size_t) shmImage->bytes_per_line * h,
+			   IPC_CREAT | 0600);
+    if (shmInfo.shmid < 0) { shmRelease();  return NULL; }
+
+    shmInfo.shmaddr = (char *) shmat(shmInfo.shmid, (void *) NULL, 0);
+    if (shmInfo.shmaddr == (char *) -1) {
+      shmctl(shmInfo.shmid, IPC_RMID, (struct shmid_ds *) NULL);
+      shmRelease();
+      return NULL;
+    }
+    shmImage->data   = shmInfo.shmaddr;
+    shmInfo.readOnly = False;
+
+    /* attaching fails (BadAccess) when the server is on another machine.
+       Don't let xvErrorHandler() take that as fatal */
+    XSync(theDisp, False);
+    shmFailed = 0;
+    oldh = XSetErrorHandler(shmErrorHandler);
+    XShmAttach(theDisp, &shmInfo);
+    XSync(theDisp, False);
+    XSetErrorHandler(oldh);
+
+    /* the segment goes away once both sides have detached */
+    shmctl(shmInfo.shmid, IPC_RMID, (struct shmid_ds *) NULL);
+
+    if (shmFailed) {
+      if (DEBUG) fprintf(stderr,"Grab: can't attach MIT-SHM segment\n");
+      shmState = -1;
+      shmRelease();
+      return NULL;
+    }
+    shmAttached = 1;
+  }
+
+  /* the area may not all be readable (window partly off-screen, etc.)
+     that's a BadMatch on a request xvErrorHandler() doesn't know about */
+  XSync(theDisp, False);
+  shmFailed = 0;
+  oldh = XSetErrorHandler(shmErrorHandler);
+  ok = XShmGetImage(theDisp, win, shmImage, x, y, AllPlanes);
+  XSetErrorHandler(oldh);
+
+  return (ok && !shmFailed) ? shmImage : (XImage *) NULL;
+}
+
+
+/**************************************/
+static void shmRelease(void)
+{
+  if (!shmImage) return;
+
+  if (shmAttached) {
+    XShmDetach(theDisp, &shmInfo);
+    XSync(theDisp, False);
+    shmAttached = 0;
+  }
+
+  if (shmImage->data) shmdt(shmImage->data);
+  shmImage->data = (char *) NULL;
+  XDestroyImage(shmImage);
+  shmImage = (XImage *) NULL;
+}
+
+
+/**************************************/
+static int shmErrorHandler(Display *disp, XErrorEvent *err)
+{
+  XV_UNUSED(disp);
+  XV_UNUSED(err);
+
+  shmFailed = 1;
+  return 0;
+}
+#endif /* HAVE_XSHM */
+
+
+/***********************************/
+static void freeRegrabList(void)
+{
+  struct rectlist *rr, *tmprr;
+
+  rr = regrabList;
+  while (rr) {
+    tmprr = rr->next;
+    free((char *) rr);
+    rr = tmprr;
+  }
+  regrabList = (struct rectlist *) NULL;
+}
+
+
+/***********************************/
+static void recordRegion(void)
+{
+  /* after a successful grab, grabs the same area again 'recFrames' times,
+     at least 'recDelay' msec apart, and writes each frame as a raw PPM
+     file named by the 'recName' template.  The grabbed image itself is
+     left alone.  Holding down Button3 stops it early */
+
+  byte              *savePic;
+  int                saveType, frame, rv, rx, ry, x1, y1;
+  char               fname[MAXPATHLEN+1], errstr[MAXPATHLEN+64];
+  FILE              *fp;
+  Window             rW, cW;
+  unsigned int       mask;
+  XWindowAttributes  xwa;
+
+  savePic  = grabPic;
+  saveType = gptype;
+
+  grabPic = (byte *) malloc((size_t) gWIDE * gHIGH * 3);
+  if (!grabPic) {
+    grabPic = savePic;
+    ErrPopUp("Unable to malloc() space for recorded frames!", "\nBite Me!");
+    return;
+  }
+
+  errstr[0] = '\0';
+  for (frame=1; frame<=recFrames; frame++) {
+    if (frame>1) Timer(recDelay);
+
+    if (XQueryPointer(theDisp,rootW,&rW,&cW,&rx,&ry,&x1,&y1,&mask) &&
+	(mask & CANCELGRABMASK)) break;
+
+    WaitCursor();
+
+    rv = !XGetWindowAttributes(theDisp, rootW, &xwa);
+    if (!rv) {
+      regrabList = (struct rectlist *) NULL;
+      rv = grabWinImage(rootW, XVisualIDFromVisual(xwa.visual),
+			xwa.colormap, 0);
+      freeRegrabList();
+    }
+    if (rv) {
+      sprintf(errstr, "Problems occurred grabbing frame %d.", frame);
+      break;
+    }
+
+    GrabSeqName(recName, frame, fname, sizeof(fname));
+    fp = xv_fopen(fname, "w");
+    if (fp) {
+      fprintf(fp, "P6\n%d %d\n255\n", gWIDE, gHIGH);
+      fwrite(grabPic, (size_t) 3, (size_t) gWIDE * gHIGH, fp);
+      if (ferror(fp)) rv = 1;
+      if (fclose(fp) == EOF) rv = 1;
+    }
+    if (!fp || rv) {
+      sprintf(errstr, "Can't write frame %d to '%s'.", frame, fname);
+      break;
+    }
+  }
+
+#ifdef HAVE_XSHM
+  shmRelease();
+#endif
+
+  free(grabPic);
+  grabPic = savePic;
+  gptype  = saveType;
+
+  if (errstr[0]) ErrPopUp(errstr, "\nBummer!");
+  else { XBell(theDisp, 0);  XBell(theDisp, 0); }
+}
+
+
+/***********************************/
+int GrabSeqName(const char *tmpl, int n, char *buf, size_t len)
+{
+  /* checks that the '-record' template 'tmpl' has exactly one printf()
+     conversion, and that it's an integer one ('%d', '%04d', ...).  If so,
+     and 'buf' isn't NULL, puts the name of frame 'n' in it.
+     returns '0' if the template is no good */
+
+  const char *p;
+  int         nconv;
+
+  if (!tmpl || !*tmpl) return 0;
+
+  for (p=tmpl, nconv=0; *p; p++) {
+    if (*p != '%') continue;
+    if (p[1] == '%') { p++;  continue; }
+
+    for (p++; *p>='0' && *p<='9'; p++);
+    if (*p != 'd') return 0;
+    nconv++;
+  }
+
+  if (nconv != 1) return 0;
+
+  if (buf) snprintf(buf, len, tmpl, n);
+  return 1;
+}
+
+
 /***********************************/
 static int RectIntersect(int ax, int ay, int aw, int ah, int bx, int by, int bw, int bh)
 {
@@ -12,6 +12,7 @@
  *   Str2Graf()         -  parses an xrdb string into GRAF settings
  *   GetGrafState()     -  copies GRAF data into GRAF_STATE structure
  *   SetGrafState()     -  sets GRAF data based on GRAF_STATE
+ *   GrafFunc()         -  evaluates the GRAF's function between its points
  *   InitSpline()       -  called to generate y' table for EvalSpline
  *   EvalSpline()       -  evalutes spline function at given point
  */
@@ -842,6 +843,33 @@ int SetGrafState(GRAF *gp, GRAF_STATE *gsp)
 }
 
 
+/*********************/
+double GrafFunc(GRAF *gp, double x)
+{
+  /* returns the GRAF's output function at 'x' (0.0 - 255.0), which needn't
+     be a whole number:  a gamma function is computed exactly, and the
+     others are interpolated between their whole-number points */
+
+  int i;
+
+  if (x < 0.0)   x = 0.0;
+  if (x > 255.0) x = 255.0;
+
+  if (gp->gammamode) {
+    if (gp->gamma > 0.0)
+      return pow(x / 255.0, 1.0 / gp->gamma) * 255.0;
+    if (gp->gamma < 0.0)   /* stored in reverse order */
+      return pow((255.0 - x) / 255.0, 1.0 / -gp->gamma) * 255.0;
+    return 0.0;
+  }
+
+  i = (int) x;
+  if (i >= 255) return (double) gp->func[255];
+  return gp->func[i] + (x - i) * ((int) gp->func[i+1] - gp->func[i]);
+}
+
+
+
 /*********************/
 void InitSpline(int *x, int *y, int n, double *y2)
 {
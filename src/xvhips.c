@@ -33,9 +33,16 @@
 #define LINES 100
 #define LINELENGTH 132
 
-static int   fread_header(int fd, struct header *hd);
+/* header line buffers, one set per LoadHIPS() call */
+typedef struct {
+  char *ssave[LINES];
+  int   slmax[LINES];
+  int   lalloc;
+} HIPSLINES;
+
+static int   fread_header(HIPSLINES *hl, int fd, struct header *hd);
 static char  *xvh_getline(int fd, char **s, int *l);
-static int   dfscanf(int fd);
+static int   dfscanf(HIPSLINES *hl, int fd);
 static void  make_grayscale(unsigned char *r, unsigned char *g, 
 			    unsigned char *b);
 static float hls_value (float n1, float n2, float hue);
@@ -55,79 +62,76 @@ static int   load_colourmap(const char *filestem, int max_colours,
  *
  ************************************************************************/
 
-static char *ssave[LINES];
-static int slmax[LINES];
-static int lalloc = 0;
 /* extern char *calloc(); */
 
 
 
-static int fread_header(int fd, struct header *hd)
+static int fread_header(HIPSLINES *hl, int fd, struct header *hd)
 {
   int lineno, len, i;
   char *s;
 
 /*fprintf(stderr,"fread_header: entered\n");*/
-  if(lalloc<1) {
-    ssave[0] = calloc(LINELENGTH, sizeof (char));
-    slmax[0] = LINELENGTH;
-    lalloc = 1;
+  if(hl->lalloc<1) {
+    hl->ssave[0] = calloc(LINELENGTH, sizeof (char));
+    hl->slmax[0] = LINELENGTH;
+    hl->lalloc = 1;
   }
 /*fprintf(stderr,"fread_header: ssave allocated\n");*/
-  xvh_getline(fd,&ssave[0],&slmax[0]);
-  hd->orig_name = calloc(strlen(ssave[0])+1, sizeof (char));
-  strcpy(hd->orig_name,ssave[0]);
-  xvh_getline(fd,&ssave[0],&slmax[0]);
-  hd->seq_name = calloc(strlen(ssave[0])+1, sizeof (char));
-  strcpy(hd->seq_name,ssave[0]);
-  hd->num_frame = dfscanf(fd);
-  xvh_getline(fd,&ssave[0],&slmax[0]);
-  hd->orig_date = calloc(strlen(ssave[0])+1, sizeof (char));
-  strcpy(hd->orig_date,ssave[0]);
-  hd->rows = dfscanf(fd);
-  hd->cols = dfscanf(fd);
-  hd->bits_per_pixel = dfscanf(fd);
-  hd->bit_packing = dfscanf(fd);
-  hd->pixel_format = dfscanf(fd);
+  xvh_getline(fd,&hl->ssave[0],&hl->slmax[0]);
+  hd->orig_name = calloc(strlen(hl->ssave[0])+1, sizeof (char));
+  strcpy(hd->orig_name,hl->ssave[0]);
+  xvh_getline(fd,&hl->ssave[0],&hl->slmax[0]);
+  hd->seq_name = calloc(strlen(hl->ssave[0])+1, sizeof (char));
+  strcpy(hd->seq_name,hl->ssave[0]);
+  hd->num_frame = dfscanf(hl, fd);
+  xvh_getline(fd,&hl->ssave[0],&hl->slmax[0]);
+  hd->orig_date = calloc(strlen(hl->ssave[0])+1, sizeof (char));
+  strcpy(hd->orig_date,hl->ssave[0]);
+  hd->rows = dfscanf(hl, fd);
+  hd->cols = dfscanf(hl, fd);
+  hd->bits_per_pixel = dfscanf(hl, fd);
+  hd->bit_packing = dfscanf(hl, fd);
+  hd->pixel_format = dfscanf(hl, fd);
   lineno = 0;
   len = 1;
-  xvh_getline(fd,&ssave[0],&slmax[0]);
-  s = ssave[0];
+  xvh_getline(fd,&hl->ssave[0],&hl->slmax[0]);
+  s = hl->ssave[0];
   while(*(s += strlen(s)-3) == '|') {
-    len += strlen(ssave[lineno]);
+    len += strlen(hl->ssave[lineno]);
     lineno++;
     if (lineno >= LINES)
       fprintf(stderr, "Too many lines in header history");
-    if(lineno >= lalloc) {
-      ssave[lineno] = calloc(LINELENGTH, sizeof (char));
-      slmax[lineno] = LINELENGTH;
-      lalloc++;
+    if(lineno >= hl->lalloc) {
+      hl->ssave[lineno] = calloc(LINELENGTH, sizeof (char));
+      hl->slmax[lineno] = LINELENGTH;
+      hl->lalloc++;
     }
-    xvh_getline(fd,&ssave[lineno],&slmax[lineno]);
-    s = ssave[lineno];
+    xvh_getline(fd,&hl->ssave[lineno],&hl->slmax[lineno]);
+    s = hl->ssave[lineno];
   }
-  len += strlen(ssave[lineno]);
+  len += strlen(hl->ssave[lineno]);
   hd->seq_history = calloc(len, sizeof (char));
   hd->seq_history[0] = '\0';
   for (i=0;i<=lineno;i++)
-    strcat(hd->seq_history,ssave[i]);
+    strcat(hd->seq_history,hl->ssave[i]);
   lineno = 0;
   len = 1;
-  while(strcmp(xvh_getline(fd,&ssave[lineno],&slmax[lineno]),".\n")) {
-    len += strlen(ssave[lineno]);
+  while(strcmp(xvh_getline(fd,&hl->ssave[lineno],&hl->slmax[lineno]),".\n")) {
+    len += strlen(hl->ssave[lineno]);
     lineno++;
     if (lineno >= LINES)
       fprintf(stderr, "Too many lines in header desc.");
-    if(lineno >= lalloc) {
-      ssave[lineno] = calloc(LINELENGTH, sizeof (char));
-      slmax[lineno] = LINELENGTH;
-      lalloc++;
+    if(lineno >= hl->lalloc) {
+      hl->ssave[lineno] = calloc(LINELENGTH, sizeof (char));
+      hl->slmax[lineno] = LINELENGTH;
+      hl->lalloc++;
     }
   }
   hd->seq_desc = calloc(len, sizeof (char));
   *hd->seq_desc = '\0';
   for (i=0;i<lineno;i++)
-    strcat(hd->seq_desc,ssave[i]);
+    strcat(hd->seq_desc,hl->ssave[i]);
 /*fprintf(stderr,"fread_header: exiting\n");*/
   return 0;
 }
@@ -166,12 +170,12 @@ static char *xvh_getline(int fd, char **s, int *l)
 
 
 
-static int dfscanf(int fd)
+static int dfscanf(HIPSLINES *hl, int fd)
 {
   int i;
 
-  xvh_getline(fd,&ssave[0],&slmax[0]);
-  sscanf(ssave[0],"%d",&i);
+  xvh_getline(fd,&hl->ssave[0],&hl->slmax[0]);
+  sscanf(hl->ssave[0],"%d",&i);
   return(i);
 }
 
@@ -184,12 +188,18 @@ int LoadHIPS(char *fname, PICINFO *pinfo)
   FILE  *fp;
   struct header h;
   byte * pic;
+  HIPSLINES hl;
+  int   i, rv;
 
   /* open the stream, if necesary */
   fp=fopen(fname,"r");
   if (!fp) return 0;
 
-  if (!fread_header(fileno(fp), &h)) {
+  hl.lalloc = 0;
+  rv = fread_header(&hl, fileno(fp), &h);
+  for (i=0; i<hl.lalloc; i++) free(hl.ssave[i]);
+
+  if (!rv) {
     SetISTR(ISTR_WARNING,"Can't read HIPS header");
     return 0;
   }
@@ -37,8 +37,6 @@
 
 #include "xv.h"
 
-static long filesize;
-
 /* static int           readID       PARM((FILE *, char *));  DOES NOT EXIST */
 static int           iffError     PARM((const char *, const char *));
 static void          decomprle    PARM((byte *, byte *, long, long));
@@ -46,9 +44,6 @@ static unsigned int  iff_getword  PARM((byte *));
 static unsigned long iff_getlong  PARM((byte *));
 
 
-static const char *bname;
-
-
 /* Define internal ILBM types */
 #define ILBM_NORMAL     0
 #define ILBM_EHB        1
@@ -76,6 +71,8 @@ int LoadIFF(char *fname, PICINFO *pinfo)
   long          chunkLen, camg_viewmode;
   byte          *databuf, *dataptr, *cmapptr, *picptr, *pic, *bodyptr;
   byte          *workptr, *workptr2, *workptr3, *decomp_mem;
+  long          filesize;
+  const char    *bname;
 
   BMHDok = CAMGok = bmhd_width = bmhd_height = bmhd_bitplanes = colors = 0;
   bmhd_compression = 0;
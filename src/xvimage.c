@@ -13,6 +13,9 @@
  *            void RotatePic();
  *            void InstallNewPic(void);
  *            void DrawEpic(void);
+ *            void UpdatePicRect(x,y,w,h);
+ *            int  DrawViewport(x,y,w,h);
+ *            byte *EpicRect(x,y,w,h);
  *            byte *FSDither()
  *            void CreateXImage()
  *            void Set824Menus( pictype );
@@ -36,6 +39,11 @@
 
 
 static void flipSel           PARM((int));
+static int  updateRectOK      PARM((void));
+static void expandRect        PARM((byte *, int, int, int, int, int));
+static int  viewportOK        PARM((void));
+static void visibleRect       PARM((int *, int *, int *, int *));
+static void renderViewport    PARM((void));
 static void do_zoom           PARM((int, int));
 static void compute_zoom_rect PARM((int, int, int*, int*, int*, int*));
 static void do_unzoom         PARM((void));
@@ -324,6 +332,15 @@ static int fs2_dither(FSBUF *fs, byte *ptr, int nc, int num_rows, int num_cols)
 #define DO_CROP 0
 #define DO_ZOOM 1
 
+/* when the window is much bigger than the screen (only possible with
+   -nolimits), a raw epic isn't generated at all.  theImage just holds the
+   part of the window that's on the screen, plus VPMARGIN pixels all around,
+   and is re-rendered from cpic when some other part gets exposed */
+#define VPMARGIN 128
+
+static int vpOn = 0;                   /* epic is being done a viewport at */
+static int vpX, vpY, vpW, vpH;         /* a time.  theImage holds this rect */
+
 
 /***********************************/
 void Resize(int w, int h)
@@ -357,6 +374,7 @@ void GenerateCpic(void)
   int   i, j, bperpix;
   byte *pp, *cp;
 
+  FreeMips();
   if (cpic == pic) return;     /* no cropping, nothing to do */
 
   cp = cpic;
@@ -400,7 +418,7 @@ void GenerateEpic(int w, int h)
 			  rMap,gMap,bMap, rdisp,gdisp,bdisp, numcols);
     }
     else {  /* PIC24 */
-      epic = Smooth24(cpic, 1, cWIDE, cHIGH, eWIDE, eHIGH, NULL, NULL, NULL);
+      epic = SmoothMip(cpic, 1, cWIDE, cHIGH, eWIDE, eHIGH, NULL, NULL, NULL);
     }
 
     if (epic) return;   /* success */
@@ -414,6 +432,11 @@ void GenerateEpic(int w, int h)
 
   /* generate a 'raw' epic, as we'll need it for ColorDither if EM_DITH */
 
+  if (viewportOK()) {                  /* too big.  CreateXImage() and */
+    vpOn = 1;                          /* DrawViewport() take it from here */
+    return;
+  }
+
   if (eWIDE==cWIDE && eHIGH==cHIGH) {  /* 1:1 expansion.  point epic at cpic */
     epic = cpic;
   }
@@ -427,7 +450,7 @@ void GenerateEpic(int w, int h)
 
     /* create a new epic of the appropriate size */
 
-    epic = (byte *) malloc((size_t) (eWIDE * eHIGH * bperpix));
+    epic = PoolAlloc((size_t) eWIDE * eHIGH * bperpix);
     if (!epic) FatalError("GenerateEpic():  unable to malloc 'epic'");
 
     /* the scaling routine.  not really all that scary after all... */
@@ -796,7 +819,8 @@ void UnCrop(void)
 
   /* dispose of old cpic and epic */
   FreeEpic();
-  if (cpic && cpic !=  pic) free(cpic);
+  FreeMips();
+  if (cpic && cpic !=  pic) PoolFree(cpic);
   cpic = NULL;
 
 
@@ -1078,7 +1102,8 @@ void DoCrop(int x, int y, int w, int h)
 
 
   FreeEpic();
-  if (cpic && cpic !=  pic) free(cpic);
+  FreeMips();
+  if (cpic && cpic !=  pic) PoolFree(cpic);
   cpic = NULL;
 
   expw = (double) eWIDE / (double) cWIDE;
@@ -1097,7 +1122,7 @@ void DoCrop(int x, int y, int w, int h)
     /* at this point, we want to generate cpic, which will contain a
        cWIDE*cHIGH subsection of 'pic', top-left at cXOFF,cYOFF */
 
-    cpic = (byte *) malloc((size_t) (cWIDE * cHIGH * bperpix));
+    cpic = PoolAlloc((size_t) cWIDE * cHIGH * bperpix);
 
     if (cpic == NULL) {
       fprintf(stderr,"%s: unable to allocate memory for cropped image\n", cmd);
@@ -1166,6 +1191,7 @@ void DoRotate(int dir)
 
   /* dir=0: 90 degrees clockwise, else 90 degrees counter-clockwise */
   WaitCursor();
+  FreeMips();
 
   if (origPic!=NULL) {
         int tmp_pw,tmp_ph;
@@ -1174,6 +1200,7 @@ void DoRotate(int dir)
         RotatePic(origPic,origPicType,&tmp_pw,&tmp_ph,dir);
   }
   RotatePic(pic, picType, &pWIDE, &pHIGH, dir);
+  DeepRotate(dir);
 
   /* rotate clipped version and modify 'clip' coords */
   if (cpic != pic && cpic != NULL) {
@@ -1197,6 +1224,7 @@ void DoRotate(int dir)
     WaitCursor();
     RotatePic(epic, picType, &eWIDE, &eHIGH,dir);
   }
+  else if (vpOn) { i = eWIDE;  eWIDE = eHIGH;  eHIGH = i; }
   else { eWIDE = cWIDE;  eHIGH = cHIGH; }
 
 
@@ -1278,13 +1306,16 @@ void Flip(int dir)
    */
 
   WaitCursor();
+  FreeMips();
 
   if (HaveSelection()) {            /* only flip selection region */
+    DeepStale();
     flipSel(dir);
     return;
   }
 
   FlipPic(pic, pWIDE, pHIGH, dir);
+  DeepFlip(dir);
 
   /* flip clipped version */
   if (cpic && cpic != pic) {
@@ -1404,7 +1435,8 @@ void InstallNewPic(void)
 
   /* toss old cpic and epic, if any */
   FreeEpic();
-  if (cpic && cpic != pic) free(cpic);
+  FreeMips();
+  if (cpic && cpic != pic) PoolFree(cpic);
   cpic = NULL;
 
   /* toss old colors, and allocate new ones */
@@ -1434,15 +1466,329 @@ void DrawEpic(void)
 }
 
 
+/***********************************/
+void UpdatePicRect(int x, int y, int w, int h)
+{
+  /* called when the pixels in rectangle x,y,w,h of 'pic' (and nothing
+     else) have been changed.  Brings cpic, epic, egampic and theImage up to
+     date for just that area, and redraws it.  When the area can't be done
+     on its own (smoothed or dithered epic, a display that needs dithering,
+     root window, ...) it falls back to regenerating the whole thing, as
+     callers used to */
+
+  int     cx0,cy0,cx1,cy1, ex0,ey0,ex1,ey1, ew,eh;
+  int     i, bperpix, xbpp;
+  byte   *sub, *gsub;
+  XImage *xim;
+
+  CropRect2Rect(&x,&y,&w,&h, 0,0,pWIDE,pHIGH);
+  if (w<1 || h<1) return;
+
+  FreeMips();
+  FreeRootTiles();  /* theImage is about to change, even in window mode */
+  DeepStale();      /* 'pic' is no longer what the master develops into */
+
+  if (!updateRectOK()) {
+    GenerateCpic();
+    WaitCursor();
+    GenerateEpic(eWIDE,eHIGH);
+    WaitCursor();
+    DrawEpic();        /* redraws selection, also */
+    return;
+  }
+
+  bperpix = (picType == PIC8) ? 1 : 3;
+
+  /* the part of cpic that changed */
+  cx0 = x - cXOFF;  cy0 = y - cYOFF;  cx1 = cx0 + w;  cy1 = cy0 + h;
+  RANGE(cx0, 0, cWIDE);  RANGE(cx1, 0, cWIDE);
+  RANGE(cy0, 0, cHIGH);  RANGE(cy1, 0, cHIGH);
+  if (cx0 >= cx1 || cy0 >= cy1) return;      /* cropped out of view */
+
+  if (cpic != pic) {
+    for (i=cy0; i<cy1; i++)
+      bcopy((char *) pic  + ((size_t) (i+cYOFF) * pWIDE + cXOFF + cx0) * bperpix,
+	    (char *) cpic + ((size_t) i * cWIDE + cx0) * bperpix,
+	    (size_t) (cx1 - cx0) * bperpix);
+  }
+
+
+  /* the epic pixels that sample those cpic pixels.  epic pixel ex comes
+     from cpic column (cWIDE*ex)/eWIDE, exactly as in GenerateEpic() */
+  ex0 = (int) (((long) cx0 * eWIDE + cWIDE - 1) / cWIDE);
+  ex1 = (int) (((long) cx1 * eWIDE + cWIDE - 1) / cWIDE);
+  ey0 = (int) (((long) cy0 * eHIGH + cHIGH - 1) / cHIGH);
+  ey1 = (int) (((long) cy1 * eHIGH + cHIGH - 1) / cHIGH);
+  RANGE(ex1, 0, eWIDE);  RANGE(ey1, 0, eHIGH);
+  ew = ex1 - ex0;  eh = ey1 - ey0;
+  if (ew<1 || eh<1) return;                  /* shrunk out of existence */
+
+  if (epic != cpic)
+    expandRect(epic + ((size_t) ey0 * eWIDE + ex0) * bperpix, eWIDE,
+	       ex0, ey0, ew, eh);
+
+
+  /* pull the block out of epic, gammify it if need be, and build an
+     XImage of just the block, using the normal conversion code */
+  sub = (byte *) malloc((size_t) ew * eh * bperpix);
+  if (!sub) FatalError("couldn't malloc block in UpdatePicRect()");
+
+  for (i=0; i<eh; i++)
+    bcopy((char *) epic + ((size_t) (ey0+i) * eWIDE + ex0) * bperpix,
+	  (char *) sub + (size_t) i * ew * bperpix, (size_t) ew * bperpix);
+
+  if (picType == PIC8)
+    xim = Pic8ToXImage(sub, (u_int) ew, (u_int) eh, cols, rMap, gMap, bMap);
+
+  else {
+    gsub = sub;
+    if (egampic && egampic != epic) {
+      gsub = GammifyPic24(sub, ew, eh);
+      if (!gsub) gsub = sub;                 /* mods don't change anything */
+      for (i=0; i<eh; i++)
+	bcopy((char *) gsub + (size_t) i * ew * 3,
+	      (char *) egampic + ((size_t) (ey0+i) * eWIDE + ex0) * 3,
+	      (size_t) ew * 3);
+    }
+    xim = Pic24ToXImage(gsub, (u_int) ew, (u_int) eh);
+    if (gsub != sub) free(gsub);
+  }
+  free(sub);
+
+  if (!xim) return;
+
+
+  /* and copy it into place in theImage */
+  if (xim->bits_per_pixel == theImage->bits_per_pixel &&
+      xim->byte_order     == theImage->byte_order) {
+    xbpp = theImage->bits_per_pixel / 8;
+    for (i=0; i<eh; i++)
+      bcopy(xim->data + (size_t) i * xim->bytes_per_line,
+	    theImage->data + (size_t) (ey0+i) * theImage->bytes_per_line
+	                   + (size_t) ex0 * xbpp,
+	    (size_t) ew * xbpp);
+    xvDestroyImage(xim);
+  }
+  else {                                     /* shouldn't happen */
+    xvDestroyImage(xim);
+    CreateXImage();
+    ex0 = ey0 = 0;  ew = eWIDE;  eh = eHIGH;
+  }
+
+  if (HaveSelection()) DrawSelection(0);     /* erase it ... */
+  DrawWindow(ex0, ey0, ew, eh);
+  if (HaveSelection()) DrawSelection(0);     /* ... and put it back */
+}
+
+
+/***********************************/
+static int updateRectOK(void)
+{
+  /* returns '1' if UpdatePicRect() can redo just part of the image:  epic
+     has to be a plain resampling of cpic, and theImage has to be a simple
+     pixel-for-pixel conversion of epic, with whole bytes per pixel */
+
+  if (!pic || !cpic || !epic || !theImage || useroot) return 0;
+
+  if (eWIDE != cWIDE || eHIGH != cHIGH) {
+    if (epicMode != EM_RAW) return 0;        /* smoothed or dithered */
+  }
+  else if (epic != cpic) return 0;
+
+  if (dispDEEP == 1 || ncols == 0) return 0;           /* b/w dither */
+  if (theImage->format != ZPixmap ||
+      (theImage->bits_per_pixel & 7) != 0) return 0;   /* packed pixels */
+
+  if (picType == PIC24) {
+    if (theVisual->class != TrueColor && theVisual->class != DirectColor)
+      return 0;                                        /* 3/3/2 dither */
+#ifdef ENABLE_FIXPIX_SMOOTH
+    if (do_fixpix_smooth && theImage->bits_per_pixel < 24) return 0;
+#endif
+  }
+
+  return 1;
+}
+
+
+/***********************************/
+static void expandRect(byte *dst, int dstw, int ex0, int ey0, int ew, int eh)
+{
+  /* does the 'raw' cpic -> epic resampling of GenerateEpic() for just the
+     rectangle ex0,ey0,ew,eh of epic, storing it in 'dst', whose lines are
+     'dstw' pixels apart */
+
+  int   ex, ey, i, bperpix, *cxarr;
+  byte *src, *dp, *sp;
+
+  bperpix = (picType == PIC8) ? 1 : 3;
+
+  cxarr = (int *) malloc(ew * sizeof(int));
+  if (!cxarr) FatalError("unable to allocate cxarr");
+
+  for (ex=0; ex<ew; ex++)
+    cxarr[ex] = bperpix * (int) (((long) cWIDE * (ex0+ex)) / eWIDE);
+
+  for (ey=0; ey<eh; ey++) {
+    src = cpic + (size_t) ((cHIGH * (long) (ey0+ey)) / eHIGH) * cWIDE * bperpix;
+    dp  = dst  + (size_t) ey * dstw * bperpix;
+
+    if (bperpix == 1) {
+      for (ex=0; ex<ew; ex++) *dp++ = src[cxarr[ex]];
+    }
+    else {
+      for (ex=0; ex<ew; ex++) {
+	sp = src + cxarr[ex];
+	for (i=0; i<3; i++) *dp++ = *sp++;
+      }
+    }
+  }
+
+  free(cxarr);
+}
+
+
+/***********************************/
+static int viewportOK(void)
+{
+  /* returns '1' if the current eWIDE,eHIGH are enough bigger than the
+     screen that theImage should only cover the visible part of the window.
+     Only done where rendering a piece gives the same pixels as rendering
+     the whole thing would (ie, no smoothing or dithering) */
+
+  double vpsize;
+
+  if (!theDisp || !mainW || useroot || !cpic) return 0;
+  if (epicMode != EM_RAW) return 0;
+  if (dispDEEP == 1 || ncols == 0) return 0;
+
+  if (picType == PIC24) {
+    if (theVisual->class != TrueColor && theVisual->class != DirectColor)
+      return 0;
+#ifdef ENABLE_FIXPIX_SMOOTH
+    if (do_fixpix_smooth && dispDEEP < 24) return 0;
+#endif
+  }
+
+  vpsize = (double) (dispWIDE + 2*VPMARGIN) * (dispHIGH + 2*VPMARGIN);
+  return ((double) eWIDE * eHIGH > 2.0 * vpsize);
+}
+
+
+/***********************************/
+static void visibleRect(int *x, int *y, int *w, int *h)
+{
+  /* returns the part of mainW (in epic coords) that's on the screen */
+
+  int    wx, wy;
+  Window child;
+
+  if (!XTranslateCoordinates(theDisp, mainW, rootW, 0, 0, &wx, &wy, &child))
+    wx = wy = 0;
+
+  *x = -wx;  *y = -wy;  *w = dispWIDE;  *h = dispHIGH;
+  CropRect2Rect(x, y, w, h, 0, 0, eWIDE, eHIGH);
+}
+
+
+/***********************************/
+static void renderViewport(void)
+{
+  /* builds theImage for the visible part of the window, plus a margin,
+     straight from cpic */
+
+  int   x, y, w, h, bperpix;
+  byte *blk, *gblk;
+
+  xvDestroyImage(theImage);   theImage = NULL;
+
+  visibleRect(&x, &y, &w, &h);
+  x -= VPMARGIN;  y -= VPMARGIN;  w += 2*VPMARGIN;  h += 2*VPMARGIN;
+  CropRect2Rect(&x, &y, &w, &h, 0, 0, eWIDE, eHIGH);
+  if (w<1 || h<1) { x = y = 0;  w = h = 1; }   /* window is off-screen */
+
+  if (DEBUG) fprintf(stderr,"renderViewport: %d,%d %dx%d of %dx%d\n",
+		     x, y, w, h, eWIDE, eHIGH);
+
+  WaitCursor();
+  bperpix = (picType == PIC8) ? 1 : 3;
+  blk = PoolAlloc((size_t) w * h * bperpix);
+  if (!blk) FatalError("couldn't malloc viewport in renderViewport()");
+
+  expandRect(blk, w, x, y, w, h);
+
+  if (picType == PIC8)
+    theImage = Pic8ToXImage(blk, (u_int) w, (u_int) h, cols, rMap,gMap,bMap);
+  else {
+    gblk = GammifyPic24(blk, w, h);
+    theImage = Pic24ToXImage((gblk) ? gblk : blk, (u_int) w, (u_int) h);
+    if (gblk) free(gblk);
+  }
+  PoolFree(blk);
+
+  vpX = x;  vpY = y;  vpW = w;  vpH = h;
+}
+
+
+/***********************************/
+int DrawViewport(int x, int y, int w, int h)
+{
+  /* called by DrawWindow().  If theImage only holds a viewport, draws
+     whatever part of window area x,y,w,h is on the screen, rendering a new
+     viewport first if need be, and returns '1'.  Otherwise returns '0', and
+     does nothing */
+
+  int vx, vy, vw, vh;
+
+  if (!vpOn || !theImage) return 0;
+
+  visibleRect(&vx, &vy, &vw, &vh);
+  CropRect2Rect(&x, &y, &w, &h, vx, vy, vw, vh);
+  if (w<1 || h<1) return 1;                  /* not on screen.  nothing to do */
+
+  if (x < vpX || y < vpY || x+w > vpX+vpW || y+h > vpY+vpH) {
+    renderViewport();
+    if (!theImage) return 1;
+    CropRect2Rect(&x, &y, &w, &h, vpX, vpY, vpW, vpH);
+    if (w<1 || h<1) return 1;
+  }
+
+  XPutImage(theDisp, mainW, theGC, theImage, x-vpX, y-vpY, x, y,
+	    (u_int) w, (u_int) h);
+  return 1;
+}
+
+
+/***********************************/
+byte *EpicRect(int x, int y, int w, int h)
+{
+  /* when only a viewport of epic exists, returns a malloc'd copy of the
+     rectangle x,y,w,h of the raw epic, for the few things that really need
+     it.  Returns NULL if there's no memory for it */
+
+  byte *ep;
+
+  ep = (byte *) malloc((size_t) w * h * ((picType==PIC8) ? 1 : 3));
+  if (ep) {
+    WaitCursor();
+    expandRect(ep, w, x, y, w, h);
+  }
+  return ep;
+}
+
+
 /************************************/
 void KillOldPics(void)
 {
   /* throw away all previous images */
 
   FreeEpic();
-  if (cpic && cpic != pic) free(cpic);
+  FreeMips();
+  FreeDeep();
+  if (cpic && cpic != pic) PoolFree(cpic);
   if (pic) free(pic);
   xvDestroyImage(theImage);   theImage = NULL;
+  FreeRootTiles();
   pic = egampic = epic = cpic = NULL;
 
   if (picComments) free(picComments);
@@ -1696,8 +2042,12 @@ byte *FSDither(byte *inpic, int intype, int w, int h, byte *rmap, byte *gmap, by
 void CreateXImage(void)
 {
   xvDestroyImage(theImage);   theImage = NULL;
+  FreeRootTiles();
+
+  if (vpOn) { renderViewport();  return; }
 
   if (!epic) GenerateEpic(eWIDE, eHIGH);  /* shouldn't happen... */
+  if (vpOn) { renderViewport();  return; }
 
   if (picType == PIC24) {  /* generate egampic */
     if (egampic && egampic != epic) free(egampic);
@@ -1749,7 +2099,7 @@ XImage *Pic8ToXImage(byte *pic8, unsigned int wide, unsigned int high, long unsi
 		       wide, high, 32, 0);
     if (!xim) FatalError("couldn't create xim!");
 
-    imagedata = (byte *) malloc((size_t) (xim->bytes_per_line * high));
+    imagedata = PoolAlloc((size_t) xim->bytes_per_line * high);
     if (!imagedata) FatalError("couldn't malloc imagedata");
 
     xim->data = (char *) imagedata;
@@ -1780,7 +2130,7 @@ XImage *Pic8ToXImage(byte *pic8, unsigned int wide, unsigned int high, long unsi
     imWIDE = wide + nullCount;
 
     /* Now create the image data - pad each scanline as necessary */
-    imagedata = (byte *) malloc((size_t) (imWIDE * high));
+    imagedata = PoolAlloc((size_t) imWIDE * high);
     if (!imagedata) FatalError("couldn't malloc imagedata");
 
     pp = (dithpic) ? dithpic : pic8;
@@ -1819,7 +2169,7 @@ XImage *Pic8ToXImage(byte *pic8, unsigned int wide, unsigned int high, long unsi
     if (!xim) FatalError("couldn't create xim!");
 
     bperline = xim->bytes_per_line;
-    imagedata = (byte *) malloc((size_t) (bperline * high));
+    imagedata = PoolAlloc((size_t) bperline * high);
     if (!imagedata) FatalError("couldn't malloc imagedata");
     xim->data = (char *) imagedata;
 
@@ -1873,7 +2223,7 @@ XImage *Pic8ToXImage(byte *pic8, unsigned int wide, unsigned int high, long unsi
     if (!xim) FatalError("couldn't create xim!");
 
     bperline = xim->bytes_per_line;
-    imagedata = (byte *) malloc((size_t) (bperline * high));
+    imagedata = PoolAlloc((size_t) bperline * high);
     if (!imagedata) FatalError("couldn't malloc imagedata");
     xim->data = (char *) imagedata;
 
@@ -1949,7 +2299,7 @@ XImage *Pic8ToXImage(byte *pic8, unsigned int wide, unsigned int high, long unsi
       FatalError("This display's too bizarre.  Can't create XImage.");
 
     bperline = xim->bytes_per_line;
-    imagedata = (byte *) malloc((size_t) (bperline * high));
+    imagedata = PoolAlloc((size_t) bperline * high);
     if (!imagedata) FatalError("couldn't malloc imagedata");
     xim->data = (char *) imagedata;
 
@@ -1970,7 +2320,7 @@ XImage *Pic8ToXImage(byte *pic8, unsigned int wide, unsigned int high, long unsi
   case 16: {
     byte  *imagedata, *ip, *pp;
 
-    imagedata = (byte *) malloc((size_t) (2*wide*high));
+    imagedata = PoolAlloc((size_t) 2*wide*high);
     if (!imagedata) FatalError("couldn't malloc imagedata");
 
     xim = XCreateImage(theDisp,theVisual,dispDEEP,ZPixmap,0,
@@ -2019,7 +2369,7 @@ XImage *Pic8ToXImage(byte *pic8, unsigned int wide, unsigned int high, long unsi
     byte  *imagedata, *ip, *pp, *tip;
     int    j, do32;
 
-    imagedata = (byte *) malloc((size_t) (4*wide*high));
+    imagedata = PoolAlloc((size_t) 4*wide*high);
     if (!imagedata) FatalError("couldn't malloc imagedata");
 
     xim = XCreateImage(theDisp,theVisual,dispDEEP,ZPixmap,0,
@@ -2118,7 +2468,7 @@ XImage *Pic24ToXImage(byte *pic24, unsigned int wide, unsigned int high)
 		        wide,  high, 32, 0);
     if (!xim) FatalError("couldn't create xim!");
 
-    imagedata = (byte *) malloc((size_t) (xim->bytes_per_line * high));
+    imagedata = PoolAlloc((size_t) xim->bytes_per_line * high);
     if (!imagedata) FatalError("couldn't malloc imagedata");
 
     xim->data = (char *) imagedata;
@@ -2148,7 +2498,7 @@ XImage *Pic24ToXImage(byte *pic24, unsigned int wide, unsigned int high)
     bperline = xim->bytes_per_line;
     bperpix  = xim->bits_per_pixel;
 
-    imagedata = (byte *) malloc((size_t) (high * bperline));
+    imagedata = PoolAlloc((size_t) high * bperline);
     if (!imagedata) FatalError("couldn't malloc imagedata");
 
     xim->data = (char *) imagedata;
@@ -2344,7 +2694,7 @@ XImage *Pic24ToXImage(byte *pic24, unsigned int wide, unsigned int high)
       imWIDE = wide + nullCount;
 
       /* Now create the image data - pad each scanline as necessary */
-      imagedata = (byte *) malloc((size_t) (imWIDE * high));
+      imagedata = PoolAlloc((size_t) imWIDE * high);
       if (!imagedata) FatalError("couldn't malloc imagedata");
 
       for (i=0, pp=pic8, ip=imagedata; i<high; i++) {
@@ -2379,7 +2729,7 @@ XImage *Pic24ToXImage(byte *pic24, unsigned int wide, unsigned int high)
       if (!xim) FatalError("couldn't create xim!");
 
       bperline = xim->bytes_per_line;
-      imagedata = (byte *) malloc((size_t) (bperline * high));
+      imagedata = PoolAlloc((size_t) bperline * high);
       if (!imagedata) FatalError("couldn't malloc imagedata");
       xim->data = (char *) imagedata;
 
@@ -2436,7 +2786,7 @@ XImage *Pic24ToXImage(byte *pic24, unsigned int wide, unsigned int high)
       if (!xim) FatalError("couldn't create xim!");
 
       bperline = xim->bytes_per_line;
-      imagedata = (byte *) malloc((size_t) (bperline * high));
+      imagedata = PoolAlloc((size_t) bperline * high);
       if (!imagedata) FatalError("couldn't malloc imagedata");
       xim->data = (char *) imagedata;
 
@@ -2514,7 +2864,7 @@ XImage *Pic24ToXImage(byte *pic24, unsigned int wide, unsigned int high)
 	FatalError("This display's too bizarre.  Can't create XImage.");
 
       bperline = xim->bytes_per_line;
-      imagedata = (byte *) malloc((size_t) (bperline * high));
+      imagedata = PoolAlloc((size_t) bperline * high);
       if (!imagedata) FatalError("couldn't malloc imagedata");
       xim->data = (char *) imagedata;
 
@@ -2541,7 +2891,7 @@ XImage *Pic24ToXImage(byte *pic24, unsigned int wide, unsigned int high)
       int     bperline;
       unsigned long xcol;
 
-      imagedata = (unsigned short *) malloc((size_t) (2*wide*high));
+      imagedata = (unsigned short *) PoolAlloc((size_t) 2*wide*high);
       if (!imagedata) FatalError("couldn't malloc imagedata");
 
       xim = XCreateImage(theDisp,theVisual,dispDEEP,ZPixmap,0,
@@ -2586,7 +2936,7 @@ XImage *Pic24ToXImage(byte *pic24, unsigned int wide, unsigned int high)
       unsigned long xcol;
       int bperpix;
 
-      imagedata = (byte *) malloc((size_t) (4*wide*high));
+      imagedata = PoolAlloc((size_t) 4*wide*high);
       if (!imagedata) FatalError("couldn't malloc imagedata");
 
       xim = XCreateImage(theDisp,theVisual,dispDEEP,ZPixmap,0,
@@ -2723,8 +3073,9 @@ void Change824Mode(int mode)
 void FreeEpic(void)
 {
   if (egampic && egampic != epic) free(egampic);
-  if (epic && epic != cpic) free(epic);
+  if (epic && epic != cpic) PoolFree(epic);
   epic = egampic = NULL;
+  vpOn = 0;
 }
 
 
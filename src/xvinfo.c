@@ -298,6 +298,12 @@ va_dcl
 	    istrs[ISTR_COLOR]);
   }
 
+  if (!theDisp) {    /* batch mode:  no windows, so warnings go to stderr */
+    if (stnum == ISTR_WARNING && strlen(istrs[stnum]))
+      fprintf(stderr, "%s: %s\n", cmd, istrs[stnum]);
+    return;
+  }
+
   if (infoUp) {
     redrawString(stnum);
     if (stnum == ISTR_COLOR) redrawString(ISTR_INFO);
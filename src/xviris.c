@@ -81,7 +81,7 @@ typedef struct {
 
 
 static int      irisError     PARM((const char *, const char *));
-static byte    *getimagedata  PARM((FILE *, IMAGE *));
+static byte    *getimagedata  PARM((FILE *, IMAGE *, const char **));
 static void     interleaverow PARM((byte *, byte *, int, int));
 static void     expandrow     PARM((byte *, byte *, int));
 static void     readtab       PARM((FILE *, u_long *, int));
@@ -97,9 +97,6 @@ static void     putshort      PARM((FILE *, int));
 static void     putlong       PARM((FILE *, u_long));
 
 
-static const char *loaderr;
-static const char *bname;
-
 /*****************************************************/
 int LoadIRIS(char *fname, PICINFO *pinfo)
 /*****************************************************/
@@ -113,6 +110,7 @@ int LoadIRIS(char *fname, PICINFO *pinfo)
   int     trunc, i, npixels, bufsize;
   u_short ii, jj;
   long    filesize;
+  const char *bname, *loaderr;
 
   trunc = 0;
   bzero((char *) &img, sizeof(IMAGE));
@@ -146,7 +144,7 @@ int LoadIRIS(char *fname, PICINFO *pinfo)
     return irisError(bname, "bad magic number");
   }
 
-  rawdata = getimagedata(fp, &img);
+  rawdata = getimagedata(fp, &img, &loaderr);
   if (!rawdata) {
     fclose(fp);
     if (loaderr) irisError(bname, loaderr);
@@ -239,10 +237,11 @@ static int irisError(const char *name, const char *st)
 
 
 /****************************************************/
-static byte *getimagedata(FILE *fp, IMAGE *img)
+static byte *getimagedata(FILE *fp, IMAGE *img, const char **loaderr)
 {
   /* read in a B/W RGB or RGBA iris image file and return a
-     pointer to an array of 4-byte pixels, arranged ABGR, NULL on error */
+     pointer to an array of 4-byte pixels, arranged ABGR, NULL on error.
+     On error, *loaderr is set to a message, or NULL */
 
   byte   *base, *lptr;
   byte   *verdat;
@@ -254,10 +253,10 @@ static byte *getimagedata(FILE *fp, IMAGE *img)
 
   rle     = ISRLE(img->type);
   bpp     = BPP(img->type);
-  loaderr = (const char *) NULL;
+  *loaderr = (const char *) NULL;
 
   if (bpp != 1) {
-    loaderr = "image must have 1 byte per pix chan";
+    *loaderr = "image must have 1 byte per pix chan";
     return (byte *) NULL;
   }
 
@@ -266,7 +265,7 @@ static byte *getimagedata(FILE *fp, IMAGE *img)
   zsize = img->zsize;
   npixels = xsize * ysize;  /* 65535*65535 = (2^32 - 131071) max */
   if (npixels/xsize != ysize) {
-    loaderr = "IRIS image dimensions out of range";
+    *loaderr = "IRIS image dimensions out of range";
     return (byte *) NULL;
   }
 
@@ -279,12 +278,12 @@ static byte *getimagedata(FILE *fp, IMAGE *img)
     bufsize   = tablen * sizeof(long);
 
     if (tablen/ysize != zsize || bufsize/tablen != sizeof(long)) {
-      loaderr = "IRIS image dimensions out of range";
+      *loaderr = "IRIS image dimensions out of range";
       return (byte *)NULL;
     }
     
     if (rlebuflen < 0 || tablen < 0) { /* || (tablen * sizeof(long)) < 0) */
-      loaderr = "Bogus IRIS File!";
+      *loaderr = "Bogus IRIS File!";
       return (byte *)NULL;
     }
 
@@ -300,7 +299,7 @@ static byte *getimagedata(FILE *fp, IMAGE *img)
     readtab(fp, lengthtab, tablen);
 
     if (FERROR(fp)) {
-      loaderr = "error reading scanline tables";
+      *loaderr = "error reading scanline tables";
       free(starttab);  free(lengthtab);  free(rledat);
       return (byte *) NULL;
     }
@@ -321,7 +320,7 @@ static byte *getimagedata(FILE *fp, IMAGE *img)
 
     bufsize = 4 * (npixels+TAGLEN);
     if (bufsize/4 != (npixels+TAGLEN)) {
-      loaderr = "Bogus IRIS File!";
+      *loaderr = "Bogus IRIS File!";
       free(starttab);  free(lengthtab);  free(rledat);
       return (byte *)NULL;
     }
@@ -341,7 +340,7 @@ static byte *getimagedata(FILE *fp, IMAGE *img)
 
 	  if (lengthtab[y+z*ysize]>rlebuflen) {
 	    free(starttab); free(lengthtab); free(rledat); free(base);
-	    loaderr = "rlebuf too small (corrupt image file?)";
+	    *loaderr = "rlebuf too small (corrupt image file?)";
 	    return (byte *) NULL;
 	  }
 
@@ -378,7 +377,7 @@ static byte *getimagedata(FILE *fp, IMAGE *img)
   else {  /* not RLE */
     bufsize = 4 * (npixels+TAGLEN);
     if (bufsize/4 != (npixels+TAGLEN)) {
-      loaderr = "Bogus IRIS File!";
+      *loaderr = "Bogus IRIS File!";
       return (byte *)NULL;
     }
     base   = (byte *) malloc((size_t) bufsize);
@@ -31,10 +31,12 @@
  *
  * XXX  Things to do:
  *
- * 1. In "LoadJP{2,C}()" try to handle the "quick" option, which requests
- *    faster loading of a reduced-size image for the visual schnauzer.  The
- * schnauzer's icon size is currently 80x60, so the old "xvjpeg.c" module tries
- * to produce a 2X (160x120) image.  Can we do the same?
+ * 1. In "LoadJP{2,C}()" the "quick" option, which requests faster loading of
+ *    a reduced-size image for the visual schnauzer, only gets us the first
+ * quality layer from JasPer:  it can't stop decoding at a lower resolution
+ * level the way "xvjpeg.c" scales its icons down, so we still pay for every
+ * pixel.  (When XV is built with OpenJPEG, that does the decoding and skips
+ * the resolution levels we don't need.)
  *
  * 2. In "StoreJP2K()", JasPer Library Version 1.701 apparently has no API to
  *    let the XV global "picComments" string be inserted in a JPEG 2000 comment
@@ -58,10 +60,16 @@
 #ifdef HAVE_JP2K
 
 #include <jasper/jasper.h>
+#ifdef HAVE_OPENJPEG
+#include <openjpeg.h>
+#endif
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
 
 #define GIBI (1024ULL * 1024ULL * 1024ULL)
 
-static const char *fbasename, /* File's base name, for error/warning msgs */
+static const char *logname, /* File's base name, for JasPer's log messages */
 	bad_samp[] = "%s:  can't read %d-plane %s file!", fmode[] = "rb",
 	full_msg[] = "%s %s. (%ld bytes)", jp2_kind[] = "JP2",
 	load_msg[] = "Loading %dx%d %s %s (%ld bytes)...",
@@ -70,6 +78,24 @@ static const char *fbasename, /* File's base name, for error/warning msgs */
 	shrt_msg[] = "%dx%d %s %s. ",
 	bad_dims[] = "%s:  error in JPEG-2000 header (bad image size)";
 
+/* JasPer's library setup and its log hook are process-wide, so only one
+   thread at a time may be using it.  (OpenJPEG has no such problem.) */
+#ifdef HAVE_PTHREADS
+static pthread_mutex_t jaslock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static void lock_jasper(void) {
+#ifdef HAVE_PTHREADS
+	pthread_mutex_lock(&jaslock);
+#endif
+}
+
+static void unlock_jasper(void) {
+#ifdef HAVE_PTHREADS
+	pthread_mutex_unlock(&jaslock);
+#endif
+}
+
 static int get_debug_level(void)
 {
 	int debug_level = 0;
@@ -112,7 +138,7 @@ static int print_log(jas_logtype_t type, const char *format, va_list ap) {
 					buffer[i] = ' ';
 				}
 			}
-			SetISTR(kind, "%s:  %s", fbasename, buffer);
+			SetISTR(kind, "%s:  %s", logname, buffer);
 		}
 	} else {
 		jas_eprintf("%s", buffer);
@@ -121,8 +147,221 @@ static int print_log(jas_logtype_t type, const char *format, va_list ap) {
 }
 #endif
 
-static int LoadJP2K(char *fname, register PICINFO *pinfo, int quick,
+#ifdef HAVE_OPENJPEG
+/* OpenJPEG decodes tiles and code-blocks on several threads and can stop at
+   a lower resolution level, so when it's available LoadJP2K() tries it
+   first.  Anything it can't turn into an XV image by itself (sub-sampled or
+   YCC components, odd color spaces, damaged files) is left to JasPer, which
+   also still does all of the writing.
+*/
+#define OPJ_MSGLEN 512
+
+/* Keeps the first problem reported by the decoder in 'client_data', the
+   caller's opj_msg[] */
+static void opj_msg_cb(const char *msg, void *client_data) {
+	char *opj_msg = (char *) client_data;
+
+	/* OpenJPEG may call this from its worker threads. */
+	ParallelLock();
+	if (!opj_msg[0]) {
+		int i;
+		strncpy(opj_msg, msg, OPJ_MSGLEN - 1);
+		for (i = 0; opj_msg[i]; ++i) {
+			if (opj_msg[i] == '\n') {
+				opj_msg[i] = ' ';
+			}
+		}
+	}
+	ParallelUnlock();
+}
+
+static void opj_quiet_cb(const char *msg, void *client_data) {
+	XV_UNUSED(msg);
+	XV_UNUSED(client_data);
+}
+
+/* Returns 1 on success, 0 if JasPer should have a go at the file instead. */
+static int LoadJP2KOpj(char *fname, register PICINFO *pinfo, int quick,
   bool jpc_format) {
+	char opj_msg[OPJ_MSGLEN];
+	const char *fbasename;
+	opj_stream_t *str = 0;
+	opj_codec_t *codec = 0;
+	opj_image_t *img = 0;
+	opj_dparameters_t params;
+	FILE *fp;
+	const char *s;
+	unsigned long filesize;
+	long fullw, fullh, w, h, npixels, bufsize;
+	int vstride, ow, oh, reduce = 0;
+	register int i;
+	int ret = 0;
+
+	if (!(fp = xv_fopen(fname, fmode))) {
+		return 0;
+	}
+	fseek(fp, 0L, 2);
+	filesize = ftell(fp);
+	fclose(fp);
+
+	fbasename = BaseName(fname);
+	opj_msg[0] = '\0';
+
+	if (!(str = opj_stream_create_default_file_stream(fname, OPJ_TRUE)) ||
+		!(codec = opj_create_decompress(jpc_format ? OPJ_CODEC_J2K
+												   : OPJ_CODEC_JP2))) {
+		goto done;
+	}
+	opj_set_info_handler(codec, opj_quiet_cb, 0);
+	opj_set_warning_handler(codec, opj_quiet_cb, 0);
+	opj_set_error_handler(codec, opj_msg_cb, opj_msg);
+
+	opj_set_default_decoder_parameters(&params);
+	if (!opj_setup_decoder(codec, &params)) {
+		goto done;
+	}
+#if (OPJ_VERSION_MAJOR > 2 || (OPJ_VERSION_MAJOR == 2 && OPJ_VERSION_MINOR >= 2))
+	if (opj_has_thread_support()) {
+		opj_codec_set_threads(codec, ParallelWorkers(1 << 16));
+	}
+#endif
+
+	if (!opj_read_header(str, codec, &img) || img->numcomps < 1) {
+		goto done;
+	}
+
+	/* Decode only as many resolution levels as the display needs. */
+	fullw = img->x1 - img->x0;
+	fullh = img->y1 - img->y0;
+	if (OverviewSize(fullw, fullh, quick, &ow, &oh)) {
+		opj_codestream_info_v2_t *cstr = opj_get_cstr_info(codec);
+		int nres = 1;
+
+		if (cstr) {
+			if (cstr->m_default_tile_info.tccp_info) {
+				nres = cstr->m_default_tile_info.tccp_info[0].numresolutions;
+			}
+			opj_destroy_cstr_info(&cstr);
+		}
+		while (reduce + 1 < nres &&
+			   ((fullw + (2L << reduce) - 1) >> (reduce + 1)) >= ow &&
+			   ((fullh + (2L << reduce) - 1) >> (reduce + 1)) >= oh) {
+			++reduce;
+		}
+		if (reduce && !opj_set_decoded_resolution_factor(codec, reduce)) {
+			reduce = 0;
+		}
+	}
+
+	if (!opj_decode(codec, str, img) || !opj_end_decompress(codec, str)) {
+		goto done;
+	}
+
+	/* We only handle full-resolution components of at most 16 bits, in
+	   gray or RGB; leave everything else to JasPer. */
+	vstride = img->numcomps;
+	if (vstride != 1 && vstride != 3) {
+		goto done;
+	}
+	for (i = 0; i < vstride; ++i) {
+		if (img->comps[i].dx != 1 || img->comps[i].dy != 1 ||
+			img->comps[i].prec < 1 || img->comps[i].prec > 16 ||
+			img->comps[i].w != img->comps[0].w ||
+			img->comps[i].h != img->comps[0].h || !img->comps[i].data) {
+			goto done;
+		}
+	}
+	if (vstride == 1 ? (img->color_space != OPJ_CLRSPC_GRAY &&
+						img->color_space != OPJ_CLRSPC_UNSPECIFIED &&
+						img->color_space != OPJ_CLRSPC_UNKNOWN)
+					 : (img->color_space != OPJ_CLRSPC_SRGB &&
+						img->color_space != OPJ_CLRSPC_UNSPECIFIED)) {
+		goto done;
+	}
+
+	w = img->comps[0].w;
+	h = img->comps[0].h;
+
+	/* avoid buffer overflow */
+	npixels = w * h;
+	bufsize = vstride * npixels;
+	if (w <= 0 || h <= 0 || npixels / w != h || bufsize / vstride != npixels) {
+		SetISTR(ISTR_WARNING, bad_dims, fbasename);
+		goto done;
+	}
+	pinfo->w = w;
+	pinfo->h = h;
+	pinfo->normw = reduce ? fullw : w;
+	pinfo->normh = reduce ? fullh : h;
+
+	if (vstride == 1) {
+		s = "Greyscale";
+		pinfo->type = PIC8;
+		pinfo->colType = F_GREYSCALE;
+		i = 256; /* Return fake indexed-color "map" */
+		while (--i >= 0)
+			pinfo->r[i] = pinfo->g[i] = pinfo->b[i] = i;
+	} else {
+		s = "Color";
+		pinfo->type = PIC24;
+		pinfo->colType = F_FULLCOLOR;
+	}
+
+	if (!(pinfo->pic = (byte *)malloc(bufsize))) {
+		SetISTR(ISTR_WARNING, no_mem, fbasename, jp2_kind);
+		goto done;
+	}
+	pinfo->frmType = F_JP2;
+	sprintf(pinfo->fullInfo, full_msg, s, jp2_kind, filesize);
+	sprintf(pinfo->shrtInfo, shrt_msg, pinfo->w, pinfo->h, s, jp2_kind);
+	SetISTR(ISTR_INFO, load_msg, pinfo->normw, pinfo->normh, s, jp2_kind,
+			filesize);
+
+	/* Interleave the planes, scaling each sample to 8 bits. */
+	{
+		int comp_ind;
+		for (comp_ind = 0; comp_ind < vstride; ++comp_ind) {
+			opj_image_comp_t *comp = &img->comps[comp_ind];
+			int prec = comp->prec;
+			long maxval = (1L << prec) - 1;
+			long offset = comp->sgnd ? 1L << (prec - 1) : 0;
+			OPJ_INT32 *src = comp->data;
+			unsigned char *dst = pinfo->pic + comp_ind;
+			long n;
+
+			for (n = 0; n < npixels; ++n) {
+				long v = (long) *src++ + offset;
+				if (v < 0) v = 0;
+				else if (v > maxval) v = maxval;
+				*dst = (prec == 8) ? v : (v * 255 + maxval / 2) / maxval;
+				dst += vstride;
+			}
+		}
+	}
+
+	/* Success! */
+	ret = 1;
+
+done:
+	if (!ret && opj_msg[0] && get_debug_level() >= 1) {
+		fprintf(stderr, "%s:  OpenJPEG: %s\n", fbasename, opj_msg);
+	}
+	if (img) {
+		opj_image_destroy(img);
+	}
+	if (codec) {
+		opj_destroy_codec(codec);
+	}
+	if (str) {
+		opj_stream_destroy(str);
+	}
+	return ret;
+}
+#endif /* HAVE_OPENJPEG */
+
+static int LoadJP2KJas(char *fname, register PICINFO *pinfo, int quick,
+  bool jpc_format) {
+	const char *fbasename;
 	jas_image_t *img = 0;
 	jas_stream_t *str = 0;
 	FILE *fp;
@@ -155,13 +394,11 @@ static int LoadJP2K(char *fname, register PICINFO *pinfo, int quick,
 	jas_setdbglevel(debug_level);
 #endif
 
-	XV_UNUSED(quick);
-
 	if (!(fp = xv_fopen(fname, fmode))) {
 		return 0;
 	}
 	/* Input file's base name, for message(s) */
-	fbasename = BaseName(fname);
+	logname = fbasename = BaseName(fname);
 
 	/* Compute file size is portable way. */
 	fseek(fp, 0L, 2);
@@ -217,7 +454,10 @@ static int LoadJP2K(char *fname, register PICINFO *pinfo, int quick,
 	const jas_image_fmtinfo_t *fmtinfo = jas_image_lookupfmtbyname(
 	  jpc_format ? "jpc" : "jp2");
 	assert(fmtinfo);
-	if (!(img = jas_image_decode(str, fmtinfo->id, 0))) {
+	/* An icon doesn't need more than the first quality layer, and skipping
+	   the rest saves most of the entropy decoding on multi-layer files. */
+	if (!(img = jas_image_decode(str, fmtinfo->id,
+								 quick ? "maxlyrs=1" : 0))) {
 		ret = 0;
 		goto done;
 	}
@@ -389,6 +629,22 @@ done:
 	return ret;
 }
 
+static int LoadJP2K(char *fname, register PICINFO *pinfo, int quick,
+  bool jpc_format) {
+	int ret;
+
+#ifdef HAVE_OPENJPEG
+	if (LoadJP2KOpj(fname, pinfo, quick, jpc_format)) {
+		return 1;
+	}
+#endif
+
+	lock_jasper();
+	ret = LoadJP2KJas(fname, pinfo, quick, jpc_format);
+	unlock_jasper();
+	return ret;
+}
+
 int LoadJP2(char *fname, register PICINFO *pinfo, int quick) {
 	return LoadJP2K(fname, pinfo, quick, false);
 }
@@ -461,6 +717,7 @@ static MBUTT menu[J_NMENU];
 static RBUTT *radio;
 static Window text[J_NTEXT];
 static int colorType, format, textval[J_NTEXT];
+static char *savepath; /* Output file path, from JP2KSaveParams() */
 static const char *ProgList[] = {"lrcp", "rlcp", "rpcl", "pcrl", "cprl"};
 
 void CreateJP2KW(void) {
@@ -586,7 +843,7 @@ void CreateJP2KW(void) {
 void JP2KSaveParams(int fmt, char *fname, int col) /* Save output-file parms */
 {
 	format = fmt;	   /* Desired file format: F_JPC|F_JP2 */
-	fbasename = fname; /* ->Output file path */
+	savepath = fname;  /* ->Output file path */
 	colorType = col;   /* Desired color space: F_GREYSCALE|... */
 }
 
@@ -611,6 +868,7 @@ static void StoreJP2K(char *options) {
 	jas_matrix_t *data = 0;
 	int debug_level = get_debug_level();
 
+	lock_jasper();
 #if (JAS_VERSION_MAJOR >= 3)
 	size_t max_mem = jas_get_total_mem_size();
 	if (!max_mem) {
@@ -635,13 +893,21 @@ static void StoreJP2K(char *options) {
 	   image buffer from XV and begin crunching it into a suitable form for the
 	   JasPer Library.
 	*/
-	if (!(fp = OpenOutFile(filename = fbasename)))
+	if (!(fp = OpenOutFile(filename = savepath))) {
+		unlock_jasper();
 		return; /* Oops! */
+	}
 	setbuf(fp,
 		   0); /* We don't really use this file pointer for I/O; see below */
-	fbasename = BaseName(filename);
+	logname = BaseName(filename);
 	WaitCursor();
 	pic = GenSavePic(&ptype, &w, &h, &pfree, &nc, &r, &g, &b);
+	if (!pic) {
+		CloseOutFileWhy(fp, filename, 1, "not enough memory");
+		SetCursors(-1);
+		unlock_jasper();
+		return;
+	}
 	assert(ptype == PIC8 || ptype == PIC24);
 	imagesize = w * h;
 	if (ptype == PIC24)
@@ -825,6 +1091,7 @@ L2:
 #else
 	jas_cleanup();
 #endif
+	unlock_jasper();
 }
 
 void JP2KDialog(int vis) {
@@ -1194,6 +1461,11 @@ void VersionInfoJP2K(void) /* GRR 20070304 */
 {
 	fprintf(stderr, "   Compiled with libjasper %s; using libjasper %s.\n",
 			JAS_VERSION, jas_getversion());
+#ifdef HAVE_OPENJPEG
+	fprintf(stderr, "   Compiled with libopenjp2 %d.%d.%d; using libopenjp2 %s.\n",
+			OPJ_VERSION_MAJOR, OPJ_VERSION_MINOR, OPJ_VERSION_BUILD,
+			opj_version());
+#endif
 }
 
 #endif /* HAVE_JP2K */
@@ -34,17 +34,16 @@
 #define J_BCANC  1
 #define BUTTH    (24*dpiMult)
 
-/* Minimum size compression when doing a 'quick' image load.  (Of course, if
-   the image *is* smaller than this, you'll get whatever size it actually is.)
-   This is currently hardcoded to be twice the size of a schnauzer icon, as
-   the schnauzer's the only thing that does a quick load... */
-
-#define QUICKWIDE (160*dpiMult)
-#define QUICKHIGH (120*dpiMult)
-
+/* the error manager also carries what one load or save needs to keep
+   between libjpeg callbacks, so several files can be handled at once */
 struct my_error_mgr {
   struct jpeg_error_mgr pub;
   jmp_buf               setjmp_buffer;
+  const char           *fbasename;     /* for messages */
+  char                  msg[JMSG_LENGTH_MAX];  /* the error that ended it */
+  char                 *comment;       /* COM markers read so far */
+  byte                 *exifInfo;      /* first APP1 marker */
+  int                   exifInfoSize;  /* not a string => must track size */
 };
 
 typedef struct my_error_mgr *my_error_ptr;
@@ -55,6 +54,8 @@ static    void         drawJD             PARM((int, int, int, int));
 static    void         clickJD            PARM((int, int));
 static    void         doCmd              PARM((int));
 static    void         writeJPEG          PARM((void));
+static    int          jpegWritePic       PARM((FILE *, byte *, int, int, int,
+                                                byte *, byte *, byte *, int));
 #if JPEG_LIB_VERSION > 60
 METHODDEF(void)        xv_error_exit      PARM((j_common_ptr));
 METHODDEF(void)        xv_error_output    PARM((j_common_ptr));
@@ -76,12 +77,9 @@ static    int          writeJFIF          PARM((FILE *, byte *, int,int,int));
 
 
 
-/*** local variables ***/
+/*** local variables (save dialog) ***/
 static char *filename;
 static const char *fbasename;
-static char *comment;
-static byte *exifInfo;
-static int   exifInfoSize;   /* not a string => must track size explicitly */
 static int   colorType;
 
 static DIAL  qDial, smDial;
@@ -329,10 +327,8 @@ char errbuffer[JMSG_LENGTH_MAX];
 static void writeJPEG(void)
 {
   FILE          *fp;
-  int            i, nc, rv, w, h, npixels, ptype, pfree;
-  register byte *ip, *ep;
+  int            nc, rv, w, h, ptype, pfree;
   byte          *inpix, *rmap, *gmap, *bmap;
-  byte          *image8, *image24;
 
   /* get the XV image into a format that the JPEG software can grok on.
      Also, open the output file, so we don't waste time doing this format
@@ -346,13 +342,38 @@ static void writeJPEG(void)
 
   WaitCursor();
   inpix = GenSavePic(&ptype, &w, &h, &pfree, &nc, &rmap, &gmap, &bmap);
+  if (!inpix) {
+    CloseOutFileWhy(fp, filename, 1, "not enough memory");
+    SetCursors(-1);
+    return;
+  }
+
+  rv = jpegWritePic(fp, inpix, ptype, w, h, rmap, gmap, bmap, nc);
+
+  if (pfree) free(inpix);
+
+  if (CloseOutFileWhy(fp, filename, rv, errbuffer) == 0) DirBox(0);
+  SetCursors(-1);
+}
+
+
+
+/*******************************************/
+static int jpegWritePic(FILE *fp, byte *inpix, int ptype, int w, int h, byte *rmap, byte *gmap, byte *bmap, int nc)
+{
+  /* converts inpix to greyscale or truecolor, as colorType dictates, and
+     writes it.  returns '0' on success */
+
+  int            i, rv, npixels;
+  register byte *ip, *ep;
+  byte          *image8, *image24;
 
   /* this case may not be possible to trigger, but not totally clear, so... */
   npixels = w*h;
   if (w <= 0 || h <= 0 || npixels/w < h) {
     SetISTR(ISTR_WARNING, "%s:  image dimensions too large (%dx%d)",
             fbasename, w, h);
-    return;
+    return 1;
   }
 
   image8 = image24 = (byte *) NULL;
@@ -396,7 +417,7 @@ static void writeJPEG(void)
       if (count/3 < npixels) {
         SetISTR(ISTR_WARNING, "%s:  image dimensions too large (%dx%d)",
                 fbasename, w, h);
-        return;
+        return 1;
       }
 
       image24 = (byte *) malloc((size_t) count);
@@ -424,10 +445,23 @@ static void writeJPEG(void)
   if      (colorType == F_GREYSCALE) free(image8);
   else if (ptype == PIC8)            free(image24);
 
-  if (pfree) free(inpix);
+  return rv;
+}
 
-  if (CloseOutFileWhy(fp, filename, rv, errbuffer) == 0) DirBox(0);
-  SetCursors(-1);
+
+
+/*******************************************/
+int JPEGBatchSave(FILE *fp, byte *pic, int ptype, int w, int h, byte *rmap, byte *gmap, byte *bmap, int nc, int col, char *fname, int quality)
+{
+  /* batch-mode entry point:  no dialog, so the settings come from the
+     arguments.  quality < 0 means the usual default */
+
+  fbasename = BaseName(fname);
+  colorType = col;
+  qDial.val  = (quality >= 1 && quality <= 100) ? quality : 75;
+  smDial.val = 0;
+
+  return jpegWritePic(fp, pic, ptype, w, h, rmap, gmap, bmap, nc);
 }
 
 
@@ -451,7 +485,7 @@ METHODDEF void  xv_error_exit(j_common_ptr cinfo)
   my_error_ptr myerr;
 
   myerr = (my_error_ptr) cinfo->err;
-  (*cinfo->err->format_message)(cinfo, errbuffer);     /* fmt error message */
+  (*cinfo->err->format_message)(cinfo, myerr->msg);    /* fmt error message */
   longjmp(myerr->setjmp_buffer, 1);         /* return from error */
 }
 
@@ -463,11 +497,13 @@ METHODDEF(void) xv_error_output(j_common_ptr cinfo)
 METHODDEF void  xv_error_output(j_common_ptr cinfo)
 #endif
 {
+  my_error_ptr myerr;
   char         buffer[JMSG_LENGTH_MAX];
 
+  myerr = (my_error_ptr) cinfo->err;
   (*cinfo->err->format_message)(cinfo, buffer);
 
-  SetISTR(ISTR_WARNING, "%s: %s", fbasename, buffer);   /* send it to XV */
+  SetISTR(ISTR_WARNING, "%s: %s", myerr->fbasename, buffer);   /* send it to XV */
 }
 
 
@@ -511,13 +547,12 @@ int LoadJFIF(char *fname, PICINFO *pinfo, int quick)
   const char                      *colorspace_name = "Color";
   byte                            *pic;
   long                             filesize;
+  const char                      *fbasename;
   int                              i,w,h,bperpix,bperline,count;
 
 
   fbasename = BaseName(fname);
   pic       = (byte *) NULL;
-  comment   = (char *) NULL;
-  exifInfo  = (byte *) NULL;
 
   pinfo->type  = PIC8;
 
@@ -531,25 +566,25 @@ int LoadJFIF(char *fname, PICINFO *pinfo, int quick)
   cinfo.err = jpeg_std_error(&jerr.pub);
   jerr.pub.error_exit     = xv_error_exit;
   jerr.pub.output_message = xv_error_output;
+  jerr.fbasename    = fbasename;
+  jerr.comment      = (char *) NULL;
+  jerr.exifInfo     = (byte *) NULL;
+  jerr.exifInfoSize = 0;
 
   if (setjmp(jerr.setjmp_buffer)) {
 L1:
     /* if we're here, it blowed up... */
     jpeg_destroy_decompress(&cinfo);
     fclose(fp);
-    if (pic)      free(pic);
-    if (comment)  free(comment);
-    if (exifInfo) free(exifInfo);
+    if (pic)           free(pic);
+    if (jerr.comment)  free(jerr.comment);
+    if (jerr.exifInfo) free(jerr.exifInfo);
 
     pinfo->pic      = (byte *) NULL;
     pinfo->comment  = (char *) NULL;
     pinfo->exifInfo = (byte *) NULL;
     pinfo->exifInfoSize = 0;
 
-    comment  = (char *) NULL;
-    exifInfo = (byte *) NULL;
-    exifInfoSize = 0;
-
     return 0;
   }
 
@@ -762,18 +797,14 @@ L2:
   sprintf(pinfo->fullInfo, "%s JPEG. (%ld bytes)", colorspace_name, filesize);
   sprintf(pinfo->shrtInfo, "%dx%d %s JPEG. ", w, h, colorspace_name);
 
-  pinfo->comment      = comment;
-  pinfo->exifInfo     = exifInfo;
-  pinfo->exifInfoSize = exifInfoSize;
-
   jpeg_finish_decompress(&cinfo);
   jpeg_destroy_decompress(&cinfo);
   fclose(fp);
 
   /* ownership transferred to pinfo */
-  comment  = (char *) NULL;
-  exifInfo = (byte *) NULL;
-  exifInfoSize = 0;
+  pinfo->comment      = jerr.comment;
+  pinfo->exifInfo     = jerr.exifInfo;
+  pinfo->exifInfoSize = jerr.exifInfoSize;
 
   return 1;
 }
@@ -802,9 +833,13 @@ METHODDEF(boolean) xv_process_comment(j_decompress_ptr cinfo)
 METHODDEF boolean  xv_process_comment(j_decompress_ptr cinfo)
 #endif
 {
+  my_error_ptr myerr;
   int          length, hasnull;
   unsigned int ch;
-  char         *oldsp, *sp;
+  char         *oldsp, *sp, *comment;
+
+  myerr   = (my_error_ptr) cinfo->err;
+  comment = myerr->comment;
 
   length  = j_getc(cinfo) << 8;
   length += j_getc(cinfo);
@@ -816,6 +851,7 @@ METHODDEF boolean  xv_process_comment(j_decompress_ptr cinfo)
   }
   else comment = (char *) realloc(comment, strlen(comment) + length + 1);
   if (!comment) FatalError("out of memory in xv_process_comment");
+  myerr->comment = comment;
 
   oldsp = sp = comment + strlen(comment);
   hasnull = 0;
@@ -840,27 +876,30 @@ METHODDEF(boolean) xv_process_app1(j_decompress_ptr cinfo)   /* Geoff H. Kuennin
 METHODDEF boolean  xv_process_app1(j_decompress_ptr cinfo)
 #endif
 {
+  my_error_ptr myerr;
   int          length;
   unsigned int ch;
   byte         *sp;
 
+  myerr = (my_error_ptr) cinfo->err;
+
   length  = j_getc(cinfo) << 8;
   length += j_getc(cinfo);
   length -= 2;                  /* discount the length word itself */
 
-  if (!exifInfo) {
-    exifInfo = (byte *) malloc((size_t) length);
-    exifInfoSize = 0;
+  if (!myerr->exifInfo) {
+    myerr->exifInfo = (byte *) malloc((size_t) length);
+    myerr->exifInfoSize = 0;
   }
   else {
     /* one APP1 data struct only, ignore extra stuff */
     while (length-- > 0)
       (void)j_getc(cinfo);
   }
-  if (!exifInfo) FatalError("out of memory in xv_process_app1 (EXIF info)");
+  if (!myerr->exifInfo) FatalError("out of memory in xv_process_app1 (EXIF info)");
   
-  sp = exifInfo + exifInfoSize;
-  exifInfoSize += length;
+  sp = myerr->exifInfo + myerr->exifInfoSize;
+  myerr->exifInfoSize += length;
 
   while (length-- > 0) {
     ch = j_getc(cinfo);
@@ -884,16 +923,18 @@ static int writeJFIF(FILE *fp, byte *pic, int w, int h, int coltype)
   struct     my_error_mgr         jerr;
   JSAMPROW                        rowptr[1];
   int                             i, bperpix;
-  char                            xvcmt[256];
+  char                            xvcmt[256], *comment;
 
   comment = (char *) NULL;
 
   cinfo.err               = jpeg_std_error(&jerr.pub);
   jerr.pub.error_exit     = xv_error_exit;
   jerr.pub.output_message = xv_error_output;
+  jerr.fbasename          = fbasename;
 
   if (setjmp(jerr.setjmp_buffer)) {
     /* if we're here, it blowed up... */
+    strcpy(errbuffer, jerr.msg);
     jpeg_destroy_compress(&cinfo);
     if (picComments && comment) free(comment);
     return 1;
@@ -0,0 +1,235 @@
+/*
+ * xvloadtest.c - checks that the image loaders are reentrant
+ *
+ *  usage:  xvloadtest [-threads n] [-passes n] file ...
+ *
+ * Decodes every file once, serially, with ReadPicFile(), then decodes all
+ * of them again 'passes' times over, from 'threads' threads at once, and
+ * compares each of those results with the serial one:  any loader that
+ * still keeps its decoding state in static variables will sooner or later
+ * hand back a different (or corrupted) image.  Files that are of an
+ * unknown type, that can't be decoded serially (formats that weren't
+ * compiled in), or that are decoded by running some other program
+ * (PostScript), are skipped.
+ *
+ * Exits 0 if every concurrent decode matched, 1 otherwise.
+ *
+ * Built from xv's own object files, with xv.c's main() renamed out of the
+ * way, so it tests exactly the code that xv runs.
+ */
+
+#include "copyright.h"
+
+#include "xv.h"
+
+#undef main     /* xv.c's is xv_main() in this program */
+
+
+typedef struct {
+  char    *fname;
+  int      ftype;
+  int      quick;
+  PICINFO  ref;                  /* the serial decode */
+} LTFILE;
+
+typedef struct {
+  LTFILE  *files;
+  int      nfiles;
+  int      njobs, next;          /* jobs are (pass, file) pairs */
+  int     *bad;                  /* per job:  0 = matched */
+} LTRUN;
+
+
+int         main       PARM((int, char **));
+static int  ltDecode   PARM((LTFILE *, PICINFO *));
+static int  ltCompare  PARM((PICINFO *, PICINFO *));
+static void ltFree     PARM((PICINFO *));
+static void ltWorker   PARM((void *, int));
+static void ltSyntax   PARM((void));
+
+
+/*******************************************/
+int main(int argc, char **argv)
+{
+  LTFILE *files;
+  LTRUN   run;
+  int     i, nfiles, nthreads, passes, nbad;
+
+  cmd = (char *) "xvloadtest";
+  tmpdir = (char *) getenv("TMPDIR");
+  if (!tmpdir) tmpdir = (char *) "/tmp";
+
+  nthreads = 4;  passes = 4;
+
+  files = (LTFILE *) calloc((size_t) argc, sizeof(LTFILE));
+  if (!files) FatalError("can't malloc file list");
+  nfiles = 0;
+
+  for (i=1; i<argc; i++) {
+    if (!strcmp(argv[i], "-threads") && i+1<argc) {
+      nthreads = atoi(argv[++i]);
+      if (nthreads < 1) nthreads = 1;
+    }
+    else if (!strcmp(argv[i], "-passes") && i+1<argc) {
+      passes = atoi(argv[++i]);
+      if (passes < 1) passes = 1;
+    }
+    else if (argv[i][0] == '-') { ltSyntax();  return 1; }
+    else files[nfiles++].fname = argv[i];
+  }
+
+  if (!nfiles) { ltSyntax();  return 1; }
+
+
+  /* the reference decodes */
+  for (i=0; i<nfiles; i++) {
+    LTFILE *lf = &files[i];
+
+    lf->ftype = ReadFileType(lf->fname);
+
+    /* without a dialog to ask with, LoadPCD() wants a size, and 'quick'
+       is the only way to give it one from here */
+    lf->quick = (lf->ftype == RFT_PCD);
+
+    if (lf->ftype == RFT_ERROR || lf->ftype == RFT_UNKNOWN ||
+	lf->ftype == RFT_PS    || lf->ftype == RFT_COMPRESS ||
+	lf->ftype == RFT_BZIP2 || lf->ftype == RFT_XZ ||
+	!ltDecode(lf, &lf->ref)) {
+      printf("%s:  skipped\n", lf->fname);
+      files[i--] = files[--nfiles];      /* (nothing to free) */
+      continue;
+    }
+
+    printf("%s:  %dx%d, %d-bit\n", lf->fname, lf->ref.w, lf->ref.h,
+	   lf->ref.type == PIC24 ? 24 : 8);
+  }
+
+  if (!nfiles) {
+    printf("nothing to test\n");
+    return 0;
+  }
+
+
+  /* and the concurrent ones.  consecutive jobs are different files, so
+     different loaders (and different files of one format) overlap */
+  run.files  = files;
+  run.nfiles = nfiles;
+  run.njobs  = nfiles * passes;
+  run.next   = 0;
+  run.bad    = (int *) calloc((size_t) run.njobs, sizeof(int));
+  if (!run.bad) FatalError("can't malloc job list");
+
+  ParallelRun(nthreads, ltWorker, (void *) &run);
+
+  nbad = 0;
+  for (i=0; i<run.njobs; i++) {
+    if (run.bad[i]) {
+      printf("%s:  pass %d didn't match the serial decode\n",
+	     files[i % nfiles].fname, i / nfiles + 1);
+      nbad++;
+    }
+  }
+
+  printf("%d decodes on %d threads:  %d mismatched\n",
+	 run.njobs, nthreads, nbad);
+
+  for (i=0; i<nfiles; i++) ltFree(&files[i].ref);
+  free(run.bad);
+  free(files);
+
+  return (nbad ? 1 : 0);
+}
+
+
+/*******************************************/
+static void ltWorker(void *data, int worker)
+{
+  LTRUN   *run = (LTRUN *) data;
+  LTFILE  *lf;
+  PICINFO  pinfo;
+  int      job;
+
+  XV_UNUSED(worker);
+
+  while ((job = ParallelNext(&run->next, run->njobs)) >= 0) {
+    lf = &run->files[job % run->nfiles];
+
+    if (!ltDecode(lf, &pinfo)) { run->bad[job] = 1;  continue; }
+    run->bad[job] = ltCompare(&lf->ref, &pinfo);
+    ltFree(&pinfo);
+  }
+}
+
+
+/*******************************************/
+static int ltDecode(LTFILE *lf, PICINFO *pinfo)
+{
+  /* returns '1' if the file was decoded into 'pinfo' */
+
+  bzero((char *) pinfo, sizeof(PICINFO));
+  if (ReadPicFile(lf->fname, lf->ftype, pinfo, lf->quick) && pinfo->pic)
+    return 1;
+
+  ltFree(pinfo);
+  return 0;
+}
+
+
+/*******************************************/
+static int ltCompare(PICINFO *a, PICINFO *b)
+{
+  /* returns '0' if 'a' and 'b' hold the same image */
+
+  size_t n;
+
+  if (a->w != b->w || a->h != b->h || a->type != b->type ||
+      a->normw != b->normw || a->normh != b->normh ||
+      a->frmType != b->frmType || a->colType != b->colType ||
+      strcmp(a->fullInfo, b->fullInfo) || strcmp(a->shrtInfo, b->shrtInfo))
+    return 1;
+
+  n = (size_t) a->w * a->h * (a->type == PIC24 ? 3 : 1);
+  if (memcmp(a->pic, b->pic, n)) return 1;
+
+  if (a->type == PIC8 &&
+      (memcmp(a->r, b->r, sizeof(a->r)) || memcmp(a->g, b->g, sizeof(a->g)) ||
+       memcmp(a->b, b->b, sizeof(a->b))))
+    return 1;
+
+  if ((a->comment == NULL) != (b->comment == NULL) ||
+      (a->comment && strcmp(a->comment, b->comment)))
+    return 1;
+
+  if (a->exifInfoSize != b->exifInfoSize ||
+      (a->exifInfoSize && memcmp(a->exifInfo, b->exifInfo,
+				 (size_t) a->exifInfoSize)))
+    return 1;
+
+  if ((a->deep == NULL) != (b->deep == NULL)) return 1;
+  if (a->deep) {
+    if (a->deepSpp != b->deepSpp || a->deepMax != b->deepMax) return 1;
+    n = (size_t) a->w * a->h * a->deepSpp * sizeof(u_short);
+    if (memcmp(a->deep, b->deep, n)) return 1;
+  }
+
+  return 0;
+}
+
+
+/*******************************************/
+static void ltFree(PICINFO *pinfo)
+{
+  if (pinfo->numpages > 1) KillPageFiles(pinfo->pagebname, pinfo->numpages);
+  if (pinfo->pic)      free(pinfo->pic);
+  if (pinfo->comment)  free(pinfo->comment);
+  if (pinfo->exifInfo) free(pinfo->exifInfo);
+  if (pinfo->deep)     free(pinfo->deep);
+  bzero((char *) pinfo, sizeof(PICINFO));
+}
+
+
+/*******************************************/
+static void ltSyntax(void)
+{
+  fprintf(stderr, "usage:  %s [-threads n] [-passes n] file ...\n", cmd);
+}
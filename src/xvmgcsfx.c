@@ -1467,9 +1467,11 @@ LoadMGCSFX(file_name, pinfo)
     rv = 0;
   }
 
-  /* fail if pid still == -2? */
-  while(wait(&pst) != pid);  /* FIXME?  pid isn't necessarily initialized... */
-  if( *((char *)&pst) != 0 ) rv = 0;
+  /* reap our own filter, and nobody else's:  another load may have one
+     running, too.  (pid is still -2 if no filter was started) */
+  if (pid > 0) {
+    if (waitpid(pid, &pst, 0) != pid || *((char *)&pst) != 0) rv = 0;
+  }
 
   input_command_ex_flag = 0;
 
@@ -1991,6 +1993,12 @@ static int writeMGCSFX()
 
   WaitCursor();
   inpix = GenSavePic(&ptype, &w, &h, &pfree, &nc, &rmap, &gmap, &bmap);
+  if (!inpix) {
+    close(file);
+    CloseOutFileWhy(NULL, fullname, 1, "not enough memory");
+    SetCursors(-1);
+    return rv;
+  }
 
   rv = WriteMGCSFX(&fp, inpix, ptype, w, h,
 		   rmap, gmap, bmap, nc, colorType, fullname,
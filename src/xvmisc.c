@@ -375,8 +375,9 @@ void xvDestroyImage(XImage *image)
      systems.  Also, can be called with a NULL image pointer */
 
   if (image) {
-    /* free data by hand, since XDestroyImage is vague about it */
-    if (image->data) free(image->data);
+    /* free data by hand, since XDestroyImage is vague about it.
+       it may have come from PoolAlloc() */
+    if (image->data) PoolFree(image->data);
     image->data = NULL;
     XDestroyImage(image);
   }
@@ -505,6 +506,7 @@ void Quit(int i)
 
   if (useroot && i==0) {   /* save the root info */
     SaveRootInfo();
+    FreeRootTiles();
 
     /* kill the various windows, since we're in RetainPermanent mode now */
     if (dirW)  XDestroyWindow(theDisp, dirW);
@@ -562,6 +564,7 @@ void Quit(int i)
   }
 
   KillPageFiles(pageBaseName, numPages);
+  KillPageDoc();
 
 
   if (autoDelete) {  /* delete all files listed on command line */
@@ -584,6 +587,8 @@ void Quit(int i)
     }
   }
 
+  if (DEBUG) PoolStats(stderr);
+
   if (InSignal == 0)
   XSync(theDisp, False);
   exit(i);
@@ -658,6 +663,8 @@ void WaitCursor(void)
   XWMHints xwmh;
   time_t   nowT;
 
+  if (!theDisp) return;    /* batch mode */
+
   if (!waiting) {
     time(&lastwaittime);
     waiting=1;
@@ -689,6 +696,8 @@ void SetCursors(int n)
   /* if n < 0   sets normal cursor in all windows
      n = 0..6   cycles through fish cursors */
 
+  if (!theDisp) return;    /* batch mode */
+
   if (n<0) {
     if (waiting) {
       waiting=0;
@@ -35,19 +35,44 @@ typedef unsigned char   uch;
 
 #define TRUNCSTR "File appears to be truncated."
 
-static int garbage;
-static long numgot, filesize;
-
-static int loadpbm  PARM((FILE *, PICINFO *, int));
-static int loadpgm  PARM((FILE *, PICINFO *, int, int));
-static int loadppm  PARM((FILE *, PICINFO *, int, int));
-static int loadpam  PARM((FILE *, PICINFO *, int, int));
-static int getint   PARM((FILE *, PICINFO *));
-static int getbit   PARM((FILE *, PICINFO *));
-static int getshort PARM((FILE *));
-static int pbmError PARM((const char *, const char *));
-
-static const char *bname;
+/* ASCII image data is parsed out of a private buffer rather than with a
+   getc() per character.  Only used once the header has been read. */
+#define TOKBUFSIZE 16384
+
+/* per-file loader state, so that several files can be read at once */
+typedef struct { FILE       *fp;
+		 const char *bname;
+		 long        filesize;
+		 long        numgot;     /* # of values read from the data */
+		 int         garbage;    /* saw non-whitespace junk */
+	       } PBMDEC;
+
+typedef struct { PBMDEC *pd;
+		 FILE   *fp;
+		 int     pos, len;
+		 byte    buf[TOKBUFSIZE];
+	       } TOKBUF;
+
+#define TOKGETC(tb) (((tb)->pos < (tb)->len || tokfill(tb)) ? \
+		     (int) (tb)->buf[(tb)->pos++] : EOF)
+
+/* raw 16-bit samples are read this many at a time, then reduced to 8 bits */
+#define RAW16CHUNK (256*1024)
+
+static int  loadpbm  PARM((PBMDEC *, PICINFO *, int));
+static int  loadpgm  PARM((PBMDEC *, PICINFO *, int, int));
+static int  loadppm  PARM((PBMDEC *, PICINFO *, int, int));
+static int  loadpam  PARM((PBMDEC *, PICINFO *, int, int));
+static int  getint   PARM((PBMDEC *, PICINFO *));
+static void addcomment PARM((PICINFO *, char *));
+static int  tokfill  PARM((TOKBUF *));
+static int  tokcomment PARM((TOKBUF *, PICINFO *));
+static int  tokint   PARM((TOKBUF *, PICINFO *));
+static int  tokbit   PARM((TOKBUF *, PICINFO *));
+static long read16   PARM((FILE *, byte *, long, int, const byte *,
+			    u_short *));
+static u_short *deepAlloc PARM((PICINFO *, long, int, int));
+static int  pbmError PARM((const char *, const char *));
 
 
 #ifdef HAVE_MGCSFX
@@ -128,7 +153,7 @@ int LoadPBM(char *fname, PICINFO *pinfo)
 {
   /* returns '1' on success */
 
-  FILE  *fp;
+  PBMDEC pd;
   int    c, c1;
   int    maxv, rv;
 
@@ -136,37 +161,39 @@ int LoadPBM(char *fname, PICINFO *pinfo)
   pipefdr = fd;
 #endif
 
-  garbage = maxv = rv = 0;
-  bname = BaseName(fname);
+  pd.garbage = maxv = rv = 0;
+  pd.numgot = pd.filesize = 0;
+  pd.bname = BaseName(fname);
 
   pinfo->pic     = (byte *) NULL;
   pinfo->comment = (char *) NULL;
+  pinfo->deep    = (u_short *) NULL;
 
 
 #ifdef HAVE_MGCSFX
   if(fd < 0){
     /* open the file */
-    fp = xv_fopen(fname,"r");
-    if (!fp) return (pbmError(bname, "can't open file"));
+    pd.fp = xv_fopen(fname,"r");
+    if (!pd.fp) return (pbmError(pd.bname, "can't open file"));
 
     /* compute file length */
-    fseek(fp, 0L, 2);
-    filesize = ftell(fp);
-    fseek(fp, 0L, 0);
+    fseek(pd.fp, 0L, 2);
+    pd.filesize = ftell(pd.fp);
+    fseek(pd.fp, 0L, 0);
   }else{
-    fp = fdopen(fd, "r");
-    if (!fp) return (pbmError(bname, "can't open file"));
-    filesize = 0; /* dummy */
+    pd.fp = fdopen(fd, "r");
+    if (!pd.fp) return (pbmError(pd.bname, "can't open file"));
+    pd.filesize = 0; /* dummy */
   }
 #else
   /* open the file */
-  fp = xv_fopen(fname,"r");
-  if (!fp) return (pbmError(bname, "can't open file"));
+  pd.fp = xv_fopen(fname,"r");
+  if (!pd.fp) return (pbmError(pd.bname, "can't open file"));
 
   /* compute file length */
-  fseek(fp, 0L, 2);
-  filesize = ftell(fp);
-  fseek(fp, 0L, 0);
+  fseek(pd.fp, 0L, 2);
+  pd.filesize = ftell(pd.fp);
+  fseek(pd.fp, 0L, 0);
 #endif /* HAVE_MGCSFX */
 
 
@@ -175,26 +202,26 @@ int LoadPBM(char *fname, PICINFO *pinfo)
      "P3" = ascii pixmap, "P4" = raw bitmap, "P5" = raw greymap,
      "P6" = raw pixmap */
 
-  c = getc(fp);  c1 = getc(fp);
+  c = getc(pd.fp);  c1 = getc(pd.fp);
   if (c!='P' || c1<'1' || (c1>'6' && c1!='8'))	/* GRR alpha */
-    return(pbmError(bname, "unknown format"));
+    return(pbmError(pd.bname, "unknown format"));
 
   /* read in header information */
-  pinfo->w = getint(fp, pinfo);  pinfo->h = getint(fp, pinfo);
+  pinfo->w = getint(&pd, pinfo);  pinfo->h = getint(&pd, pinfo);
   pinfo->normw = pinfo->w;   pinfo->normh = pinfo->h;
 
   /* if we're not reading a bitmap, read the 'max value' */
   if ( !(c1=='1' || c1=='4')) {
-    maxv = getint(fp, pinfo);
-    if (maxv < 1) garbage=1;    /* to avoid 'div by zero' probs */
+    maxv = getint(&pd, pinfo);
+    if (maxv < 1) pd.garbage=1;    /* to avoid 'div by zero' probs */
   }
 
 
-  if (garbage) {
-    fclose(fp);
+  if (pd.garbage) {
+    fclose(pd.fp);
     if (pinfo->comment) free(pinfo->comment);
     pinfo->comment = (char *) NULL;
-    return (pbmError(bname, "Garbage characters in header."));
+    return (pbmError(pd.bname, "Garbage characters in header."));
   }
 
 
@@ -205,18 +232,20 @@ int LoadPBM(char *fname, PICINFO *pinfo)
      picinfo struct are filled in in the format-specific loaders */
 
   /* call the appropriate subroutine to handle format-specific stuff */
-  if      (c1=='1' || c1=='4') rv = loadpbm(fp, pinfo, c1=='4' ? 1 : 0);
-  else if (c1=='2' || c1=='5') rv = loadpgm(fp, pinfo, c1=='5' ? 1 : 0, maxv);
-  else if (c1=='3' || c1=='6') rv = loadppm(fp, pinfo, c1=='6' ? 1 : 0, maxv);
-  else if            (c1=='8') rv = loadpam(fp, pinfo,           1    , maxv);
+  if      (c1=='1' || c1=='4') rv = loadpbm(&pd, pinfo, c1=='4' ? 1 : 0);
+  else if (c1=='2' || c1=='5') rv = loadpgm(&pd, pinfo, c1=='5' ? 1 : 0, maxv);
+  else if (c1=='3' || c1=='6') rv = loadppm(&pd, pinfo, c1=='6' ? 1 : 0, maxv);
+  else if            (c1=='8') rv = loadpam(&pd, pinfo,           1    , maxv);
 
-  fclose(fp);
+  fclose(pd.fp);
 
   if (!rv) {
     if (pinfo->pic) free(pinfo->pic);
     if (pinfo->comment) free(pinfo->comment);
+    if (pinfo->deep) free(pinfo->deep);
     pinfo->pic     = (byte *) NULL;
     pinfo->comment = (char *) NULL;
+    pinfo->deep    = (u_short *) NULL;
   }
 
   return rv;
@@ -225,7 +254,7 @@ int LoadPBM(char *fname, PICINFO *pinfo)
 
 
 /*******************************************/
-static int loadpbm(FILE *fp, PICINFO *pinfo, int raw)
+static int loadpbm(PBMDEC *pd, PICINFO *pinfo, int raw)
 {
   byte *pic8;
   byte *pix;
@@ -241,7 +270,7 @@ static int loadpbm(FILE *fp, PICINFO *pinfo, int raw)
   pixchk *= (uint64_t)h;
 
   if (w <= 0 || h <= 0 || (uint64_t)npixels != pixchk)
-    return pbmError(bname, "image dimensions too large");
+    return pbmError(pd->bname, "image dimensions too large");
 
   pic8 = (byte *) calloc((size_t) npixels, (size_t) 1);
   if (!pic8) FatalError("couldn't malloc 'pic8' for PBM");
@@ -249,7 +278,7 @@ static int loadpbm(FILE *fp, PICINFO *pinfo, int raw)
   pinfo->pic  = pic8;
   pinfo->type = PIC8;
   sprintf(pinfo->fullInfo, "PBM, %s format.  (%ld bytes)",
-	  (raw) ? "raw" : "ascii", filesize);
+	  (raw) ? "raw" : "ascii", pd->filesize);
   sprintf(pinfo->shrtInfo, "%dx%d PBM.", w, h);
   pinfo->colType = F_BWDITHER;
 
@@ -260,15 +289,18 @@ static int loadpbm(FILE *fp, PICINFO *pinfo, int raw)
 
 
   if (!raw) {
-    numgot = 0;
+    TOKBUF tb;
+
+    tb.pd = pd;  tb.fp = pd->fp;  tb.pos = tb.len = 0;
+    pd->numgot = 0;
     for (i=0, pix=pic8; i<h; i++) {
       if ((i&0x3f)==0) WaitCursor();
-      for (j=0; j<w; j++, pix++) *pix = getbit(fp, pinfo);
+      for (j=0; j<w; j++, pix++) *pix = tokbit(&tb, pinfo);
     }
 
-    if (numgot != npixels) pbmError(bname, TRUNCSTR);
-    if (garbage) {
-      return(pbmError(bname, "Garbage characters in image data."));
+    if (pd->numgot != npixels) pbmError(pd->bname, TRUNCSTR);
+    if (pd->garbage) {
+      return(pbmError(pd->bname, "Garbage characters in image data."));
     }
   }
 
@@ -282,7 +314,7 @@ static int loadpbm(FILE *fp, PICINFO *pinfo, int raw)
 
 	bit &= 7;
 	if (!bit) {
-	  k = getc(fp);
+	  k = getc(pd->fp);
 	  if (k==EOF) { trunc=1; k=0; }
 	}
 
@@ -291,7 +323,7 @@ static int loadpbm(FILE *fp, PICINFO *pinfo, int raw)
       }
     }
 
-    if (trunc) pbmError(bname, TRUNCSTR);
+    if (trunc) pbmError(pd->bname, TRUNCSTR);
   }
 
   return 1;
@@ -299,10 +331,11 @@ static int loadpbm(FILE *fp, PICINFO *pinfo, int raw)
 
 
 /*******************************************/
-static int loadpgm(FILE *fp, PICINFO *pinfo, int raw, int maxv)
+static int loadpgm(PBMDEC *pd, PICINFO *pinfo, int raw, int maxv)
 {
-  byte *pix, *pic8;
-  int   i,j,bitshift,w,h,npixels, holdmaxv;
+  byte    *pix, *pic8;
+  u_short *deep;
+  int      i,j,v,bitshift,w,h,npixels, holdmaxv;
   uint64_t pixchk;
 
   w = pinfo->w;
@@ -314,7 +347,7 @@ static int loadpgm(FILE *fp, PICINFO *pinfo, int raw, int maxv)
   pixchk *= (uint64_t)h;
 
   if (w <= 0 || h <= 0 || (uint64_t)npixels != pixchk)
-    return pbmError(bname, "image dimensions too large");
+    return pbmError(pd->bname, "image dimensions too large");
 
   pic8 = (byte *) calloc((size_t) npixels, (size_t) 1);
   if (!pic8) FatalError("couldn't malloc 'pic8' for PGM");
@@ -323,7 +356,7 @@ static int loadpgm(FILE *fp, PICINFO *pinfo, int raw, int maxv)
   pinfo->pic  = pic8;
   pinfo->type = PIC8;
   sprintf(pinfo->fullInfo, "PGM, %s format.  (%ld bytes)",
-	  (raw) ? "raw" : "ascii", filesize);
+	  (raw) ? "raw" : "ascii", pd->filesize);
   sprintf(pinfo->shrtInfo, "%dx%d PGM.", pinfo->w, pinfo->h);
   pinfo->colType = F_GREYSCALE;
 
@@ -337,28 +370,40 @@ static int loadpgm(FILE *fp, PICINFO *pinfo, int raw, int maxv)
   for (i=0; i<=maxv; i++)
     pinfo->r[i] = pinfo->g[i] = pinfo->b[i] = (i*255)/maxv;
 
+  deep = deepAlloc(pinfo, (long) npixels, 1, holdmaxv);
+
 
-  numgot = 0;
+  pd->numgot = 0;
 
   if (!raw) {
+    TOKBUF tb;
+
+    tb.pd = pd;  tb.fp = pd->fp;  tb.pos = tb.len = 0;
     for (i=0, pix=pic8; i<h; i++) {
       if ((i&0x3f)==0) WaitCursor();
-      for (j=0; j<w; j++, pix++)
-	*pix = (byte) (getint(fp, pinfo) >> bitshift);
+      for (j=0; j<w; j++, pix++) {
+	v = tokint(&tb, pinfo);
+	*pix = (byte) (v >> bitshift);
+	if (deep) *deep++ = (u_short) ((v > holdmaxv) ? holdmaxv : v);
+      }
     }
   }
   else { /* raw */
     if (holdmaxv>255) {
-      for (i=0, pix=pic8; i<h; i++) {
-	if ((i&0x3f)==0) WaitCursor();
-	for (j=0; j<w; j++, pix++)
-	  *pix = (byte) (getshort(fp) >> bitshift);
-      }
+      /* the colormap does the rescaling; the samples just lose bits */
+      byte *lut = (byte *) malloc((size_t) 65536);
+      if (!lut) FatalError("couldn't malloc 'lut' for PGM");
+
+      for (i=0; i<65536; i++)
+	lut[i] = (byte) (((i > holdmaxv) ? holdmaxv : i) >> bitshift);
+
+      pd->numgot = read16(pd->fp, pic8, (long) npixels, holdmaxv, lut, deep);
+      free(lut);
     }
     else {
 #ifdef FIX_PIPE_ERROR
   reread:
-      numgot += fread(pic8 + numgot, (size_t) 1, (size_t) w*h - numgot, fp); /* read raw data */
+      pd->numgot += fread(pic8 + pd->numgot, (size_t) 1, (size_t) w*h - pd->numgot, pd->fp); /* read raw data */
       if(errno == EINTR){
         if(DEBUG){
 	  fprintf(stderr,
@@ -368,15 +413,15 @@ static int loadpgm(FILE *fp, PICINFO *pinfo, int raw, int maxv)
 	goto reread;
       }
 #else
-      numgot = fread(pic8, (size_t)1, (size_t)npixels, fp);  /* read raw data */
+      pd->numgot = fread(pic8, (size_t)1, (size_t)npixels, pd->fp);  /* read raw data */
 #endif
     }
   }
 
-  if (numgot != npixels) pbmError(bname, TRUNCSTR);   /* warning only */
+  if (pd->numgot != npixels) pbmError(pd->bname, TRUNCSTR);   /* warning only */
 
-  if (garbage) {
-    return (pbmError(bname, "Garbage characters in image data."));
+  if (pd->garbage) {
+    return (pbmError(pd->bname, "Garbage characters in image data."));
   }
 
   return 1;
@@ -384,10 +429,11 @@ static int loadpgm(FILE *fp, PICINFO *pinfo, int raw, int maxv)
 
 
 /*******************************************/
-static int loadppm(FILE *fp, PICINFO *pinfo, int raw, int maxv)
+static int loadppm(PBMDEC *pd, PICINFO *pinfo, int raw, int maxv)
 {
-  byte *pix, *pic24, scale[256];
-  int   i,j,bitshift, w, h, npixels, bufsize, holdmaxv;
+  byte    *pix, *pic24, scale[256];
+  u_short *deep;
+  int      i,j,v,bitshift, w, h, npixels, bufsize, holdmaxv;
   uint64_t  bufchk, pixchk;
 
   w = pinfo->w;
@@ -402,7 +448,7 @@ static int loadppm(FILE *fp, PICINFO *pinfo, int raw, int maxv)
   bufchk *= 3ULL;
 
   if (w <= 0 || h <= 0 || (uint64_t)npixels != pixchk || (uint64_t)bufsize != bufchk)
-    return pbmError(bname, "image dimensions too large");
+    return pbmError(pd->bname, "image dimensions too large");
 
   /* allocate 24-bit image */
   pic24 = (byte *) calloc((size_t) bufsize, (size_t) 1);
@@ -411,7 +457,7 @@ static int loadppm(FILE *fp, PICINFO *pinfo, int raw, int maxv)
   pinfo->pic  = pic24;
   pinfo->type = PIC24;
   sprintf(pinfo->fullInfo, "PPM, %s format.  (%ld bytes)",
-	  (raw) ? "raw" : "ascii", filesize);
+	  (raw) ? "raw" : "ascii", pd->filesize);
   sprintf(pinfo->shrtInfo, "%dx%d PPM.", w, h);
   pinfo->colType = F_FULLCOLOR;
 
@@ -421,28 +467,43 @@ static int loadppm(FILE *fp, PICINFO *pinfo, int raw, int maxv)
   bitshift = 0;
   while (maxv>255) { maxv = maxv>>1;  bitshift++; }
 
+  deep = deepAlloc(pinfo, (long) npixels, 3, holdmaxv);
+
 
-  numgot = 0;
+  pd->numgot = 0;
 
   if (!raw) {
+    TOKBUF tb;
+
+    tb.pd = pd;  tb.fp = pd->fp;  tb.pos = tb.len = 0;
     for (i=0, pix=pic24; i<h; i++) {
       if ((i&0x3f)==0) WaitCursor();
-      for (j=0; j<w*3; j++, pix++)
-	*pix = (byte) (getint(fp, pinfo) >> bitshift);
+      for (j=0; j<w*3; j++, pix++) {
+	v = tokint(&tb, pinfo);
+	*pix = (byte) (v >> bitshift);
+	if (deep) *deep++ = (u_short) ((v > holdmaxv) ? holdmaxv : v);
+      }
     }
   }
   else { /* raw */
     if (holdmaxv>255) {
-      for (i=0, pix=pic24; i<h; i++) {
-	if ((i&0x3f)==0) WaitCursor();
-	for (j=0; j<w*3; j++,pix++)
-	  *pix = (byte) (getshort(fp) >> bitshift);
+      /* drop the extra bits and rescale to 0-255 in one table lookup */
+      byte *lut = (byte *) malloc((size_t) 65536);
+      if (!lut) FatalError("couldn't malloc 'lut' for PPM");
+
+      for (i=0; i<65536; i++) {
+	j = ((i > holdmaxv) ? holdmaxv : i) >> bitshift;
+	lut[i] = (byte) ((maxv<255) ? (j * 255) / maxv : j);
       }
+
+      pd->numgot = read16(pd->fp, pic24, (long) bufsize, holdmaxv, lut, deep);
+      free(lut);
+      maxv = 255;     /* already scaled */
     }
     else {
 #ifdef FIX_PIPE_ERROR
   reread:
-      numgot += fread(pic24 + numgot, (size_t) 1, (size_t) w*h*3 - numgot, fp);  /* read data */
+      pd->numgot += fread(pic24 + pd->numgot, (size_t) 1, (size_t) w*h*3 - pd->numgot, pd->fp);  /* read data */
       if(errno == EINTR){
         if(DEBUG){
 	  fprintf(stderr,
@@ -452,15 +513,15 @@ static int loadppm(FILE *fp, PICINFO *pinfo, int raw, int maxv)
 	goto reread;
       }
 #else
-      numgot = fread(pic24, (size_t) 1, (size_t) bufsize, fp);  /* read data */
+      pd->numgot = fread(pic24, (size_t) 1, (size_t) bufsize, pd->fp);  /* read data */
 #endif
     }
   }
 
-  if (numgot != bufsize) pbmError(bname, TRUNCSTR);
+  if (pd->numgot != bufsize) pbmError(pd->bname, TRUNCSTR);
 
-  if (garbage)
-    return(pbmError(bname, "Garbage characters in image data."));
+  if (pd->garbage)
+    return(pbmError(pd->bname, "Garbage characters in image data."));
 
 
   /* have to scale up all RGB values (Conv24to8 expects RGB values to
@@ -480,7 +541,7 @@ static int loadppm(FILE *fp, PICINFO *pinfo, int raw, int maxv)
 
 
 /*******************************************/
-static int loadpam(FILE *fp, PICINFO *pinfo, int raw, int maxv)	/* unofficial RGBA extension */
+static int loadpam(PBMDEC *pd, PICINFO *pinfo, int raw, int maxv)	/* unofficial RGBA extension */
 {
   byte *p, *pix, *pic24, *linebuf, scale[256], bgR, bgG, bgB, r, g, b, a;
   int   i, j, w, h, npixels, bufsize, linebufsize, holdmaxv;
@@ -503,7 +564,7 @@ static int loadpam(FILE *fp, PICINFO *pinfo, int raw, int maxv)	/* unofficial RG
 
   if (w <= 0 || h <= 0 || (uint64_t)npixels != pixchk || (uint64_t)bufsize != bufchk ||
       (uint64_t)linebufsize != lnbchk)
-    return pbmError(bname, "image dimensions too large");
+    return pbmError(pd->bname, "image dimensions too large");
 
   /* allocate 24-bit image */
   pic24 = (byte *) calloc((size_t) bufsize, (size_t) 1);
@@ -519,7 +580,7 @@ static int loadpam(FILE *fp, PICINFO *pinfo, int raw, int maxv)	/* unofficial RG
   pinfo->pic  = pic24;
   pinfo->type = PIC24;
   sprintf(pinfo->fullInfo, "PAM, %s format.  (%ld bytes)",
-	  (raw) ? "raw" : "ascii", filesize);
+	  (raw) ? "raw" : "ascii", pd->filesize);
   sprintf(pinfo->shrtInfo, "%dx%d PAM.", w, h);
   pinfo->colType = F_FULLCOLOR;
 
@@ -530,10 +591,10 @@ static int loadpam(FILE *fp, PICINFO *pinfo, int raw, int maxv)	/* unofficial RG
   while (maxv>255) { maxv = maxv>>1;  /* bitshift++; */ }
 
 
-  numgot = 0;
+  pd->numgot = 0;
 
   if (!raw) {					/* GRR:  not alpha-ready */
-    return pbmError(bname, "can't handle non-raw PAM image");
+    return pbmError(pd->bname, "can't handle non-raw PAM image");
 /*
     for (i=0, pix=pic24; i<h; i++) {
       if ((i&0x3f)==0) WaitCursor();
@@ -544,7 +605,7 @@ static int loadpam(FILE *fp, PICINFO *pinfo, int raw, int maxv)	/* unofficial RG
   }
   else { /* raw */
     if (holdmaxv>255) {				/* GRR:  not alpha-ready */
-      return pbmError(bname, "can't handle PAM image with maxval > 255");
+      return pbmError(pd->bname, "can't handle PAM image with maxval > 255");
 /*
       for (i=0, pix=pic24; i<h; i++) {
 	if ((i&0x3f)==0) WaitCursor();
@@ -562,7 +623,7 @@ static int loadpam(FILE *fp, PICINFO *pinfo, int raw, int maxv)	/* unofficial RG
         bgR = bgG = bgB = 0;
       }
       for (i=0, pix=pic24; i<h; i++) {
-        numgot += fread(linebuf, (size_t) 1, (size_t) linebufsize, fp);  /* read data */
+        pd->numgot += fread(linebuf, (size_t) 1, (size_t) linebufsize, pd->fp);  /* read data */
 	if ((i&0x3f)==0) WaitCursor();
 	for (j=0, p=linebuf; j<w; j++) {
           r = *p++;
@@ -580,10 +641,10 @@ static int loadpam(FILE *fp, PICINFO *pinfo, int raw, int maxv)	/* unofficial RG
   free(linebuf);
 
   /* in principle this could overflow, but not critical */
-  if (numgot != w*h*4) pbmError(bname, TRUNCSTR);
+  if (pd->numgot != w*h*4) pbmError(pd->bname, TRUNCSTR);
 
-  if (garbage)
-    return(pbmError(bname, "Garbage characters in image data."));
+  if (pd->garbage)
+    return(pbmError(pd->bname, "Garbage characters in image data."));
 
 
   /* have to scale up all RGB values (Conv24to8 expects RGB values to
@@ -604,7 +665,7 @@ static int loadpam(FILE *fp, PICINFO *pinfo, int raw, int maxv)	/* unofficial RG
 
 
 /*******************************************/
-static int getint(FILE *fp, PICINFO *pinfo)
+static int getint(PBMDEC *pd, PICINFO *pinfo)
 {
   int c, i, firstchar;
 
@@ -612,15 +673,15 @@ static int getint(FILE *fp, PICINFO *pinfo)
      line are appended to the comment string */
 
   /* skip forward to start of next number */
-  c = getc(fp);
+  c = getc(pd->fp);
   while (1) {
     /* eat comments */
     if (c=='#') {   /* if we're at a comment, read to end of line */
-      char cmt[256], *sp, *tmpptr;
+      char cmt[256], *sp;
 
       sp = cmt;  firstchar = 1;
       while (1) {
-	c=getc(fp);
+	c=getc(pd->fp);
 	if (firstchar && c == ' ') firstchar = 0;  /* lop off 1 sp after # */
 	else {
 	  if (c == '\n' || c == EOF) break;
@@ -630,29 +691,16 @@ static int getint(FILE *fp, PICINFO *pinfo)
       *sp++ = '\n';
       *sp   = '\0';
 
-      if (strlen(cmt) > (size_t) 0) {    /* add to pinfo->comment */
-	if (!pinfo->comment) {
-	  pinfo->comment = (char *) malloc(strlen(cmt)+1);
-	  if (!pinfo->comment) FatalError("malloc failure in xvpbm.c getint");
-	  pinfo->comment[0] = '\0';
-	}
-	else {
-	  tmpptr = (char *) realloc(pinfo->comment,
-		      strlen(pinfo->comment) + strlen(cmt) + 1);
-	  if (!tmpptr) FatalError("realloc failure in xvpbm.c getint");
-	  pinfo->comment = tmpptr;
-	}
-	strcat(pinfo->comment, cmt);
-      }
+      addcomment(pinfo, cmt);
     }
 
     if (c==EOF) return 0;
     if (c>='0' && c<='9') break;   /* we've found what we were looking for */
 
     /* see if we are getting garbage (non-whitespace) */
-    if (c!=' ' && c!='\t' && c!='\r' && c!='\n' && c!=',') garbage=1;
+    if (c!=' ' && c!='\t' && c!='\r' && c!='\n' && c!=',') pd->garbage=1;
 
-    c = getc(fp);
+    c = getc(pd->fp);
   }
 
 
@@ -660,99 +708,202 @@ static int getint(FILE *fp, PICINFO *pinfo)
   i = 0;
   while (1) {
     i = (i*10) + (c - '0');
-    c = getc(fp);
+    c = getc(pd->fp);
     if (c==EOF) return i;
     if (c<'0' || c>'9') break;
   }
 
-  numgot++;
+  pd->numgot++;
   return i;
 }
 
 
 
 /*******************************************/
-static int getshort(FILE *fp)
+static void addcomment(PICINFO *pinfo, char *cmt)
 {
-  /* used in RAW mode to read 16-bit values */
+  /* appends 'cmt' to pinfo->comment */
+  char *tmpptr;
 
-  int c1, c2;
+  if (strlen(cmt) == (size_t) 0) return;
 
-  c1 = getc(fp);
-  if (c1 == EOF) return 0;
-  c2 = getc(fp);
-  if (c2 == EOF) return 0;
+  if (!pinfo->comment) {
+    pinfo->comment = (char *) malloc(strlen(cmt)+1);
+    if (!pinfo->comment) FatalError("malloc failure in xvpbm.c addcomment");
+    pinfo->comment[0] = '\0';
+  }
+  else {
+    tmpptr = (char *) realloc(pinfo->comment,
+			      strlen(pinfo->comment) + strlen(cmt) + 1);
+    if (!tmpptr) FatalError("realloc failure in xvpbm.c addcomment");
+    pinfo->comment = tmpptr;
+  }
+  strcat(pinfo->comment, cmt);
+}
 
-  numgot++;
 
-  /* Sometime after 1995, NetPBM's ppm(5) man page was changed to say, "Each
-   * sample is represented in pure binary by either 1 or 2 bytes.  If the
-   * Maxval is less than  256, it is 1 byte.  Otherwise, it is 2 bytes.  The
-   * most significant byte is first."  This change is incompatible with
-   * images created for viewing with all previous versions of XV, however,
-   * so both approaches are left available as a compile-time option.  (Could
-   * make it runtime-selectable, too, but unclear whether anybody cares.) */
-#ifdef ASSUME_RAW_PPM_LSB_FIRST  /* legacy approach */
-  return (c2 << 8) | c1;
-#else /* MSB first */
-  return (c1 << 8) | c2;
-#endif
+
+/*******************************************/
+static int tokfill(TOKBUF *tb)
+{
+  tb->pos = 0;
+  tb->len = (int) fread(tb->buf, (size_t) 1, (size_t) TOKBUFSIZE, tb->fp);
+  return (tb->len > 0);
 }
 
 
 
 /*******************************************/
-static int getbit(FILE *fp, PICINFO *pinfo)
+static int tokcomment(TOKBUF *tb, PICINFO *pinfo)
 {
-  int c;
+  /* called just past a '#'.  Appends the rest of the line to the comment,
+     and returns the character that ended it ('\n' or EOF) */
 
-  /* skip forward to start of next number */
-  c = getc(fp);
+  char cmt[256], *sp;
+  int  c, firstchar;
+
+  sp = cmt;  firstchar = 1;
   while (1) {
-    /* eat comments */
-    if (c=='#') {   /* if we're at a comment, read to end of line */
-      char cmt[256], *sp, *tmpptr;
+    c = TOKGETC(tb);
+    if (firstchar && c == ' ') firstchar = 0;  /* lop off 1 sp after # */
+    else {
+      if (c == '\n' || c == EOF) break;
+      if ((sp-cmt)<250) *sp++ = c;
+    }
+  }
+  *sp++ = '\n';
+  *sp   = '\0';
 
-      sp = cmt;
-      while (1) {
-	c=getc(fp);
-	if (c == '\n' || c == EOF) break;
+  addcomment(pinfo, cmt);
+  return c;
+}
 
-	if ((sp-cmt)<250) *sp++ = c;
-      }
-      *sp++ = '\n';
-      *sp = '\0';
 
-      if (strlen(cmt) > (size_t) 0) {    /* add to pinfo->comment */
-	if (!pinfo->comment) {
-	  pinfo->comment = (char *) malloc(strlen(cmt)+1);
-	  if (!pinfo->comment) FatalError("malloc failure in xvpbm.c getint");
-	  pinfo->comment[0] = '\0';
-	}
-	else {
-	  tmpptr = (char *) realloc(pinfo->comment,
-		      strlen(pinfo->comment) + strlen(cmt) + 1);
-	  if (!tmpptr) FatalError("realloc failure in xvpbm.c getint");
-	  pinfo->comment = tmpptr;
-	}
-	strcat(pinfo->comment, cmt);
-      }
-    }
+
+/*******************************************/
+static int tokint(TOKBUF *tb, PICINFO *pinfo)
+{
+  /* same as getint(), but reads from the TOKBUF */
+  int c, i;
+
+  c = TOKGETC(tb);
+  while (c<'0' || c>'9') {
+    if (c=='#') c = tokcomment(tb, pinfo);
     if (c==EOF) return 0;
-    if (c=='0' || c=='1') break;   /* we've found what we were looking for */
 
     /* see if we are getting garbage (non-whitespace) */
-    if (c!=' ' && c!='\t' && c!='\r' && c!='\n' && c!=',') garbage=1;
+    if (c!=' ' && c!='\t' && c!='\r' && c!='\n' && c!=',')
+      tb->pd->garbage=1;
 
-    c = getc(fp);
+    c = TOKGETC(tb);
   }
 
+  /* digits are almost always already in the buffer */
+  i = 0;
+  do {
+    i = (i*10) + (c - '0');
+    c = TOKGETC(tb);
+  } while (c>='0' && c<='9');
+
+  tb->pd->numgot++;
+  return i;
+}
+
+
 
-  numgot++;
+/*******************************************/
+static int tokbit(TOKBUF *tb, PICINFO *pinfo)
+{
+  /* reads one '0' or '1' from P1 data (no separator required) */
+  int c;
+
+  c = TOKGETC(tb);
+  while (c!='0' && c!='1') {
+    if (c=='#') c = tokcomment(tb, pinfo);
+    if (c==EOF) return 0;
+
+    /* see if we are getting garbage (non-whitespace) */
+    if (c!=' ' && c!='\t' && c!='\r' && c!='\n' && c!=',')
+      tb->pd->garbage=1;
+
+    c = TOKGETC(tb);
+  }
+
+  tb->pd->numgot++;
   return(c-'0');
 }
 
 
+
+/*******************************************/
+static long read16(FILE *fp, byte *dst, long nsamples, int maxval,
+		   const byte *lut, u_short *deep)
+{
+  /* reads 'nsamples' raw 16-bit samples, in bulk, and stores lut[sample]
+     for each in 'dst', and (if 'deep' isn't NULL) the sample itself, no
+     bigger than 'maxval', in 'deep'.  Returns the # of samples actually
+     read.
+
+     Sometime after 1995, NetPBM's ppm(5) man page was changed to say, "Each
+     sample is represented in pure binary by either 1 or 2 bytes.  If the
+     Maxval is less than  256, it is 1 byte.  Otherwise, it is 2 bytes.  The
+     most significant byte is first."  This change is incompatible with
+     images created for viewing with all previous versions of XV, however,
+     so both approaches are left available as a compile-time option.  (Could
+     make it runtime-selectable, too, but unclear whether anybody cares.) */
+
+#ifdef ASSUME_RAW_PPM_LSB_FIRST  /* legacy approach */
+#  define HI16 1
+#  define LO16 0
+#else /* MSB first */
+#  define HI16 0
+#  define LO16 1
+#endif
+
+  byte   *buf, *sp;
+  long    got, n, i;
+  size_t  nread;
+  int     v;
+
+  buf = (byte *) malloc((size_t) RAW16CHUNK * 2);
+  if (!buf) FatalError("couldn't malloc 'buf' in xvpbm.c read16");
+
+  for (got=0; got<nsamples; got+=n) {
+    WaitCursor();
+
+    n = nsamples - got;
+    if (n > RAW16CHUNK) n = RAW16CHUNK;
+
+    nread = fread(buf, (size_t) 2, (size_t) n, fp);
+    if (nread < (size_t) n) n = (long) nread;
+    if (n == 0) break;
+
+    if (maxval == 65535) {
+      /* the common case:  the 8-bit value is just the high byte */
+      for (i=0, sp=buf+HI16; i<n; i++, sp+=2) dst[got+i] = *sp;
+    }
+    else {
+      for (i=0, sp=buf; i<n; i++, sp+=2)
+	dst[got+i] = lut[(sp[HI16] << 8) | sp[LO16]];
+    }
+
+    if (deep) {
+      for (i=0, sp=buf; i<n; i++, sp+=2) {
+	v = (sp[HI16] << 8) | sp[LO16];
+	deep[got+i] = (u_short) ((v > maxval) ? maxval : v);
+      }
+    }
+  }
+
+  free(buf);
+  return got;
+
+#undef HI16
+#undef LO16
+}
+
+
+
 /*******************************************/
 static int pbmError(const char *fname, const char *st)
 {
@@ -904,3 +1055,22 @@ int WritePBM(FILE *fp, byte *pic, int ptype, int w, int h, byte *rmap, byte *gma
 
   return 0;
 }
+
+
+
+/*******************************************/
+static u_short *deepAlloc(PICINFO *pinfo, long npixels, int spp, int maxv)
+{
+  /* if the samples have more than 8 bits, allocates pinfo->deep to keep
+     them in, and returns it.  Otherwise (or if there's no memory for it;
+     it's only nice to have) returns NULL */
+
+  if (maxv <= 255) return (u_short *) NULL;
+
+  pinfo->deep = (u_short *) calloc((size_t) npixels * spp, sizeof(u_short));
+  if (!pinfo->deep) return (u_short *) NULL;
+
+  pinfo->deepSpp = spp;
+  pinfo->deepMax = maxv;
+  return pinfo->deep;
+}
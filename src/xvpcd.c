@@ -41,6 +41,23 @@
 #  define trace(x)
 #endif
 
+/* WORDTYPE & char buffer must be unsigned else */
+/* fills with sign bit not 0 on right shifts */
+typedef unsigned int WORDTYPE;
+typedef int SWORDTYPE;
+#define WORDSIZE sizeof(WORDTYPE)
+#define NBYTESINBUF 0x800
+
+/* per-file decoder state:  the open file and the huffman bit reader */
+typedef struct {
+  FILE     *fp;
+  byte      buffer[NBYTESINBUF];
+  int       bitsleft;
+  int       bytesleft;
+  byte     *bufptr;
+  WORDTYPE  word;
+} PCDDEC;
+
 /* Comments on error-handling:
    A truncated file is not considered a Major Error.  The file is loaded,
    and the rest of the pic is filled with 0's.
@@ -51,7 +68,7 @@
 #ifdef __STDC__
 static void magnify(int, int, int, int, int, byte *);
 static int pcdError(const char *, const char *);
-static int gethuffdata(byte *, byte *, byte *, int, int);
+static int gethuffdata(PCDDEC *, byte *, byte *, byte *, int, int);
 #else
 static void magnify();
 static int pcdError();
@@ -63,7 +80,6 @@ static int gethuffdata();
 static int  size;    /* Set by window routines */
 static int  leaveitup;/* Cleared by docmd() when OK or CANCEL pressed */
 static int  goforit;  /* Set to 1 if OK or 0 if CANCEL */
-static FILE  *fp;
 static CBUTT  lutCB;
 
 /*
@@ -71,10 +87,6 @@ static CBUTT  lutCB;
  * Why there are 351 entries and not 346 as per Kodak documentation
  * is a mystery.
  */
-static  double  rscale = 1.00,
-    gscale = 1.00,
-    bscale = 1.00;
-
 static  byte  Y[351] = {
     0,   1,   2,   3,   4,   5,   6,   7,   8,   9,
    10,  11,  12,  13,  14,  15,  16,  17,  18,  19,
@@ -133,23 +145,28 @@ LoadPCD(char *fname, PICINFO *pinfo, int theSize)
   int   w, h, npixels, bufsize;
   int   row, col;
   int  huffplanes;
+  int  psize;
+  double  rscale, gscale, bscale;
   const char  *bname;
+  PCDDEC  pd;
 
   bname    = BaseName(fname);
   pinfo->pic  = NULL;
+  pd.bitsleft = pd.bytesleft = 0;
+  pd.word     = 0;
   pinfo->comment  = NULL;
 
 
   /*
    *  open the file
    */
-  if((fp=fopen(fname,"r")) == NULL)
+  if((pd.fp=fopen(fname,"r")) == NULL)
     return pcdError(bname, "can't open file");
 
   /*
    * inspect the header
    */
-  if(fread(&header[0], 1, sizeof(header), fp) != sizeof(header))
+  if(fread(&header[0], 1, sizeof(header), pd.fp) != sizeof(header))
     return pcdError(bname, "could not load PCD header");
   if(strncmp((char *)&header[0x800], "PCD_", 4) != 0)
     return pcdError(bname, "not a PCD file");
@@ -276,19 +293,17 @@ data for 16 base:
       return 0;
     }
     WaitCursor();
+    psize = size;
   }
   else
-  {
-    size = theSize;
-    goforit = 1;
-  }
+    psize = theSize;
 
   if(lutCB.val)
     rscale = gscale = bscale = 255.0/346.0;
   else
     rscale = gscale = bscale = 1.0;
 
-  switch (size) {
+  switch (psize) {
   case 0:
     pinfo->w = 192;
     pinfo->h = 128;
@@ -375,7 +390,7 @@ data for 16 base:
   pinfo->colType = F_FULLCOLOR;
   pinfo->frmType = -1;
 
-  if(fseek(fp, offset, SEEK_SET) == -1) {
+  if(fseek(pd.fp, offset, SEEK_SET) == -1) {
     free(pinfo->pic);
     return pcdError(bname,"Can't find start of data.");
   }
@@ -408,22 +423,22 @@ data for 16 base:
   /* top right hand corner of the larger allocated image */
 
   trace((stderr, "base image: start @ 0x%08lx (sector %ld.%ld)\n",
-        ftell(fp), ftell(fp)/0x800, ftell(fp) % 0x800));
+        ftell(pd.fp), ftell(pd.fp)/0x800, ftell(pd.fp) % 0x800));
   for(row=0,lptr=luma,c1ptr=chroma1,c2ptr=chroma2; row <h/mag;
         row+=2,lptr+=w*2,c1ptr+=w/2,c2ptr+=w/2) {
-    if(fread(lptr, 1, w/mag, fp) != w/mag) {
+    if(fread(lptr, 1, w/mag, pd.fp) != w/mag) {
       pcdError(bname, "Luma plane too short.");
       break;
     }
-    if(fread(lptr+w, 1, w/mag, fp) != w/mag) {
+    if(fread(lptr+w, 1, w/mag, pd.fp) != w/mag) {
       pcdError(bname, "Luma plane too short.");
       break;
     }
-    if(fread(c1ptr, 1, w/2/mag, fp) != w/2/mag) {
+    if(fread(c1ptr, 1, w/2/mag, pd.fp) != w/2/mag) {
       pcdError(bname, "Chroma1 plane too short.");
       break;
     }
-    if(fread(c2ptr, 1, w/2/mag, fp) != w/2/mag) {
+    if(fread(c2ptr, 1, w/2/mag, pd.fp) != w/2/mag) {
       pcdError(bname, "Chroma2 plane too short.");
       break;
     }
@@ -431,10 +446,10 @@ data for 16 base:
       WaitCursor();
   }
   trace((stderr, "base image: done @ 0x%08lx (sector %ld.%ld)\n",
-        ftell(fp), ftell(fp)/0x800, ftell(fp) % 0x800));
+        ftell(pd.fp), ftell(pd.fp)/0x800, ftell(pd.fp) % 0x800));
 
   if(huffplanes) {
-    if(fseek(fp, 388*0x800, SEEK_SET) == -1)
+    if(fseek(pd.fp, 388*0x800, SEEK_SET) == -1)
       return pcdError(bname,
           "Can't find start of huffman tables.");
 
@@ -446,7 +461,7 @@ data for 16 base:
      * doesn't really touch the chroma planes which aren't
      * present in 4base
      */
-    gethuffdata(luma, chroma1, chroma2, w, h/mag*2);
+    gethuffdata(&pd, luma, chroma1, chroma2, w, h/mag*2);
 
     /*
      * if only doing 4base should probably fetch 16bases
@@ -460,18 +475,18 @@ data for 16 base:
        * (cf. Hadmut's code which is positioned at start
        * of the next sector)
        */
-      long  offset = ftell(fp)/0x800+12;
+      long  offset = ftell(pd.fp)/0x800+12;
 
-      if(fseek(fp, offset*0x800, SEEK_SET) == 0) {
+      if(fseek(pd.fp, offset*0x800, SEEK_SET) == 0) {
         magnify(2,h/2,w/2,h,w,luma);
         magnify(2,h/4,w/4,h/2,w/2,chroma1);
         magnify(2,h/4,w/4,h/2,w/2,chroma2);
-        gethuffdata(luma,chroma1,chroma2,w,h);
+        gethuffdata(&pd, luma,chroma1,chroma2,w,h);
       } else
         fprintf(stderr, "can't seek to 2nd huffman tables\n");
     }
   }
-  fclose(fp);
+  fclose(pd.fp);
 
   /*
    * YCC -> R'G'B' and image rotate
@@ -755,6 +770,7 @@ void
 PCDSetParamOptions(const char *fname)
 {
   XV_UNUSED(fname);
+  if (!theDisp) return;    /* batch mode */
   RBSetActive(resnRB,0,1);
   RBSetActive(resnRB,1,1);
   RBSetActive(resnRB,2,1);
@@ -895,7 +911,7 @@ dumphufftab(int n, const byte *h, int m, const int *t)
 }
 
 static int *
-gethufftable(void)
+gethufftable(PCDDEC *pd)
 {
   int  *hufftab, *h, i, j, N, num, bufsize, huffptr, hufftop;
   byte  *huf;
@@ -904,10 +920,10 @@ gethufftable(void)
    * absorb the entirety of the table in one chunk (for better
    * dumps in case of error)
    */
-  trace((stderr, "hufftab 0x%08lx ", ftell(fp)));
-  num = 1 + fgetc(fp);   /* 256 max */
+  trace((stderr, "hufftab 0x%08lx ", ftell(pd->fp)));
+  num = 1 + fgetc(pd->fp);   /* 256 max */
   huf = (byte *)alloca(4*num*sizeof(byte));
-  if((i = fread(huf, 1, 4*num, fp)) != 4*num) {
+  if((i = fread(huf, 1, 4*num, pd->fp)) != 4*num) {
     fprintf(stderr, "unexpected EOF: got %d bytes, wanted %d\n",
                 i, 4*num);
     return NULL;
@@ -1041,28 +1057,16 @@ gethufftable(void)
   return hufftab;
 }
 
-/* WORDTYPE & char buffer must be unsigned else */
-/* fills with sign bit not 0 on right shifts */
-typedef unsigned int WORDTYPE;
-typedef int SWORDTYPE;
-#define WORDSIZE sizeof(WORDTYPE)
-#define NBYTESINBUF 0x800
-
-static byte buffer[NBYTESINBUF];
-static int bitsleft=0;
-static int bytesleft=0;
-static byte *bufptr;
-static WORDTYPE word;
 
 #if 0
 static void
-dumpbuffer(void)
+dumpbuffer(PCDDEC *pd)
 {
   int i,left;
-  byte *ptr=buffer;
+  byte *ptr=pd->buffer;
 
   fprintf(stderr,"dumpbuffer: bytesleft=%d bitsleft= %d word=0x%08lx\n",
-    bytesleft,bitsleft,(unsigned long)word);
+    pd->bytesleft,pd->bitsleft,(unsigned long)pd->word);
   for (left=NBYTESINBUF; left>0; left-=16) {
     fprintf(stderr,"%05d  ",left);
     for (i=0; i<8; i++) {
@@ -1075,88 +1079,89 @@ dumpbuffer(void)
 #endif /* 0 */
 
 static void
-loadbuffer(void)
+loadbuffer(PCDDEC *pd)
 {
-  if ((bytesleft=fread(buffer,1,NBYTESINBUF,fp)) == 0) {
+  if ((pd->bytesleft=fread(pd->buffer,1,NBYTESINBUF,pd->fp)) == 0) {
     fprintf(stderr,"Truncation error\n");
     exit(1);
   }
-  bufptr=buffer;
+  pd->bufptr=pd->buffer;
   /* dumpbuffer(); */
 }
 
 static void
-loadbyte(void)
+loadbyte(PCDDEC *pd)
 {
-  if (bytesleft <= 0) loadbuffer();
-  --bytesleft;
-  word|=(WORDTYPE)(*bufptr++)<<(sizeof(WORDTYPE)*8-8-bitsleft);
-  bitsleft+=8;
+  if (pd->bytesleft <= 0) loadbuffer(pd);
+  --pd->bytesleft;
+  pd->word|=(WORDTYPE)(*pd->bufptr++)<<(sizeof(WORDTYPE)*8-8-pd->bitsleft);
+  pd->bitsleft+=8;
 }
 
 static int
-getbit(void)
+getbit(PCDDEC *pd)
 {
   int bit;
 
-  while (bitsleft <= 0) loadbyte();
-  --bitsleft;
-  bit=(SWORDTYPE)(word)<0;  /* assumes word is signed */
+  while (pd->bitsleft <= 0) loadbyte(pd);
+  --pd->bitsleft;
+  bit=(SWORDTYPE)(pd->word)<0;  /* assumes word is signed */
   /* bit=word>>(sizeof(WORDTYPE)*8-1); */
-  word<<=1;
+  pd->word<<=1;
   return bit;
 }
 
 static WORDTYPE
-getnn(int nn)
+getnn(PCDDEC *pd, int nn)
 {
   WORDTYPE value;
 
-  while (bitsleft <= nn) loadbyte();
-  bitsleft-=nn;
-  value=word>>(sizeof(WORDTYPE)*8-nn);
-  word<<=nn;
+  while (pd->bitsleft <= nn) loadbyte(pd);
+  pd->bitsleft-=nn;
+  value=pd->word>>(sizeof(WORDTYPE)*8-nn);
+  pd->word<<=nn;
   return value;
 }
 
 static WORDTYPE
-isnn(int nn)
+isnn(PCDDEC *pd, int nn)
 {
   WORDTYPE value;
 
-  while (bitsleft <= nn) loadbyte();
-  value=word>>(sizeof(WORDTYPE)*8-nn);
+  while (pd->bitsleft <= nn) loadbyte(pd);
+  value=pd->word>>(sizeof(WORDTYPE)*8-nn);
   return value;
 }
 
 static void
-skipnn(int nn)
+skipnn(PCDDEC *pd, int nn)
 {
-  while (bitsleft <= nn) loadbyte();
-  bitsleft-=nn;
-  word<<=nn;
+  while (pd->bitsleft <= nn) loadbyte(pd);
+  pd->bitsleft-=nn;
+  pd->word<<=nn;
 }
 
-#define get1()    (getbit())
-#define get2()    (getnn(2))
-#define get8()    (getnn(8))
-#define get13()    (getnn(13))
-#define get16()    (getnn(16))
-#define get24()    (getnn(24))
+#define get1()    (getbit(pd))
+#define get2()    (getnn(pd, 2))
+#define get8()    (getnn(pd, 8))
+#define get13()    (getnn(pd, 13))
+#define get16()    (getnn(pd, 16))
+#define get24()    (getnn(pd, 24))
 
-#define is24()    (isnn(24))
+#define is24()    (isnn(pd, 24))
 
-#define skip1()    (skipnn(1))
-#define skip24()  (skipnn(24))
+#define skip1()    (skipnn(pd, 1))
+#define skip24()  (skipnn(pd, 24))
 
 static int
-gethuffdata(  byte *luma,
+gethuffdata(  PCDDEC *pd,
+    byte *luma,
     byte *chroma1,
     byte *chroma2,
     int realrowwidth,
     int maxrownumber)
 {
-static  byte  clip[3*256];
+  byte  clip[3*256];
   int  *hufftable[3], *huffstart = NULL, *huffptr = NULL;
   int  row, plane, i, result = 1;
 #if TRACE
@@ -1166,17 +1171,15 @@ static  byte  clip[3*256];
   byte  *pixelptr = NULL;
 
   trace((stderr,"gethuffdata: start @ 0x%08lx (sector %ld.%ld)\n",
-      ftell(fp), ftell(fp)/0x800, ftell(fp) % 0x800));
+      ftell(pd->fp), ftell(pd->fp)/0x800, ftell(pd->fp) % 0x800));
 
   /*
    * correction clipping
    */
-  if(clip[256+255] == 0) {
-    for(i = 0; i < 256; ++i)
-      clip[i +   0] = 0x00,
-      clip[i + 256] = (byte) i,
-      clip[i + 512] = 0xff;
-  }
+  for(i = 0; i < 256; ++i)
+    clip[i +   0] = 0x00,
+    clip[i + 256] = (byte) i,
+    clip[i + 512] = 0xff;
 
   /*
    * should really only look for luma plane for 4base, but the
@@ -1186,7 +1189,7 @@ static  byte  clip[3*256];
   for(i = 0; i < 3; ++i)
     hufftable[i] = NULL;
   for(i = 0; i < 3; ++i) {
-    if((hufftable[i] = gethufftable()) == NULL) {
+    if((hufftable[i] = gethufftable(pd)) == NULL) {
       result = 0;
       break;
     }
@@ -1197,8 +1200,8 @@ static  byte  clip[3*256];
   /*
    * skip remainder of current sector
    */
-  i = (ftell(fp) | 0x7ff) + 1;
-  if(fseek(fp, i, SEEK_SET) < 0) {
+  i = (ftell(pd->fp) | 0x7ff) + 1;
+  if(fseek(pd->fp, i, SEEK_SET) < 0) {
     fprintf(stderr, "gethuffdata: sector skip failed\n");
     return 0;
   }
@@ -1315,7 +1318,7 @@ oops:
     free(hufftable[i]);
   trace((stderr, "gethuffdata: uflow=%d oflow=%d\n", uflow, oflow));
   trace((stderr, "gethuffdata: done @ 0x%08lx (sector %ld.%d)\n",
-        ftell(fp), ftell(fp)/0x800, 0x800 - bytesleft));
+        ftell(pd->fp), ftell(pd->fp)/0x800, 0x800 - pd->bytesleft));
   return result;
 }
 
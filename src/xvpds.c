@@ -129,33 +129,9 @@
 #define COMMENTSIZE	50
 #define INOTESIZE	1000
 
-
-static int	lastwasinote = FALSE;
-static char	scanbuff         [MAX_SIZE+1],
-                rtbuff         [RTBUFFSIZE+1],
-		inote	        [INOTESIZE+1],
-                infobuff      [COMMENTSIZE+1],
-		spacecraft    [COMMENTSIZE+1],
-		target        [COMMENTSIZE+1],
-		filtname      [COMMENTSIZE+1],
-		gainmode      [COMMENTSIZE+1],
-		editmode      [COMMENTSIZE+1],
-		scanmode      [COMMENTSIZE+1],
-		exposure      [COMMENTSIZE+1],
-		shuttermode   [COMMENTSIZE+1],
-		mphase        [COMMENTSIZE+1],
-		iname         [COMMENTSIZE+1],
-		itime         [COMMENTSIZE+1],
-                garbage       [1024],
-		*tmptmp,
-		pdsuncompfname[FNAMESIZE];
-
 #define SSTR(l)			"%" #l "s"
 #define S(l)			SSTR(l)
 
-byte *image;
-static int elaphe;
-
 
 
 /* local function declarations */
@@ -171,8 +147,8 @@ static int LoadPDSPalette     PARM((char *, PICINFO *));
 
 static int getpdsrec(FILE *f, char *buff)
 {
-  static char *bp;
-  static int count;
+  char *bp;
+  int count;
   int c;
 
   /* read any leading CR's or LF's (sigh) */
@@ -254,17 +230,38 @@ int LoadPDS(char *fname, PICINFO *pinfo)
   int tmpfd;
 #endif
   FILE	*zf;
-  static int isfixed,teco,i,j,itype,vaxbyte,
-             recsize,hrecsize,irecsize,isimage,labelrecs,labelsofar,
-             w,h,lpsize,lssize,samplesize,returnp,labelsize,yy;
-  char	*tmp;
+  int   isfixed,teco,i,j,itype,vaxbyte,
+        recsize,hrecsize,irecsize,isimage,labelrecs,labelsofar,
+        w,h,lpsize,lssize,samplesize,returnp,labelsize,yy;
+  int   lastwasinote, elaphe;
+  byte *image;
+  char	*tmp, *tmptmp;
+  char	scanbuff      [MAX_SIZE+1],
+        rtbuff        [RTBUFFSIZE+1],
+        inote         [INOTESIZE+1],
+        infobuff      [COMMENTSIZE+1],
+        spacecraft    [COMMENTSIZE+1],
+        target        [COMMENTSIZE+1],
+        filtname      [COMMENTSIZE+1],
+        gainmode      [COMMENTSIZE+1],
+        editmode      [COMMENTSIZE+1],
+        scanmode      [COMMENTSIZE+1],
+        exposure      [COMMENTSIZE+1],
+        shuttermode   [COMMENTSIZE+1],
+        mphase        [COMMENTSIZE+1],
+        iname         [COMMENTSIZE+1],
+        itime         [COMMENTSIZE+1],
+        garbage       [1024],
+        pdsuncompfname[FNAMESIZE];
   const char   *ftypstr;
   unsigned long filesize;
   char  sampletype[64+1];
 
   pinfo->type = PIC8;
+  pinfo->deep = (u_short *) NULL;
   isfixed = TRUE;
-  returnp = isimage = FALSE;
+  returnp = isimage = lastwasinote = FALSE;
+  vaxbyte = 0;
   itype   = PDSTRASH;
 
   teco = i = j = recsize = hrecsize = irecsize = labelrecs = w = h = 0;
@@ -853,7 +850,12 @@ int LoadPDS(char *fname, PICINFO *pinfo)
     strncat(pinfo->comment, tmp, 2000 - strlen(pinfo->comment) - 1);
   }
 
-  if (LoadPDSPalette(fname, pinfo))  return 1;
+  if (LoadPDSPalette(fname, pinfo)) {
+    /* the 16-bit samples can only be redeveloped as greys */
+    if (pinfo->deep) free(pinfo->deep);
+    pinfo->deep = (u_short *) NULL;
+    return 1;
+  }
 
   /* these are grayscale, so cobble up a ramped colormap */
   /* Viking images on the CD's seem to be inverted.  Sigh */
@@ -872,6 +874,8 @@ int LoadPDS(char *fname, PICINFO *pinfo)
     for (yy=0; yy<=255; yy++) {
       pinfo->r[yy] = pinfo->g[yy] = pinfo->b[yy] = (255-yy);
     }
+    if (pinfo->deep) free(pinfo->deep);     /* (not inverted) */
+    pinfo->deep = (u_short *) NULL;
   }
 
   pinfo->normw = pinfo->w;   pinfo->normh = pinfo->h;
@@ -997,8 +1001,20 @@ static int Convert16BitImage(char *fname, PICINFO *pinfo, int swab)
   pinfo->pic = pPix8;
   while(--n >= 0)
     *pPix8++ = lut[*pShort++];
-  free(oldpic);
   free(lut);
+
+  /* keep the 16-bit samples, in native byte order, as pinfo->deep */
+  if (swab) {
+    n = pinfo->w * pinfo->h;
+    pShort = (unsigned short *)oldpic;
+    while(--n >= 0) {
+      *pShort = ((*pShort & 255) << 8) | ((*pShort >> 8) & 255);
+      pShort++;
+    }
+  }
+  pinfo->deep    = (u_short *) oldpic;
+  pinfo->deepSpp = 1;
+  pinfo->deepMax = 65535;
   return 1;
 }
 
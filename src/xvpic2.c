@@ -167,6 +167,14 @@ struct pic2_info {
     short *flag2_now;
     short *flag2_next;
     short *flag2_next2;
+    pixel *sv_vram_prev;		/* saved by pic2_handle_para(pi, 0) */
+    pixel *sv_vram_now;
+    pixel *sv_vram_next;
+    short *sv_flag_now;
+    short *sv_flag_next;
+    short *sv_flag2_now;
+    short *sv_flag2_next;
+    short *sv_flag2_next2;
     pixel (*cache)[PIC2_ARITH_CACHE];
     unsigned short *cache_pos;
     unsigned short *mulu_tab;
@@ -2642,20 +2650,16 @@ static pixel pic2_exchange_rg(pixel p, int colbits)
  */
 static void pic2_handle_para(struct pic2_info *pi, int mode)
 {
-    static pixel *vram_prev, *vram_now, *vram_next;
-    static short *flag_now, *flag_next;
-    static short *flag2_now, *flag2_next, *flag2_next2;
-
     switch (mode) {
     case 0:
-	vram_prev = pi->vram_prev;
-	vram_now = pi->vram_now;
-	vram_next = pi->vram_next;
-	flag_now = pi->flag_now;
-	flag_next = pi->flag_next;
-	flag2_now = pi->flag2_now;
-	flag2_next = pi->flag2_next;
-	flag2_next2 = pi->flag2_next2;
+	pi->sv_vram_prev = pi->vram_prev;
+	pi->sv_vram_now = pi->vram_now;
+	pi->sv_vram_next = pi->vram_next;
+	pi->sv_flag_now = pi->flag_now;
+	pi->sv_flag_next = pi->flag_next;
+	pi->sv_flag2_now = pi->flag2_now;
+	pi->sv_flag2_next = pi->flag2_next;
+	pi->sv_flag2_next2 = pi->flag2_next2;
 	pi->vram_prev += 4;
 	pi->vram_now += 4;
 	pi->vram_next += 4;
@@ -2666,14 +2670,14 @@ static void pic2_handle_para(struct pic2_info *pi, int mode)
 	pi->flag2_next2 += 4;
 	break;
     case 1:
-	pi->vram_prev = vram_now;
-	pi->vram_now = vram_next;
-	pi->vram_next = vram_prev;
-	pi->flag_now = flag_next;
-	pi->flag_next = flag_now;
-	pi->flag2_now = flag2_next;
-	pi->flag2_next = flag2_next2;
-	pi->flag2_next2 = flag2_now;
+	pi->vram_prev = pi->sv_vram_now;
+	pi->vram_now = pi->sv_vram_next;
+	pi->vram_next = pi->sv_vram_prev;
+	pi->flag_now = pi->sv_flag_next;
+	pi->flag_next = pi->sv_flag_now;
+	pi->flag2_now = pi->sv_flag2_next;
+	pi->flag2_next = pi->sv_flag2_next2;
+	pi->flag2_next2 = pi->sv_flag2_now;
 	break;
     }
 }
@@ -3060,15 +3064,18 @@ static void *pic2_new(size_t size, char *fn)
 static void drawTD    PARM((int,int,int,int));
 static void clickTD   PARM((int,int));
 static void doCmd     PARM((int));
-static void writePIC2 PARM((void));
+static void writePIC2 PARM((int, int));
+
+/* the save dialog's state.  Only the main thread touches it;  the loader
+   and WritePIC2() keep everything they need in their pic2_info */
+static struct {
+    FILE  *fp;			/* opened by PIC2SaveParams() */
+    char  *filename;
+    int    colorType;
+    int    append;		/* fp is an existing PIC2 file */
+} p2save;
 
 /* local variables */
-static FILE  *fp;
-static char  *filename;
-static int   colorType;
-static int   append;
-static int   x_offset;
-static int   y_offset;
 static BUTT  tbut[T_NBUTTS];
 static RBUTT *typeRB;
 static RBUTT *depthRB;
@@ -3209,12 +3216,12 @@ int PIC2CheckEvent(XEvent *xev)
 /***************************************************/
 int PIC2SaveParams(char *fname, int col)
 {
-    filename = fname;
-    colorType = col;
+    p2save.filename = fname;
+    p2save.colorType = col;
 
     /* see if we can open the output file before proceeding */
-    fp = pic2_OpenOutFile(filename, &append);
-    if (!fp)
+    p2save.fp = pic2_OpenOutFile(p2save.filename, &p2save.append);
+    if (!p2save.fp)
 	return (-1);
 
     RBSetActive(typeRB,0,1);
@@ -3224,11 +3231,11 @@ int PIC2SaveParams(char *fname, int col)
     RBSelect(typeRB,0);
 
 
-    if (append) {
+    if (p2save.append) {
 	struct pic2_info pic2;
 
 	pic2_init_info(&pic2);
-	pic2.fp = fp;
+	pic2.fp = p2save.fp;
 	pic2_read_header(&pic2);
 
 	RBSetActive(depthRB,0,0);
@@ -3280,11 +3287,11 @@ int PIC2SaveParams(char *fname, int col)
 	    break;
 	default: {
 	    char str[512];
-	    sprintf(str, "unsupported PIC2 file '%s'.", filename);
+	    sprintf(str, "unsupported PIC2 file '%s'.", p2save.filename);
 	    ErrPopUp(str, "\nBummer");
-	    CloseOutFile(fp, filename, 0);
-	    fp = OpenOutFile(fname);
-	    if (!fp)
+	    CloseOutFile(p2save.fp, p2save.filename, 0);
+	    p2save.fp = OpenOutFile(fname);
+	    if (!p2save.fp)
 		return (-1);
 	    break;
 	}
@@ -3374,6 +3381,7 @@ static void doCmd(int cmd)
     case T_BOK: {
 	char              *fullname;
 	char               buf[64], *x_offsetp, *y_offsetp;
+	int                x_offset, y_offset;
 	static const char *labels[] = { "\nOk", "\033Cancel" };
         XEvent             event;
 	int                i;
@@ -3404,7 +3412,7 @@ static void doCmd(int cmd)
 #endif
 	HandleEvent(&event, &i);
 
-	writePIC2();
+	writePIC2(x_offset, y_offset);
 	PIC2Dialog(0);
 
 	fullname = GetDirFullName();
@@ -3415,7 +3423,7 @@ static void doCmd(int cmd)
     }
 	break;
     case T_BCANC:
-	pic2_KillNullFile(fp);
+	pic2_KillNullFile(p2save.fp);
 	PIC2Dialog(0);
 	break;
     default:
@@ -3425,7 +3433,7 @@ static void doCmd(int cmd)
 
 
 /*******************************************/
-static void writePIC2(void)
+static void writePIC2(int x_offset, int y_offset)
 {
     int   w, h, nc, rv, type, depth, ptype, pfree;
     byte *inpix, *rmap, *gmap, *bmap;
@@ -3433,9 +3441,14 @@ static void writePIC2(void)
 
     WaitCursor();
     inpix = GenSavePic(&ptype, &w, &h, &pfree, &nc, &rmap, &gmap, &bmap);
+    if (!inpix) {
+	CloseOutFileWhy(p2save.fp, p2save.filename, 1, "not enough memory");
+	SetCursors(-1);
+	return;
+    }
 
-    if (colorType == F_REDUCED)
-	colorType = F_FULLCOLOR;
+    if (p2save.colorType == F_REDUCED)
+	p2save.colorType = F_FULLCOLOR;
 
     switch (RBWhich(typeRB)) {
     case 0: type = P2SS;  break;
@@ -3455,11 +3468,11 @@ static void writePIC2(void)
     case 7: depth = 24;  break;
     default: depth = 24; break;
     }
-    rv = WritePIC2(fp, inpix, ptype, w, h,
-		   rmap, gmap, bmap, nc, colorType, filename,
-		   type, depth, x_offset, y_offset, append, picComments);
+    rv = WritePIC2(p2save.fp, inpix, ptype, w, h,
+		   rmap, gmap, bmap, nc, p2save.colorType, p2save.filename,
+		   type, depth, x_offset, y_offset, p2save.append, picComments);
 
-    if (CloseOutFile(fp, filename, rv) == 0)
+    if (CloseOutFile(p2save.fp, p2save.filename, rv) == 0)
 	DirBox(0);
 
     if (pfree)
@@ -42,9 +42,7 @@ typedef struct {
 /***** end PM.H *****/
 
 
-static pmpic thePic;
-
-static int  pmError  PARM((const char *, const char *));
+static int  pmError  PARM((pmpic *, const char *, const char *));
 static int  flip4    PARM((int));
 static int  getint32 PARM((FILE *));
 static void putint32 PARM((int, FILE *));
@@ -60,6 +58,7 @@ int LoadPM(char *fname, PICINFO *pinfo)
   byte  *pic8;
   int    isize,i,flipit,w,h,npixels,nRGBbytes;
   const char  *bname;
+  pmpic  thePic;
 
   bname = BaseName(fname);
   thePic.pm_image = (char *) NULL;
@@ -70,7 +69,7 @@ int LoadPM(char *fname, PICINFO *pinfo)
 
 
   fp = xv_fopen(fname,"r");
-  if (!fp) return( pmError(bname, "unable to open file") );
+  if (!fp) return( pmError(&thePic, bname, "unable to open file") );
 
   /* read in the pmpic struct, one byte at a time */
   thePic.pm_id      = getint32(fp);
@@ -81,7 +80,7 @@ int LoadPM(char *fname, PICINFO *pinfo)
   thePic.pm_form    = getint32(fp);
   thePic.pm_cmtsize = getint32(fp);
 
-  if (ferror(fp) || feof(fp)) return(pmError(bname, "error reading header"));
+  if (ferror(fp) || feof(fp)) return(pmError(&thePic, bname, "error reading header"));
 
   flipit = 0;
 
@@ -90,7 +89,7 @@ int LoadPM(char *fname, PICINFO *pinfo)
     if (thePic.pm_id == PM_MAGICNO) flipit = 1;
     else thePic.pm_id = flip4(thePic.pm_id);
   }
-  if (thePic.pm_id != PM_MAGICNO) return( pmError(bname, "not a PM file") );
+  if (thePic.pm_id != PM_MAGICNO) return( pmError(&thePic, bname, "not a PM file") );
 
   if (flipit) {
     thePic.pm_np      = flip4(thePic.pm_np);
@@ -112,7 +111,7 @@ int LoadPM(char *fname, PICINFO *pinfo)
     fprintf(stderr,"PM picture not in a displayable format.\n");
     fprintf(stderr,"(ie, 1-plane PM_I, or 1-, 3-, or 4-plane PM_C)\n");
 
-    return pmError(bname, "PM file in unsupported format");
+    return pmError(&thePic, bname, "PM file in unsupported format");
   }
 
 
@@ -123,7 +122,7 @@ int LoadPM(char *fname, PICINFO *pinfo)
   /* make sure image is more-or-less valid (and no overflows) */
   if (isize <= 0 || w <= 0 || h <= 0 || npixels/w < h ||
       nRGBbytes/3 < npixels || thePic.pm_cmtsize < 0)
-    return pmError(bname, "Bogus PM file!!");
+    return pmError(&thePic, bname, "Bogus PM file!!");
 
   if (DEBUG)
     fprintf(stderr,"%s: LoadPM() - loading a %dx%d %s pic, %d planes\n",
@@ -134,15 +133,13 @@ int LoadPM(char *fname, PICINFO *pinfo)
   /* allocate memory for picture and read it in */
   thePic.pm_image = (char *) malloc((size_t) isize);
   if (thePic.pm_image == NULL)
-    return( pmError(bname, "unable to malloc PM picture") );
+    return( pmError(&thePic, bname, "unable to malloc PM picture") );
 
-  if (fread(thePic.pm_image, (size_t) isize, (size_t) 1, fp) != 1)   {
-    free(thePic.pm_image);
-    return( pmError(bname, "file read error") );
-  }
+  if (fread(thePic.pm_image, (size_t) isize, (size_t) 1, fp) != 1)
+    return( pmError(&thePic, bname, "file read error") );
 
   if (thePic.pm_cmtsize+1 <= 0)
-    return pmError(bname, "Bogus PM file!!");
+    return pmError(&thePic, bname, "Bogus PM file!!");
 
   /* alloc and read in comment, if any */
   if (thePic.pm_cmtsize>0) {
@@ -164,11 +161,11 @@ int LoadPM(char *fname, PICINFO *pinfo)
     byte *pic24, *picptr;
     
     if (w*h*3 <= 0)
-      return pmError(bname, "Bogus PM file!!");
+      return pmError(&thePic, bname, "Bogus PM file!!");
 
     if ((pic24 = (byte *) malloc((size_t) nRGBbytes))==NULL) {
       if (thePic.pm_cmt) free(thePic.pm_cmt);
-      return( pmError(bname, "unable to malloc 24-bit picture") );
+      return( pmError(&thePic, bname, "unable to malloc 24-bit picture") );
     }
 
     intptr = (int *) thePic.pm_image;
@@ -202,11 +199,11 @@ int LoadPM(char *fname, PICINFO *pinfo)
     byte *pic24, *picptr, *rptr, *gptr, *bptr;
 
     if (w*h*3 <= 0)
-      return pmError(bname, "Bogus PM file!!");
+      return pmError(&thePic, bname, "Bogus PM file!!");
 
     if ((pic24 = (byte *) malloc((size_t) nRGBbytes))==NULL) {
       if (thePic.pm_cmt) free(thePic.pm_cmt);
-      return( pmError(bname, "unable to malloc 24-bit picture") );
+      return( pmError(&thePic, bname, "unable to malloc 24-bit picture") );
     }
 
     rptr = (byte *) thePic.pm_image;
@@ -270,6 +267,7 @@ int WritePM(FILE *fp, byte *pic, int ptype, int w, int h, byte *rmap, byte *gmap
   char  foo[256];
   int   i;
   byte *p;
+  pmpic thePic;
 
   /* create 'comment' field */
   sprintf(foo,"CREATOR: XV %s\n", REVDATE);
@@ -358,10 +356,10 @@ int WritePM(FILE *fp, byte *pic, int ptype, int w, int h, byte *rmap, byte *gmap
 
 
 /*****************************/
-static int pmError(const char *fname, const char *st)
+static int pmError(pmpic *pm, const char *fname, const char *st)
 {
   SetISTR(ISTR_WARNING,"%s:  %s", fname, st);
-  if (thePic.pm_image != NULL) free(thePic.pm_image);
+  if (pm->pm_image != NULL) free(pm->pm_image);
   return 0;
 }
 
@@ -7,6 +7,7 @@
  *    PNGDialog(vis)
  *    PNGCheckEvent(xev)
  *    PNGSaveParams(fname, col)
+ *    PNGBatchSave(fp, pic, ptype, w, h, r, g, b, nc, col, fname, level)
  *    LoadPNG(fname, pinfo)
  *    VersionInfoPNG()
  */
@@ -61,6 +62,38 @@
 #define LF       10   /* a.k.a. '\n' on ASCII machines */
 #define CR       13   /* a.k.a. '\r' on ASCII machines */
 
+/* state shared by the parallel-IDAT workers */
+#define PAR_CHUNK   (256*1024)   /* target uncompressed bytes per deflate job */
+#define PAR_WINDOW  32768        /* deflate window, primed from previous job */
+#define PAR_BAND    32           /* rows per filtering job */
+
+/* values 'failed' can take */
+#define PAR_OK      0
+#define PAR_NOMEM   1
+#define PAR_ZERR    2            /* zlib refused, for some other reason */
+
+typedef struct {
+  byte   *out;                   /* compressed bytes */
+  size_t  len;
+  uLong   adler;
+} PARJOB;
+
+typedef struct {
+  byte   *pic;                   /* source image, as passed to WritePNG */
+  int     ptype, w, h, linesize;
+  int     color_type, bit_depth;
+  byte   *pc2nc, *remap;
+  int     filters;               /* PNG_FILTER_* bits to choose among */
+  int     level, strategy;
+  size_t  rowbytes;              /* packed row, not counting filter byte */
+  int     bpp;                   /* filter 'bytes per pixel' */
+  byte   *filt;                  /* h * (1+rowbytes) filtered rows */
+  int     rowsper, njobs;
+  PARJOB *jobs;
+  int     next;                  /* ParallelNext() counter */
+  int     failed;                /* PAR_* */
+} PNGPAR;
+
 /*** local functions ***/
 static    void drawPD         PARM((int, int, int, int));
 static    void clickPD        PARM((int, int));
@@ -71,14 +104,20 @@ static    int  WritePNG       PARM((FILE *, byte *, int, int, int,
 
 static    void png_xv_error   PARM((png_structp png_ptr,
                                     png_const_charp message));
+static    int  writeParIDAT   PARM((png_structp, byte *, int, int, int, int,
+                                   int, int, byte *, byte *, int, int));
+static    void parFilter      PARM((void *, int));
+static    void parDeflate     PARM((void *, int));
+static    void packRow        PARM((PNGPAR *, int, byte *));
+static    void parFree        PARM((PNGPAR *));
+static    void deepTo8        PARM((PICINFO *));
 static    void png_xv_warning PARM((png_structp png_ptr,
                                     png_const_charp message));
 
 /*** local variables ***/
-static char *filename;
+static char *filename;              /* save dialog */
 static const char *fbasename;
 static int   colorType;
-static int   read_anything;
 static double Display_Gamma = DISPLAY_GAMMA;
 
 static DIAL  cDial, gDial;
@@ -409,6 +448,11 @@ static void writePNG(void)
 
   WaitCursor();
   inpix = GenSavePic(&ptype, &w, &h, &pfree, &nc, &rmap, &gmap, &bmap);
+  if (!inpix) {
+    CloseOutFileWhy(fp, filename, 1, "not enough memory");
+    SetCursors(-1);
+    return;
+  }
 
   rv = WritePNG(fp, inpix, ptype, w, h, rmap, gmap, bmap, nc);
 
@@ -420,6 +464,24 @@ static void writePNG(void)
 }
 
 
+/*******************************************/
+int PNGBatchSave(FILE *fp, byte *pic, int ptype, int w, int h, byte *rmap, byte *gmap, byte *bmap, int nc, int col, char *fname, int level)
+{
+  /* batch-mode entry point:  no dialog, so the settings come from the
+     arguments.  level < 0 means the usual default compression */
+
+  fbasename = BaseName(fname);
+  colorType = col;
+  cDial.val = (level >= Z_NO_COMPRESSION && level <= Z_BEST_COMPRESSION)
+                ? level : COMPRESSION;
+  gDial.val = DISPLAY_GAMMA;
+  FdefCB.val = 1;
+  interCB.val = 0;
+
+  return WritePNG(fp, pic, ptype, w, h, rmap, gmap, bmap, nc);
+}
+
+
 /*******************************************/
 int WritePNG(FILE *fp, byte *pic, int ptype, int w, int h, byte *rmap, byte *gmap, byte *bmap, int numcols)
      /* FIXME?  what's diff between picComments and WriteGIF's comment arg? */
@@ -440,8 +502,8 @@ int WritePNG(FILE *fp, byte *pic, int ptype, int w, int h, byte *rmap, byte *gma
   png_uint_32 _width,_height;
   png_time    _mod_time;
 
-  if ((png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL,
-       png_xv_error, png_xv_warning)) == NULL) {
+  if ((png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING,
+       (png_voidp) fbasename, png_xv_error, png_xv_warning)) == NULL) {
     sprintf(software, "png_create_write_struct() failure in WritePNG");
     FatalError(software);
   }
@@ -460,7 +522,7 @@ int WritePNG(FILE *fp, byte *pic, int ptype, int w, int h, byte *rmap, byte *gma
 
 #ifdef PNG_NO_STDIO
   png_set_write_fn(png_ptr, fp, png_default_write_data, NULL);
-  png_set_error_fn(png_ptr, NULL, png_xv_error, png_xv_warning);
+  png_set_error_fn(png_ptr, (png_voidp) fbasename, png_xv_error, png_xv_warning);
 #else
   png_init_io(png_ptr, fp);
 #endif
@@ -699,43 +761,6 @@ int WritePNG(FILE *fp, byte *pic, int ptype, int w, int h, byte *rmap, byte *gma
 /* doesn't seem to be a way to set valid directly anymore, unnecessary maybe..
   info_ptr->valid |= PNG_INFO_gAMA; */
 
-/* might need to be png_write_info_before_PLTE() ... */
-  png_write_info(png_ptr, info_ptr);
-
-  if (_bit_depth < 8)
-    png_set_packing(png_ptr);
-
-  pass=png_set_interlace_handling(png_ptr);
-
-  if ((png_line = malloc(linesize)) == NULL)
-    png_error(png_ptr, "cannot allocate temp image line");
-    /* FIXME:  should be FatalError() */
-
-  for (i = 0; i < pass; ++i) {
-    int j;
-    p = pic;
-    for (j = 0; j < h; ++j) {
-      if (_color_type == PNG_COLOR_TYPE_GRAY) {
-        int k;
-        for (k = 0; k < w; ++k)
-          png_line[k] = ptype==PIC24 ? MONO(p[k*3], p[k*3+1], p[k*3+2]) :
-                                       remap[pc2nc[p[k]]];
-        png_write_row(png_ptr, png_line);
-      } else if (_color_type == PNG_COLOR_TYPE_PALETTE) {
-        int k;
-        for (k = 0; k < w; ++k)
-          png_line[k] = pc2nc[p[k]];
-        png_write_row(png_ptr, png_line);
-      } else {  /* PNG_COLOR_TYPE_RGB */
-        png_write_row(png_ptr, p);
-      }
-      if ((j & 0x1f) == 0) WaitCursor();
-      p += linesize;
-    }
-  }
-
-  free(png_line);
-
   savecmnt = NULL;   /* quiet a compiler warning */
 
   if (text) {
@@ -857,7 +882,60 @@ int WritePNG(FILE *fp, byte *pic, int ptype, int w, int h, byte *rmap, byte *gma
 /* dunno how to set validity
   info_ptr->valid |= PNG_INFO_tIME; */
 
-  png_write_end(png_ptr, info_ptr);
+  /* (text and tIME go out ahead of the image data, so that the parallel
+     path below can finish the file itself) */
+
+/* might need to be png_write_info_before_PLTE() ... */
+  png_write_info(png_ptr, info_ptr);
+
+  if (_interlace_type == PNG_INTERLACE_NONE &&
+      writeParIDAT(png_ptr, pic, ptype, w, h, linesize, _color_type,
+                   _bit_depth, pc2nc, remap, (int)cDial.val,
+                   FdefCB.val ? -1 : filter)) {
+    /* the image data is out.  png_write_end() refuses to run unless libpng
+       wrote the IDATs itself, and there's nothing left for it to do, so
+       close the file off here */
+    png_write_chunk(png_ptr, (png_const_bytep) "IEND", NULL, 0);
+  }
+
+  else {
+    if (_bit_depth < 8)
+      png_set_packing(png_ptr);
+
+    pass=png_set_interlace_handling(png_ptr);
+
+    if ((png_line = malloc(linesize)) == NULL)
+      png_error(png_ptr, "cannot allocate temp image line");
+      /* FIXME:  should be FatalError() */
+
+    for (i = 0; i < pass; ++i) {
+      int j;
+      p = pic;
+      for (j = 0; j < h; ++j) {
+        if (_color_type == PNG_COLOR_TYPE_GRAY) {
+          int k;
+          for (k = 0; k < w; ++k)
+            png_line[k] = ptype==PIC24 ? MONO(p[k*3], p[k*3+1], p[k*3+2]) :
+                                         remap[pc2nc[p[k]]];
+          png_write_row(png_ptr, png_line);
+        } else if (_color_type == PNG_COLOR_TYPE_PALETTE) {
+          int k;
+          for (k = 0; k < w; ++k)
+            png_line[k] = pc2nc[p[k]];
+          png_write_row(png_ptr, png_line);
+        } else {  /* PNG_COLOR_TYPE_RGB */
+          png_write_row(png_ptr, p);
+        }
+        if ((j & 0x1f) == 0) WaitCursor();
+        p += linesize;
+      }
+    }
+
+    free(png_line);
+
+    png_write_end(png_ptr, info_ptr);
+  }
+
   fflush(fp);   /* just in case we core-dump before finishing... */
 
   if (text) {
@@ -877,6 +955,322 @@ int WritePNG(FILE *fp, byte *pic, int ptype, int w, int h, byte *rmap, byte *gma
 }
 
 
+/*******************************************/
+static void parFree(PNGPAR *par)
+{
+  /* frees whatever writeParIDAT() has allocated so far */
+
+  int i;
+
+  if (par->jobs) {
+    for (i=0; i<par->njobs; i++)
+      if (par->jobs[i].out) free(par->jobs[i].out);
+    free(par->jobs);
+  }
+  if (par->filt) free(par->filt);
+  par->jobs = (PARJOB *) NULL;  par->filt = (byte *) NULL;
+}
+
+
+/*******************************************/
+static int writeParIDAT(png_structp png_ptr, byte *pic, int ptype, int w, int h, int linesize, int color_type, int bit_depth, byte *pc2nc, byte *remap, int level, int filters)
+{
+  /* writes the IDAT data for a non-interlaced image by filtering bands of
+   * rows, and deflating independent runs of rows, on several threads at
+   * once (a la pigz).  Each run is compressed as raw deflate with the end
+   * of the previous run preset as its dictionary, and ends on a byte
+   * boundary (Z_SYNC_FLUSH), so the runs concatenate into one ordinary
+   * zlib stream and the file is a perfectly standard PNG.
+   *
+   * 'filters' is the set of PNG_FILTER_* bits to choose among per row, or
+   * -1 for libpng's defaults.  Returns '0', having written nothing, if it
+   * isn't worth doing (small image, one thread), or couldn't be done (out
+   * of memory, zlib trouble), in which case the caller goes the usual
+   * png_write_row() route.  Returns '1' when done.
+   */
+
+  PNGPAR  par;
+  int     i, nworkers;
+  size_t  total;
+  uLong   adler;
+  byte    hdr[2], trl[4];
+  jmp_buf caller;
+
+  bzero((char *) &par, sizeof(par));
+  par.pic = pic;  par.ptype = ptype;  par.w = w;  par.h = h;
+  par.linesize   = linesize;
+  par.color_type = color_type;
+  par.bit_depth  = bit_depth;
+  par.pc2nc = pc2nc;  par.remap = remap;
+  par.level = level;
+
+  /* same defaults libpng would use */
+  if (filters < 0)
+    filters = (level == 0 || color_type == PNG_COLOR_TYPE_PALETTE ||
+               bit_depth < 8) ? PNG_FILTER_NONE : PNG_ALL_FILTERS;
+  if (!(filters & PNG_ALL_FILTERS)) filters = PNG_FILTER_NONE;
+  par.filters  = filters;
+  par.strategy = (filters == PNG_FILTER_NONE) ? Z_DEFAULT_STRATEGY
+                                              : Z_FILTERED;
+
+  par.rowbytes = ((size_t) w * bit_depth *
+                  (color_type == PNG_COLOR_TYPE_RGB ? 3 : 1) + 7) / 8;
+  par.bpp = (color_type == PNG_COLOR_TYPE_RGB) ? 3 : 1;
+
+  par.rowsper = PAR_CHUNK / (int) (par.rowbytes + 1);
+  if (par.rowsper < 1) par.rowsper = 1;
+  par.njobs = (h + par.rowsper - 1) / par.rowsper;
+
+  nworkers = ParallelWorkers(par.njobs);
+  if (nworkers < 2) return 0;
+
+  total = (size_t) h * (par.rowbytes + 1);
+  if (total / (par.rowbytes + 1) != (size_t) h) return 0;
+
+  par.filt = (byte *) malloc(total);
+  par.jobs = (PARJOB *) calloc((size_t) par.njobs, sizeof(PARJOB));
+  if (!par.filt || !par.jobs) par.failed = PAR_NOMEM;
+
+  WaitCursor();
+
+  /* pass 1:  pick a filter for, and filter, every row */
+  if (!par.failed) {
+    par.next = 0;
+    ParallelRun(ParallelWorkers((h + PAR_BAND - 1) / PAR_BAND), parFilter,
+                &par);
+  }
+
+  WaitCursor();
+
+  /* pass 2:  deflate */
+  if (!par.failed) {
+    par.next = 0;
+    ParallelRun(nworkers, parDeflate, &par);
+  }
+
+  /* nothing's been written yet, so libpng can still do it the slow way.
+     (the image is big, so running out of memory here is likely enough,
+     and it's no reason to lose the user's work) */
+  if (par.failed) {
+    if (DEBUG) fprintf(stderr, "WritePNG: %s, writing the rows serially\n",
+                       (par.failed == PAR_NOMEM) ? "out of memory"
+                                                 : "zlib error");
+    parFree(&par);
+    return 0;
+  }
+
+  free(par.filt);  par.filt = (byte *) NULL;   /* all deflated */
+
+  /* zlib header:  deflate, 32K window, FLEVEL to match 'level' */
+  hdr[0] = 0x78;
+  hdr[1] = (level < 2) ? 0x00 : (level < 6) ? 0x40 : (level == 6) ? 0x80
+                                                                  : 0xc0;
+  hdr[1] += 31 - ((hdr[0] << 8) + hdr[1]) % 31;
+
+  adler = par.jobs[0].adler;
+  for (i=1; i<par.njobs; i++) {
+    adler = adler32_combine(adler, par.jobs[i].adler,
+                (z_off_t) ((size_t) (((i+1 < par.njobs) ? par.rowsper
+                              : h - i * par.rowsper)) * (par.rowbytes + 1)));
+  }
+  trl[0] = (byte) (adler >> 24);  trl[1] = (byte) (adler >> 16);
+  trl[2] = (byte) (adler >>  8);  trl[3] = (byte) adler;
+
+  /* a write error longjmp()s out of png_write_chunk(), through here on
+     its way to WritePNG()'s handler, so the compressed runs get freed */
+  memcpy((char *) caller, (char *) png_jmpbuf(png_ptr), sizeof(jmp_buf));
+  if (setjmp(png_jmpbuf(png_ptr))) {
+    parFree(&par);
+    memcpy((char *) png_jmpbuf(png_ptr), (char *) caller, sizeof(jmp_buf));
+    longjmp(png_jmpbuf(png_ptr), 1);
+  }
+
+  png_write_chunk(png_ptr, (png_const_bytep) "IDAT", hdr, 2);
+  for (i=0; i<par.njobs; i++) {
+    png_write_chunk(png_ptr, (png_const_bytep) "IDAT",
+                    par.jobs[i].out, par.jobs[i].len);
+    free(par.jobs[i].out);  par.jobs[i].out = (byte *) NULL;
+  }
+  png_write_chunk(png_ptr, (png_const_bytep) "IDAT", trl, 4);
+
+  memcpy((char *) png_jmpbuf(png_ptr), (char *) caller, sizeof(jmp_buf));
+  parFree(&par);
+  return 1;
+}
+
+
+/*******************************************/
+static void packRow(PNGPAR *par, int y, byte *dst)
+{
+  /* builds row 'y' of the image exactly as the png_write_row() path would
+     hand it to libpng (after png_set_packing()) */
+
+  byte *p;
+  int   k, v, shift;
+
+  p = par->pic + (size_t) y * par->linesize;
+
+  if (par->color_type == PNG_COLOR_TYPE_RGB) {
+    memcpy(dst, p, par->rowbytes);
+    return;
+  }
+
+  if (par->bit_depth == 8) {
+    for (k=0; k<par->w; k++, p += (par->ptype == PIC24) ? 3 : 1) {
+      if (par->color_type == PNG_COLOR_TYPE_PALETTE) dst[k] = par->pc2nc[*p];
+      else if (par->ptype == PIC24) dst[k] = MONO(p[0], p[1], p[2]);
+      else dst[k] = par->remap[par->pc2nc[*p]];
+    }
+    return;
+  }
+
+  /* 1, 2 or 4 bits per pixel, packed high bits first */
+  bzero((char *) dst, par->rowbytes);
+  for (k=0; k<par->w; k++) {
+    v = (par->color_type == PNG_COLOR_TYPE_PALETTE) ? par->pc2nc[p[k]]
+                                              : par->remap[par->pc2nc[p[k]]];
+    shift = 8 - par->bit_depth - (k * par->bit_depth) % 8;
+    dst[(k * par->bit_depth) / 8] |= (byte) (v << shift);
+  }
+}
+
+
+/*******************************************/
+static void parFilter(void *arg, int worker)
+{
+  /* filters bands of PAR_BAND rows.  each row gets whichever allowed
+     filter minimizes the sum of absolute (signed) residuals, the same
+     heuristic libpng uses */
+
+  PNGPAR *par = (PNGPAR *) arg;
+  byte   *prev, *cur, *cand, *best, *tmp, *out;
+  size_t  rb, i;
+  int     bpp, band, y, y1, f, a, b, c, pa, pb, pc, pred;
+  unsigned long sum, bestsum;
+
+  (void) worker;
+  rb  = par->rowbytes;
+  bpp = par->bpp;
+
+  prev = (byte *) malloc(rb);
+  cur  = (byte *) malloc(rb);
+  cand = (byte *) malloc(rb + 1);
+  best = (byte *) malloc(rb + 1);
+  if (!prev || !cur || !cand || !best) {
+    par->failed = PAR_NOMEM;
+    if (prev) free(prev);
+    if (cur)  free(cur);
+    if (cand) free(cand);
+    if (best) free(best);
+    return;
+  }
+
+  while ((band = ParallelNext(&par->next, (par->h + PAR_BAND - 1) / PAR_BAND))
+         >= 0) {
+    y  = band * PAR_BAND;
+    y1 = y + PAR_BAND;
+    if (y1 > par->h) y1 = par->h;
+
+    if (y > 0) packRow(par, y-1, prev);
+    else bzero((char *) prev, rb);
+
+    for ( ; y<y1; y++) {
+      packRow(par, y, cur);
+      out = par->filt + (size_t) y * (rb + 1);
+      bestsum = ~0UL;
+
+      for (f=PNG_FILTER_VALUE_NONE; f<=PNG_FILTER_VALUE_PAETH; f++) {
+        if (!(par->filters & (PNG_FILTER_NONE << f))) continue;
+
+        cand[0] = (byte) f;
+        sum = 0;
+        for (i=0; i<rb; i++) {
+          a = (i >= (size_t) bpp) ? cur[i-bpp]  : 0;
+          b = (y > 0)             ? prev[i]     : 0;
+          c = (i >= (size_t) bpp && y > 0) ? prev[i-bpp] : 0;
+
+          switch (f) {
+          case PNG_FILTER_VALUE_SUB:  pred = a;            break;
+          case PNG_FILTER_VALUE_UP:   pred = b;            break;
+          case PNG_FILTER_VALUE_AVG:  pred = (a + b) >> 1; break;
+          case PNG_FILTER_VALUE_PAETH:
+            pa = abs(b - c);  pb = abs(a - c);  pc = abs(a + b - 2*c);
+            pred = (pa <= pb && pa <= pc) ? a : (pb <= pc) ? b : c;
+            break;
+          default:                    pred = 0;            break;
+          }
+
+          cand[i+1] = (byte) (cur[i] - pred);
+          sum += (cand[i+1] < 128) ? cand[i+1] : 256 - cand[i+1];
+        }
+
+        if (sum < bestsum) {
+          bestsum = sum;
+          tmp = best;  best = cand;  cand = tmp;
+        }
+      }
+
+      memcpy(out, best, rb + 1);
+      tmp = prev;  prev = cur;  cur = tmp;
+    }
+  }
+
+  free(prev);  free(cur);  free(cand);  free(best);
+}
+
+
+/*******************************************/
+static void parDeflate(void *arg, int worker)
+{
+  /* deflates runs of 'rowsper' filtered rows */
+
+  PNGPAR  *par = (PNGPAR *) arg;
+  PARJOB  *job;
+  z_stream zs;
+  byte    *in;
+  size_t   inlen, dictlen, cap;
+  int      j, last, rv;
+
+  (void) worker;
+  while ((j = ParallelNext(&par->next, par->njobs)) >= 0) {
+    job  = &par->jobs[j];
+    last = (j == par->njobs - 1);
+
+    in    = par->filt + (size_t) j * par->rowsper * (par->rowbytes + 1);
+    inlen = (size_t) (last ? par->h - j * par->rowsper : par->rowsper)
+              * (par->rowbytes + 1);
+
+    job->adler = adler32(adler32(0L, Z_NULL, 0), in, (uInt) inlen);
+
+    bzero((char *) &zs, sizeof(zs));
+    rv = deflateInit2(&zs, par->level, Z_DEFLATED, -15, 8, par->strategy);
+    if (rv != Z_OK) {
+      par->failed = (rv == Z_MEM_ERROR) ? PAR_NOMEM : PAR_ZERR;
+      return;
+    }
+
+    if (j > 0) {
+      dictlen = (size_t) (in - par->filt);
+      if (dictlen > PAR_WINDOW) dictlen = PAR_WINDOW;
+      deflateSetDictionary(&zs, in - dictlen, (uInt) dictlen);
+    }
+
+    cap = deflateBound(&zs, (uLong) inlen) + 16;   /* + sync-flush marker */
+    job->out = (byte *) malloc(cap);
+    if (!job->out) { deflateEnd(&zs);  par->failed = PAR_NOMEM;  return; }
+
+    zs.next_in   = in;         zs.avail_in  = (uInt) inlen;
+    zs.next_out  = job->out;   zs.avail_out = (uInt) cap;
+    rv = deflate(&zs, last ? Z_FINISH : Z_SYNC_FLUSH);
+    if ((last && rv != Z_STREAM_END) || (!last && rv != Z_OK) ||
+        zs.avail_in) par->failed = PAR_ZERR;
+
+    job->len = cap - zs.avail_out;
+    deflateEnd(&zs);
+  }
+}
+
+
 /*******************************************/
 int LoadPNG(char *fname, PICINFO *pinfo)
 /*******************************************/
@@ -900,11 +1294,14 @@ int LoadPNG(char *fname, PICINFO *pinfo)
   png_textp   _text;
   png_colorp  _palette;
   png_color_16p _background;
+  const char   *fbasename;
+  volatile int  read_anything;   /* survives png_xv_error()'s longjmp */
 
   fbasename = BaseName(fname);
 
   pinfo->pic     = (byte *) NULL;
   pinfo->comment = (char *) NULL;
+  pinfo->deep    = (u_short *) NULL;
 
   read_anything=0;
 
@@ -920,7 +1317,8 @@ int LoadPNG(char *fname, PICINFO *pinfo)
   filesize = ftell(fp);
   fseek(fp, 0L, 0);
 
-  png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL,
+  png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING,
+                                   (png_voidp) fbasename,
                                    png_xv_error, png_xv_warning);
   if (!png_ptr) {
     fclose(fp);
@@ -947,13 +1345,18 @@ int LoadPNG(char *fname, PICINFO *pinfo)
         free(pinfo->comment);
         pinfo->comment = NULL;
       }
+      if (pinfo->deep) {
+        free(pinfo->deep);
+        pinfo->deep = NULL;
+      }
     }
+    else if (pinfo->deep) deepTo8(pinfo);
     return read_anything;
   }
 
 #ifdef PNG_NO_STDIO
   png_set_read_fn(png_ptr, fp, png_default_read_data);
-  png_set_error_fn(png_ptr, NULL, png_xv_error, png_xv_warning);
+  png_set_error_fn(png_ptr, (png_voidp) fbasename, png_xv_error, png_xv_warning);
 #else
   png_init_io(png_ptr, fp);
 #endif
@@ -1052,8 +1455,12 @@ int LoadPNG(char *fname, PICINFO *pinfo)
     }
   }
 
-  if (_bit_depth == 16)
-    png_set_strip_16(png_ptr);
+  if (_bit_depth == 16) {
+    /* keep all 16 bits (in native byte order).  the 8-bit pic is made
+       from them after they've been read */
+    int one = 1;
+    if (*(char *) &one) png_set_swap(png_ptr);
+  }
 
   if (_color_type == PNG_COLOR_TYPE_GRAY ||
       _color_type == PNG_COLOR_TYPE_GRAY_ALPHA)
@@ -1114,20 +1521,34 @@ int LoadPNG(char *fname, PICINFO *pinfo)
     png_error(png_ptr, "can't allocate space for PNG image");
   }
 
+  if (_bit_depth == 16) {
+    if (png_get_channels(png_ptr,info_ptr) != linesize / pinfo->w)
+      png_error(png_ptr, "unexpected channel count in 16-bit PNG image");
+
+    pinfo->deep = (u_short *) calloc((size_t)bufsize, sizeof(u_short));
+    if (!pinfo->deep) {
+      png_error(png_ptr, "can't allocate space for 16-bit PNG image");
+    }
+    pinfo->deepSpp = linesize / pinfo->w;
+    pinfo->deepMax = 65535;
+  }
+
   /*png_start_read_image(png_ptr); -- causes a warning and seems to be unnecessary */
 
   for (i = 0; i < pass; i++) {
-    byte *p = pinfo->pic;
+    byte *p = (pinfo->deep) ? (byte *) pinfo->deep : pinfo->pic;
     for (j = 0; j < pinfo->h; j++) {
       png_read_row(png_ptr, p, NULL);
       read_anything = 1;
       if ((j & 0x1f) == 0) WaitCursor();
-      p += linesize;
+      p += (pinfo->deep) ? linesize * 2 : linesize;
     }
   }
 
   png_read_end(png_ptr, info_ptr);
 
+  if (pinfo->deep) deepTo8(pinfo);
+
   png_get_text(png_ptr,info_ptr,&_text,&_num_text);
   if (_num_text > 0) {
     commentsize = 1;
@@ -1158,11 +1579,30 @@ int LoadPNG(char *fname, PICINFO *pinfo)
 }
 
 
+/*******************************************/
+static void
+deepTo8(PICINFO *pinfo)
+{
+  /* fills in the 8-bit pic from the 16-bit samples in pinfo->deep, the
+     same way png_set_strip_16() would have */
+
+  u_short *sp;
+  byte    *dp;
+  long     n;
+
+  n  = (long) pinfo->w * pinfo->h * pinfo->deepSpp;
+  sp = pinfo->deep;  dp = pinfo->pic;
+  for ( ; n>0; n--) *dp++ = (byte) (*sp++ >> 8);
+}
+
+
 /*******************************************/
 static void
 png_xv_error(png_structp png_ptr, png_const_charp message)
 {
-  SetISTR(ISTR_WARNING,"%s:  libpng error: %s", fbasename, message);
+  /* the error pointer is the file's base name */
+  SetISTR(ISTR_WARNING,"%s:  libpng error: %s",
+	  (const char *) png_get_error_ptr(png_ptr), message);
 
   longjmp(png_jmpbuf(png_ptr), 1);
 }
@@ -1175,7 +1615,8 @@ png_xv_warning(png_structp png_ptr, png_const_charp message)
   if (!png_ptr)
     return;
 
-  SetISTR(ISTR_WARNING,"%s:  libpng warning: %s", fbasename, message);
+  SetISTR(ISTR_WARNING,"%s:  libpng warning: %s",
+	  (const char *) png_get_error_ptr(png_ptr), message);
 }
 
 
@@ -0,0 +1,275 @@
+/*
+ * xvpool.c - recycles the large image buffers (cpic, epic, XImage data)
+ *
+ *  Contains:
+ *            byte *PoolAlloc(size)
+ *            void  PoolFree(ptr)
+ *            void  PoolTrim()
+ *            void  PoolStats(fp)
+ *
+ * Every crop, zoom and colormode change used to free a full-size buffer and
+ * then malloc another one of (usually) exactly the same size, and a slide
+ * show of same-sized images does the same thing on every image.  Buffers
+ * handed out by PoolAlloc() are rounded up to a 'size class' (four classes
+ * per power of two), and when they're given back with PoolFree() they're
+ * kept around for the next request in that class, up to 'poolSize'
+ * megabytes of idle buffers.  With 'hugePages' set, buffers of 2MB and up
+ * are aligned on, and advised into, huge pages where the OS supports it.
+ *
+ * PoolFree() also accepts anything that came from plain malloc(), and
+ * just free()s it, so a variable that may hold either kind of buffer can
+ * always be freed with PoolFree().  The reverse is NOT true:  a pool
+ * buffer must never be passed to free().  Each pool buffer carries a
+ * small header, just in front of the returned pointer, that records its
+ * size class and a tag made from its own address.  PoolFree() only takes
+ * an address it handed out as a pool buffer if the tag is still there, so
+ * if a pool buffer does get free()d, and malloc() later returns the same
+ * address, the stale entry is dropped instead of being recycled at the
+ * wrong size.  (malloc() keeps its own bookkeeping right in front of what
+ * it returns, which overwrites the tag.)
+ *
+ * Small requests (under POOLMIN bytes) aren't worth recycling, and go
+ * straight to malloc().  None of this is thread-safe;  only call it from
+ * the main thread.
+ */
+
+#include "copyright.h"
+
+#include "xv.h"
+
+#include <sys/mman.h>
+
+#define POOLMIN   (64 * 1024)         /* smaller requests aren't pooled */
+#define POOLLIVE  64                  /* pool buffers that can be out */
+#define POOLIDLE  16                  /* idle buffers that can be kept */
+#define HUGEPAGE  (2 * 1024 * 1024)
+#define POOLHDR   64                  /* header in front of pool buffers */
+#define POOLTAG   ((size_t) 0x58565030UL)
+
+/* the header sits in the last bytes before the returned pointer */
+#define HDRSIZE(p) (((size_t *) (p))[-2])
+#define HDRTAG(p)  (((size_t *) (p))[-1])
+#define PTRTAG(p)  (POOLTAG ^ (size_t) (p))
+
+typedef struct {
+  byte   *ptr;
+  size_t  size;                       /* size class it was allocated as */
+} PBUF;
+
+static PBUF   live[POOLLIVE];         /* buffers that are handed out */
+static int    nlive = 0;
+static PBUF   idle[POOLIDLE];         /* buffers waiting for reuse, oldest 1st */
+static int    nidle = 0;
+static size_t idlebytes = 0;
+
+static struct {
+  long   allocs, hits, misses, frees, drops;
+  size_t inuse, peak;
+} pst;
+
+static size_t sizeClass  PARM((size_t));
+static byte  *poolNew    PARM((size_t));
+static void   poolRelease PARM((byte *));
+static void   poolDrop   PARM((int));
+static int    poolLive   PARM((byte *));
+static size_t poolLimit  PARM((void));
+
+
+/***************************************************/
+byte *PoolAlloc(size_t size)
+{
+  /* returns a buffer of at least 'size' bytes, or NULL if there's no
+     memory.  It must be freed with PoolFree() */
+
+  byte   *p;
+  size_t  sz;
+  int     i;
+
+  if (size < POOLMIN || nlive == POOLLIVE) return (byte *) malloc(size);
+
+  sz = sizeClass(size);
+  pst.allocs++;
+
+  /* most recently freed buffer of the right class wins.  its pages are
+     the most likely to still be resident */
+  for (i=nidle-1; i>=0 && idle[i].size != sz; i--);
+
+  if (i >= 0) {
+    p = idle[i].ptr;
+    idlebytes -= sz;
+    for ( ; i<nidle-1; i++) idle[i] = idle[i+1];
+    nidle--;
+    pst.hits++;
+  }
+  else {
+    p = poolNew(sz);
+    if (!p && nidle) {               /* low on memory:  give back the idle */
+      PoolTrim();                    /* buffers and try again */
+      p = poolNew(sz);
+    }
+    if (!p) return (byte *) NULL;
+    pst.misses++;
+
+    /* a new buffer can't be at the address of one that's still out,
+       unless that one was free()d behind the pool's back */
+    if ((i = poolLive(p)) >= 0) {
+      pst.inuse -= live[i].size;
+      live[i] = live[--nlive];
+    }
+  }
+
+  HDRSIZE(p) = sz;
+  HDRTAG(p)  = PTRTAG(p);
+
+  live[nlive].ptr = p;  live[nlive].size = sz;  nlive++;
+  pst.inuse += sz;
+  if (pst.inuse > pst.peak) pst.peak = pst.inuse;
+
+  return p;
+}
+
+
+/***************************************************/
+void PoolFree(void *ptr)
+{
+  /* gives a buffer back to the pool.  NULL and buffers that didn't come
+     from PoolAlloc() are handled too */
+
+  size_t sz;
+  int    i;
+
+  if (!ptr) return;
+
+  i = poolLive((byte *) ptr);
+  if (i < 0) { free(ptr);  return; }
+
+  sz = live[i].size;
+  live[i] = live[--nlive];
+  pst.inuse -= sz;
+
+  if (HDRTAG(ptr) != PTRTAG(ptr) || HDRSIZE(ptr) != sz) {
+    /* stale entry:  the pool buffer that was here got free()d, and this
+       is some later malloc() at the same address */
+    free(ptr);
+    return;
+  }
+
+  pst.frees++;
+  HDRTAG(ptr) = 0;
+
+  if (sz > poolLimit()) {            /* would never fit.  don't bother */
+    poolRelease((byte *) ptr);
+    pst.drops++;
+    return;
+  }
+
+  if (nidle == POOLIDLE) poolDrop(0);
+  idle[nidle].ptr = (byte *) ptr;  idle[nidle].size = sz;  nidle++;
+  idlebytes += sz;
+
+  while (idlebytes > poolLimit()) poolDrop(0);
+}
+
+
+/***************************************************/
+void PoolTrim(void)
+{
+  /* releases all idle buffers back to the system */
+
+  while (nidle) poolDrop(0);
+}
+
+
+/***************************************************/
+void PoolStats(FILE *fp)
+{
+  long pct;
+
+  pct = (pst.allocs) ? (100 * pst.hits) / pst.allocs : 0;
+
+  fprintf(fp, "%s: image buffer pool:  %ld allocs, %ld reused (%ld%%), ",
+	  cmd, pst.allocs, pst.hits, pct);
+  fprintf(fp, "%ld new;  %ld frees, %ld released\n",
+	  pst.misses, pst.frees, pst.drops);
+  fprintf(fp, "%s:   %.1f MB in use (peak %.1f MB), %.1f MB idle in %d bufs%s\n",
+	  cmd, pst.inuse / 1048576.0, pst.peak / 1048576.0,
+	  idlebytes / 1048576.0, nidle, (hugePages) ? ", huge pages" : "");
+}
+
+
+/***************************************************/
+static size_t sizeClass(size_t size)
+{
+  /* rounds 'size' up to the next of 4/4, 5/4, 6/4 or 7/4 times a power
+     of two, so sizes that are almost the same share buffers, and no more
+     than 25% is wasted */
+
+  size_t step;
+
+  for (step = 1; (step << 3) <= size; step <<= 1);
+  return (size + step - 1) & ~(step - 1);
+}
+
+
+/***************************************************/
+static byte *poolNew(size_t sz)
+{
+  /* allocates a size-class 'sz' buffer, with room for the header in
+     front.  Returns the buffer, past the header */
+
+  void *p;
+
+#ifdef MADV_HUGEPAGE
+  if (hugePages && sz >= HUGEPAGE) {
+    if (posix_memalign(&p, (size_t) HUGEPAGE, sz + POOLHDR))
+      return (byte *) NULL;
+    madvise(p, sz & ~((size_t) HUGEPAGE - 1), MADV_HUGEPAGE);
+    return (byte *) p + POOLHDR;
+  }
+#endif
+
+  p = malloc(sz + POOLHDR);
+  if (!p) return (byte *) NULL;
+  return (byte *) p + POOLHDR;
+}
+
+
+/***************************************************/
+static void poolRelease(byte *p)
+{
+  /* gives a buffer from poolNew() back to the system */
+
+  free(p - POOLHDR);
+}
+
+
+/***************************************************/
+static int poolLive(byte *p)
+{
+  /* returns the live[] index of the buffer at 'p', or -1 */
+
+  int i;
+
+  for (i=nlive-1; i>=0 && live[i].ptr != p; i--);
+  return i;
+}
+
+
+/***************************************************/
+static void poolDrop(int i)
+{
+  /* frees idle buffer #i */
+
+  poolRelease(idle[i].ptr);
+  idlebytes -= idle[i].size;
+  for ( ; i<nidle-1; i++) idle[i] = idle[i+1];
+  nidle--;
+  pst.drops++;
+}
+
+
+/***************************************************/
+static size_t poolLimit(void)
+{
+  return (poolSize > 0) ? (size_t) poolSize * 1024 * 1024 : 0;
+}
@@ -251,6 +251,11 @@ static int doPopUp(const char *txt, const char **labels, int n, int poptyp, cons
   int    i;
   XEvent event;
 
+  if (!theDisp) {    /* batch mode:  nobody to ask, so take the default */
+    fprintf(stderr, "%s: %s\n", cmd, txt);
+    return 0;
+  }
+
   if (firsttime) createPUD();
 
   if (poptyp != ISPAD) { puwide = PUWIDE;      puhigh = PUHIGH;     }
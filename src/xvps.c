@@ -15,6 +15,12 @@
 
 #include "xv.h"
 
+#ifdef HAVE_GSAPI
+#  include <ghostscript/iapi.h>
+#  include <ghostscript/ierrors.h>
+#  include <ghostscript/gdevdsp.h>
+#endif
+
 #define PSWIDE (431*dpiMult)
 #define PSHIGH (350*dpiMult)
 #define PMAX   (200*dpiMult)    /* size of square that a 'page' has to fit into */
@@ -78,6 +84,13 @@ static int  writeBWStip    PARM((FILE *, byte *, const char *, int, int, int));
 static void buildCmdStr    PARM((char *, char *, char *, int, int));
 #endif
 
+#ifdef HAVE_GSAPI
+static int  gsapiLoad      PARM((char *, PICINFO *, int, int));
+static int  gsapiPageCount PARM((char *));
+static int  gsapiNewInst   PARM((void **, void *, char *, int, char **));
+static void gsapiPSString  PARM((char *, char *, size_t));
+#endif
+
 
 /* local variables */
 static Window pageF;
@@ -895,6 +908,11 @@ static void writePS(void)
   WaitCursor();
 
   inpix = GenSavePic(&ptype, &w, &h, &pfree, &nc, &rmap, &gmap, &bmap);
+  if (!inpix) {
+    CloseOutFileWhy(fp, filename, 1, "not enough memory");
+    SetCursors(-1);
+    return;
+  }
 
   if (w <= 0 || h <= 0 || w*2 < w) {
     SetISTR(ISTR_WARNING,"%s:  Image dimensions out of range", filename);
@@ -1541,6 +1559,14 @@ int LoadPS(char *fname, PICINFO *pinfo, int quick)
   pinfo->pic     = (byte *) NULL;
   pinfo->comment = (char *) NULL;
 
+#ifdef HAVE_GSAPI
+  {
+    int rv = gsapiLoad(fname, pinfo, quick, res);
+    if (rv >= 0) return rv;
+    /* else libgs couldn't be started at all.  fall back on running 'gs' */
+  }
+#endif
+
 #ifdef GS_PATH
 
   doalert = (!quick && !ctrlUp && !infoUp);  /* open alert if no info wins */
@@ -1751,3 +1777,388 @@ void buildCmdStr(char *str, char *gscmd, char *xname, int quick, int epsf)
 
 
 
+#ifdef HAVE_GSAPI
+/******************************************************************/
+/* In-process rendering through the Ghostscript API.  The 'display' device
+   hands us its raster directly, so there's no fork/exec, pipe, or page
+   file involved, and with -dFirstPage/-dLastPage only the one page we want
+   gets rasterized.  Multi-page documents are not split into page files:
+   openPic() remembers the document in 'pageDocName' and calls us again
+   with 'curPage' set whenever the user flips pages. */
+
+typedef struct gsapiPage {
+  PICINFO *pinfo;
+  int      gray;         /* asked for DISPLAY_COLORS_GRAY */
+  int      w, h, raster;
+  byte    *image;        /* device raster, owned by gs */
+  int      npages;       /* # of pages the device has output */
+  int      failed;       /* out of memory, etc. */
+  char    *out;          /* gs stdout, when counting PDF pages */
+  size_t   outlen;
+} GSAPIPAGE;
+
+
+static int GSDLLCALL gsdOpen(void *handle, void *device)
+{
+  XV_UNUSED(handle);  XV_UNUSED(device);
+  return 0;
+}
+
+
+static int GSDLLCALL gsdPresize(void *handle, void *device, int width,
+				int height, int raster, unsigned int format)
+{
+  XV_UNUSED(handle);  XV_UNUSED(device);  XV_UNUSED(raster);
+  XV_UNUSED(format);
+
+  /* refuse page sizes we couldn't hold as a PIC24 */
+  if (width <= 0 || height <= 0 || width > INT_MAX/3/height) return -1;
+  return 0;
+}
+
+
+static int GSDLLCALL gsdSize(void *handle, void *device, int width,
+			     int height, int raster, unsigned int format,
+			     unsigned char *pimage)
+{
+  GSAPIPAGE *pg = (GSAPIPAGE *) handle;
+  XV_UNUSED(device);  XV_UNUSED(format);
+
+  pg->w = width;  pg->h = height;  pg->raster = raster;
+  pg->image = pimage;
+  return 0;
+}
+
+
+static int GSDLLCALL gsdSync(void *handle, void *device)
+{
+  XV_UNUSED(handle);  XV_UNUSED(device);
+  return 0;
+}
+
+
+static int GSDLLCALL gsdPage(void *handle, void *device, int copies,
+			     int flush)
+{
+  /* the device only outputs pages within FirstPage..LastPage, and we only
+     ever ask for one, so whatever shows up here is the page we want */
+  GSAPIPAGE *pg = (GSAPIPAGE *) handle;
+  PICINFO   *pinfo = pg->pinfo;
+  int        y, bpp;
+  size_t     rowlen;
+  byte      *pp;
+
+  XV_UNUSED(device);  XV_UNUSED(copies);  XV_UNUSED(flush);
+
+  pg->npages++;
+  if (pinfo->pic || !pg->image) return 0;
+
+  bpp    = (pg->gray) ? 1 : 3;
+  rowlen = (size_t) pg->w * bpp;
+  pinfo->pic = (byte *) malloc(rowlen * pg->h);
+  if (!pinfo->pic) {
+    pg->failed = 1;
+    return -1;
+  }
+
+  for (y=0, pp=pinfo->pic; y<pg->h; y++, pp+=rowlen)
+    bcopy((char *) pg->image + (size_t) y * pg->raster, (char *) pp, rowlen);
+
+  pinfo->w = pinfo->normw = pg->w;
+  pinfo->h = pinfo->normh = pg->h;
+
+  if (pg->gray) {
+    for (y=0; y<256; y++) pinfo->r[y] = pinfo->g[y] = pinfo->b[y] = y;
+    pinfo->type = PIC8;
+  }
+  else pinfo->type = PIC24;
+
+  return 0;
+}
+
+
+static int GSDLLCALL gsdUpdate(void *handle, void *device, int x, int y,
+			       int w, int h)
+{
+  XV_UNUSED(handle);  XV_UNUSED(device);  XV_UNUSED(x);  XV_UNUSED(y);
+  XV_UNUSED(w);  XV_UNUSED(h);
+  return 0;
+}
+
+
+static display_callback gsDisplay;   /* filled in by gsapiNewInst() */
+
+
+static int GSDLLCALL gsCallout(void *instance, void *handle,
+			       const char *dev_name, int id, int size,
+			       void *data)
+{
+  gs_display_get_callback_t *cb;
+  XV_UNUSED(instance);  XV_UNUSED(size);
+
+  if (dev_name == NULL || strcmp(dev_name, "display") != 0 ||
+      id != DISPLAY_CALLOUT_GET_CALLBACK) return -1;
+
+  cb = (gs_display_get_callback_t *) data;
+  cb->callback      = &gsDisplay;
+  cb->caller_handle = handle;
+  return 0;
+}
+
+
+static int GSDLLCALL gsStdin(void *handle, char *buf, int len)
+{
+  XV_UNUSED(handle);  XV_UNUSED(buf);  XV_UNUSED(len);
+  return 0;    /* never feed gs from our stdin */
+}
+
+
+static int GSDLLCALL gsStdout(void *handle, const char *str, int len)
+{
+  GSAPIPAGE *pg = (GSAPIPAGE *) handle;
+  char      *nout;
+
+  if (pg->outlen < 256) {      /* only ever expecting a page count */
+    nout = (char *) realloc(pg->out, pg->outlen + len + 1);
+    if (nout) {
+      bcopy(str, nout + pg->outlen, (size_t) len);
+      pg->outlen += len;
+      nout[pg->outlen] = '\0';
+      pg->out = nout;
+    }
+  }
+  else if (DEBUG) fwrite(str, (size_t) 1, (size_t) len, stderr);
+
+  return len;
+}
+
+
+static int GSDLLCALL gsStderr(void *handle, const char *str, int len)
+{
+  XV_UNUSED(handle);
+  if (DEBUG) fwrite(str, (size_t) 1, (size_t) len, stderr);
+  return len;
+}
+
+
+
+/******************************************************************/
+static int gsapiNewInst(void **inst, void *handle, char *fname, int nargs,
+			char **args)
+{
+  /* creates and initializes a gs instance, with the common options
+     prepended to 'args'.  Returns 1 if ok, 0 if gs failed while starting
+     up, and -1 if the library can't be used at all */
+
+  char  *argv[32], permit[MAXPATHLEN + 32];
+  int    argc, i, code;
+
+  if (gsDisplay.size == 0) {
+    gsDisplay.size             = sizeof(display_callback);
+    gsDisplay.version_major    = DISPLAY_VERSION_MAJOR;
+    gsDisplay.version_minor    = DISPLAY_VERSION_MINOR;
+    gsDisplay.display_open     = gsdOpen;
+    gsDisplay.display_preclose = gsdOpen;
+    gsDisplay.display_close    = gsdOpen;
+    gsDisplay.display_presize  = gsdPresize;
+    gsDisplay.display_size     = gsdSize;
+    gsDisplay.display_sync     = gsdSync;
+    gsDisplay.display_page     = gsdPage;
+    gsDisplay.display_update   = gsdUpdate;
+    /* no memalloc:  gs allocates (and frees) the raster itself */
+  }
+
+  if (gsapi_new_instance(inst, handle) < 0) return -1;
+
+  gsapi_set_stdio(*inst, gsStdin, gsStdout, gsStderr);
+  gsapi_set_arg_encoding(*inst, GS_ARG_ENCODING_UTF8);
+  if (gsapi_register_callout(*inst, gsCallout, handle) < 0) {
+    gsapi_delete_instance(*inst);
+    return -1;
+  }
+
+  argc = 0;
+  argv[argc++] = "xv";
+  argv[argc++] = "-q";
+  argv[argc++] = "-dSAFER";
+  argv[argc++] = "-dNOPAUSE";
+  argv[argc++] = "-dBATCH";
+
+  snprintf(permit, sizeof(permit), "--permit-file-read=%s", fname);
+  argv[argc++] = permit;
+
+#ifdef GS_LIB
+  argv[argc++] = "-I" GS_LIB;
+#endif
+
+  for (i=0; i<nargs && argc<32; i++) argv[argc++] = args[i];
+
+  code = gsapi_init_with_args(*inst, argc, argv);
+  if (code < 0 && code != gs_error_Quit) {
+    gsapi_exit(*inst);
+    gsapi_delete_instance(*inst);
+    return 0;
+  }
+
+  return 1;
+}
+
+
+/******************************************************************/
+static void gsapiPSString(char *dst, char *src, size_t dstlen)
+{
+  /* copies 'src' into 'dst' as the body of a PostScript (string) */
+  size_t n = 0;
+
+  for ( ; *src && n+3 < dstlen; src++) {
+    if (*src == '(' || *src == ')' || *src == '\\') dst[n++] = '\\';
+    dst[n++] = *src;
+  }
+  dst[n] = '\0';
+}
+
+
+/******************************************************************/
+static int gsapiPageCount(char *fname)
+{
+  /* PDF documents know their page count, so ask instead of rendering
+     every page just to count them.  Returns 0 if it can't be determined */
+
+  GSAPIPAGE  pg;
+  void      *inst;
+  char       psname[2*MAXPATHLEN + 1], cmd[2*MAXPATHLEN + 64];
+  char      *args[1];
+  int        code, exit_code, nump;
+
+  bzero((char *) &pg, sizeof(pg));
+
+  args[0] = "-dNODISPLAY";
+  if (gsapiNewInst(&inst, &pg, fname, 1, args) <= 0) return 0;
+
+  gsapiPSString(psname, fname, sizeof(psname));
+  snprintf(cmd, sizeof(cmd),
+	   "(%s) (r) file runpdfbegin pdfpagecount = flush quit\n", psname);
+
+  code = gsapi_run_string(inst, cmd, 0, &exit_code);
+  gsapi_exit(inst);
+  gsapi_delete_instance(inst);
+
+  nump = 0;
+  if ((code == 0 || code == gs_error_Quit) && pg.out) nump = atoi(pg.out);
+  if (pg.out) free(pg.out);
+
+  return (nump > 0) ? nump : 0;
+}
+
+
+/******************************************************************/
+static int gsapiLoad(char *fname, PICINFO *pinfo, int quick, int res)
+{
+  /* renders one page of 'fname' into pinfo.  If 'fname' is the current
+     on-demand page document, renders page 'curPage', otherwise page 1.
+     Returns 1 on success, 0 on failure, -1 if libgs is unusable */
+
+  GSAPIPAGE    pg;
+  void        *inst;
+  char        *args[8], devstr[32], fmtstr[48], resstr[16], geomstr[64];
+  char         firststr[32], laststr[32];
+  byte         magic[8];
+  FILE        *fp;
+  unsigned int format;
+  int          rv, code, exit_code, page, nump, ispdf, nargs;
+
+  /* only gs knows for sure, but we need to know how to count pages */
+  ispdf = 0;
+  fp = xv_fopen(fname, "r");
+  if (fp) {
+    ispdf = (fread(magic, (size_t) 1, (size_t) 4, fp) == 4 &&
+	     strncmp((char *) magic, "%PDF", (size_t) 4) == 0);
+    fclose(fp);
+  }
+
+  page = 0;  nump = 0;
+  if (!quick && strlen(pageDocName) && strcmp(fname, pageDocName) == 0) {
+    page = curPage;  nump = numPages;       /* flipping through the doc */
+  }
+  else if (!quick && ispdf) nump = gsapiPageCount(fname);
+
+  bzero((char *) &pg, sizeof(pg));
+  pg.pinfo = pinfo;
+  pg.gray  = (strncmp(gsDev, "pgm", (size_t) 3) == 0 ||
+	      strncmp(gsDev, "pbm", (size_t) 3) == 0);
+
+  format = DISPLAY_ALPHA_NONE | DISPLAY_DEPTH_8 | DISPLAY_BIGENDIAN |
+           DISPLAY_TOPFIRST |
+	   ((pg.gray) ? DISPLAY_COLORS_GRAY : DISPLAY_COLORS_RGB);
+
+  nargs = 0;
+  strcpy(devstr, "-sDEVICE=display");                args[nargs++] = devstr;
+  sprintf(fmtstr, "-dDisplayFormat=%u", format);     args[nargs++] = fmtstr;
+  sprintf(resstr, "-r%d", res);                      args[nargs++] = resstr;
+  if (gsGeomStr) {
+    snprintf(geomstr, sizeof(geomstr), "-g%s", gsGeomStr);
+    args[nargs++] = geomstr;
+  }
+
+  /* if we don't know how many pages there are, we have to let gs run
+     through the whole document, and grab the first page on the way */
+  sprintf(firststr, "-dFirstPage=%d", page+1);       args[nargs++] = firststr;
+  if (nump || quick) {
+    sprintf(laststr, "-dLastPage=%d", page+1);       args[nargs++] = laststr;
+  }
+
+  if (DEBUG) fprintf(stderr,"LoadPS:  rendering page %d of '%s' via libgs\n",
+		     page+1, fname);
+
+  rv = gsapiNewInst(&inst, &pg, fname, nargs, args);
+  if (rv < 0) return -1;
+  if (rv == 0) {
+    SetISTR(ISTR_WARNING, "Ghostscript couldn't be initialized.");
+    return 0;
+  }
+
+  SetISTR(ISTR_INFO, "Rendering page %d...", page+1);
+  WaitCursor();
+
+  code = gsapi_run_file(inst, fname, 0, &exit_code);
+
+  /* EPSF hack:  no showpage in the file?  supply one */
+  if ((code == 0 || code == gs_error_Quit) && pg.npages == 0 && !pg.failed)
+    code = gsapi_run_string(inst, "showpage\n", 0, &exit_code);
+
+  gsapi_exit(inst);
+  gsapi_delete_instance(inst);
+  WaitCursor();
+
+  if (pg.out) free(pg.out);
+
+  if (!pinfo->pic) {
+    if (pg.failed) SetISTR(ISTR_WARNING, "LoadPS: not enough memory for page");
+    else if (code < 0 && code != gs_error_Quit)
+      SetISTR(ISTR_WARNING,"Ghostscript interpreter returned error code %d.",
+	      code);
+    else {
+      SetISTR(ISTR_INFO, "Ghostscript: No pages produced.");
+      if (!quick) Warning();
+    }
+    SetCursors(-1);
+    return 0;
+  }
+
+  /* a PostScript program can only be counted by running all of it */
+  if (!nump) nump = (quick) ? 1 : pg.npages;
+  pinfo->numpages = nump;
+
+  sprintf(pinfo->fullInfo, "%s, %d page%s (rendered by libgs)",
+	  (ispdf) ? "PDF" : "PostScript", nump, (nump==1) ? "" : "s");
+  sprintf(pinfo->shrtInfo, "%dx%d %s.", pinfo->w, pinfo->h,
+	  (ispdf) ? "PDF" : "PostScript");
+  pinfo->frmType = -1;
+  pinfo->colType = (pg.gray) ? F_GREYSCALE : F_FULLCOLOR;
+
+  SetISTR(ISTR_INFO, "Rendering page %d...  Done.  (%d page%s)",
+	  page+1, nump, (nump==1) ? "" : "s");
+
+  return 1;
+}
+#endif  /* HAVE_GSAPI */
@@ -3,6 +3,7 @@
  *
  *  Contains:
  *            MakeRootPic()
+ *            FreeRootTiles()
  *            ClearRoot()
  *            SaveRootInfo()
  *            KillOldRootInfo()
@@ -15,8 +16,25 @@
 #include "bits/root_weave"
 
 
+/* the image, uploaded once into server-side pixmaps.  Every root mode is
+   put together from these with XCopyArea(), so changing just the root mode
+   doesn't send the image to the server again.  Thrown away (FreeRootTiles())
+   whenever theImage is rebuilt or patched, in root mode or not, and when
+   xv goes back to a window, as makeTiles() only checks the size */
+static Pixmap tilePix = (Pixmap) None;    /* eWIDE x eHIGH:  the image */
+static Pixmap mirPix  = (Pixmap) None;    /* 2*eWIDE x 2*eHIGH:  the image,
+					     and its h-, v- and hv-flips */
+static int    tileW, tileH;
+static int    building = 0;               /* making mirPix.  keep tilePix */
+static GC     tileGC = (GC) 0;            /* no GraphicsExposes */
+
+
 /* local function pre-definitions */
-static void killRootPix PARM((void));
+static void   killRootPix PARM((void));
+static int    makeTiles   PARM((int));
+static Pixmap newPixmap   PARM((unsigned int, unsigned int));
+static void   copyTile    PARM((Drawable, int, int, int, int, int,
+				int, int));
 
 
 /***********************************/
@@ -26,12 +44,15 @@ void MakeRootPic(void)
      creates the XImage and the pixmap, sets the root to the new
      pixmap, and refreshes the display */
 
-  Pixmap       tmpPix;
-  int          i, j, k, rmode;
+  Pixmap       tmpPix, bgPix;
+  int          i, j, k, rmode, mirror;
   unsigned int rpixw, rpixh;
 
   killRootPix();
 
+  /* a window-sized epic may only exist a screenful at a time */
+  if (!epic) { GenerateEpic(eWIDE, eHIGH);  CreateXImage(); }
+
   rmode = rootMode;
   /* if eWIDE,eHIGH == dispWIDE,dispHIGH just use 'normal' mode to save mem */
   if (rmode>=RM_CENTER && eWIDE==dispWIDE && eHIGH==dispHIGH) rmode=RM_NORMAL;
@@ -56,48 +77,42 @@ void MakeRootPic(void)
   if (nolimits) { RANGE(rpixw, 1, maxWIDE);  RANGE(rpixh, 1, maxHIGH); }
            else { RANGE(rpixw, 1, dispWIDE);  RANGE(rpixh, 1, dispHIGH); }
 
-  /* create tmpPix */
-  xerrcode = 0;
-  tmpPix = XCreatePixmap(theDisp, mainW, rpixw, rpixh, dispDEEP);
-  XSync(theDisp, False);
-  if (xerrcode || !tmpPix) {
+  mirror = (rmode == RM_MIRROR || rmode == RM_IMIRROR || rmode == RM_ECMIRR);
+  if (!makeTiles(mirror)) {
     ErrPopUp("Insufficient memory in X server to store root pixmap.",
 	     "\nDarn!");
     return;
   }
 
 
-  if (rmode == RM_NORMAL || rmode == RM_TILE) {
-    XPutImage(theDisp, tmpPix, theGC, theImage, 0,0, 0,0,
-	      (u_int) eWIDE, (u_int) eHIGH);
+  /* normal, tiled and mirrored modes are just the uploaded image, unless
+     it's been cropped to the screen */
+  bgPix = (mirror) ? mirPix : tilePix;
+  if ((rmode == RM_NORMAL || rmode == RM_TILE ||
+       rmode == RM_MIRROR || rmode == RM_IMIRROR) &&
+      rpixw == (unsigned int) ((mirror ? 2 : 1) * tileW) &&
+      rpixh == (unsigned int) ((mirror ? 2 : 1) * tileH)) {
+    XSetWindowBackgroundPixmap(theDisp, mainW, bgPix);
+    XClearWindow(theDisp, mainW);
+    return;
   }
 
-  else if (rmode == RM_MIRROR || rmode == RM_IMIRROR) {
-    /* quadrant 2 */
-    XPutImage(theDisp, tmpPix, theGC, theImage, 0,0, 0,0,
-	      (u_int) eWIDE, (u_int) eHIGH);
-    if (epic == NULL) FatalError("epic == NULL in RM_MIRROR code...\n");
 
-    /* quadrant 1 */
-    FlipPic(epic, eWIDE, eHIGH, 0);   /* flip horizontally */
-    CreateXImage();
-    XPutImage(theDisp, tmpPix, theGC, theImage, 0,0, eWIDE,0,
-	      (u_int) eWIDE, (u_int) eHIGH);
+  /* create tmpPix */
+  tmpPix = newPixmap(rpixw, rpixh);
+  if (!tmpPix) {
+    ErrPopUp("Insufficient memory in X server to store root pixmap.",
+	     "\nDarn!");
+    return;
+  }
 
-    /* quadrant 4 */
-    FlipPic(epic, eWIDE, eHIGH, 1);   /* flip vertically */
-    CreateXImage();
-    XPutImage(theDisp, tmpPix, theGC, theImage, 0,0, eWIDE,eHIGH,
-	      (u_int) eWIDE, (u_int) eHIGH);
 
-    /* quadrant 3 */
-    FlipPic(epic, eWIDE, eHIGH, 0);   /* flip horizontally */
-    CreateXImage();
-    XPutImage(theDisp, tmpPix, theGC, theImage, 0,0, 0,eHIGH,
-	      (u_int) eWIDE, (u_int) eHIGH);
+  if (rmode == RM_NORMAL || rmode == RM_TILE) {
+    copyTile(tmpPix, 0, 0,0, 0,0, eWIDE, eHIGH);
+  }
 
-    FlipPic(epic, eWIDE, eHIGH, 1);   /* flip vertically  (back to orig) */
-    CreateXImage();                   /* put back to original state */
+  else if (rmode == RM_MIRROR || rmode == RM_IMIRROR) {
+    XCopyArea(theDisp, mirPix, tmpPix, tileGC, 0,0, rpixw, rpixh, 0,0);
   }
 
 
@@ -131,8 +146,7 @@ void MakeRootPic(void)
 	  if (y<0)           { offy = -y;  h1 -= offy;  y = 0; }
 	  if (y+h1>eHIGH)    { h1 = (eHIGH-y); }
 
-	  XPutImage(theDisp, tmpPix, theGC, theImage, offx, offy,
-		    x, y, (u_int) w1, (u_int) h1);
+	  copyTile(tmpPix, 0, offx, offy, x, y, w1, h1);
 	}
       }
     }
@@ -140,9 +154,7 @@ void MakeRootPic(void)
     else if (rmode == RM_CSOLID) { }
 
     else if (rmode == RM_UPLEFT) {
-
-      XPutImage(theDisp, tmpPix, theGC, theImage, 0,0, 0,0,
-		(u_int) eWIDE, (u_int) eHIGH);
+      copyTile(tmpPix, 0, 0,0, 0,0, eWIDE, eHIGH);
     }
 
     else if (rmode == RM_CWARP) {          /* warp effect */
@@ -165,16 +177,18 @@ void MakeRootPic(void)
 
     /* draw the image centered on top of the background */
     if ((rmode != RM_CENTILE) && (rmode != RM_UPLEFT))
-      XPutImage(theDisp, tmpPix, theGC, theImage, 0,0,
-		((int) dispWIDE-eWIDE)/2, ((int) dispHIGH-eHIGH)/2,
-		(u_int) eWIDE, (u_int) eHIGH);
+      copyTile(tmpPix, 0, 0,0, ((int) dispWIDE-eWIDE)/2,
+	       ((int) dispHIGH-eHIGH)/2, eWIDE, eHIGH);
   }
 
 
   else if (rmode == RM_ECENTER || rmode == RM_ECMIRR) {
-    int fliph, flipv;
+    /* 'flip' says which copy of the image the next tile comes from:
+       bit 0 set = flipped horizontally, bit 1 set = flipped vertically */
+    int flip, emirr;
 
-    fliph = 0;  flipv = 0;
+    flip = 0;
+    emirr = (rmode == RM_ECMIRR);
 
     if (dispWIDE == eWIDE) {
       /* horizontal center line */
@@ -183,14 +197,10 @@ void MakeRootPic(void)
       y = eHIGH - ((dispHIGH/2)%eHIGH); /* Starting point in picture to copy */
       ay = 0;    /* Vertical anchor point */
       while (ay < dispHIGH) {
-	XPutImage(theDisp, tmpPix, theGC, theImage, 0,y,
-		  0,ay, (u_int) eWIDE, (u_int) eHIGH);
+	copyTile(tmpPix, flip, 0,y, 0,ay, eWIDE, eHIGH);
 	ay += eHIGH - y;
 	y = 0;
-	if (rmode == RM_ECMIRR) {
-	  FlipPic(epic, eWIDE, eHIGH, 1);   flipv = !flipv;
-	  CreateXImage();
-	}
+	if (emirr) flip ^= 2;
       }
     }
     else if (dispHIGH == eHIGH) {
@@ -200,14 +210,10 @@ void MakeRootPic(void)
       x = eWIDE - ((dispWIDE/2)%eWIDE); /* Starting point in picture to copy */
       ax = 0;    /* Horizontal anchor point */
       while (ax < dispWIDE) {
-	XPutImage(theDisp, tmpPix, theGC, theImage, x,0,
-		  ax,0, (u_int) eWIDE, (u_int) eHIGH);
+	copyTile(tmpPix, flip, x,0, ax,0, eWIDE, eHIGH);
 	ax += eWIDE - x;
 	x = 0;
-	if (rmode == RM_ECMIRR) {
-	  FlipPic(epic, eWIDE, eHIGH, 0);   fliph = !fliph;
-	  CreateXImage();
-	}
+	if (emirr) flip ^= 1;
       }
     }
     else {
@@ -221,30 +227,17 @@ void MakeRootPic(void)
 	x = eWIDE - ((dispWIDE/2)%eWIDE);/* Starting point in picture to cpy */
 	ax = 0;    /* Horizontal anchor point */
 	while (ax < dispWIDE) {
-	  XPutImage(theDisp, tmpPix, theGC, theImage, x,y,
-		    ax,ay, (u_int) eWIDE, (u_int) eHIGH);
-	  if (rmode == RM_ECMIRR) {
-	    FlipPic(epic, eWIDE, eHIGH, 0);  fliph = !fliph;
-	    CreateXImage();
-	  }
+	  copyTile(tmpPix, flip, x,y, ax,ay, eWIDE, eHIGH);
+	  if (emirr) flip ^= 1;
 	  ax += eWIDE - x;
 	  x = 0;
 	}
-	if (rmode == RM_ECMIRR) {
-	  FlipPic(epic, eWIDE, eHIGH, 1);   flipv = !flipv;
-	  if (fliph) {   /* leftmost image is always non-hflipped */
-	    FlipPic(epic, eWIDE, eHIGH, 0);   fliph = !fliph;
-	  }
-	  CreateXImage();
-	}
+	/* leftmost image is always non-hflipped */
+	if (emirr) flip = (flip ^ 2) & 2;
 	ay += eHIGH - y;
 	y = 0;
       }
     }
-
-    /* put epic back to normal */
-    if (fliph) FlipPic(epic, eWIDE, eHIGH, 0);
-    if (flipv) FlipPic(epic, eWIDE, eHIGH, 1);
   }
 
 
@@ -255,6 +248,126 @@ void MakeRootPic(void)
 }
 
 
+/***********************************/
+void FreeRootTiles(void)
+{
+  /* called whenever theImage changes, as the uploaded copies of it are
+     no longer any good.  (A pixmap that's still some window's background
+     stays alive in the server until the window lets go of it) */
+
+  if (building) return;
+
+  if (tilePix) XFreePixmap(theDisp, tilePix);
+  if (mirPix)  XFreePixmap(theDisp, mirPix);
+  tilePix = mirPix = (Pixmap) None;
+  tileW = tileH = 0;
+}
+
+
+/***********************************/
+static int makeTiles(int mirror)
+{
+  /* makes sure tilePix (and mirPix, if 'mirror') hold the current image.
+     returns '0' if the X server is out of memory */
+
+  if (tilePix && (tileW != eWIDE || tileH != eHIGH)) FreeRootTiles();
+
+  if (!tilePix) {
+    tilePix = newPixmap((u_int) eWIDE, (u_int) eHIGH);
+    if (!tilePix) return 0;
+    tileW = eWIDE;  tileH = eHIGH;
+
+    if (!tileGC) {
+      XGCValues gcv;
+      gcv.graphics_exposures = False;
+      tileGC = XCreateGC(theDisp, tilePix, GCGraphicsExposures, &gcv);
+    }
+
+    XPutImage(theDisp, tilePix, theGC, theImage, 0,0, 0,0,
+	      (u_int) eWIDE, (u_int) eHIGH);
+  }
+
+  if (mirror && !mirPix) {
+    if (epic == NULL) FatalError("epic == NULL in makeTiles()...\n");
+
+    mirPix = newPixmap((u_int) 2*eWIDE, (u_int) 2*eHIGH);
+    if (!mirPix) return 0;
+
+    /* quadrant 2 */
+    XCopyArea(theDisp, tilePix, mirPix, tileGC, 0,0,
+	      (u_int) eWIDE, (u_int) eHIGH, 0,0);
+
+    building = 1;     /* CreateXImage() mustn't throw away tilePix */
+
+    /* quadrant 1 */
+    FlipPic(epic, eWIDE, eHIGH, 0);   /* flip horizontally */
+    CreateXImage();
+    XPutImage(theDisp, mirPix, theGC, theImage, 0,0, eWIDE,0,
+	      (u_int) eWIDE, (u_int) eHIGH);
+
+    /* quadrant 4 */
+    FlipPic(epic, eWIDE, eHIGH, 1);   /* flip vertically */
+    CreateXImage();
+    XPutImage(theDisp, mirPix, theGC, theImage, 0,0, eWIDE,eHIGH,
+	      (u_int) eWIDE, (u_int) eHIGH);
+
+    /* quadrant 3 */
+    FlipPic(epic, eWIDE, eHIGH, 0);   /* flip horizontally */
+    CreateXImage();
+    XPutImage(theDisp, mirPix, theGC, theImage, 0,0, 0,eHIGH,
+	      (u_int) eWIDE, (u_int) eHIGH);
+
+    FlipPic(epic, eWIDE, eHIGH, 1);   /* flip vertically  (back to orig) */
+    CreateXImage();                   /* put back to original state */
+
+    building = 0;
+  }
+
+  return 1;
+}
+
+
+/***********************************/
+static Pixmap newPixmap(unsigned int w, unsigned int h)
+{
+  /* returns a w*h pixmap of the screen's depth, or None if the X server
+     hasn't got the memory */
+
+  Pixmap pix;
+
+  xerrcode = 0;
+  pix = XCreatePixmap(theDisp, mainW, w, h, dispDEEP);
+  XSync(theDisp, False);
+  if (xerrcode || !pix) return (Pixmap) None;
+
+  return pix;
+}
+
+
+/***********************************/
+static void copyTile(Drawable dst, int flip, int sx, int sy, int dx, int dy, int w, int h)
+{
+  /* copies the area sx,sy,w,h of the image to dx,dy in 'dst', taking it
+     from the copy in mirPix chosen by 'flip' (see MakeRootPic()), or from
+     tilePix if 'flip' is 0.  Like XPutImage(), clips the area to the
+     image, so it never spills over into a neighbouring copy */
+
+  if (sx<0) { w += sx;  dx -= sx;  sx = 0; }
+  if (sy<0) { h += sy;  dy -= sy;  sy = 0; }
+  if (sx+w > eWIDE) w = eWIDE - sx;
+  if (sy+h > eHIGH) h = eHIGH - sy;
+  if (w<=0 || h<=0) return;
+
+  if (!flip)
+    XCopyArea(theDisp, tilePix, dst, tileGC, sx, sy, (u_int) w, (u_int) h,
+	      dx, dy);
+  else
+    XCopyArea(theDisp, mirPix, dst, tileGC,
+	      sx + ((flip & 1) ? eWIDE : 0), sy + ((flip & 2) ? eHIGH : 0),
+	      (u_int) w, (u_int) h, dx, dy);
+}
+
+
 
 /************************************************************************/
 void ClearRoot(void)
@@ -6,6 +6,13 @@
  *                               rmap, gmap, bmap, rdmap, gdmap, bdmap, maplen)
  *            byte *Smooth24(pic824, is24, swide, shigh, dwide, dhigh,
  *                               rmap, gmap, bmap)
+ *            byte *SmoothMip(pic824, is24, swide, shigh, dwide, dhigh,
+ *                               rmap, gmap, bmap)
+ *            void  FreeMips()
+ *            byte *Resample24(pic824, is24, swide, shigh, dwide, dhigh,
+ *                               rmap, gmap, bmap, filter, linear)
+ *            int   LightTables(linear, &tolin, &fromlin)
+ *            int   SmoothFilterNum(name)
  *            byte *DoColorDither(pic24, pic8, w, h, rmap,gmap,bmap,
  *                                rdisp, gdisp, bdisp, maplen)
  *            byte *Do332ColorDither(pic24, pic8, w, h, rmap,gmap,bmap,
@@ -16,12 +23,80 @@
 
 #include "xv.h"
 
+static byte *smoothXV PARM((byte *, int, int, int, int, int,
+			    byte *, byte *, byte *));
 static int smoothX  PARM((byte *, byte *, int, int, int, int, int,
 			  byte *, byte *, byte *));
 static int smoothY  PARM((byte *, byte *, int, int, int, int, int,
 			  byte *, byte *, byte *));
 static int smoothXY PARM((byte *, byte *, int, int, int, int, int,
 			  byte *, byte *, byte *));
+static byte *mipLevel  PARM((int));
+static void  mipWorker PARM((void *, int));
+static double rsKernel PARM((int, double));
+static int   rsTable   PARM((int, int, int, int **, short **));
+static void  rsHWorker PARM((void *, int));
+static void  rsVWorker PARM((void *, int));
+
+
+/* 2x box-filtered reductions ('mipmaps') of the last image SmoothMip() was
+   asked to shrink.  Level 1 is half the size of the image, level 2 a
+   quarter, and so on;  all are 24-bit, whatever the image was.  Levels are
+   only made as they're needed, and are kept until FreeMips() */
+
+#define MIPLEVELS 24
+
+static byte *mipSrc = (byte *) NULL;       /* the image they came from */
+static int   mipIs24, mipLinear, mipN;
+static byte  mipMap[3][256];               /* its colormap, if !mipIs24 */
+static byte *mipPic[MIPLEVELS+1];          /* [0] is the image itself */
+static int   mipW[MIPLEVELS+1], mipH[MIPLEVELS+1];
+
+/* shared state for the mipWorker()s */
+typedef struct { byte *src, *dst;
+		 int   sw, sh, dw, sbpp;   /* sbpp: bytes per pixel of src */
+		 u_short *tolin;           /* averaging in linear light:  */
+		 byte  *fromlin;           /*   LightTables(), else NULL */
+		 int   nunits, next;       /* ParallelNext() counter */
+	       } MIPPAR;
+
+#define MIPROWS 32                         /* dst rows per unit of work */
+
+
+/* Resample24() kernels, in SF_* order.  'support' is the kernel's radius
+   in source pixels when it isn't being stretched to cover a shrink */
+
+static struct { const char *name;  double support; } rsFilt[SF_MAX] = {
+  { "xv",       0.0 },
+  { "box",      0.5 },
+  { "bilinear", 1.0 },
+  { "mitchell", 2.0 },
+  { "lanczos",  3.0 },
+};
+
+/* weights are fixed-point, RSONE = 1.0.  The horizontal pass keeps RSFRAC
+   fraction bits in its (short) results, so the overshoot of the negative
+   lobes isn't lost before the vertical pass */
+
+#define RSBITS  14
+#define RSONE   (1 << RSBITS)
+#define RSFRAC  6
+#define RSROWS  16                         /* rows per unit of work */
+
+/* shared state for the rsHWorker()s and rsVWorker()s */
+typedef struct { byte  *src, *dst;
+		 short *tmp;               /* dwide x shigh, 3 per pixel */
+		 int   *acc;               /* one dwide*3 row per worker */
+		 int    sw, sh, dw, dh, is24;
+		 byte  *rmap, *gmap, *bmap;
+		 u_short *tolin;           /* linear light:  LightTables() */
+		 u_short  lmap[3][256];    /*   rmap,gmap,bmap made linear */
+		 byte  *fromlin;           /*   or NULL when not linear */
+		 int    hshift, vshift;    /* to scale the passes' sums */
+		 int   *xstart, *ystart, xtaps, ytaps;
+		 short *xwt, *ywt;
+		 int    nunits, next;      /* ParallelNext() counter */
+	       } RSPAR;
 
 
 /***************************************************/
@@ -35,14 +110,17 @@ byte *SmoothResize(byte *srcpic8, int swide, int shigh, int dwide, int dhigh,
 
   /* returns ptr to a dwide*dhigh array of bytes, or NULL on failure */
 
+  /* (the only caller is GenerateEpic(), with cpic, so this can keep
+     reductions of the image around with SmoothMip()) */
+
   byte *pic24, *pic8;
 
-  pic24 = Smooth24(srcpic8, 0, swide, shigh, dwide, dhigh, rmap, gmap, bmap);
+  pic24 = SmoothMip(srcpic8, 0, swide, shigh, dwide, dhigh, rmap, gmap, bmap);
 
   if (pic24) {
     pic8 = DoColorDither(pic24, NULL, dwide, dhigh, rmap, gmap, bmap,
 			 rdmap, gdmap, bdmap, maplen);
-    free(pic24);
+    PoolFree(pic24);
     return pic8;
   }
 
@@ -56,11 +134,26 @@ byte *Smooth24(byte *pic824, int is24, int swide, int shigh, int dwide, int dhig
 {
   /* does a SMOOTH resize from pic824 (which is either a swide*shigh, 8-bit
      pic, with colormap rmap,gmap,bmap OR a swide*shigh, 24-bit image, based
-     on whether 'is24' is set) into a dwide * dhigh 24-bit image
+     on whether 'is24' is set) into a dwide * dhigh 24-bit image, with the
+     kernel picked by 'smoothFilter', in linear light if 'linearLight'
 
-     returns a dwide*dhigh 24bit image, or NULL on failure (malloc) */
+     returns a dwide*dhigh 24bit image, or NULL on failure (malloc).
+     the image comes from PoolAlloc(), so free it with PoolFree() */
   /* rmap,gmap,bmap should be 'desired' colors */
 
+  if ((smoothFilter > SF_XV && smoothFilter < SF_MAX) || linearLight)
+    return Resample24(pic824, is24, swide, shigh, dwide, dhigh,
+		      rmap, gmap, bmap, smoothFilter, linearLight);
+
+  return smoothXV(pic824, is24, swide, shigh, dwide, dhigh, rmap, gmap, bmap);
+}
+
+
+/***************************************************/
+static byte *smoothXV(byte *pic824, int is24, int swide, int shigh, int dwide, int dhigh, byte *rmap, byte *gmap, byte *bmap)
+{
+  /* xv's own smooth resize, for Smooth24() */
+
   byte *pic24, *pp;
   int  *cxtab, *pxtab;
   int   y1Off, cyOff;
@@ -70,7 +163,7 @@ byte *Smooth24(byte *pic824, int is24, int swide, int shigh, int dwide, int dhig
   int   retval, bperpix;
 
   cA = cB = cC = cD = 0;
-  pp = pic24 = (byte *) malloc((size_t) (dwide * dhigh * 3));
+  pp = pic24 = PoolAlloc((size_t) dwide * dhigh * 3);
   if (!pic24) {
     fprintf(stderr,"unable to malloc pic24 in 'Smooth24()'\n");
     return pic24;
@@ -104,10 +197,10 @@ byte *Smooth24(byte *pic824, int is24, int swide, int shigh, int dwide, int dhig
          px = ((ex * swide * 128) / dwide) - (cx * 128) - 64; */
 
     cxtab = (int *) malloc(dwide * sizeof(int));
-    if (!cxtab) { free(pic24);  return NULL; }
+    if (!cxtab) { PoolFree(pic24);  return NULL; }
 
     pxtab = (int *) malloc(dwide * sizeof(int));
-    if (!pxtab) { free(pic24);  free(cxtab);  return NULL; }
+    if (!pxtab) { PoolFree(pic24);  free(cxtab);  return NULL; }
 
     for (ex=0; ex<dwide; ex++) {
       cxtab[ex] = (ex * swide) / dwide;
@@ -203,7 +296,7 @@ byte *Smooth24(byte *pic824, int is24, int swide, int shigh, int dwide, int dhig
   }
 
   if (retval) {    /* one of the Smooth**() methods failed */
-    free(pic24);
+    PoolFree(pic24);
     pic24 = (byte *) NULL;
   }
 
@@ -213,6 +306,540 @@ byte *Smooth24(byte *pic824, int is24, int swide, int shigh, int dwide, int dhig
 
 
 
+/***************************************************/
+byte *SmoothMip(byte *pic824, int is24, int swide, int shigh, int dwide, int dhigh, byte *rmap, byte *gmap, byte *bmap)
+{
+  /* same as Smooth24(), for an image that's going to be shrunk over and
+     over (cpic, as it's zoomed or its window resized).  Shrinks from the
+     smallest mipmap level that's still at least dwide x dhigh, so the cost
+     depends on the size of the result, not of the image.  The caller
+     must call FreeMips() whenever the image's pixels change */
+
+  int i;
+
+  if (dwide*2 > swide || dhigh*2 > shigh)       /* level 1 wouldn't do */
+    return Smooth24(pic824, is24, swide, shigh, dwide, dhigh,
+		    rmap, gmap, bmap);
+
+  if (mipSrc != pic824 || mipW[0] != swide || mipH[0] != shigh ||
+      mipIs24 != is24 || mipLinear != linearLight ||
+      (!is24 && (bcmp((char *) mipMap[0], (char *) rmap, (size_t) 256) ||
+		 bcmp((char *) mipMap[1], (char *) gmap, (size_t) 256) ||
+		 bcmp((char *) mipMap[2], (char *) bmap, (size_t) 256)))) {
+    FreeMips();
+    mipSrc  = mipPic[0] = pic824;
+    mipW[0] = swide;  mipH[0] = shigh;
+    mipIs24   = is24;
+    mipLinear = linearLight;
+    if (!is24) {
+      bcopy((char *) rmap, (char *) mipMap[0], (size_t) 256);
+      bcopy((char *) gmap, (char *) mipMap[1], (size_t) 256);
+      bcopy((char *) bmap, (char *) mipMap[2], (size_t) 256);
+    }
+  }
+
+  /* go down while the next level is still big enough */
+  for (i=0; i < MIPLEVELS && (mipW[i]+1)/2 >= dwide && (mipH[i]+1)/2 >= dhigh;
+       i++) {
+    if (i == mipN && !mipLevel(i+1)) break;     /* no memory:  stop here */
+  }
+
+  if (DEBUG) fprintf(stderr,"SmoothMip: %dx%d -> %dx%d from level %d (%dx%d)\n",
+		     swide, shigh, dwide, dhigh, i, mipW[i], mipH[i]);
+
+  if (i == 0) return Smooth24(pic824, is24, swide, shigh, dwide, dhigh,
+			      rmap, gmap, bmap);
+
+  return Smooth24(mipPic[i], 1, mipW[i], mipH[i], dwide, dhigh,
+		  (byte *) NULL, (byte *) NULL, (byte *) NULL);
+}
+
+
+/***************************************************/
+void FreeMips(void)
+{
+  /* throws away the mipmaps.  Call it whenever the image they were made
+     from is changed or freed */
+
+  int i;
+
+  for (i=1; i<=mipN; i++) free(mipPic[i]);
+  mipN   = 0;
+  mipSrc = (byte *) NULL;
+  mipW[0] = mipH[0] = 0;
+}
+
+
+/***************************************************/
+static byte *mipLevel(int n)
+{
+  /* makes level 'n' from level n-1, each pixel the average of a 2x2 block
+     (in linear light, if the levels were started with 'linearLight' on).
+     At an odd edge, the last pixel stands in for the missing one.
+     returns NULL if there's no memory */
+
+  MIPPAR mp;
+
+  mp.tolin = (u_short *) NULL;  mp.fromlin = (byte *) NULL;
+  if (mipLinear) LightTables(1, &mp.tolin, &mp.fromlin);
+
+  mp.src  = mipPic[n-1];
+  mp.sw   = mipW[n-1];  mp.sh = mipH[n-1];
+  mp.sbpp = (n == 1 && !mipIs24) ? 1 : 3;
+  mp.dw   = (mp.sw + 1) / 2;
+
+  mp.dst = (byte *) malloc((size_t) mp.dw * ((mp.sh + 1) / 2) * 3);
+  if (!mp.dst) return (byte *) NULL;
+
+  WaitCursor();
+  mp.nunits = ((mp.sh + 1) / 2 + MIPROWS - 1) / MIPROWS;
+  mp.next   = 0;
+  ParallelRun(ParallelWorkers(mp.nunits), mipWorker, (void *) &mp);
+
+  mipPic[n] = mp.dst;
+  mipW[n]   = mp.dw;
+  mipH[n]   = (mp.sh + 1) / 2;
+  mipN      = n;
+  return mp.dst;
+}
+
+
+/***************************************************/
+static void mipWorker(void *data, int worker)
+{
+  /* ParallelRun() worker:  does MIPROWS rows of a mipLevel() at a time */
+
+  MIPPAR  *mp = (MIPPAR *) data;
+  int      band, y, y1, x, x0, x1, c, dh, sbpp;
+  byte    *s0, *s1, *dp, *rm, *gm, *bm, *fl;
+  u_short *tl;
+
+  XV_UNUSED(worker);
+
+  dh   = (mp->sh + 1) / 2;
+  sbpp = mp->sbpp;
+  rm = mipMap[0];  gm = mipMap[1];  bm = mipMap[2];
+  tl = mp->tolin;  fl = mp->fromlin;
+
+  while ((band = ParallelNext(&mp->next, mp->nunits)) >= 0) {
+    y  = band * MIPROWS;
+    y1 = y + MIPROWS;
+    if (y1 > dh) y1 = dh;
+
+    for ( ; y<y1; y++) {
+      s0 = mp->src + (size_t) (2*y) * mp->sw * sbpp;
+      s1 = (2*y+1 < mp->sh) ? s0 + (size_t) mp->sw * sbpp : s0;
+      dp = mp->dst + (size_t) y * mp->dw * 3;
+
+      for (x=0; x<mp->dw; x++, dp+=3) {
+	x0 = 2*x;
+	x1 = (x0+1 < mp->sw) ? x0+1 : x0;
+
+	if (fl && sbpp == 3) {
+	  for (c=0; c<3; c++)
+	    dp[c] = fl[(tl[s0[x0*3+c]] + tl[s0[x1*3+c]] +
+			tl[s1[x0*3+c]] + tl[s1[x1*3+c]] + 2) >> 2];
+	}
+	else if (fl) {
+	  dp[0] = fl[(tl[rm[s0[x0]]] + tl[rm[s0[x1]]] +
+		      tl[rm[s1[x0]]] + tl[rm[s1[x1]]] + 2) >> 2];
+	  dp[1] = fl[(tl[gm[s0[x0]]] + tl[gm[s0[x1]]] +
+		      tl[gm[s1[x0]]] + tl[gm[s1[x1]]] + 2) >> 2];
+	  dp[2] = fl[(tl[bm[s0[x0]]] + tl[bm[s0[x1]]] +
+		      tl[bm[s1[x0]]] + tl[bm[s1[x1]]] + 2) >> 2];
+	}
+	else if (sbpp == 3) {
+	  for (c=0; c<3; c++)
+	    dp[c] = (s0[x0*3+c] + s0[x1*3+c] + s1[x0*3+c] + s1[x1*3+c] + 2) >> 2;
+	}
+	else {
+	  dp[0] = (rm[s0[x0]] + rm[s0[x1]] + rm[s1[x0]] + rm[s1[x1]] + 2) >> 2;
+	  dp[1] = (gm[s0[x0]] + gm[s0[x1]] + gm[s1[x0]] + gm[s1[x1]] + 2) >> 2;
+	  dp[2] = (bm[s0[x0]] + bm[s0[x1]] + bm[s1[x0]] + bm[s1[x1]] + 2) >> 2;
+	}
+      }
+    }
+  }
+}
+
+
+/***************************************************/
+byte *Resample24(byte *pic824, int is24, int swide, int shigh, int dwide, int dhigh, byte *rmap, byte *gmap, byte *bmap, int filter, int linear)
+{
+  /* resizes pic824 (as in Smooth24()) into a dwide * dhigh 24-bit image,
+     with one of the SF_* kernels.  The kernel is applied separably:  first
+     across each row, into a dwide x shigh intermediate, then down each
+     column.  When shrinking, the kernel is stretched to cover every
+     source pixel that lands in a destination pixel.  Past the edges of
+     the image, the edge pixels are repeated.
+
+     If 'linear' is set, the pixels are averaged in linear light, rather
+     than as the (gamma-encoded) sRGB values they're stored as, so fine
+     detail doesn't come out too dark.  SF_XV is only allowed with
+     'linear', and stands for xv's own method:  an area average on an axis
+     that's shrinking, and bilinear on one that isn't.
+
+     returns a dwide*dhigh 24bit image from PoolAlloc(), or NULL on
+     failure (malloc) */
+
+  RSPAR rp;
+  byte *pic24;
+  int   nw, i, xfilt, yfilt;
+
+  if (filter < SF_XV || filter >= SF_MAX) filter = SF_XV;
+
+  xfilt = yfilt = filter;
+  if (filter == SF_XV) {
+    if (!linear) return smoothXV(pic824, is24, swide, shigh, dwide, dhigh,
+				 rmap, gmap, bmap);
+    xfilt = (dwide < swide) ? SF_BOX : SF_BILINEAR;
+    yfilt = (dhigh < shigh) ? SF_BOX : SF_BILINEAR;
+  }
+
+  bzero((char *) &rp, sizeof(rp));
+  pic24 = PoolAlloc((size_t) dwide * dhigh * 3);
+  rp.tmp = (short *) malloc((size_t) dwide * shigh * 3 * sizeof(short));
+  rp.xtaps = rsTable(xfilt, swide, dwide, &rp.xstart, &rp.xwt);
+  rp.ytaps = rsTable(yfilt, shigh, dhigh, &rp.ystart, &rp.ywt);
+
+  nw = ParallelWorkers((dhigh + RSROWS - 1) / RSROWS);
+  rp.acc = (int *) malloc((size_t) nw * dwide * 3 * sizeof(int));
+
+  if (!pic24 || !rp.tmp || !rp.xtaps || !rp.ytaps || !rp.acc) {
+    fprintf(stderr,"unable to malloc in 'Resample24()'\n");
+    if (pic24) PoolFree(pic24);
+    pic24 = (byte *) NULL;
+    goto rsexit;
+  }
+
+  rp.src = pic824;  rp.dst  = pic24;  rp.is24 = is24;
+  rp.sw  = swide;   rp.sh   = shigh;
+  rp.dw  = dwide;   rp.dh   = dhigh;
+  rp.rmap = rmap;   rp.gmap = gmap;   rp.bmap = bmap;
+
+  /* the passes' results are 6 bits more precise than bytes.  in linear
+     light, 0..LINMAX is already that precise */
+  rp.hshift = RSBITS - RSFRAC;
+  rp.vshift = RSBITS + RSFRAC;
+  if (linear) {
+    LightTables(1, &rp.tolin, &rp.fromlin);
+    rp.hshift = rp.vshift = RSBITS;
+    if (!is24) {
+      for (i=0; i<256; i++) {
+	rp.lmap[0][i] = rp.tolin[rmap[i]];
+	rp.lmap[1][i] = rp.tolin[gmap[i]];
+	rp.lmap[2][i] = rp.tolin[bmap[i]];
+      }
+    }
+  }
+
+  WaitCursor();
+  rp.nunits = (shigh + RSROWS - 1) / RSROWS;
+  rp.next   = 0;
+  ParallelRun(ParallelWorkers(rp.nunits), rsHWorker, (void *) &rp);
+
+  WaitCursor();
+  rp.nunits = (dhigh + RSROWS - 1) / RSROWS;
+  rp.next   = 0;
+  ParallelRun(nw, rsVWorker, (void *) &rp);
+
+ rsexit:
+  if (rp.tmp)    free(rp.tmp);
+  if (rp.acc)    free(rp.acc);
+  if (rp.xstart) free(rp.xstart);
+  if (rp.xwt)    free(rp.xwt);
+  if (rp.ystart) free(rp.ystart);
+  if (rp.ywt)    free(rp.ywt);
+
+  return pic24;
+}
+
+
+/***************************************************/
+int SmoothFilterNum(const char *name)
+{
+  /* returns the SF_* value named by 'name' (any case), or -1 */
+
+  int i;
+
+  for (i=0; i<SF_MAX; i++)
+    if (!strcasecmp(name, rsFilt[i].name)) return i;
+
+  return -1;
+}
+
+
+/***************************************************/
+int LightTables(int linear, u_short **tolin, byte **fromlin)
+{
+  /* hands back lookup tables for averaging pixel values:  tolin[] maps a
+     byte to the value to average, and fromlin[] maps an average back to a
+     byte.  If 'linear' is set, they convert sRGB to and from linear light,
+     0..LINMAX.  If not, they're 0..255 identity tables.  returns the value
+     that white maps to.
+
+     The tables are made on the first call, so make that from the main
+     thread, before starting any workers */
+
+  static u_short tl[256], id[256];
+  static byte    fl[LINMAX+1], idb[256];
+  static int     made = 0;
+  double v;
+  int    i;
+
+  if (!made) {
+    for (i=0; i<256; i++) {
+      v = i / 255.0;
+      v = (v <= 0.04045) ? v / 12.92 : pow((v + 0.055) / 1.055, 2.4);
+      tl[i] = (u_short) (v * LINMAX + 0.5);
+      id[i] = (u_short) i;  idb[i] = (byte) i;
+    }
+
+    for (i=0; i<=LINMAX; i++) {
+      v = (double) i / LINMAX;
+      v = (v <= 0.0031308) ? v * 12.92 : 1.055 * pow(v, 1.0/2.4) - 0.055;
+      fl[i] = (byte) (v * 255.0 + 0.5);
+    }
+    made = 1;
+  }
+
+  *tolin   = (linear) ? tl : id;
+  *fromlin = (linear) ? fl : idb;
+  return (linear) ? LINMAX : 255;
+}
+
+
+/***************************************************/
+static double rsKernel(int filter, double x)
+{
+  /* value of the kernel at distance 'x' (in source pixels, at 1:1) */
+
+  double ax, px;
+
+  ax = fabs(x);
+
+  switch (filter) {
+  case SF_BOX:
+    return (x > -0.5 && x <= 0.5) ? 1.0 : 0.0;
+
+  case SF_BILINEAR:
+    return (ax < 1.0) ? 1.0 - ax : 0.0;
+
+  case SF_MITCHELL:                        /* B = C = 1/3 */
+    if (ax < 1.0) return (7.0*ax*ax*ax - 12.0*ax*ax + 16.0/3.0) / 6.0;
+    if (ax < 2.0) return (-7.0/3.0*ax*ax*ax + 12.0*ax*ax - 20.0*ax
+			  + 32.0/3.0) / 6.0;
+    return 0.0;
+
+  case SF_LANCZOS:
+    if (ax < 1e-8) return 1.0;
+    if (ax >= 3.0) return 0.0;
+    px = 3.1415926535897932385 * ax;
+    return 3.0 * sin(px) * sin(px / 3.0) / (px * px);
+  }
+
+  return 0.0;
+}
+
+
+/***************************************************/
+static int rsTable(int filter, int slen, int dlen, int **startp, short **wtp)
+{
+  /* builds the weights for resizing a line of 'slen' pixels to 'dlen'.
+     Every destination pixel gets the same number of taps;  destination
+     pixel i is the sum of src[start[i] + k] * wt[i*taps + k] / RSONE.
+     Taps that fall off the end are folded onto the edge pixel.
+
+     returns the number of taps, or 0 if there's no memory */
+
+  double  scale, support, center, *fw, sum;
+  int     taps, i, j, k, left, right, start, idx, total, big;
+  int    *st;
+  short  *wt;
+
+  scale   = (dlen < slen) ? (double) slen / dlen : 1.0;
+  support = rsFilt[filter].support * scale;
+  taps    = (int) (2.0 * support) + 1;
+  if (taps > slen) taps = slen;
+
+  st = (int *)    malloc((size_t) dlen * sizeof(int));
+  wt = (short *)  malloc((size_t) dlen * taps * sizeof(short));
+  fw = (double *) malloc((size_t) taps * sizeof(double));
+  if (!st || !wt || !fw) {
+    if (st) free(st);
+    if (wt) free(wt);
+    if (fw) free(fw);
+    *startp = (int *) NULL;  *wtp = (short *) NULL;
+    return 0;
+  }
+
+  for (i=0; i<dlen; i++) {
+    center = (i + 0.5) * slen / dlen - 0.5;
+    left   = (int) ceil (center - support);
+    right  = (int) floor(center + support);
+
+    start = left;
+    if (start > slen - taps) start = slen - taps;
+    if (start < 0) start = 0;
+
+    for (k=0; k<taps; k++) fw[k] = 0.0;
+    for (j=left, sum=0.0; j<=right; j++) {
+      idx = (j < 0) ? 0 : (j >= slen) ? slen-1 : j;
+      fw[idx - start] += rsKernel(filter, (j - center) / scale);
+    }
+
+    for (k=0; k<taps; k++) sum += fw[k];
+    if (sum <= 0.0) {              /* box kernel falling between pixels */
+      idx = (int) floor(center + 0.5);
+      RANGE(idx, 0, slen-1);
+      fw[idx - start] = sum = 1.0;
+    }
+
+    /* rounding can leave the weights a bit off RSONE.  the biggest one
+       takes up the slack, so flat areas stay exactly flat */
+    for (k=total=big=0; k<taps; k++) {
+      wt[i*taps + k] = (short) floor(fw[k] / sum * RSONE + 0.5);
+      total += wt[i*taps + k];
+      if (abs(wt[i*taps + k]) > abs(wt[i*taps + big])) big = k;
+    }
+    wt[i*taps + big] += RSONE - total;
+    st[i] = start;
+  }
+
+  free(fw);
+  *startp = st;  *wtp = wt;
+  return taps;
+}
+
+
+/***************************************************/
+static void rsHWorker(void *data, int worker)
+{
+  /* ParallelRun() worker:  resamples RSROWS source rows across at a time,
+     into rp->tmp */
+
+  RSPAR   *rp = (RSPAR *) data;
+  int      band, y, y1, x, k, taps, r, g, b, w, sh, rnd;
+  byte    *sp, *s, *rm, *gm, *bm;
+  short   *tp, *wp;
+  u_short *tl, *lr, *lg, *lb;
+
+  XV_UNUSED(worker);
+
+  taps = rp->xtaps;
+  rm = rp->rmap;  gm = rp->gmap;  bm = rp->bmap;
+  tl = rp->tolin;
+  lr = rp->lmap[0];  lg = rp->lmap[1];  lb = rp->lmap[2];
+  sh  = rp->hshift;
+  rnd = 1 << (sh - 1);
+
+  while ((band = ParallelNext(&rp->next, rp->nunits)) >= 0) {
+    y  = band * RSROWS;
+    y1 = y + RSROWS;
+    if (y1 > rp->sh) y1 = rp->sh;
+
+    for ( ; y<y1; y++) {
+      sp = rp->src + (size_t) y * rp->sw * ((rp->is24) ? 3 : 1);
+      tp = rp->tmp + (size_t) y * rp->dw * 3;
+
+      for (x=0, wp=rp->xwt; x<rp->dw; x++, wp+=taps, tp+=3) {
+	r = g = b = rnd;
+	if (rp->is24) {
+	  s = sp + rp->xstart[x] * 3;
+	  if (tl) {
+	    for (k=0; k<taps; k++, s+=3) {
+	      w = wp[k];
+	      r += tl[s[0]] * w;  g += tl[s[1]] * w;  b += tl[s[2]] * w;
+	    }
+	  }
+	  else {
+	    for (k=0; k<taps; k++, s+=3) {
+	      w = wp[k];
+	      r += s[0] * w;  g += s[1] * w;  b += s[2] * w;
+	    }
+	  }
+	}
+	else {
+	  s = sp + rp->xstart[x];
+	  if (tl) {
+	    for (k=0; k<taps; k++, s++) {
+	      w = wp[k];
+	      r += lr[*s] * w;  g += lg[*s] * w;  b += lb[*s] * w;
+	    }
+	  }
+	  else {
+	    for (k=0; k<taps; k++, s++) {
+	      w = wp[k];
+	      r += rm[*s] * w;  g += gm[*s] * w;  b += bm[*s] * w;
+	    }
+	  }
+	}
+
+	/* at most 1.3 * (255 << RSFRAC) or LINMAX (the lanczos overshoot),
+	   so no clipping is needed to fit in a short */
+	tp[0] = (short) (r >> sh);
+	tp[1] = (short) (g >> sh);
+	tp[2] = (short) (b >> sh);
+      }
+    }
+  }
+}
+
+
+/***************************************************/
+static void rsVWorker(void *data, int worker)
+{
+  /* ParallelRun() worker:  resamples RSROWS destination rows down at a
+     time, from rp->tmp into rp->dst.  Each row is built up one tap at a
+     time in this worker's accumulator row, in straight-line loops that the
+     compiler can vectorize */
+
+  RSPAR *rp = (RSPAR *) data;
+  int    band, y, y1, i, k, n, taps, w, v, sh, *acc;
+  short *tp, *wp;
+  byte  *dp, *fl;
+
+  sh   = rp->vshift;
+  fl   = rp->fromlin;
+  taps = rp->ytaps;
+  n    = rp->dw * 3;
+  acc  = rp->acc + (size_t) worker * n;
+
+  while ((band = ParallelNext(&rp->next, rp->nunits)) >= 0) {
+    y  = band * RSROWS;
+    y1 = y + RSROWS;
+    if (y1 > rp->dh) y1 = rp->dh;
+
+    for ( ; y<y1; y++) {
+      wp = rp->ywt + (size_t) y * taps;
+      tp = rp->tmp + (size_t) rp->ystart[y] * n;
+
+      for (i=0; i<n; i++) acc[i] = 1 << (sh-1);   /* rounding */
+
+      for (k=0; k<taps; k++, tp+=n) {
+	w = wp[k];
+	if (!w) continue;
+	for (i=0; i<n; i++) acc[i] += tp[i] * w;
+      }
+
+      dp = rp->dst + (size_t) y * n;
+      if (fl) {
+	for (i=0; i<n; i++) {
+	  v = acc[i] >> sh;
+	  dp[i] = fl[(v < 0) ? 0 : (v > LINMAX) ? LINMAX : v];
+	}
+      }
+      else {
+	for (i=0; i<n; i++) {
+	  v = acc[i] >> sh;
+	  dp[i] = (v < 0) ? 0 : (v > 255) ? 255 : v;
+	}
+      }
+    }
+  }
+}
+
+
 /***************************************************/
 static int smoothX(byte *pic24, byte *pic824, int is24, int swide, int shigh, int dwide, int dhigh,
 		   byte *rmap, byte *gmap, byte *bmap)
@@ -455,7 +1082,7 @@ static int smoothXY(byte *pic24, byte *pic824, int is24, int swide, int shigh, i
   lastline = linecnt = pixR = pixG = pixB = 0;
   cptr = pic824;
 
-  for (i=0; i<shigh; i++) {
+  for (i=0; i<=shigh; i++) {   /* one extra pass flushes the last line */
     ProgressMeter(0, shigh, i, "Smooth");
     if ((i&15) == 0) WaitCursor();
 
@@ -524,7 +1151,7 @@ byte *DoColorDither(byte *pic24, byte *pic8, int w, int h, byte *rmap, byte *gma
      rdisp, gdisp, bdisp (which have already been allocated),
      and generates an 8-bit w*h image, which it returns.
      ignores input value 'pic8'
-     returns NULL on error
+     returns NULL on error.  the image comes from PoolAlloc()
 
      note: the rdisp,gdisp,bdisp arrays should be the 'displayed' colors,
      not the 'desired' colors
@@ -554,12 +1181,12 @@ byte *DoColorDither(byte *pic24, byte *pic8, int w, int h, byte *rmap, byte *gma
   ep = (pic24) ? pic24 : pic8;
 
   /* attempt to malloc things */
-  newpic = (byte *)  malloc((size_t) (w * h));
+  newpic = PoolAlloc((size_t) w * h);
   cache  = (short *) calloc((size_t) (2<<14), sizeof(short));
   thisline = (int *) malloc(pwide3 * sizeof(int));
   nextline = (int *) malloc(pwide3 * sizeof(int));
   if (!cache || !newpic || !thisline || !nextline) {
-    if (newpic)   free(newpic);
+    if (newpic)   PoolFree(newpic);
     if (cache)    free(cache);
     if (thisline) free(thisline);
     if (nextline) free(nextline);
@@ -40,7 +40,7 @@ struct rasterfile {
 
 
 static int  sunRasError    PARM((const char *, const char *));
-static int  rle_read       PARM((byte *, int, int, FILE *, int));
+static int  rle_read       PARM((byte *, int, int, FILE *, int *));
 static void sunRas1to8     PARM((byte *, byte *, int));
 static void sunRas8to1     PARM((byte *, byte *, int, int));
 static int  read_sun_long  PARM((int *, FILE *));
@@ -56,6 +56,7 @@ int LoadSunRas(char *fname, PICINFO *pinfo)
   byte	 *image, *line;
   struct rasterfile sunheader;
   const char *bname;
+  int    rlestate[2];    /* rle_read()'s pending run:  count, byte */
 
   bname = BaseName(fname);
 
@@ -205,10 +206,11 @@ int LoadSunRas(char *fname, PICINFO *pinfo)
     FatalError("Can't allocate memory for image\n");
 
 
+  rlestate[0] = rlestate[1] = 0;
   for (i = 0; i < h; i++) {
     if ((i&0x1f) == 0) WaitCursor();
     if (sunheader.ras_type == RT_BYTE_ENCODED) {
-      if (rle_read (line, 1, linesize, fp, (i==0)) != linesize) break;
+      if (rle_read (line, 1, linesize, fp, rlestate) != linesize) break;
     }
 
     else {
@@ -274,12 +276,14 @@ int LoadSunRas(char *fname, PICINFO *pinfo)
 
 
 /*****************************/
-static int rle_read (byte *ptr, int size, int nitems, FILE *fp, int init)
+static int rle_read (byte *ptr, int size, int nitems, FILE *fp, int *state)
 {
-  static int count, ch;
-  int readbytes, c, read;
+  /* 'state' carries a run that's still pending from one call to the next.
+     Zero it before the first call */
 
-  if (init) { count = ch = 0; }
+  int count, ch, readbytes, c, read;
+
+  count = state[0];  ch = state[1];
 
   readbytes = size * nitems;
   for (read = 0; read < readbytes; read++) {
@@ -307,6 +311,7 @@ static int rle_read (byte *ptr, int size, int nitems, FILE *fp, int init)
     }
   }
 
+  state[0] = count;  state[1] = ch;
   return (read/size);
 }
 
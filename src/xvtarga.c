@@ -35,8 +35,6 @@
 
 #include "xv.h"
 
-static long filesize;
-static const char *bname;
 
 
 /*******************************************/
@@ -48,6 +46,8 @@ int LoadTarga(char *fname, PICINFO *pinfo)
   FILE  *fp;
   int    i, row, c, c1, w, h, npixels, bufsize, flags, intlace, topleft, trunc;
   byte *pic24, *pp;
+  long   filesize;
+  const char *bname;
 
   bname = BaseName(fname);
 
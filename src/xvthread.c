@@ -0,0 +1,148 @@
+/*
+ * xvthread.c - tiny worker-thread helper for XV
+ *
+ *  Contains:
+ *            int  ParallelWorkers(nitems)
+ *            void ParallelRun(nworkers, func, data)
+ *            int  ParallelNext(counter, limit)
+ *            void ParallelLock()
+ *            void ParallelUnlock()
+ *
+ * Loaders and image-processing routines that can split their work into
+ * independent units (strips, tiles, row bands) hand them to ParallelRun().
+ * Worker 0 always runs on the calling thread, so when threads are disabled
+ * (or only one is wanted) everything degenerates to a plain function call.
+ *
+ * Worker functions must not touch X, the UI, or FatalError(); record
+ * problems in their own state and let the caller report them afterwards.
+ */
+
+#include "copyright.h"
+
+#include "xv.h"
+
+#ifdef HAVE_PTHREADS
+#  include <pthread.h>
+#  include <unistd.h>
+#endif
+
+#define MAXWORKERS 64
+
+typedef struct {
+  void (*func) PARM((void *, int));
+  void  *data;
+  int    worker;
+} PWORK;
+
+#ifdef HAVE_PTHREADS
+static pthread_mutex_t plock = PTHREAD_MUTEX_INITIALIZER;
+
+static void *pthreadMain PARM((void *));
+#endif
+
+
+/***************************************************/
+int ParallelWorkers(int nitems)
+{
+  /* returns the number of workers worth starting for 'nitems' independent
+     units of work.  honors the '-threads' option / 'threads' resource;
+     0 (the default) means 'one per online cpu' */
+
+  int n;
+
+#ifdef HAVE_PTHREADS
+  n = numThreads;
+  if (n <= 0) {
+#  ifdef _SC_NPROCESSORS_ONLN
+    n = (int) sysconf(_SC_NPROCESSORS_ONLN);
+#  else
+    n = 1;
+#  endif
+  }
+  if (n > MAXWORKERS) n = MAXWORKERS;
+#else
+  n = 1;
+#endif
+
+  if (n > nitems) n = nitems;
+  if (n < 1)      n = 1;
+  return n;
+}
+
+
+/***************************************************/
+void ParallelRun(int nworkers, void (*func) PARM((void *, int)), void *data)
+{
+  /* calls func(data, w) for w = 0 .. nworkers-1, concurrently if possible,
+     and returns when all of them have finished */
+
+  int i;
+#ifdef HAVE_PTHREADS
+  pthread_t tids[MAXWORKERS];
+  PWORK     work[MAXWORKERS];
+  int       started[MAXWORKERS];
+
+  if (nworkers > MAXWORKERS) nworkers = MAXWORKERS;
+
+  for (i=1; i<nworkers; i++) {
+    work[i].func = func;  work[i].data = data;  work[i].worker = i;
+    started[i] = (pthread_create(&tids[i], NULL, pthreadMain, &work[i]) == 0);
+  }
+
+  (*func)(data, 0);
+
+  for (i=1; i<nworkers; i++) {
+    if (started[i]) pthread_join(tids[i], NULL);
+    else (*func)(data, i);     /* couldn't spawn it:  do its share here */
+  }
+#else
+  for (i=0; i<nworkers; i++) (*func)(data, i);
+#endif
+}
+
+
+/***************************************************/
+int ParallelNext(int *counter, int limit)
+{
+  /* hands out work items 0 .. limit-1 from a shared counter, one per call.
+     returns -1 when they're all gone */
+
+  int n;
+
+  ParallelLock();
+  n = *counter;
+  if (n < limit) (*counter)++;
+  ParallelUnlock();
+
+  return (n < limit) ? n : -1;
+}
+
+
+/***************************************************/
+void ParallelLock(void)
+{
+#ifdef HAVE_PTHREADS
+  pthread_mutex_lock(&plock);
+#endif
+}
+
+
+/***************************************************/
+void ParallelUnlock(void)
+{
+#ifdef HAVE_PTHREADS
+  pthread_mutex_unlock(&plock);
+#endif
+}
+
+
+#ifdef HAVE_PTHREADS
+/***************************************************/
+static void *pthreadMain(void *arg)
+{
+  PWORK *pw = (PWORK *) arg;
+
+  (*pw->func)(pw->data, pw->worker);
+  return NULL;
+}
+#endif
@@ -10,12 +10,17 @@
 
 #include <string.h>
 #include <stdint.h>
+#include <fcntl.h>
 #include "xv.h"
 
 #ifdef HAVE_TIFF
 
 #include "tiffio.h"     /* has to be after xv.h, as it needs varargs/stdarg */
 
+#ifdef HAVE_PTHREADS
+#  include <pthread.h>
+#endif
+
 
 /* Portions fall under the following copyright:
  *
@@ -43,20 +48,66 @@
  */
 
 
+/* everything one LoadTIFF() call keeps between its helpers.  The workers
+   that decode its strips or tiles share it, too */
+typedef struct {
+  const char *filename;           /* file (or page file) being read */
+  const char *bname;              /* what messages call it */
+  long        filesize;
+  byte       *rmap, *gmap, *bmap;
+
+  int         error_occurred;
+  int         defermsgs;          /* hold messages while workers run */
+  char        deferredmsg[2048];
+
+  u_short     bitspersample;
+  u_short     samplesperpixel;
+  u_short     photometric;
+  u_short     orientation;
+
+  /* colormap for pallete images */
+  u_short    *redcmap, *greencmap, *bluecmap;
+  int         stoponerr;          /* stop on read error */
+
+  /* YCbCr support */
+  u_short     YCbCrHorizSampling;
+  u_short     YCbCrVertSampling;
+  float      *YCbCrCoeffs;
+  float      *refBlackWhite;
+  float       D1, D2, D3, D4;
+
+  byte      **BWmap;
+  byte      **PALmap;
+  int         jpegcolormode;      /* JPEGCOLORMODE_RGB was set */
+} TIFFDEC;
+
+
+static int   loadTIFF    PARM((TIFFDEC *, char *, PICINFO *, int));
+static TIFF *tiffOpen    PARM((const char *, const char *));
 static int   copyTiff    PARM((TIFF *, char *));
+static int   cpDir       PARM((TIFF *, TIFF *));
 static int   cpStrips    PARM((TIFF *, TIFF *));
 static int   cpTiles     PARM((TIFF *, TIFF *));
-static byte *loadPalette PARM((TIFF *, uint32_t, uint32_t, int, int, PICINFO *));
-static byte *loadColor   PARM((TIFF *, uint32_t, uint32_t, int, int, PICINFO *));
-static int   loadImage   PARM((TIFF *, uint32_t, uint32_t, byte *, int));
+static byte *loadPalette PARM((TIFFDEC *, TIFF *, uint32_t, uint32_t, int, int, PICINFO *));
+static byte *loadColor   PARM((TIFFDEC *, TIFF *, uint32_t, uint32_t, int, int, PICINFO *));
+static int   loadImage   PARM((TIFFDEC *, TIFF *, uint32_t, uint32_t, byte *, int));
+static int   isOverview  PARM((TIFF *));
+static int   pickOverview PARM((TIFF *, uint32_t, uint32_t, int));
+static void  setDec      PARM((TIFFDEC *));
+static TIFFDEC *curDec   PARM((void));
 static void  _TIFFerr    PARM((const char *, const char *, va_list));
 static void  _TIFFwarn   PARM((const char *, const char *, va_list));
 
-static long  filesize;
-static byte *rmap, *gmap, *bmap;
-static const char *filename;
-
-static int   error_occurred;
+/* libtiff's error handlers are process-wide and aren't told which file
+   they're complaining about, so each thread notes the TIFFDEC it's
+   working for, and the handlers look it up */
+#ifdef HAVE_PTHREADS
+static pthread_key_t  deckey;
+static pthread_once_t deconce = PTHREAD_ONCE_INIT;
+static void makeDecKey PARM((void));
+#else
+static TIFFDEC *curdec;
+#endif
 
 
 /*******************************************/
@@ -65,17 +116,30 @@ int LoadTIFF(char *fname, PICINFO *pinfo, int quick)
 {
   /* returns '1' on success, '0' on failure */
 
+  TIFFDEC tiffdec;
+  int     rv;
+
+  bzero((char *) &tiffdec, sizeof(tiffdec));
+  setDec(&tiffdec);
+  rv = loadTIFF(&tiffdec, fname, pinfo, quick);
+  setDec((TIFFDEC *) NULL);
+
+  return rv;
+}
+
+
+/*******************************************/
+static int loadTIFF(TIFFDEC *td, char *fname, PICINFO *pinfo, int quick)
+{
   TIFF  *tif;
-  uint32_t w, h;
+  uint32_t w, h, fullw, fullh;
   float  xres, yres;
   short	 bps, spp, photo, orient;
   FILE  *fp;
   byte  *pic8;
-  char  *desc, oldpath[MAXPATHLEN+1], tmppath[MAXPATHLEN+1], *sp;
+  char  *desc;
   char   tmp[256+32], tmpname[256];
-  int    i, nump;
-
-  error_occurred = 0;
+  int    i, nump, reduced;
 
   pinfo->type = PIC8;
 
@@ -90,31 +154,19 @@ int LoadTIFF(char *fname, PICINFO *pinfo, int quick)
   }
 
   fseek(fp, 0L, 2);
-  filesize = ftell(fp);
+  td->filesize = ftell(fp);
   fclose(fp);
 
 
 
-  rmap = pinfo->r;  gmap = pinfo->g;  bmap = pinfo->b;
+  td->rmap = pinfo->r;  td->gmap = pinfo->g;  td->bmap = pinfo->b;
 
-  /* a kludge:  temporarily cd to the directory that the file is in (if
-     the file has a path), and cd back when done, as I can't make the
-     various TIFF error messages print the simple filename */
+  /* the TIFF error messages should print the simple filename.  (this used
+     to be done by cd'ing to the file's directory for the duration, but the
+     current directory belongs to the whole process) */
 
-  filename = fname;    /* use fullname unless it all works out */
-  oldpath[0] = '\0';
-  if (fname[0] == '/') {
-    xv_getwd(oldpath, sizeof(oldpath));
-    strcpy(tmppath, fname);
-    sp = (char *) BaseName(tmppath);  /* intentionally losing constness */
-    if (sp != tmppath) {
-      sp[-1] = '\0';     /* truncate before last '/' char */
-      if (chdir(tmppath)) {
-	oldpath[0] = '\0';
-      }
-      else filename = BaseName(fname);
-    }
-  }
+  td->filename = fname;
+  td->bname    = BaseName(fname);
 
 
   nump = 1;
@@ -123,9 +175,12 @@ int LoadTIFF(char *fname, PICINFO *pinfo, int quick)
     /* see if there's more than 1 image in tiff file, to determine if we
        should do multi-page thing... */
 
-    tif = TIFFOpen(filename, "r");
+    /* (reduced-resolution copies of an image aren't pages) */
+
+    tif = tiffOpen(td->filename, td->bname);
     if (!tif) return 0;
-    while (TIFFReadDirectory(tif)) ++nump;
+    while (TIFFReadDirectory(tif))
+      if (!isOverview(tif)) ++nump;
     TIFFClose(tif);
     if (DEBUG)
       fprintf(stderr,"LoadTIFF: %d page%s found\n", nump, nump==1 ? "" : "s");
@@ -136,6 +191,7 @@ int LoadTIFF(char *fname, PICINFO *pinfo, int quick)
 
     if (nump>1) {
       TIFF *in;
+      int   more;
 
       /* GRR 20050320:  converted this fake mktemp() to use mktemp()/mkstemp()
          internally (formerly it simply prepended tmpdir to the string and
@@ -151,7 +207,7 @@ int LoadTIFF(char *fname, PICINFO *pinfo, int quick)
       /* GRR 20070506:  could clean up unappended tmpname-file here (Linux
          bug?), but "cleaner" (more general) to do so in KillPageFiles() */
 
-      in = TIFFOpen(filename, "r");
+      in = tiffOpen(td->filename, td->bname);
       if (!in) return 0;
       for (i=1; i<=nump; i++) {
 	sprintf(tmp, "%s%d", tmpname, i);
@@ -160,7 +216,10 @@ int LoadTIFF(char *fname, PICINFO *pinfo, int quick)
 	  break;
 	}
 
-	if (!TIFFReadDirectory(in)) break;
+	do {
+	  more = TIFFReadDirectory(in);
+	} while (more && isOverview(in));
+	if (!more) break;
       }
       TIFFClose(in);
       if (DEBUG)
@@ -168,14 +227,36 @@ int LoadTIFF(char *fname, PICINFO *pinfo, int quick)
 		i-1, (i-1)==1 ? "" : "s");
 
       sprintf(tmp, "%s%d", tmpname, 1);           /* start with page #1 */
-      filename = tmp;
+      td->filename = tmp;
     }
   }  /* if (!quick) ... */
 
 
-  tif = TIFFOpen(filename, "r");
+  tif = tiffOpen(td->filename, td->bname);
   if (!tif) return 0;
 
+  /* try to get comments, if any.  (do it now, as overviews rarely have
+     their own) */
+  pinfo->comment = (char *) NULL;
+
+  desc = (char *) NULL;
+
+  TIFFGetField(tif, TIFFTAG_IMAGEDESCRIPTION, &desc);
+  if (desc && strlen(desc) > (size_t) 0) {
+    /* kludge:  tiff library seems to return bizarre comments */
+    if (strlen(desc)==4 && strcmp(desc, "\367\377\353\370")==0) {}
+    else {
+      pinfo->comment = (char *) malloc(strlen(desc) + 1);
+      if (pinfo->comment) strcpy(pinfo->comment, desc);
+    }
+  }
+
+  /* if the file has reduced-resolution copies of the image, and one of
+     them is big enough, load that instead */
+  TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &fullw);
+  TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &fullh);
+  reduced = pickOverview(tif, fullw, fullh, quick);
+
   /* flip orientation so that image comes in X order */
   TIFFGetFieldDefaulted(tif, TIFFTAG_ORIENTATION, &orient);
   switch (orient) {
@@ -204,33 +285,19 @@ int LoadTIFF(char *fname, PICINFO *pinfo, int quick)
   }
 
   if (spp == 1) {
-      pic8 = loadPalette(tif, w, h, photo, bps, pinfo);
+      pic8 = loadPalette(td, tif, w, h, photo, bps, pinfo);
   } else {
-      pic8 = loadColor(tif, w, h, photo, bps, pinfo);
+      pic8 = loadColor(td, tif, w, h, photo, bps, pinfo);
   }
 
-  /* try to get comments, if any */
-  pinfo->comment = (char *) NULL;
-
-  desc = (char *) NULL;
-
-  TIFFGetField(tif, TIFFTAG_IMAGEDESCRIPTION, &desc);
-  if (desc && strlen(desc) > (size_t) 0) {
-    /* kludge:  tiff library seems to return bizarre comments */
-    if (strlen(desc)==4 && strcmp(desc, "\367\377\353\370")==0) {}
-    else {
-      pinfo->comment = (char *) malloc(strlen(desc) + 1);
-      if (pinfo->comment) strcpy(pinfo->comment, desc);
-    }
-  }
+  if (reduced)
+    sprintf(pinfo->shrtInfo, "%ux%u TIFF (overview of %ux%u).",
+	    (u_int) w, (u_int) h, (u_int) fullw, (u_int) fullh);
 
   TIFFClose(tif);
 
-  /* un-kludge */
-  if (oldpath[0] != '\0') chdir(oldpath);
 
-
-  if (error_occurred) {
+  if (td->error_occurred) {
     if (pic8) free(pic8);
     if (pinfo->comment) free(pinfo->comment);
     pinfo->comment = (char *) NULL;
@@ -242,7 +309,7 @@ int LoadTIFF(char *fname, PICINFO *pinfo, int quick)
 
   pinfo->pic = pic8;
   pinfo->w = w;  pinfo->h = h;
-  pinfo->normw = pinfo->w;   pinfo->normh = pinfo->h;
+  pinfo->normw = fullw;   pinfo->normh = fullh;
   pinfo->frmType = F_TIFF;
 
   if (nump>1) strcpy(pinfo->pagebname, tmpname);
@@ -264,6 +331,27 @@ int LoadTIFF(char *fname, PICINFO *pinfo, int quick)
 
 
 
+/*******************************************/
+static TIFF *tiffOpen(const char *fname, const char *name)
+{
+  /* opens 'fname' for reading, as TIFFOpen() does, but libtiff's messages
+     about it will call it 'name' */
+
+  TIFF *tif;
+  int   fd;
+
+  fd = open(fname, O_RDONLY);
+  if (fd < 0) {
+    TIFFError(name, "couldn't open file");
+    return (TIFF *) NULL;
+  }
+
+  tif = TIFFFdOpen(fd, name, "r");
+  if (!tif) close(fd);
+  return tif;
+}
+
+
 /*******************************************/
 
 #define CopyField(tag, v) \
@@ -277,10 +365,40 @@ int LoadTIFF(char *fname, PICINFO *pinfo, int quick)
 /*******************************************/
 static int copyTiff(TIFF *in, char *fname)
 {
-  /* copies tiff (sub)image to given filename.  (Used only for multipage
-     images.)  Returns 0 on error */
+  /* copies tiff (sub)image to given filename, along with the overviews
+     that follow it in the file, so that a page loads as quickly as a
+     single-page file would.  (Used only for multipage images.)  Leaves
+     'in' on the last directory copied.  Returns 0 on error */
+
+  TIFF     *out;
+  tdir_t    last;
+  int       rv;
+
+  out = TIFFOpen(fname, "w");
+  if (!out) return 0;
+
+  rv   = cpDir(in, out);
+  last = TIFFCurrentDirectory(in);
+
+  /* overviews kept in SubIFDs, rather than in the main chain, aren't
+     copied:  the page file just won't have any */
+  while (rv && TIFFReadDirectory(in) && isOverview(in)) {
+    rv   = cpDir(in, out);
+    last = TIFFCurrentDirectory(in);
+  }
+  TIFFSetDirectory(in, last);
+
+  TIFFClose(out);
+  return rv;
+}
+
+
+/*******************************************/
+static int cpDir(TIFF *in, TIFF *out)
+{
+  /* copies the current directory of 'in', tags and (raw) image data, to a
+     new directory in 'out'.  Returns 0 on error */
 
-  TIFF   *out;
   short   bitspersample, samplesperpixel, shortv, *shortav;
   uint32_t  w, l;
   float   floatv, *floatav;
@@ -289,9 +407,6 @@ static int copyTiff(TIFF *in, char *fname)
   uint16_t *red, *green, *blue, shortv2;
   int     rv;
 
-  out = TIFFOpen(fname, "w");
-  if (!out) return 0;
-
   if (TIFFGetField(in, TIFFTAG_COMPRESSION, &shortv)){
     /* Currently, the TIFF Library cannot correctly copy TIFF version 6.0 (or
      * earlier) files that use "old" JPEG compression, so don't even try. */
@@ -344,7 +459,7 @@ static int copyTiff(TIFF *in, char *fname)
   if (TIFFIsTiled(in)) rv = cpTiles (in, out);
                   else rv = cpStrips(in, out);
 
-  TIFFClose(out);
+  if (rv && !TIFFWriteDirectory(out)) rv = 0;
   return rv;
 }
 
@@ -416,7 +531,80 @@ static int cpTiles(TIFF *in, TIFF *out)
 
 
 /*******************************************/
-static byte *loadPalette(TIFF *tif, uint32_t w, uint32_t h, int photo, int bps, PICINFO *pinfo)
+static int isOverview(TIFF *tif)
+{
+  /* true if the current directory is a reduced-resolution copy of some
+     other image in the file, rather than an image in its own right */
+
+  uint32_t subfiletype;
+
+  return (TIFFGetField(tif, TIFFTAG_SUBFILETYPE, &subfiletype) &&
+	  (subfiletype & FILETYPE_REDUCEDIMAGE));
+}
+
+
+/*******************************************/
+static int pickOverview(TIFF *tif, uint32_t w, uint32_t h, int quick)
+{
+  /* looks through the reduced-resolution copies of the current image (held
+     either in SubIFDs, or in 'reduced image' directories that follow it)
+     for the smallest one that's still big enough to show.  Leaves 'tif' on
+     that directory, and returns '1', or leaves it where it was and returns
+     '0' if the full-size image will have to do */
+
+  toff_t   base, best, *subifds, offs[64];
+  uint16_t nsub;
+  uint32_t bw, bh, ow, oh;
+  int      i, n, wantw, wanth;
+
+  if (!OverviewSize((int) w, (int) h, quick, &wantw, &wanth)) return 0;
+
+  base = best = TIFFCurrentDirOffset(tif);
+  bw = w;  bh = h;
+
+  /* the SubIFD list belongs to the current directory, so copy it out
+     before wandering off */
+  n = 0;
+  if (TIFFGetField(tif, TIFFTAG_SUBIFD, &nsub, &subifds)) {
+    for (i=0; i<nsub && n<64; i++) offs[n++] = subifds[i];
+  }
+
+  for (i=0; i<n; i++) {
+    if (!TIFFSetSubDirectory(tif, offs[i])) continue;
+    TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &ow);
+    TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &oh);
+    if (ow >= (uint32_t) wantw && oh >= (uint32_t) wanth &&
+	ow <= w && oh <= h && (double) ow * oh < (double) bw * bh) {
+      best = offs[i];  bw = ow;  bh = oh;
+    }
+  }
+
+  if (TIFFSetSubDirectory(tif, base)) {
+    while (TIFFReadDirectory(tif) && isOverview(tif)) {
+      TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &ow);
+      TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &oh);
+      if (ow >= (uint32_t) wantw && oh >= (uint32_t) wanth &&
+	  ow <= w && oh <= h && (double) ow * oh < (double) bw * bh) {
+	best = TIFFCurrentDirOffset(tif);  bw = ow;  bh = oh;
+      }
+    }
+  }
+
+  if (!TIFFSetSubDirectory(tif, best)) {
+    TIFFSetSubDirectory(tif, base);
+    return 0;
+  }
+
+  if (DEBUG && best != base)
+    fprintf(stderr,"LoadTIFF: using %ux%u overview of %ux%u image\n",
+	    (u_int) bw, (u_int) bh, (u_int) w, (u_int) h);
+
+  return (best != base);
+}
+
+
+/*******************************************/
+static byte *loadPalette(TIFFDEC *td, TIFF *tif, uint32_t w, uint32_t h, int photo, int bps, PICINFO *pinfo)
 {
   byte *pic8;
   uint32_t npixels;
@@ -425,7 +613,7 @@ static byte *loadPalette(TIFF *tif, uint32_t w, uint32_t h, int photo, int bps,
   case PHOTOMETRIC_PALETTE:
     pinfo->colType = F_FULLCOLOR;
     sprintf(pinfo->fullInfo, "TIFF, %u-bit, palette format.  (%ld bytes)",
-	    bps, filesize);
+	    bps, td->filesize);
     break;
 
   case PHOTOMETRIC_MINISWHITE:
@@ -435,7 +623,7 @@ static byte *loadPalette(TIFF *tif, uint32_t w, uint32_t h, int photo, int bps,
 	    bps,
 	    photo == PHOTOMETRIC_MINISWHITE ? "min-is-white" :
 	    "min-is-black",
-	    filesize);
+	    td->filesize);
     break;
   }
 
@@ -444,21 +632,21 @@ static byte *loadPalette(TIFF *tif, uint32_t w, uint32_t h, int photo, int bps,
   npixels = w*h;
   if (npixels/w != h) {
     /* SetISTR(ISTR_WARNING, "loadPalette() - image dimensions too large"); */
-    TIFFError(filename, "Image dimensions too large");
+    TIFFError(td->bname, "Image dimensions too large");
     return (byte *) NULL;
   }
 
   pic8 = (byte *) malloc((size_t) npixels);
   if (!pic8) FatalError("loadPalette() - couldn't malloc 'pic8'");
 
-  if (loadImage(tif, w, h, pic8, 0)) return pic8;
+  if (loadImage(td, tif, w, h, pic8, 0)) return pic8;
 
   return (byte *) NULL;
 }
 
 
 /*******************************************/
-static byte *loadColor(TIFF *tif, uint32_t w, uint32_t h, int photo, int bps, PICINFO *pinfo)
+static byte *loadColor(TIFFDEC *td, TIFF *tif, uint32_t w, uint32_t h, int photo, int bps, PICINFO *pinfo)
 {
   byte *pic24, *pic8;
   uint32_t npixels, count;
@@ -469,7 +657,7 @@ static byte *loadColor(TIFF *tif, uint32_t w, uint32_t h, int photo, int bps, PI
 	  (photo == PHOTOMETRIC_RGB ?	"RGB" :
 	   photo == PHOTOMETRIC_YCBCR ?	"YCbCr" :
 	   "???"),
-	  filesize);
+	  td->filesize);
 
   sprintf(pinfo->shrtInfo, "%ux%u TIFF.",(u_int) w, (u_int) h);
 
@@ -477,7 +665,7 @@ static byte *loadColor(TIFF *tif, uint32_t w, uint32_t h, int photo, int bps, PI
   count = 3*npixels;
   if (npixels/w != h || count/3 != npixels) {
     /* SetISTR(ISTR_WARNING, "loadPalette() - image dimensions too large"); */
-    TIFFError(filename, "Image dimensions too large");
+    TIFFError(td->bname, "Image dimensions too large");
     return (byte *) NULL;
   }
 
@@ -487,7 +675,7 @@ static byte *loadColor(TIFF *tif, uint32_t w, uint32_t h, int photo, int bps, PI
 
   pic8 = (byte *) NULL;
 
-  if (loadImage(tif, w, h, pic24, 0)) {
+  if (loadImage(td, tif, w, h, pic24, 0)) {
     pinfo->type = PIC24;
     pic8 = pic24;
   }
@@ -497,9 +685,43 @@ static byte *loadColor(TIFF *tif, uint32_t w, uint32_t h, int photo, int bps, PI
 }
 
 
+#ifdef HAVE_PTHREADS
+/*******************************************/
+static void makeDecKey(void)
+{
+  pthread_key_create(&deckey, NULL);
+}
+#endif
+
+
+/*******************************************/
+static void setDec(TIFFDEC *td)
+{
+#ifdef HAVE_PTHREADS
+  pthread_once(&deconce, makeDecKey);
+  pthread_setspecific(deckey, (void *) td);
+#else
+  curdec = td;
+#endif
+}
+
+
+/*******************************************/
+static TIFFDEC *curDec(void)
+{
+#ifdef HAVE_PTHREADS
+  pthread_once(&deconce, makeDecKey);
+  return (TIFFDEC *) pthread_getspecific(deckey);
+#else
+  return curdec;
+#endif
+}
+
+
 /*******************************************/
 static void _TIFFerr(const char *module, const char *fmt, va_list ap)
 {
+  TIFFDEC *td = curDec();
   char buf[2048];
   char *cp = buf;
 
@@ -511,15 +733,24 @@ static void _TIFFerr(const char *module, const char *fmt, va_list ap)
   vsprintf(cp, fmt, ap);
   strcat(cp, ".");
 
+  if (td && td->defermsgs) {     /* called from a decoding worker */
+    ParallelLock();
+    strcpy(td->deferredmsg, buf);
+    td->error_occurred = 1;
+    ParallelUnlock();
+    return;
+  }
+
   SetISTR(ISTR_WARNING, "%s", buf);
 
-  error_occurred = 1;
+  if (td) td->error_occurred = 1;
 }
 
 
 /*******************************************/
 static void _TIFFwarn(const char *module, const char *fmt, va_list ap)
 {
+  TIFFDEC *td = curDec();
   char buf[2048];
   char *cp = buf;
 
@@ -532,6 +763,13 @@ static void _TIFFwarn(const char *module, const char *fmt, va_list ap)
   vsprintf(cp, fmt, ap);
   strcat(cp, ".");
 
+  if (td && td->defermsgs) {     /* called from a decoding worker */
+    ParallelLock();
+    if (!td->error_occurred) strcpy(td->deferredmsg, buf);
+    ParallelUnlock();
+    return;
+  }
+
   SetISTR(ISTR_WARNING, "%s", buf);
 }
 
@@ -542,121 +780,105 @@ static void _TIFFwarn(const char *module, const char *fmt, va_list ap)
 
 typedef	byte RGBvalue;
 
-static	u_short bitspersample;
-static	u_short samplesperpixel;
-static	u_short photometric;
-static	u_short orientation;
-
-/* colormap for pallete images */
-static	u_short *redcmap, *greencmap, *bluecmap;
-static	int      stoponerr;			/* stop on read error */
-
-/* YCbCr support */
-static	u_short YCbCrHorizSampling;
-static	u_short YCbCrVertSampling;
-static	float   *YCbCrCoeffs;
-static	float   *refBlackWhite;
-
-static	byte **BWmap;
-static	byte **PALmap;
-
 /* XXX Work around some collisions with the new library. */
 #define tileContigRoutine _tileContigRoutine
 #define tileSeparateRoutine _tileSeparateRoutine
 
-typedef void (*tileContigRoutine)   PARM((byte*, u_char*, RGBvalue*,
+typedef void (*tileContigRoutine)   PARM((TIFFDEC*, byte*, u_char*, RGBvalue*,
 					  uint32_t, uint32_t, int, int));
 
-typedef void (*tileSeparateRoutine) PARM((byte*, u_char*, u_char*, u_char*,
-                                         RGBvalue*, uint32_t, uint32_t, int, int));
+typedef void (*tileSeparateRoutine) PARM((TIFFDEC*, byte*, u_char*, u_char*,
+                                         u_char*, RGBvalue*, uint32_t, uint32_t,
+                                         int, int));
 
 
-static int    checkcmap             PARM((int, u_short*, u_short*, u_short*));
+static int    checkcmap             PARM((TIFFDEC *, int, u_short*, u_short*, u_short*));
 
-static int    gt                       PARM((TIFF *, uint32_t, uint32_t, byte *));
-static uint32_t setorientation           PARM((TIFF *, uint32_t));
-static int    gtTileContig             PARM((TIFF *, byte *, RGBvalue *,
+static int    gt                       PARM((TIFFDEC *, TIFF *, uint32_t, uint32_t, byte *));
+static uint32_t setorientation           PARM((TIFFDEC *, TIFF *, uint32_t));
+static int    gtTileContig             PARM((TIFFDEC *, TIFF *, byte *, RGBvalue *,
 					     uint32_t, uint32_t, int));
-static int    gtTileSeparate           PARM((TIFF *, byte *, RGBvalue *,
+static int    gtTileSeparate           PARM((TIFFDEC *, TIFF *, byte *, RGBvalue *,
 					     uint32_t, uint32_t, int));
-static int    gtStripContig            PARM((TIFF *, byte *, RGBvalue *,
+static int    gtStripContig            PARM((TIFFDEC *, TIFF *, byte *, RGBvalue *,
 					     uint32_t, uint32_t, int));
-static int    gtStripSeparate          PARM((TIFF *, byte *, RGBvalue *,
+static int    gtStripSeparate          PARM((TIFFDEC *, TIFF *, byte *, RGBvalue *,
 					     uint32_t, uint32_t, int));
+static void   gtWorker                 PARM((void *, int));
 
-static int    makebwmap                PARM((void));
-static int    makecmap                 PARM((void));
+static int    makebwmap                PARM((TIFFDEC *));
+static int    makecmap                 PARM((TIFFDEC *));
 
-static void   put8bitcmaptile          PARM((byte *, u_char *, RGBvalue *,
+static void   put8bitcmaptile          PARM((TIFFDEC *, byte *, u_char *, RGBvalue *,
 					     uint32_t, uint32_t, int, int));
-static void   put4bitcmaptile          PARM((byte *, u_char *, RGBvalue *,
+static void   put4bitcmaptile          PARM((TIFFDEC *, byte *, u_char *, RGBvalue *,
 					     uint32_t, uint32_t, int, int));
-static void   put2bitcmaptile          PARM((byte *, u_char *, RGBvalue *,
+static void   put2bitcmaptile          PARM((TIFFDEC *, byte *, u_char *, RGBvalue *,
 					     uint32_t, uint32_t, int, int));
-static void   put1bitcmaptile          PARM((byte *, u_char *, RGBvalue *,
+static void   put1bitcmaptile          PARM((TIFFDEC *, byte *, u_char *, RGBvalue *,
 					     uint32_t, uint32_t, int, int));
-static void   putgreytile              PARM((byte *, u_char *, RGBvalue *,
+static void   putgreytile              PARM((TIFFDEC *, byte *, u_char *, RGBvalue *,
 					     uint32_t, uint32_t, int, int));
-static void   put1bitbwtile            PARM((byte *, u_char *, RGBvalue *,
+static void   put1bitbwtile            PARM((TIFFDEC *, byte *, u_char *, RGBvalue *,
 					     uint32_t, uint32_t, int, int));
-static void   put2bitbwtile            PARM((byte *, u_char *, RGBvalue *,
+static void   put2bitbwtile            PARM((TIFFDEC *, byte *, u_char *, RGBvalue *,
 					     uint32_t, uint32_t, int, int));
-static void   put4bitbwtile            PARM((byte *, u_char *, RGBvalue *,
+static void   put4bitbwtile            PARM((TIFFDEC *, byte *, u_char *, RGBvalue *,
 					     uint32_t, uint32_t, int, int));
-static void   put16bitbwtile           PARM((byte *, u_short *, RGBvalue *,
+static void   put16bitbwtile           PARM((TIFFDEC *, byte *, u_short *, RGBvalue *,
 					     uint32_t, uint32_t, int, int));
 
-static void   putRGBcontig8bittile     PARM((byte *, u_char *, RGBvalue *,
+static void   putRGBcontig8bittile     PARM((TIFFDEC *, byte *, u_char *, RGBvalue *,
 					     uint32_t, uint32_t, int, int));
 
-static void   putRGBcontig16bittile    PARM((byte *, u_short *, RGBvalue *,
+static void   putRGBcontig16bittile    PARM((TIFFDEC *, byte *, u_short *, RGBvalue *,
 					     uint32_t, uint32_t, int, int));
 
-static void   putRGBseparate8bittile   PARM((byte *, u_char *, u_char *,
+static void   putRGBseparate8bittile   PARM((TIFFDEC *, byte *, u_char *, u_char *,
 					     u_char *, RGBvalue *,
 					     uint32_t, uint32_t, int, int));
 
-static void   putRGBseparate16bittile  PARM((byte *, u_short *, u_short *,
+static void   putRGBseparate16bittile  PARM((TIFFDEC *, byte *, u_short *, u_short *,
 					    u_short *, RGBvalue *,
 					    uint32_t, uint32_t, int, int));
 
 
-static void   initYCbCrConversion      PARM((void));
+static void   initYCbCrConversion      PARM((TIFFDEC *));
 
-static void   putRGBContigYCbCrClump   PARM((byte *, u_char *, int, int,
+static void   putRGBContigYCbCrClump   PARM((TIFFDEC *, byte *, u_char *, int, int,
 					     uint32_t, int, int, int));
 
-static void   putRGBSeparateYCbCrClump PARM((byte *, u_char *, u_char *,
+static void   putRGBSeparateYCbCrClump PARM((TIFFDEC *, byte *, u_char *, u_char *,
 					     u_char *, int, int, uint32_t, int,
 					     int, int));
 
-static void   putRGBSeparate16bitYCbCrClump PARM((byte *, u_short *, u_short *,
+static void   putRGBSeparate16bitYCbCrClump PARM((TIFFDEC *, byte *, u_short *, u_short *,
 						  u_short *, int, int, uint32_t,
 						  int, int, int));
 
-static void   putcontig8bitYCbCrtile   PARM((byte *, u_char *, RGBvalue *,
+static void   putcontig8bitYCbCrtile   PARM((TIFFDEC *, byte *, u_char *, RGBvalue *,
 					     uint32_t, uint32_t, int, int));
 
-static void   putYCbCrseparate8bittile PARM((byte *, u_char *, u_char *, 
+static void   putYCbCrseparate8bittile PARM((TIFFDEC *, byte *, u_char *, u_char *, 
 					     u_char *, RGBvalue *, 
 					     uint32_t, uint32_t, int, int));
 
-static void   putYCbCrseparate16bittile PARM((byte *, u_short *, u_short *, 
+static void   putYCbCrseparate16bittile PARM((TIFFDEC *, byte *, u_short *, u_short *, 
 					      u_short *, RGBvalue *, 
 					      uint32_t, uint32_t, int, int));
 
-static tileContigRoutine   pickTileContigCase   PARM((RGBvalue *));
-static tileSeparateRoutine pickTileSeparateCase PARM((RGBvalue *));
+static tileContigRoutine   pickTileContigCase   PARM((TIFFDEC *, RGBvalue *));
+static tileSeparateRoutine pickTileSeparateCase PARM((TIFFDEC *, RGBvalue *));
 
 
 /*******************************************/
-static int loadImage(TIFF *tif, uint32_t rwidth, uint32_t rheight, byte *raster, int stop)
+static int loadImage(TIFFDEC *td, TIFF *tif, uint32_t rwidth, uint32_t rheight, byte *raster, int stop)
 {
   int ok;
   uint32_t width, height;
 
-  TIFFGetFieldDefaulted(tif, TIFFTAG_BITSPERSAMPLE, &bitspersample);
-  switch (bitspersample) {
+  TIFFGetFieldDefaulted(tif, TIFFTAG_BITSPERSAMPLE, &td->bitspersample);
+  switch (td->bitspersample) {
   case 1:
   case 2:
   case 4:
@@ -665,30 +887,30 @@ static int loadImage(TIFF *tif, uint32_t rwidth, uint32_t rheight, byte *raster,
 
   default:
     TIFFError(TIFFFileName(tif),
-	      "Sorry, cannot handle %d-bit pictures", bitspersample);
+	      "Sorry, cannot handle %d-bit pictures", td->bitspersample);
     return (0);
   }
 
 
-  TIFFGetFieldDefaulted(tif, TIFFTAG_SAMPLESPERPIXEL, &samplesperpixel);
-  switch (samplesperpixel) {
+  TIFFGetFieldDefaulted(tif, TIFFTAG_SAMPLESPERPIXEL, &td->samplesperpixel);
+  switch (td->samplesperpixel) {
   case 1:
   case 3:
   case 4:  break;
 
   default:
     TIFFError(TIFFFileName(tif),
-	      "Sorry, cannot handle %d-channel images", samplesperpixel);
+	      "Sorry, cannot handle %d-channel images", td->samplesperpixel);
     return (0);
   }
 
 
-  if (!TIFFGetField(tif, TIFFTAG_PHOTOMETRIC, &photometric)) {
-    switch (samplesperpixel) {
-    case 1:  photometric = PHOTOMETRIC_MINISBLACK;   break;
+  if (!TIFFGetField(tif, TIFFTAG_PHOTOMETRIC, &td->photometric)) {
+    switch (td->samplesperpixel) {
+    case 1:  td->photometric = PHOTOMETRIC_MINISBLACK;   break;
 
     case 3:
-    case 4:  photometric = PHOTOMETRIC_RGB;          break;
+    case 4:  td->photometric = PHOTOMETRIC_RGB;          break;
 
     default:
       TIFFError(TIFFFileName(tif),
@@ -698,7 +920,7 @@ static int loadImage(TIFF *tif, uint32_t rwidth, uint32_t rheight, byte *raster,
 
     TIFFWarning(TIFFFileName(tif),
 	      "No \"PhotometricInterpretation\" tag, assuming %s\n",
-	      photometric == PHOTOMETRIC_RGB ? "RGB" : "min-is-black");
+	      td->photometric == PHOTOMETRIC_RGB ? "RGB" : "min-is-black");
   }
 
   /* XXX maybe should check photometric? */
@@ -706,31 +928,31 @@ static int loadImage(TIFF *tif, uint32_t rwidth, uint32_t rheight, byte *raster,
   TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &height);
 
   /* XXX verify rwidth and rheight against width and height */
-  stoponerr = stop;
-  BWmap = NULL;
-  PALmap = NULL;
-  ok = gt(tif, rwidth, height, raster + (rheight-height)*rwidth);
-  if (BWmap)
-    free((char *)BWmap);
-  if (PALmap)
-    free((char *)PALmap);
+  td->stoponerr = stop;
+  td->BWmap = NULL;
+  td->PALmap = NULL;
+  ok = gt(td, tif, rwidth, height, raster + (rheight-height)*rwidth);
+  if (td->BWmap)
+    free((char *)td->BWmap);
+  if (td->PALmap)
+    free((char *)td->PALmap);
   return (ok);
 }
 
 
 /*******************************************/
-static int checkcmap(int n, u_short *r, u_short *g, u_short *b)
+static int checkcmap(TIFFDEC *td, int n, u_short *r, u_short *g, u_short *b)
 {
   while (n-- >= 0)
     if (*r++ >= 256 || *g++ >= 256 || *b++ >= 256) return (16);
 
-  TIFFWarning(filename, "Assuming 8-bit colormap");
+  TIFFWarning(td->bname, "Assuming 8-bit colormap");
   return (8);
 }
 
 
 /*******************************************/
-static int gt(TIFF *tif, uint32_t w, uint32_t h, byte *raster)
+static int gt(TIFFDEC *td, TIFF *tif, uint32_t w, uint32_t h, byte *raster)
 {
 #ifdef USE_LIBJPEG_FOR_TIFF_YCbCr_RGB_CONVERSION
   u_short compression;
@@ -747,8 +969,9 @@ static int gt(TIFF *tif, uint32_t w, uint32_t h, byte *raster)
   TIFFGetFieldDefaulted(tif, TIFFTAG_MINSAMPLEVALUE, &minsamplevalue);
   TIFFGetFieldDefaulted(tif, TIFFTAG_MAXSAMPLEVALUE, &maxsamplevalue);
   Map = NULL;
+  td->jpegcolormode = 0;
 
-  switch (photometric) {
+  switch (td->photometric) {
   case PHOTOMETRIC_YCBCR:
 #ifdef USE_LIBJPEG_FOR_TIFF_YCbCr_RGB_CONVERSION
     if (compression == COMPRESSION_JPEG
@@ -764,17 +987,18 @@ static int gt(TIFF *tif, uint32_t w, uint32_t h, byte *raster)
         /* can rely on libjpeg to convert to RGB (assuming newer libtiff,
          * compiled with appropriate forms of JPEG support) */
         TIFFSetField(tif, TIFFTAG_JPEGCOLORMODE, JPEGCOLORMODE_RGB);
-        photometric = PHOTOMETRIC_RGB;
+        td->jpegcolormode = 1;
+        td->photometric = PHOTOMETRIC_RGB;
       } else {
-        TIFFError(filename, "Cannot handle format");
+        TIFFError(td->bname, "Cannot handle format");
         return (0);
       }
     } else
 #endif /* USE_LIBJPEG_FOR_TIFF_YCbCr_RGB_CONVERSION */
     {
-      TIFFGetFieldDefaulted(tif, TIFFTAG_YCBCRCOEFFICIENTS, &YCbCrCoeffs);
+      TIFFGetFieldDefaulted(tif, TIFFTAG_YCBCRCOEFFICIENTS, &td->YCbCrCoeffs);
       TIFFGetFieldDefaulted(tif, TIFFTAG_YCBCRSUBSAMPLING,
-			    &YCbCrHorizSampling, &YCbCrVertSampling);
+			    &td->YCbCrHorizSampling, &td->YCbCrVertSampling);
 
       /* According to the TIFF specification, if no "ReferenceBlackWhite"
        * tag is present in the input file, "TIFFGetFieldDefaulted()" returns
@@ -786,12 +1010,12 @@ static int gt(TIFF *tif, uint32_t w, uint32_t h, byte *raster)
        * slightly dirty code installs the default.  --Scott Marovich,
        * Hewlett-Packard Labs, 9/2001.
        */
-      if (!TIFFGetField(tif, TIFFTAG_REFERENCEBLACKWHITE, &refBlackWhite)) {
-        TIFFGetFieldDefaulted(tif, TIFFTAG_REFERENCEBLACKWHITE, &refBlackWhite);
-        refBlackWhite[4] = refBlackWhite[2] = 1 << (bitspersample - 1);
+      if (!TIFFGetField(tif, TIFFTAG_REFERENCEBLACKWHITE, &td->refBlackWhite)) {
+        TIFFGetFieldDefaulted(tif, TIFFTAG_REFERENCEBLACKWHITE, &td->refBlackWhite);
+        td->refBlackWhite[4] = td->refBlackWhite[2] = 1 << (td->bitspersample - 1);
       }
-      TIFFGetFieldDefaulted(tif, TIFFTAG_REFERENCEBLACKWHITE, &refBlackWhite);
-      initYCbCrConversion();
+      TIFFGetFieldDefaulted(tif, TIFFTAG_REFERENCEBLACKWHITE, &td->refBlackWhite);
+      initYCbCrConversion(td);
     }
     /* fall thru... */
 
@@ -806,11 +1030,11 @@ static int gt(TIFF *tif, uint32_t w, uint32_t h, byte *raster)
     range = maxsamplevalue - minsamplevalue;
     Map = (RGBvalue *)malloc((range + 1) * sizeof (RGBvalue));
     if (Map == NULL) {
-      TIFFError(filename, "No space for photometric conversion table");
+      TIFFError(td->bname, "No space for photometric conversion table");
       return (0);
     }
 
-    if (photometric == PHOTOMETRIC_MINISWHITE) {
+    if (td->photometric == PHOTOMETRIC_MINISWHITE) {
       for (x = 0; x <= range; x++)
 	Map[x] = (255*(range-x))/range;
     } else {
@@ -819,18 +1043,18 @@ static int gt(TIFF *tif, uint32_t w, uint32_t h, byte *raster)
     }
 
     if (range<256) {
-      for (x=0; x<=range; x++) rmap[x] = gmap[x] = bmap[x] = Map[x];
+      for (x=0; x<=range; x++) td->rmap[x] = td->gmap[x] = td->bmap[x] = Map[x];
     } else {
       for (x=0; x<256; x++)
-	rmap[x] = gmap[x] = bmap[x] = Map[(range*x)/255];
+	td->rmap[x] = td->gmap[x] = td->bmap[x] = Map[(range*x)/255];
     }
 
-    if (photometric != PHOTOMETRIC_RGB && bitspersample <= 8) {
+    if (td->photometric != PHOTOMETRIC_RGB && td->bitspersample <= 8) {
       /*
        * Use photometric mapping table to construct
        * unpacking tables for samples <= 8 bits.
        */
-      if (!makebwmap())
+      if (!makebwmap(td))
 	return (0);
       /* no longer need Map, free it */
       free((char *)Map);
@@ -840,8 +1064,8 @@ static int gt(TIFF *tif, uint32_t w, uint32_t h, byte *raster)
 
   case PHOTOMETRIC_PALETTE:
     if (!TIFFGetField(tif, TIFFTAG_COLORMAP,
-		      &redcmap, &greencmap, &bluecmap)) {
-      TIFFError(filename, "Missing required \"Colormap\" tag");
+		      &td->redcmap, &td->greencmap, &td->bluecmap)) {
+      TIFFError(td->bname, "Missing required \"Colormap\" tag");
       return (0);
     }
 
@@ -849,45 +1073,45 @@ static int gt(TIFF *tif, uint32_t w, uint32_t h, byte *raster)
      * Convert 16-bit colormap to 8-bit (unless it looks
      * like an old-style 8-bit colormap).
      */
-    range = (1<<bitspersample)-1;
-    if (checkcmap(range, redcmap, greencmap, bluecmap) == 16) {
+    range = (1<<td->bitspersample)-1;
+    if (checkcmap(td, range, td->redcmap, td->greencmap, td->bluecmap) == 16) {
 
 #define	CVT(x)		((((int) x) * 255) / ((1L<<16)-1))
 
       for (x = range; x >= 0; x--) {
-	rmap[x] = CVT(redcmap[x]);
-	gmap[x] = CVT(greencmap[x]);
-	bmap[x] = CVT(bluecmap[x]);
+	td->rmap[x] = CVT(td->redcmap[x]);
+	td->gmap[x] = CVT(td->greencmap[x]);
+	td->bmap[x] = CVT(td->bluecmap[x]);
       }
     } else {
       for (x = range; x >= 0; x--) {
-	rmap[x] = redcmap[x];
-	gmap[x] = greencmap[x];
-	bmap[x] = bluecmap[x];
+	td->rmap[x] = td->redcmap[x];
+	td->gmap[x] = td->greencmap[x];
+	td->bmap[x] = td->bluecmap[x];
       }
     }
 
-    if (bitspersample <= 8) {
+    if (td->bitspersample <= 8) {
       /*
        * Use mapping table to construct
        * unpacking tables for samples < 8 bits.
        */
-      if (!makecmap())
+      if (!makecmap(td))
 	return (0);
     }
     break;
 
   default:
-    TIFFError(filename, "Unknown photometric tag %u", photometric);
+    TIFFError(td->bname, "Unknown photometric tag %u", td->photometric);
     return (0);
   }
 
-  if (planarconfig == PLANARCONFIG_SEPARATE && samplesperpixel > 1) {
-    e = TIFFIsTiled(tif) ? gtTileSeparate (tif, raster, Map, h, w, bpp) :
-                           gtStripSeparate(tif, raster, Map, h, w, bpp);
+  if (planarconfig == PLANARCONFIG_SEPARATE && td->samplesperpixel > 1) {
+    e = TIFFIsTiled(tif) ? gtTileSeparate (td, tif, raster, Map, h, w, bpp) :
+                           gtStripSeparate(td, tif, raster, Map, h, w, bpp);
   } else {
-    e = TIFFIsTiled(tif) ? gtTileContig (tif, raster, Map, h, w, bpp) :
-                           gtStripContig(tif, raster, Map, h, w, bpp);
+    e = TIFFIsTiled(tif) ? gtTileContig (td, tif, raster, Map, h, w, bpp) :
+                           gtStripContig(td, tif, raster, Map, h, w, bpp);
   }
 
   if (Map) free((char *)Map);
@@ -896,19 +1120,19 @@ static int gt(TIFF *tif, uint32_t w, uint32_t h, byte *raster)
 
 
 /*******************************************/
-static uint32_t setorientation(TIFF *tif, uint32_t h)
+static uint32_t setorientation(TIFFDEC *td, TIFF *tif, uint32_t h)
 {
   /* note that orientation was flipped in LoadTIFF() (near line 175) */
 
   uint32_t y;
 
-  TIFFGetFieldDefaulted(tif, TIFFTAG_ORIENTATION, &orientation);
-  switch (orientation) {
+  TIFFGetFieldDefaulted(tif, TIFFTAG_ORIENTATION, &td->orientation);
+  switch (td->orientation) {
   case ORIENTATION_BOTRIGHT:
   case ORIENTATION_RIGHTBOT:	/* XXX */
   case ORIENTATION_LEFTBOT:	/* XXX */
-    TIFFWarning(filename, "using bottom-left orientation");
-    orientation = ORIENTATION_BOTLEFT;
+    TIFFWarning(td->bname, "using bottom-left orientation");
+    td->orientation = ORIENTATION_BOTLEFT;
 
     /* fall thru... */
   case ORIENTATION_BOTLEFT:
@@ -919,8 +1143,8 @@ static uint32_t setorientation(TIFF *tif, uint32_t h)
   case ORIENTATION_RIGHTTOP:	/* XXX */
   case ORIENTATION_LEFTTOP:	/* XXX */
   default:
-    TIFFWarning(filename, "using top-left orientation");
-    orientation = ORIENTATION_TOPLEFT;
+    TIFFWarning(td->bname, "using top-left orientation");
+    td->orientation = ORIENTATION_TOPLEFT;
     /* fall thru... */
   case ORIENTATION_TOPLEFT:
     /* GRR 20050319:  This may be wrong for tiled images (also stripped?);
@@ -937,6 +1161,207 @@ static uint32_t setorientation(TIFF *tif, uint32_t h)
 
 
 
+/*
+ * The strip/tile readers below only work out the geometry; the decoding
+ * itself is done by gtWorker(), one strip or one row of tiles ('unit') at a
+ * time.  When the image is big enough the units are shared out among
+ * several workers, each with its own TIFF handle (libtiff handles can't be
+ * shared between threads), and every unit is put straight into its final
+ * place in the raster.
+ */
+
+#define GT_PARALLEL_MIN  (512*512)   /* smaller images are done in-line */
+
+typedef struct {
+  TIFFDEC             *td;
+  TIFF                *tif;       /* caller's handle, used by worker 0 */
+  u_char              *buf;       /* worker 0's decode buffer */
+  tsize_t              bufsize;   /* size of one plane of a unit */
+  byte                *raster;
+  RGBvalue            *Map;
+  tileContigRoutine    cput;      /* one of these two is set */
+  tileSeparateRoutine  sput;
+  uint32_t             w, h;      /* size of the raster */
+  uint32_t             uw, uh;    /* size of a tile (uw==0 for strips) */
+  uint32_t             y0;        /* raster row of unit 0 */
+  int                  ydir;      /* +1/-1:  direction of later units */
+  int                  bpp, fromskew, toskew, scanline;
+  int                  nunits, next;
+} GTWORK;
+
+
+/*******************************************/
+static int gtUnit(GTWORK *gw, TIFF *tif, u_char *buf, int unit)
+{
+  /* decodes one strip (or row of tiles) and puts it into the raster.
+     returns '0' if a read error should stop the whole image */
+
+  TIFFDEC *td = gw->td;
+  uint32_t row, col, y, npix, w;
+  u_char  *r, *g, *b;
+  int      fromskew, bpp;
+  u_int    nrow;
+
+  w    = gw->w;
+  bpp  = gw->bpp;
+  row  = (uint32_t) unit * gw->uh;
+  nrow = (row + gw->uh > gw->h ? gw->h - row : gw->uh);
+  y    = gw->y0 + gw->ydir * (int) row;
+
+  r = buf;
+  g = r + gw->bufsize;
+  b = g + gw->bufsize;
+
+  if (gw->uw == 0) {    /* a strip */
+    tsize_t nbytes = (tsize_t) (nrow * gw->scanline);
+
+    if (gw->cput) {
+      if (TIFFReadEncodedStrip(tif, TIFFComputeStrip(tif, row, 0),
+			       (tdata_t) buf, nbytes) < 0 && td->stoponerr)
+	return 0;
+
+      (*gw->cput)(td, gw->raster + y*w*bpp, buf, gw->Map, w, nrow,
+		  gw->fromskew, gw->toskew*bpp);
+    }
+    else {
+      if ((TIFFReadEncodedStrip(tif, TIFFComputeStrip(tif, row, 0),
+				(tdata_t) r, nbytes) < 0 ||
+	   TIFFReadEncodedStrip(tif, TIFFComputeStrip(tif, row, 1),
+				(tdata_t) g, nbytes) < 0 ||
+	   TIFFReadEncodedStrip(tif, TIFFComputeStrip(tif, row, 2),
+				(tdata_t) b, nbytes) < 0) && td->stoponerr)
+	return 0;
+
+      (*gw->sput)(td, gw->raster + y*w*bpp, r, g, b, gw->Map, w, nrow,
+		  gw->fromskew, gw->toskew*bpp);
+    }
+    return 1;
+  }
+
+
+  for (col = 0; col < w; col += gw->uw) {
+    /*
+     * This reads the tile at (col,row) into buf.  "The data placed in buf
+     * are returned decompressed and, typically, in the native byte- and
+     * bit-ordering, but are otherwise packed."
+     */
+    if (gw->cput) {
+      if (TIFFReadTile(tif, buf, col, row, 0, 0) < 0 && td->stoponerr) return 0;
+    }
+    else {
+      if ((TIFFReadTile(tif, r, col, row, 0, 0) < 0 ||
+	   TIFFReadTile(tif, g, col, row, 0, 1) < 0 ||
+	   TIFFReadTile(tif, b, col, row, 0, 2) < 0) && td->stoponerr) return 0;
+    }
+
+    if (col + gw->uw > w) {
+      /*
+       * Tile is clipped horizontally.  Calculate
+       * visible portion and skewing factors.
+       */
+      npix = w - col;
+      fromskew = gw->uw - npix;
+    }
+    else {
+      npix = gw->uw;
+      fromskew = 0;
+    }
+
+    if (gw->cput)
+      (*gw->cput)(td, gw->raster + (y*w + col)*bpp, buf, gw->Map, npix,
+		  (uint32_t) nrow, fromskew, (gw->toskew + fromskew)*bpp);
+    else
+      (*gw->sput)(td, gw->raster + (y*w + col)*bpp, r, g, b, gw->Map, npix,
+		  (uint32_t) nrow, fromskew, (gw->toskew + fromskew)*bpp);
+  }
+  return 1;
+}
+
+
+/*******************************************/
+static void gtWorker(void *data, int worker)
+{
+  GTWORK  *gw = (GTWORK *) data;
+  TIFFDEC *td = gw->td;
+  TIFF    *tif;
+  u_char  *buf;
+  int      unit;
+
+  if (worker == 0) {
+    tif = gw->tif;
+    buf = gw->buf;
+  }
+  else {
+    /* a private handle on the same file and directory.  if anything goes
+       wrong here, just bow out:  the other workers pick up the slack */
+    setDec(td);
+    tif = tiffOpen(td->filename, td->bname);
+    if (!tif) return;
+
+    if (TIFFCurrentDirOffset(tif) != TIFFCurrentDirOffset(gw->tif) &&
+	!TIFFSetSubDirectory(tif, TIFFCurrentDirOffset(gw->tif))) {
+      TIFFClose(tif);
+      return;
+    }
+
+#ifdef USE_LIBJPEG_FOR_TIFF_YCbCr_RGB_CONVERSION
+    if (td->jpegcolormode)
+      TIFFSetField(tif, TIFFTAG_JPEGCOLORMODE, JPEGCOLORMODE_RGB);
+#endif
+
+    buf = (u_char *) malloc((size_t) gw->bufsize * (gw->sput ? 3 : 1));
+    if (!buf) {
+      TIFFClose(tif);
+      return;
+    }
+  }
+
+  while ((unit = ParallelNext(&gw->next, gw->nunits)) >= 0) {
+    if (!gtUnit(gw, tif, buf, unit)) {
+      ParallelLock();
+      gw->next = gw->nunits;    /* stoponerr:  nobody takes any more */
+      ParallelUnlock();
+    }
+  }
+
+  if (worker) {
+    free(buf);
+    TIFFClose(tif);
+  }
+}
+
+
+/*******************************************/
+static int gtRun(GTWORK *gw)
+{
+  TIFFDEC *td = gw->td;
+  int      nworkers;
+
+  gw->next   = 0;
+  gw->nunits = (gw->h + gw->uh - 1) / gw->uh;
+
+  nworkers = 1;
+  if ((double) gw->w * gw->h >= GT_PARALLEL_MIN)
+    nworkers = ParallelWorkers(gw->nunits);
+
+  /* the error handlers mustn't talk to X from a worker thread */
+  if (nworkers > 1) {
+    td->deferredmsg[0] = '\0';
+    td->defermsgs = 1;
+  }
+
+  ParallelRun(nworkers, gtWorker, (void *) gw);
+
+  if (nworkers > 1) {
+    td->defermsgs = 0;
+    if (td->deferredmsg[0]) SetISTR(ISTR_WARNING, "%s", td->deferredmsg);
+  }
+
+  free(gw->buf);
+  return (1);
+}
+
+
 /*
  * Get a tile-organized image that has
  *	PlanarConfiguration contiguous if SamplesPerPixel > 1
@@ -944,75 +1369,47 @@ static uint32_t setorientation(TIFF *tif, uint32_t h)
  *	SamplesPerPixel == 1
  */
 /*******************************************/
-static int gtTileContig(TIFF *tif, byte *raster, RGBvalue *Map, uint32_t h, uint32_t w, int bpp)
+static int gtTileContig(TIFFDEC *td, TIFF *tif, byte *raster, RGBvalue *Map, uint32_t h, uint32_t w, int bpp)
 {
-  uint32_t col, row, y;
-  uint32_t tw, th;
-  u_char *buf;
-  int fromskew, toskew;
-  u_int nrow;
-  tileContigRoutine put;
-  tsize_t bufsize;
+  GTWORK gw;
 
-  put = pickTileContigCase(Map);
-  if (put == 0) return (0);
+  bzero((char *) &gw, sizeof(gw));
+  gw.cput = pickTileContigCase(td, Map);
+  if (gw.cput == 0) return (0);
 
-  bufsize = TIFFTileSize(tif);
-  if (bufsize <= 0) return 0;  /* tsize_t is signed */
-  buf = (u_char *) malloc((size_t) bufsize);
-  if (buf == 0) {
-    TIFFError(filename, "No space for tile buffer");
+  gw.bufsize = TIFFTileSize(tif);
+  if (gw.bufsize <= 0) return 0;  /* tsize_t is signed */
+  gw.buf = (u_char *) malloc((size_t) gw.bufsize);
+  if (gw.buf == 0) {
+    TIFFError(td->bname, "No space for tile buffer");
     return (0);
   }
 
-  TIFFGetField(tif, TIFFTAG_TILEWIDTH, &tw);
-  TIFFGetField(tif, TIFFTAG_TILELENGTH, &th);
-  y = setorientation(tif, h);
+  gw.td = td;  gw.tif = tif;  gw.raster = raster;  gw.Map = Map;
+  gw.w = w;  gw.h = h;  gw.bpp = bpp;
+  TIFFGetField(tif, TIFFTAG_TILEWIDTH, &gw.uw);
+  TIFFGetField(tif, TIFFTAG_TILELENGTH, &gw.uh);
+  if (gw.uw == 0 || gw.uh == 0) {
+    TIFFError(td->bname, "Bad tile size");
+    free(gw.buf);
+    return (0);
+  }
+  gw.y0 = setorientation(td, tif, h);
+  gw.ydir = (td->orientation == ORIENTATION_TOPLEFT ? -1 : 1);
 #ifdef USE_TILED_TIFF_BOTLEFT_FIX  /* image _originally_ ORIENTATION_BOTLEFT */
   /* this fix causes tiles as a whole to be placed starting at the top,
    * regardless of orientation; the only difference is what happens within
    * a given tile (see toskew, below) */
   /* GRR FIXME:  apply globally in setorientation()? */
-  if (orientation == ORIENTATION_TOPLEFT)
-    y = th-1;
+  if (td->orientation == ORIENTATION_TOPLEFT)
+    gw.y0 = gw.uh-1;
+  gw.ydir = 1;
 #endif
   /* toskew causes individual tiles to copy from bottom to top for
    * ORIENTATION_TOPLEFT and from top to bottom otherwise */
-  toskew = (orientation == ORIENTATION_TOPLEFT ? -tw + -w : -tw + w);
+  gw.toskew = (td->orientation == ORIENTATION_TOPLEFT ? -gw.uw + -w : -gw.uw + w);
 
-  for (row = 0; row < h; row += th) {
-    nrow = (row + th > h ? h - row : th);
-    for (col = 0; col < w; col += tw) {
-      /*
-       * This reads the tile at (col,row) into buf.  "The data placed in buf
-       * are returned decompressed and, typically, in the native byte- and
-       * bit-ordering, but are otherwise packed."
-       */
-      if (TIFFReadTile(tif, buf, (uint32_t)col, (uint32_t)row, 0, 0) < 0
-	  && stoponerr) break;
-
-      if (col + tw > w) {
-	/*
-	 * Tile is clipped horizontally.  Calculate
-	 * visible portion and skewing factors.
-	 */
-	uint32_t npix = w - col;
-	fromskew = tw - npix;
-	(*put)(raster + (y*w + col)*bpp, buf, Map, npix, (uint32_t) nrow,
-	       fromskew, (int) ((toskew + fromskew)*bpp) );
-      } else
-	(*put)(raster + (y*w + col)*bpp, buf, Map, tw,   (uint32_t) nrow,
-	       0, (int) (toskew*bpp));
-    }
-
-#ifdef USE_TILED_TIFF_BOTLEFT_FIX  /* image _originally_ ORIENTATION_BOTLEFT */
-    y += nrow;
-#else
-    y += (orientation == ORIENTATION_TOPLEFT ? -nrow : nrow);
-#endif
-  }
-  free(buf);
-  return (1);
+  return gtRun(&gw);
 }
 
 
@@ -1026,74 +1423,41 @@ static int gtTileContig(TIFF *tif, byte *raster, RGBvalue *Map, uint32_t h, uint
  */
 
 /*******************************************/
-static int gtTileSeparate(TIFF *tif, byte *raster, RGBvalue *Map, uint32_t h, uint32_t w, int bpp)
+static int gtTileSeparate(TIFFDEC *td, TIFF *tif, byte *raster, RGBvalue *Map, uint32_t h, uint32_t w, int bpp)
 {
-  uint32_t tw, th;
-  uint32_t col, row, y;
-  u_char *buf;
-  u_char *r, *g, *b;
-  tsize_t tilesize;
+  GTWORK gw;
   uint32_t bufsize;
-  int fromskew, toskew;
-  u_int nrow;
-  tileSeparateRoutine put;
 
-  put = pickTileSeparateCase(Map);
-  if (put == 0) return (0);
+  bzero((char *) &gw, sizeof(gw));
+  gw.sput = pickTileSeparateCase(td, Map);
+  if (gw.sput == 0) return (0);
 
-  tilesize = TIFFTileSize(tif);
-  bufsize = 3*tilesize;
-  if (tilesize <= 0 || bufsize/3 != tilesize) {  /* tsize_t is signed */
-    TIFFError(filename, "Image dimensions too large");
+  gw.bufsize = TIFFTileSize(tif);
+  bufsize = 3*gw.bufsize;
+  if (gw.bufsize <= 0 || bufsize/3 != gw.bufsize) {  /* tsize_t is signed */
+    TIFFError(td->bname, "Image dimensions too large");
     return 0;
   }
-  buf = (u_char *) malloc((size_t) bufsize);
-  if (buf == 0) {
-    TIFFError(filename, "No space for tile buffer");
+  gw.buf = (u_char *) malloc((size_t) bufsize);
+  if (gw.buf == 0) {
+    TIFFError(td->bname, "No space for tile buffer");
     return (0);
   }
-  r = buf;
-  g = r + tilesize;
-  b = g + tilesize;
-  TIFFGetField(tif, TIFFTAG_TILEWIDTH, &tw);
-  TIFFGetField(tif, TIFFTAG_TILELENGTH, &th);
-  y = setorientation(tif, h);
-  toskew = (orientation == ORIENTATION_TOPLEFT ? -tw + -w : -tw + w);
-
-  for (row = 0; row < h; row += th) {
-    nrow = (row + th > h ? h - row : th);
-    for (col = 0; col < w; col += tw) {
-      tsample_t band;
-
-      band = 0;
-      if (TIFFReadTile(tif, r, (uint32_t) col, (uint32_t) row,0, band) < 0
-	  && stoponerr) break;
-
-      band = 1;
-      if (TIFFReadTile(tif, g, (uint32_t) col, (uint32_t) row,0, band) < 0
-	  && stoponerr) break;
-
-      band = 2;
-      if (TIFFReadTile(tif, b, (uint32_t) col, (uint32_t) row,0, band) < 0
-	  && stoponerr) break;
-
-      if (col + tw > w) {
-	/*
-	 * Tile is clipped horizontally.  Calculate
-	 * visible portion and skewing factors.
-	 */
-	uint32_t npix = w - col;
-	fromskew = tw - npix;
-	(*put)(raster + (y*w + col)*bpp, r, g, b, Map, npix, (uint32_t) nrow,
-	       fromskew, (int) ((toskew + fromskew)*bpp));
-      } else
-	(*put)(raster + (y*w + col)*bpp, r, g, b, Map, tw, (uint32_t) nrow,
-	       0, (int) (toskew*bpp));
-    }
-    y += (orientation == ORIENTATION_TOPLEFT ? -nrow : nrow);
+
+  gw.td = td;  gw.tif = tif;  gw.raster = raster;  gw.Map = Map;
+  gw.w = w;  gw.h = h;  gw.bpp = bpp;
+  TIFFGetField(tif, TIFFTAG_TILEWIDTH, &gw.uw);
+  TIFFGetField(tif, TIFFTAG_TILELENGTH, &gw.uh);
+  if (gw.uw == 0 || gw.uh == 0) {
+    TIFFError(td->bname, "Bad tile size");
+    free(gw.buf);
+    return (0);
   }
-  free(buf);
-  return (1);
+  gw.y0 = setorientation(td, tif, h);
+  gw.ydir = (td->orientation == ORIENTATION_TOPLEFT ? -1 : 1);
+  gw.toskew = (td->orientation == ORIENTATION_TOPLEFT ? -gw.uw + -w : -gw.uw + w);
+
+  return gtRun(&gw);
 }
 
 /*
@@ -1103,47 +1467,37 @@ static int gtTileSeparate(TIFF *tif, byte *raster, RGBvalue *Map, uint32_t h, ui
  *	SamplesPerPixel == 1
  */
 /*******************************************/
-static int gtStripContig(TIFF *tif, byte *raster, RGBvalue *Map, uint32_t h, uint32_t w, int bpp)
+static int gtStripContig(TIFFDEC *td, TIFF *tif, byte *raster, RGBvalue *Map, uint32_t h, uint32_t w, int bpp)
 {
-  uint32_t row, y, nrow;
-  u_char *buf;
-  tileContigRoutine put;
+  GTWORK gw;
   uint32_t rowsperstrip;
   uint32_t imagewidth;
-  int scanline;
-  int fromskew, toskew;
-  tsize_t bufsize;
 
-  put = pickTileContigCase(Map);
-  if (put == 0)
+  bzero((char *) &gw, sizeof(gw));
+  gw.cput = pickTileContigCase(td, Map);
+  if (gw.cput == 0)
     return (0);
 
-  bufsize = TIFFStripSize(tif);
-  if (bufsize <= 0) return 0;  /* tsize_t is signed */
-  buf = (u_char *) malloc((size_t) bufsize);
-  if (buf == 0) {
-    TIFFError(filename, "No space for strip buffer");
+  gw.bufsize = TIFFStripSize(tif);
+  if (gw.bufsize <= 0) return 0;  /* tsize_t is signed */
+  gw.buf = (u_char *) malloc((size_t) gw.bufsize);
+  if (gw.buf == 0) {
+    TIFFError(td->bname, "No space for strip buffer");
     return (0);
   }
-  y = setorientation(tif, h);
-  toskew = (orientation == ORIENTATION_TOPLEFT ? -w + -w : -w + w);
+
+  gw.td = td;  gw.tif = tif;  gw.raster = raster;  gw.Map = Map;
+  gw.w = w;  gw.h = h;  gw.bpp = bpp;
+  gw.y0 = setorientation(td, tif, h);
+  gw.ydir = (td->orientation == ORIENTATION_TOPLEFT ? -1 : 1);
+  gw.toskew = (td->orientation == ORIENTATION_TOPLEFT ? -w + -w : -w + w);
   TIFFGetFieldDefaulted(tif, TIFFTAG_ROWSPERSTRIP, &rowsperstrip);
   TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &imagewidth);
-  scanline = TIFFScanlineSize(tif);
-  fromskew = (w < imagewidth ? imagewidth - w : 0);
-  for (row = 0; row < h; row += rowsperstrip) {
-    nrow = (row + rowsperstrip > h ? h - row : rowsperstrip);
-    if (TIFFReadEncodedStrip(tif,
-			     TIFFComputeStrip(tif, (uint32_t) row,(tsample_t) 0),
-			     (tdata_t) buf, (tsize_t)(nrow*scanline)) < 0
-	&& stoponerr) break;
+  gw.uh = (rowsperstrip == 0 || rowsperstrip > h ? h : rowsperstrip);
+  gw.scanline = TIFFScanlineSize(tif);
+  gw.fromskew = (w < imagewidth ? imagewidth - w : 0);
 
-    (*put)(raster + y*w*bpp, buf, Map, w, nrow, fromskew, toskew*bpp);
-
-    y += (orientation == ORIENTATION_TOPLEFT ? -nrow : nrow);
-  }
-  free(buf);
-  return (1);
+  return gtRun(&gw);
 }
 
 
@@ -1153,69 +1507,44 @@ static int gtStripContig(TIFF *tif, byte *raster, RGBvalue *Map, uint32_t h, uin
  *	 PlanarConfiguration separated
  * We assume that all such images are RGB.
  */
-static int gtStripSeparate(TIFF *tif, byte *raster, register RGBvalue *Map, uint32_t h, uint32_t w, int bpp)
+static int gtStripSeparate(TIFFDEC *td, TIFF *tif, byte *raster, register RGBvalue *Map, uint32_t h, uint32_t w, int bpp)
 {
-  uint32_t nrow, row, y;
-  u_char *buf;
-  u_char *r, *g, *b;
-  tsize_t stripsize;
+  GTWORK gw;
   uint32_t bufsize;
-  int fromskew, toskew;
-  int scanline;
-  tileSeparateRoutine put;
   uint32_t rowsperstrip;
   uint32_t imagewidth;
 
-  stripsize = TIFFStripSize(tif);
-  bufsize = 3*stripsize;
-  if (stripsize <= 0 || bufsize/3 != stripsize) {  /* tsize_t is signed */
-    TIFFError(filename, "Image dimensions too large");
-    return 0;
-  }
-  buf = (u_char *) malloc((size_t) bufsize);
-  if (buf == 0) {
-    TIFFError(filename, "No space for strip buffer");
+  bzero((char *) &gw, sizeof(gw));
+  gw.sput = pickTileSeparateCase(td, Map);
+  if (gw.sput == 0) {
+    TIFFError(td->bname, "Cannot handle format");
     return (0);
   }
-  r = buf;
-  g = r + stripsize;
-  b = g + stripsize;
-  put = pickTileSeparateCase(Map);
-  if (put == 0) {
-    TIFFError(filename, "Cannot handle format");
+
+  gw.bufsize = TIFFStripSize(tif);
+  bufsize = 3*gw.bufsize;
+  if (gw.bufsize <= 0 || bufsize/3 != gw.bufsize) {  /* tsize_t is signed */
+    TIFFError(td->bname, "Image dimensions too large");
+    return 0;
+  }
+  gw.buf = (u_char *) malloc((size_t) bufsize);
+  if (gw.buf == 0) {
+    TIFFError(td->bname, "No space for strip buffer");
     return (0);
   }
-  y = setorientation(tif, h);
-  toskew = (orientation == ORIENTATION_TOPLEFT ? -w + -w : -w + w);
+
+  gw.td = td;  gw.tif = tif;  gw.raster = raster;  gw.Map = Map;
+  gw.w = w;  gw.h = h;  gw.bpp = bpp;
+  gw.y0 = setorientation(td, tif, h);
+  gw.ydir = (td->orientation == ORIENTATION_TOPLEFT ? -1 : 1);
+  gw.toskew = (td->orientation == ORIENTATION_TOPLEFT ? -w + -w : -w + w);
   TIFFGetFieldDefaulted(tif, TIFFTAG_ROWSPERSTRIP, &rowsperstrip);
   TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &imagewidth);
-  scanline = TIFFScanlineSize(tif);
-  fromskew = (w < imagewidth ? imagewidth - w : 0);
-  for (row = 0; row < h; row += rowsperstrip) {
-    tsample_t band;
-
-    nrow = (row + rowsperstrip > h ? h - row : rowsperstrip);
-    band = 0;
-    if (TIFFReadEncodedStrip(tif, TIFFComputeStrip(tif, (uint32_t) row, band),
-			     (tdata_t) r, (tsize_t)(nrow*scanline)) < 0
-	&& stoponerr) break;
-
-    band = 1;
-    if (TIFFReadEncodedStrip(tif, TIFFComputeStrip(tif, (uint32_t) row, band),
-			     (tdata_t) g, (tsize_t)(nrow*scanline)) < 0
-	&& stoponerr) break;
-
-    band = 2;
-    if (TIFFReadEncodedStrip(tif, TIFFComputeStrip(tif, (uint32_t) row, band),
-			     (tdata_t) b, (tsize_t)(nrow*scanline)) < 0
-	&& stoponerr) break;
-
-    (*put)(raster + y*w*bpp, r, g, b, Map, w, nrow, fromskew, toskew*bpp);
+  gw.uh = (rowsperstrip == 0 || rowsperstrip > h ? h : rowsperstrip);
+  gw.scanline = TIFFScanlineSize(tif);
+  gw.fromskew = (w < imagewidth ? imagewidth - w : 0);
 
-    y += (orientation == ORIENTATION_TOPLEFT ? -nrow : nrow);
-  }
-  free(buf);
-  return (1);
+  return gtRun(&gw);
 }
 
 
@@ -1226,22 +1555,22 @@ static int gtStripSeparate(TIFF *tif, byte *raster, register RGBvalue *Map, uint
  * pixel values simply by indexing into the table with one
  * number.
  */
-static int makebwmap(void)
+static int makebwmap(TIFFDEC *td)
 {
   register int i;
-  int nsamples = 8 / bitspersample;
+  int nsamples = 8 / td->bitspersample;
   register byte *p;
 
-  BWmap = (byte **)malloc(
+  td->BWmap = (byte **)malloc(
 			  256*sizeof (byte *)+(256*nsamples*sizeof(byte)));
-  if (BWmap == NULL) {
-    TIFFError(filename, "No space for B&W mapping table");
+  if (td->BWmap == NULL) {
+    TIFFError(td->bname, "No space for B&W mapping table");
     return (0);
   }
-  p = (byte *)(BWmap + 256);
+  p = (byte *)(td->BWmap + 256);
   for (i = 0; i < 256; i++) {
-    BWmap[i] = p;
-    switch (bitspersample) {
+    td->BWmap[i] = p;
+    switch (td->bitspersample) {
 #define	GREY(x)	*p++ = x;
     case 1:
       GREY(i>>7);
@@ -1280,23 +1609,23 @@ static int makebwmap(void)
  * (8/bitspersample) pixel-values simply by indexing into
  * the table with one number.
  */
-static int makecmap(void)
+static int makecmap(TIFFDEC *td)
 {
   register int i;
-  int nsamples = 8 / bitspersample;
+  int nsamples = 8 / td->bitspersample;
   register byte *p;
 
-  PALmap = (byte **)malloc(
+  td->PALmap = (byte **)malloc(
 			   256*sizeof (byte *)+(256*nsamples*sizeof(byte)));
-  if (PALmap == NULL) {
-    TIFFError(filename, "No space for Palette mapping table");
+  if (td->PALmap == NULL) {
+    TIFFError(td->bname, "No space for Palette mapping table");
     return (0);
   }
-  p = (byte *)(PALmap + 256);
+  p = (byte *)(td->PALmap + 256);
   for (i = 0; i < 256; i++) {
-    PALmap[i] = p;
+    td->PALmap[i] = p;
 #define	CMAP(x)	*p++ = x;
-    switch (bitspersample) {
+    switch (td->bitspersample) {
     case 1:
       CMAP(i>>7);
       CMAP((i>>6)&1);
@@ -1393,11 +1722,11 @@ static int makecmap(void)
 /*
  * 8-bit palette => colormap/RGB
  */
-static void put8bitcmaptile(byte *cp, u_char *pp, RGBvalue *Map, uint32_t w, uint32_t h, int fromskew, int toskew)
+static void put8bitcmaptile(TIFFDEC *td, byte *cp, u_char *pp, RGBvalue *Map, uint32_t w, uint32_t h, int fromskew, int toskew)
 {
   XV_UNUSED(Map);
   while (h-- > 0) {
-    UNROLL8(w, , *cp++ = PALmap[*pp++][0]);
+    UNROLL8(w, , *cp++ = td->PALmap[*pp++][0]);
     cp += toskew;
     pp += fromskew;
   }
@@ -1406,7 +1735,7 @@ static void put8bitcmaptile(byte *cp, u_char *pp, RGBvalue *Map, uint32_t w, uin
 /*
  * 4-bit palette => colormap/RGB
  */
-static void put4bitcmaptile(byte *cp, u_char *pp, RGBvalue *Map, uint32_t w, uint32_t h, int fromskew, int toskew)
+static void put4bitcmaptile(TIFFDEC *td, byte *cp, u_char *pp, RGBvalue *Map, uint32_t w, uint32_t h, int fromskew, int toskew)
 {
   register byte *bw;
 
@@ -1414,7 +1743,7 @@ static void put4bitcmaptile(byte *cp, u_char *pp, RGBvalue *Map, uint32_t w, uin
 
   fromskew /= 2;
   while (h-- > 0) {
-    UNROLL2(w, bw = PALmap[*pp++], *cp++ = *bw++);
+    UNROLL2(w, bw = td->PALmap[*pp++], *cp++ = *bw++);
     cp += toskew;
     pp += fromskew;
   }
@@ -1424,7 +1753,7 @@ static void put4bitcmaptile(byte *cp, u_char *pp, RGBvalue *Map, uint32_t w, uin
 /*
  * 2-bit palette => colormap/RGB
  */
-static void put2bitcmaptile(byte *cp, u_char *pp, RGBvalue *Map, uint32_t w, uint32_t h, int fromskew, int toskew)
+static void put2bitcmaptile(TIFFDEC *td, byte *cp, u_char *pp, RGBvalue *Map, uint32_t w, uint32_t h, int fromskew, int toskew)
 {
   register byte *bw;
 
@@ -1432,7 +1761,7 @@ static void put2bitcmaptile(byte *cp, u_char *pp, RGBvalue *Map, uint32_t w, uin
 
   fromskew /= 4;
   while (h-- > 0) {
-    UNROLL4(w, bw = PALmap[*pp++], *cp++ = *bw++);
+    UNROLL4(w, bw = td->PALmap[*pp++], *cp++ = *bw++);
     cp += toskew;
     pp += fromskew;
   }
@@ -1441,7 +1770,7 @@ static void put2bitcmaptile(byte *cp, u_char *pp, RGBvalue *Map, uint32_t w, uin
 /*
  * 1-bit palette => colormap/RGB
  */
-static void put1bitcmaptile(byte *cp, u_char *pp, RGBvalue *Map, uint32_t w, uint32_t h, int fromskew, int toskew)
+static void put1bitcmaptile(TIFFDEC *td, byte *cp, u_char *pp, RGBvalue *Map, uint32_t w, uint32_t h, int fromskew, int toskew)
 {
   register byte *bw;
 
@@ -1449,7 +1778,7 @@ static void put1bitcmaptile(byte *cp, u_char *pp, RGBvalue *Map, uint32_t w, uin
 
   fromskew /= 8;
   while (h-- > 0) {
-    UNROLL8(w, bw = PALmap[*pp++], *cp++ = *bw++)
+    UNROLL8(w, bw = td->PALmap[*pp++], *cp++ = *bw++)
     cp += toskew;
     pp += fromskew;
   }
@@ -1459,13 +1788,13 @@ static void put1bitcmaptile(byte *cp, u_char *pp, RGBvalue *Map, uint32_t w, uin
 /*
  * 8-bit greyscale => colormap/RGB
  */
-static void putgreytile(register byte *cp, register u_char *pp, RGBvalue *Map, uint32_t w, uint32_t h, int fromskew, int toskew)
+static void putgreytile(TIFFDEC *td, register byte *cp, register u_char *pp, RGBvalue *Map, uint32_t w, uint32_t h, int fromskew, int toskew)
 {
   XV_UNUSED(Map);
   while (h-- > 0) {
     register uint32_t x;
     for (x = w; x-- > 0;)
-      *cp++ = BWmap[*pp++][0];
+      *cp++ = td->BWmap[*pp++][0];
     cp += toskew;
     pp += fromskew;
   }
@@ -1475,7 +1804,7 @@ static void putgreytile(register byte *cp, register u_char *pp, RGBvalue *Map, u
 /*
  * 1-bit bilevel => colormap/RGB
  */
-static void put1bitbwtile(byte *cp, u_char *pp, RGBvalue *Map, uint32_t w, uint32_t h, int fromskew, int toskew)
+static void put1bitbwtile(TIFFDEC *td, byte *cp, u_char *pp, RGBvalue *Map, uint32_t w, uint32_t h, int fromskew, int toskew)
 {
   register byte *bw;
 
@@ -1483,7 +1812,7 @@ static void put1bitbwtile(byte *cp, u_char *pp, RGBvalue *Map, uint32_t w, uint3
 
   fromskew /= 8;
   while (h-- > 0) {
-    UNROLL8(w, bw = BWmap[*pp++], *cp++ = *bw++)
+    UNROLL8(w, bw = td->BWmap[*pp++], *cp++ = *bw++)
     cp += toskew;
     pp += fromskew;
   }
@@ -1492,7 +1821,7 @@ static void put1bitbwtile(byte *cp, u_char *pp, RGBvalue *Map, uint32_t w, uint3
 /*
  * 2-bit greyscale => colormap/RGB
  */
-static void put2bitbwtile(byte *cp, u_char *pp, RGBvalue *Map, uint32_t w, uint32_t h, int fromskew, int toskew)
+static void put2bitbwtile(TIFFDEC *td, byte *cp, u_char *pp, RGBvalue *Map, uint32_t w, uint32_t h, int fromskew, int toskew)
 {
   register byte *bw;
 
@@ -1500,7 +1829,7 @@ static void put2bitbwtile(byte *cp, u_char *pp, RGBvalue *Map, uint32_t w, uint3
 
   fromskew /= 4;
   while (h-- > 0) {
-    UNROLL4(w, bw = BWmap[*pp++], *cp++ = *bw++);
+    UNROLL4(w, bw = td->BWmap[*pp++], *cp++ = *bw++);
     cp += toskew;
     pp += fromskew;
   }
@@ -1509,7 +1838,7 @@ static void put2bitbwtile(byte *cp, u_char *pp, RGBvalue *Map, uint32_t w, uint3
 /*
  * 4-bit greyscale => colormap/RGB
  */
-static void put4bitbwtile(byte *cp, u_char *pp, RGBvalue *Map, uint32_t w, uint32_t h, int fromskew, int toskew)
+static void put4bitbwtile(TIFFDEC *td, byte *cp, u_char *pp, RGBvalue *Map, uint32_t w, uint32_t h, int fromskew, int toskew)
 {
   register byte *bw;
 
@@ -1517,7 +1846,7 @@ static void put4bitbwtile(byte *cp, u_char *pp, RGBvalue *Map, uint32_t w, uint3
 
   fromskew /= 2;
   while (h-- > 0) {
-    UNROLL2(w, bw = BWmap[*pp++], *cp++ = *bw++);
+    UNROLL2(w, bw = td->BWmap[*pp++], *cp++ = *bw++);
     cp += toskew;
     pp += fromskew;
   }
@@ -1526,10 +1855,12 @@ static void put4bitbwtile(byte *cp, u_char *pp, RGBvalue *Map, uint32_t w, uint3
 /*
  * 16-bit greyscale => colormap/RGB
  */
-static void put16bitbwtile(byte *cp, u_short *pp, RGBvalue *Map, uint32_t w, uint32_t h, int fromskew, int toskew)
+static void put16bitbwtile(TIFFDEC *td, byte *cp, u_short *pp, RGBvalue *Map, uint32_t w, uint32_t h, int fromskew, int toskew)
 {
   register uint32_t   x;
 
+  XV_UNUSED(td);
+
   while (h-- > 0) {
     for (x=w; x>0; x--) {
       *cp++ = Map[*pp++];
@@ -1544,9 +1875,9 @@ static void put16bitbwtile(byte *cp, u_short *pp, RGBvalue *Map, uint32_t w, uin
 /*
  * 8-bit packed samples => RGB
  */
-static void putRGBcontig8bittile(byte *cp, u_char *pp, RGBvalue *Map, uint32_t w, uint32_t h, int fromskew, int toskew)
+static void putRGBcontig8bittile(TIFFDEC *td, byte *cp, u_char *pp, RGBvalue *Map, uint32_t w, uint32_t h, int fromskew, int toskew)
 {
-  fromskew *= samplesperpixel;
+  fromskew *= td->samplesperpixel;
   if (Map) {
     while (h-- > 0) {
       register uint32_t x;
@@ -1554,7 +1885,7 @@ static void putRGBcontig8bittile(byte *cp, u_char *pp, RGBvalue *Map, uint32_t w
 	*cp++ = Map[pp[0]];
 	*cp++ = Map[pp[1]];
 	*cp++ = Map[pp[2]];
-	pp += samplesperpixel;
+	pp += td->samplesperpixel;
       }
       pp += fromskew;
       cp += toskew;
@@ -1565,7 +1896,7 @@ static void putRGBcontig8bittile(byte *cp, u_char *pp, RGBvalue *Map, uint32_t w
 	      *cp++ = pp[0];
 	      *cp++ = pp[1];
 	      *cp++ = pp[2];
-	      pp += samplesperpixel);
+	      pp += td->samplesperpixel);
       cp += toskew;
       pp += fromskew;
     }
@@ -1575,18 +1906,18 @@ static void putRGBcontig8bittile(byte *cp, u_char *pp, RGBvalue *Map, uint32_t w
 /*
  * 16-bit packed samples => RGB
  */
-static void putRGBcontig16bittile(byte *cp, u_short *pp, RGBvalue *Map, uint32_t w, uint32_t h, int fromskew, int toskew)
+static void putRGBcontig16bittile(TIFFDEC *td, byte *cp, u_short *pp, RGBvalue *Map, uint32_t w, uint32_t h, int fromskew, int toskew)
 {
   register u_int x;
 
-  fromskew *= samplesperpixel;
+  fromskew *= td->samplesperpixel;
   if (Map) {
     while (h-- > 0) {
       for (x = w; x-- > 0;) {
 	*cp++ = Map[pp[0]];
 	*cp++ = Map[pp[1]];
 	*cp++ = Map[pp[2]];
-	pp += samplesperpixel;
+	pp += td->samplesperpixel;
       }
       cp += toskew;
       pp += fromskew;
@@ -1597,7 +1928,7 @@ static void putRGBcontig16bittile(byte *cp, u_short *pp, RGBvalue *Map, uint32_t
 	*cp++ = pp[0];
 	*cp++ = pp[1];
 	*cp++ = pp[2];
-	pp += samplesperpixel;
+	pp += td->samplesperpixel;
       }
       cp += toskew;
       pp += fromskew;
@@ -1608,8 +1939,10 @@ static void putRGBcontig16bittile(byte *cp, u_short *pp, RGBvalue *Map, uint32_t
 /*
  * 8-bit unpacked samples => RGB
  */
-static void putRGBseparate8bittile(byte *cp, u_char *r, u_char *g, u_char *b, RGBvalue *Map, uint32_t w, uint32_t h, int fromskew, int toskew)
+static void putRGBseparate8bittile(TIFFDEC *td, byte *cp, u_char *r, u_char *g, u_char *b, RGBvalue *Map, uint32_t w, uint32_t h, int fromskew, int toskew)
 {
+  XV_UNUSED(td);
+
   if (Map) {
     while (h-- > 0) {
       register uint32_t x;
@@ -1637,10 +1970,12 @@ static void putRGBseparate8bittile(byte *cp, u_char *r, u_char *g, u_char *b, RG
 /*
  * 16-bit unpacked samples => RGB
  */
-static void putRGBseparate16bittile(byte *cp, u_short *r, u_short *g, u_short *b, RGBvalue *Map, uint32_t w, uint32_t h, int fromskew, int toskew)
+static void putRGBseparate16bittile(TIFFDEC *td, byte *cp, u_short *r, u_short *g, u_short *b, RGBvalue *Map, uint32_t w, uint32_t h, int fromskew, int toskew)
 {
   uint32_t x;
 
+  XV_UNUSED(td);
+
   if (Map) {
     while (h-- > 0) {
       for (x = w; x > 0; x--) {
@@ -1669,14 +2004,11 @@ static void putRGBseparate16bittile(byte *cp, u_short *r, u_short *g, u_short *b
 #define	CLAMP(f,min,max) \
     (int)((f)+.5 < (min) ? (min) : (f)+.5 > (max) ? (max) : (f)+.5)
 
-#define	LumaRed		YCbCrCoeffs[0]
-#define	LumaGreen	YCbCrCoeffs[1]
-#define	LumaBlue	YCbCrCoeffs[2]
-
-static	float D1, D2, D3, D4 /*, D5 */;
-
+#define	LumaRed		td->YCbCrCoeffs[0]
+#define	LumaGreen	td->YCbCrCoeffs[1]
+#define	LumaBlue	td->YCbCrCoeffs[2]
 
-static void initYCbCrConversion(void)
+static void initYCbCrConversion(TIFFDEC *td)
 {
   /*
    * Old, broken version (goes back at least to 19920426; made worse 19941222):
@@ -1694,29 +2026,29 @@ static void initYCbCrConversion(void)
    *     D3 = 1.772
    *     D4 = 0.344136
    */
-  D1 = 2 - 2*LumaRed;
-  D2 = D1*LumaRed / LumaGreen;
-  D3 = 2 - 2*LumaBlue;
-  D4 = D3*LumaBlue / LumaGreen;  /* ARGH, used to be D2*LumaBlue/LumaGreen ! */
+  td->D1 = 2 - 2*LumaRed;
+  td->D2 = td->D1*LumaRed / LumaGreen;
+  td->D3 = 2 - 2*LumaBlue;
+  td->D4 = td->D3*LumaBlue / LumaGreen;  /* ARGH, used to be D2*LumaBlue/LumaGreen ! */
 /* D5 = 1.0 / LumaGreen; */      /* unnecessary */
 }
 
-static void putRGBContigYCbCrClump(byte *cp, u_char *pp, int cw, int ch, uint32_t w, int n, int fromskew, int toskew)
+static void putRGBContigYCbCrClump(TIFFDEC *td, byte *cp, u_char *pp, int cw, int ch, uint32_t w, int n, int fromskew, int toskew)
 {
   float Cb, Cr;
   int j, k;
 
-  Cb = Code2V(pp[n],   refBlackWhite[2], refBlackWhite[3], 127);
-  Cr = Code2V(pp[n+1], refBlackWhite[4], refBlackWhite[5], 127);
+  Cb = Code2V(pp[n],   td->refBlackWhite[2], td->refBlackWhite[3], 127);
+  Cr = Code2V(pp[n+1], td->refBlackWhite[4], td->refBlackWhite[5], 127);
   for (j = 0; j < ch; j++) {
     for (k = 0; k < cw; k++) {
       float Y, R, G, B;
       Y = Code2V(*pp++,
-		 refBlackWhite[0], refBlackWhite[1], 255);
-      R = Y + Cr*D1;
+		 td->refBlackWhite[0], td->refBlackWhite[1], 255);
+      R = Y + Cr*td->D1;
 /*    G = Y*D5 - Cb*D4 - Cr*D2;  highly bogus! */
-      G = Y - Cb*D4 - Cr*D2;
-      B = Y + Cb*D3;
+      G = Y - Cb*td->D4 - Cr*td->D2;
+      B = Y + Cb*td->D3;
       /*
        * These are what the JPEG/JFIF equations--which aren't _necessarily_
        * what JPEG/TIFF uses but which seem close enough--are supposed to be,
@@ -1741,22 +2073,22 @@ static void putRGBContigYCbCrClump(byte *cp, u_char *pp, int cw, int ch, uint32_
   }
 }
 
-static void putRGBSeparateYCbCrClump(byte *cp, u_char *y, u_char *cb, u_char *cr, int cw, int ch, uint32_t w, int n, int fromskew, int toskew)
+static void putRGBSeparateYCbCrClump(TIFFDEC *td, byte *cp, u_char *y, u_char *cb, u_char *cr, int cw, int ch, uint32_t w, int n, int fromskew, int toskew)
 {
   float Cb, Cr;
   int j, k;
 
   XV_UNUSED(n);
 
-  Cb = Code2V(cb[0], refBlackWhite[2], refBlackWhite[3], 127);
-  Cr = Code2V(cr[0], refBlackWhite[4], refBlackWhite[5], 127);
+  Cb = Code2V(cb[0], td->refBlackWhite[2], td->refBlackWhite[3], 127);
+  Cr = Code2V(cr[0], td->refBlackWhite[4], td->refBlackWhite[5], 127);
   for (j = 0; j < ch; j++) {
     for (k = 0; k < cw; k++) {
       float Y, R, G, B;
-      Y = Code2V(y[k], refBlackWhite[0], refBlackWhite[1], 255);
-      R = Y + Cr*D1;
-      G = Y - Cb*D4 - Cr*D2;
-      B = Y + Cb*D3;
+      Y = Code2V(y[k], td->refBlackWhite[0], td->refBlackWhite[1], 255);
+      R = Y + Cr*td->D1;
+      G = Y - Cb*td->D4 - Cr*td->D2;
+      B = Y + Cb*td->D3;
       cp[3*k+0] = CLAMP(R,0,255);
       cp[3*k+1] = CLAMP(G,0,255);
       cp[3*k+2] = CLAMP(B,0,255);
@@ -1766,22 +2098,22 @@ static void putRGBSeparateYCbCrClump(byte *cp, u_char *y, u_char *cb, u_char *cr
   }
 }
 
-static void putRGBSeparate16bitYCbCrClump(byte *cp, u_short *y, u_short *cb, u_short *cr, int cw, int ch, uint32_t w, int n, int fromskew, int toskew)
+static void putRGBSeparate16bitYCbCrClump(TIFFDEC *td, byte *cp, u_short *y, u_short *cb, u_short *cr, int cw, int ch, uint32_t w, int n, int fromskew, int toskew)
 {
   float Cb, Cr;
   int j, k;
 
   XV_UNUSED(n);
 
-  Cb = Code2V(cb[0], refBlackWhite[2], refBlackWhite[3], 127);
-  Cr = Code2V(cr[0], refBlackWhite[4], refBlackWhite[5], 127);
+  Cb = Code2V(cb[0], td->refBlackWhite[2], td->refBlackWhite[3], 127);
+  Cr = Code2V(cr[0], td->refBlackWhite[4], td->refBlackWhite[5], 127);
   for (j = 0; j < ch; j++) {
     for (k = 0; k < cw; k++) {
       float Y, R, G, B;
-      Y = Code2V(y[k], refBlackWhite[0], refBlackWhite[1], 255);
-      R = Y + Cr*D1;
-      G = Y - Cb*D4 - Cr*D2;
-      B = Y + Cb*D3;
+      Y = Code2V(y[k], td->refBlackWhite[0], td->refBlackWhite[1], 255);
+      R = Y + Cr*td->D1;
+      G = Y - Cb*td->D4 - Cr*td->D2;
+      B = Y + Cb*td->D3;
       cp[3*k+0] = CLAMP(R,0,255);
       cp[3*k+1] = CLAMP(G,0,255);
       cp[3*k+2] = CLAMP(B,0,255);
@@ -1801,163 +2133,163 @@ static void putRGBSeparate16bitYCbCrClump(byte *cp, u_short *y, u_short *cb, u_s
 /*
  * 8-bit packed YCbCr samples => RGB
  */
-static void putcontig8bitYCbCrtile(byte *cp, u_char *pp, RGBvalue *Map, uint32_t w, uint32_t h, int fromskew, int toskew)
+static void putcontig8bitYCbCrtile(TIFFDEC *td, byte *cp, u_char *pp, RGBvalue *Map, uint32_t w, uint32_t h, int fromskew, int toskew)
 {
-  u_int Coff = YCbCrVertSampling * YCbCrHorizSampling;
+  u_int Coff = td->YCbCrVertSampling * td->YCbCrHorizSampling;
   byte *tp;
   uint32_t x;
 
   XV_UNUSED(Map);
 
   /* XXX adjust fromskew */
-  while (h >= YCbCrVertSampling) {
+  while (h >= td->YCbCrVertSampling) {
     tp = cp;
-    for (x = w; x >= YCbCrHorizSampling; x -= YCbCrHorizSampling) {
-      putRGBContigYCbCrClump(tp, pp, YCbCrHorizSampling, YCbCrVertSampling,
+    for (x = w; x >= td->YCbCrHorizSampling; x -= td->YCbCrHorizSampling) {
+      putRGBContigYCbCrClump(td, tp, pp, td->YCbCrHorizSampling, td->YCbCrVertSampling,
 			     w, (int) Coff, 0, toskew);
-      tp += 3*YCbCrHorizSampling;
+      tp += 3*td->YCbCrHorizSampling;
       pp += Coff+2;
     }
     if (x > 0) {
-      putRGBContigYCbCrClump(tp, pp, (int) x, YCbCrVertSampling,
-			     w, (int) Coff, (int)(YCbCrHorizSampling - x),
+      putRGBContigYCbCrClump(td, tp, pp, (int) x, td->YCbCrVertSampling,
+			     w, (int) Coff, (int)(td->YCbCrHorizSampling - x),
 			     toskew);
       pp += Coff+2;
     }
-    cp += YCbCrVertSampling*(3*w + toskew);
+    cp += td->YCbCrVertSampling*(3*w + toskew);
     pp += fromskew;
-    h -= YCbCrVertSampling;
+    h -= td->YCbCrVertSampling;
   }
   if (h > 0) {
     tp = cp;
-    for (x = w; x >= YCbCrHorizSampling; x -= YCbCrHorizSampling) {
-      putRGBContigYCbCrClump(tp, pp, YCbCrHorizSampling, (int) h,
+    for (x = w; x >= td->YCbCrHorizSampling; x -= td->YCbCrHorizSampling) {
+      putRGBContigYCbCrClump(td, tp, pp, td->YCbCrHorizSampling, (int) h,
 			     w, (int) Coff, 0, toskew);
-      tp += 3*YCbCrHorizSampling;
+      tp += 3*td->YCbCrHorizSampling;
       pp += Coff+2;
     }
     if (x > 0)
-      putRGBContigYCbCrClump(tp, pp, (int) x, (int) h, w,
-			     (int)Coff, (int)(YCbCrHorizSampling-x),toskew);
+      putRGBContigYCbCrClump(td, tp, pp, (int) x, (int) h, w,
+			     (int)Coff, (int)(td->YCbCrHorizSampling-x),toskew);
   }
 }
 
 /*
  * 8-bit unpacked YCbCr samples => RGB
  */
-static void putYCbCrseparate8bittile(byte *cp, u_char *y, u_char *cb, u_char *cr, RGBvalue *Map, uint32_t w, uint32_t h, int fromskew, int toskew)
+static void putYCbCrseparate8bittile(TIFFDEC *td, byte *cp, u_char *y, u_char *cb, u_char *cr, RGBvalue *Map, uint32_t w, uint32_t h, int fromskew, int toskew)
 {
   uint32_t x;
-  int fromskew2 = fromskew/YCbCrHorizSampling;
+  int fromskew2 = fromskew/td->YCbCrHorizSampling;
 
   XV_UNUSED(Map);
 
-  while (h >= YCbCrVertSampling) {
-    for (x = w; x >= YCbCrHorizSampling; x -= YCbCrHorizSampling) {
-      putRGBSeparateYCbCrClump(cp, y, cb, cr, YCbCrHorizSampling,
-			       YCbCrVertSampling, w, 0, 0, toskew);
-      cp += 3*YCbCrHorizSampling;
-      y += YCbCrHorizSampling;
+  while (h >= td->YCbCrVertSampling) {
+    for (x = w; x >= td->YCbCrHorizSampling; x -= td->YCbCrHorizSampling) {
+      putRGBSeparateYCbCrClump(td, cp, y, cb, cr, td->YCbCrHorizSampling,
+			       td->YCbCrVertSampling, w, 0, 0, toskew);
+      cp += 3*td->YCbCrHorizSampling;
+      y += td->YCbCrHorizSampling;
       ++cb;
       ++cr;
     }
     if (x > 0) {
-      putRGBSeparateYCbCrClump(cp, y, cb, cr, (int) x, YCbCrVertSampling,
-			       w, 0, (int)(YCbCrHorizSampling - x), toskew);
+      putRGBSeparateYCbCrClump(td, cp, y, cb, cr, (int) x, td->YCbCrVertSampling,
+			       w, 0, (int)(td->YCbCrHorizSampling - x), toskew);
       cp += x*3;
-      y += YCbCrHorizSampling;
+      y += td->YCbCrHorizSampling;
       ++cb;
       ++cr;
     }
-    cp += (YCbCrVertSampling - 1)*w*3 + YCbCrVertSampling*toskew;
-    y  += (YCbCrVertSampling - 1)*w + YCbCrVertSampling*fromskew;
+    cp += (td->YCbCrVertSampling - 1)*w*3 + td->YCbCrVertSampling*toskew;
+    y  += (td->YCbCrVertSampling - 1)*w + td->YCbCrVertSampling*fromskew;
     cb += fromskew2;
     cr += fromskew2;
-    h -= YCbCrVertSampling;
+    h -= td->YCbCrVertSampling;
   }
   if (h > 0) {
-    for (x = w; x >= YCbCrHorizSampling; x -= YCbCrHorizSampling) {
-      putRGBSeparateYCbCrClump(cp, y, cb, cr, YCbCrHorizSampling, (int) h,
+    for (x = w; x >= td->YCbCrHorizSampling; x -= td->YCbCrHorizSampling) {
+      putRGBSeparateYCbCrClump(td, cp, y, cb, cr, td->YCbCrHorizSampling, (int) h,
 			       w, 0, 0, toskew);
-      cp += 3*YCbCrHorizSampling;
-      y += YCbCrHorizSampling;
+      cp += 3*td->YCbCrHorizSampling;
+      y += td->YCbCrHorizSampling;
       ++cb;
       ++cr;
     }
     if (x > 0)
-      putRGBSeparateYCbCrClump(cp, y, cb, cr, (int) x, (int) h, w, 
-			       0, (int)(YCbCrHorizSampling-x),toskew);
+      putRGBSeparateYCbCrClump(td, cp, y, cb, cr, (int) x, (int) h, w, 
+			       0, (int)(td->YCbCrHorizSampling-x),toskew);
   }
 }
 
 /*
  * 16-bit unpacked YCbCr samples => RGB
  */
-static void putYCbCrseparate16bittile(byte *cp, u_short *y, u_short *cb, u_short *cr, RGBvalue *Map, uint32_t w, uint32_t h, int fromskew, int toskew)
+static void putYCbCrseparate16bittile(TIFFDEC *td, byte *cp, u_short *y, u_short *cb, u_short *cr, RGBvalue *Map, uint32_t w, uint32_t h, int fromskew, int toskew)
 {
   uint32_t x;
-  int fromskew2 = fromskew/YCbCrHorizSampling;
+  int fromskew2 = fromskew/td->YCbCrHorizSampling;
 
   XV_UNUSED(Map);
 
-  while (h >= YCbCrVertSampling) {
-    for (x = w; x >= YCbCrHorizSampling; x -= YCbCrHorizSampling) {
-      putRGBSeparate16bitYCbCrClump(cp, y, cb, cr, YCbCrHorizSampling,
-		 		    YCbCrVertSampling, w, 0, 0, toskew);
-      cp += 3*YCbCrHorizSampling;
-      y += YCbCrHorizSampling;
+  while (h >= td->YCbCrVertSampling) {
+    for (x = w; x >= td->YCbCrHorizSampling; x -= td->YCbCrHorizSampling) {
+      putRGBSeparate16bitYCbCrClump(td, cp, y, cb, cr, td->YCbCrHorizSampling,
+		 		    td->YCbCrVertSampling, w, 0, 0, toskew);
+      cp += 3*td->YCbCrHorizSampling;
+      y += td->YCbCrHorizSampling;
       ++cb;
       ++cr;
     }
     if (x > 0) {
-      putRGBSeparate16bitYCbCrClump(cp, y, cb, cr, (int) x, YCbCrVertSampling,
-				    w, 0, (int)(YCbCrHorizSampling - x),
+      putRGBSeparate16bitYCbCrClump(td, cp, y, cb, cr, (int) x, td->YCbCrVertSampling,
+				    w, 0, (int)(td->YCbCrHorizSampling - x),
 				    toskew);
       cp += x*3;
-      y += YCbCrHorizSampling;
+      y += td->YCbCrHorizSampling;
       ++cb;
       ++cr;
     }
-    cp += (YCbCrVertSampling - 1)*w*3 + YCbCrVertSampling*toskew;
-    y  += (YCbCrVertSampling - 1)*w + YCbCrVertSampling*fromskew;
+    cp += (td->YCbCrVertSampling - 1)*w*3 + td->YCbCrVertSampling*toskew;
+    y  += (td->YCbCrVertSampling - 1)*w + td->YCbCrVertSampling*fromskew;
     cb += fromskew2;
     cr += fromskew2;
-    h -= YCbCrVertSampling;
+    h -= td->YCbCrVertSampling;
   }
   if (h > 0) {
-    for (x = w; x >= YCbCrHorizSampling; x -= YCbCrHorizSampling) {
-      putRGBSeparate16bitYCbCrClump(cp, y, cb, cr, YCbCrHorizSampling, (int) h,
+    for (x = w; x >= td->YCbCrHorizSampling; x -= td->YCbCrHorizSampling) {
+      putRGBSeparate16bitYCbCrClump(td, cp, y, cb, cr, td->YCbCrHorizSampling, (int) h,
 				    w, 0, 0, toskew);
-      cp += 3*YCbCrHorizSampling;
-      y += YCbCrHorizSampling;
+      cp += 3*td->YCbCrHorizSampling;
+      y += td->YCbCrHorizSampling;
       ++cb;
       ++cr;
     }
     if (x > 0)
-      putRGBSeparate16bitYCbCrClump(cp, y, cb, cr, (int) x, (int) h, w, 
-			 	    0, (int)(YCbCrHorizSampling-x),toskew);
+      putRGBSeparate16bitYCbCrClump(td, cp, y, cb, cr, (int) x, (int) h, w, 
+			 	    0, (int)(td->YCbCrHorizSampling-x),toskew);
   }
 }
 
 /*
  * Select the appropriate conversion routine for packed data.
  */
-static tileContigRoutine pickTileContigCase(RGBvalue *Map)
+static tileContigRoutine pickTileContigCase(TIFFDEC *td, RGBvalue *Map)
 {
   tileContigRoutine put = 0;
 
   XV_UNUSED(Map);
 
-  switch (photometric) {
+  switch (td->photometric) {
   case PHOTOMETRIC_RGB:
-    switch (bitspersample) {
+    switch (td->bitspersample) {
     case 8:  put = (tileContigRoutine) putRGBcontig8bittile;   break;
     case 16: put = (tileContigRoutine) putRGBcontig16bittile;  break;
     }
     break;
 
   case PHOTOMETRIC_PALETTE:
-    switch (bitspersample) {
+    switch (td->bitspersample) {
     case 8: put = put8bitcmaptile; break;
     case 4: put = put4bitcmaptile; break;
     case 2: put = put2bitcmaptile; break;
@@ -1967,7 +2299,7 @@ static tileContigRoutine pickTileContigCase(RGBvalue *Map)
 
   case PHOTOMETRIC_MINISWHITE:
   case PHOTOMETRIC_MINISBLACK:
-    switch (bitspersample) {
+    switch (td->bitspersample) {
     case 16: put = (tileContigRoutine) put16bitbwtile; break;
     case 8:  put = putgreytile;    break;
     case 4:  put = put4bitbwtile;  break;
@@ -1977,13 +2309,13 @@ static tileContigRoutine pickTileContigCase(RGBvalue *Map)
     break;
 
   case PHOTOMETRIC_YCBCR:
-    switch (bitspersample) {
+    switch (td->bitspersample) {
     case 8: put = putcontig8bitYCbCrtile; break;
     }
     break;
   }
 
-  if (put==0) TIFFError(filename, "Cannot handle format");
+  if (put==0) TIFFError(td->bname, "Cannot handle format");
   return (put);
 }
 
@@ -1994,29 +2326,29 @@ static tileContigRoutine pickTileContigCase(RGBvalue *Map)
  * NB: we assume that unpacked single-channel data is directed
  *	 to the "packed" routines.
  */
-static tileSeparateRoutine pickTileSeparateCase(RGBvalue *Map)
+static tileSeparateRoutine pickTileSeparateCase(TIFFDEC *td, RGBvalue *Map)
 {
   tileSeparateRoutine put = 0;
 
   XV_UNUSED(Map);
 
-  switch (photometric) {
+  switch (td->photometric) {
   case PHOTOMETRIC_RGB:
-    switch (bitspersample) {
+    switch (td->bitspersample) {
     case  8: put = (tileSeparateRoutine) putRGBseparate8bittile;  break;
     case 16: put = (tileSeparateRoutine) putRGBseparate16bittile; break;
     }
     break;
 
   case PHOTOMETRIC_YCBCR:
-    switch (bitspersample) {
+    switch (td->bitspersample) {
     case  8: put = (tileSeparateRoutine) putYCbCrseparate8bittile;  break;
     case 16: put = (tileSeparateRoutine) putYCbCrseparate16bittile; break;
     }
     break;
   }
 
-  if (put==0) TIFFError(filename, "Cannot handle format");
+  if (put==0) TIFFError(td->bname, "Cannot handle format");
   return (put);
 }
 
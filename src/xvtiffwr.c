@@ -456,6 +456,11 @@ static void writeTIFF(void)
 
   WaitCursor();
   inpix = GenSavePic(&ptype, &w, &h, &pfree, &nc, &rmap, &gmap, &bmap);
+  if (!inpix) {
+    CloseOutFileWhy(fp, filename, 1, "not enough memory");
+    SetCursors(-1);
+    return;
+  }
 
   if (colorType == F_REDUCED) colorType = F_FULLCOLOR;
 
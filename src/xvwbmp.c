@@ -28,22 +28,22 @@ typedef	unsigned long uint32;	/* sizeof (uint32) must == 4 */
 
 #define MUST(a)	            if (!(a)) {\
 				close(fd); \
-				return fail(st_fname, st_err); }
+				return fail(wd->fname, wd->err); }
 #define READU8(fd,u)	    if ((read(fd, &u, 1)<1)) {\
-				myfree(); \
+				myfree(wd); \
 				close(fd); \
-				return fail(st_fname, err_ueof); }
+				return fail(wd->fname, err_ueof); }
 #define SREADU8(fd, u)	    if ((read(fd, &u, 1,)<1)) {\
-				{ st_err = err_ueof; return 0; }
+				{ wd->err = err_ueof; return 0; }
 
 #define SREADC(fd, str, l)  {	\
-    str = (char*)mymalloc(l);	\
+    str = (char*)mymalloc(wd, l);	\
     if (!str) {			\
-	myfree();		\
+	myfree(wd);		\
 	FatalError("LoadWBMP: can't malloc extension buffer");	\
     }				\
     if (read(fd, str, l)<l) {	\
-	st_err = err_ueof;	\
+	wd->err = err_ueof;	\
 	return 0;		\
     }
 
@@ -52,19 +52,21 @@ static const char err_unst[] = "Unsupported image type";
 static const char err_extf[] = "Extensions are forbidden";
 static const char err_inmb[] = "Invalid multibyte integer";
 
-static const char *st_fname;
-static const char *st_err;
+/* what one LoadWBMP() call keeps between its helpers */
+typedef struct {
+    const char *fname;
+    const char *err;		/* why the last read_*() failed */
+    void      **mem;		/* blocks from mymalloc(), freed by myfree() */
+    int         mems;
+} WBMPDEC;
 
 static int    fail	PARM((const char *, const char *));
-static int    read_mb	PARM((int *, int));
+static int    read_mb	PARM((WBMPDEC *, int *, int));
 static void   write_mb	PARM((uint32, FILE *));
-static int    read_ext	PARM((int, int));
-static void  *mymalloc	PARM((int));
-static void   myfree	PARM((void));
-static uint8 *render1	PARM((uint8 *, int, int));
-
-static void **mymem = NULL;
-static int    mymems = 0;
+static int    read_ext	PARM((WBMPDEC *, int, int));
+static void  *mymalloc	PARM((WBMPDEC *, int));
+static void   myfree	PARM((WBMPDEC *));
+static uint8 *render1	PARM((WBMPDEC *, uint8 *, int, int));
 
 
 int LoadWBMP(char *fname, PICINFO *pinfo)
@@ -75,25 +77,29 @@ int LoadWBMP(char *fname, PICINFO *pinfo)
     int width, height;
     unsigned int npixels, raw_size, aux;
     uint8 * raw;
+    WBMPDEC wbmpdec, *wd = &wbmpdec;
 
-    st_fname = fname;
+    wd->fname = fname;
+    wd->err   = (const char *) NULL;
+    wd->mem   = (void **) NULL;
+    wd->mems  = 0;
 
     fd = open(fname, O_RDONLY);
     if (fd < 0) {
 	return fail(fname, "Couldn't open the file");
     }
 
-    MUST(read_mb(&im_type, fd));
+    MUST(read_mb(wd, &im_type, fd));
     if (im_type) {
 	return fail(fname, err_unst);
     }
 
     READU8(fd, fix_header);
 
-    MUST(read_ext(fd, fix_header));
+    MUST(read_ext(wd, fd, fix_header));
 
-    MUST(read_mb(&width, fd));
-    MUST(read_mb(&height, fd));
+    MUST(read_mb(wd, &width, fd));
+    MUST(read_mb(wd, &height, fd));
 
     npixels = width * height;
     raw_size = (npixels+7) / 8;
@@ -103,9 +109,9 @@ int LoadWBMP(char *fname, PICINFO *pinfo)
 	return fail(fname, "image dimensions out of range");
     }
 
-    raw = mymalloc(raw_size);
+    raw = mymalloc(wd, raw_size);
     if (!raw) {
-	myfree();
+	myfree(wd);
 	FatalError("LoadWBMP: can't malloc image buffer");
     }
 
@@ -122,7 +128,7 @@ int LoadWBMP(char *fname, PICINFO *pinfo)
     pinfo->g[1] = 255;
     pinfo->b[1] = 255;
 
-    pinfo->pic = render1(raw, raw_size, npixels);
+    pinfo->pic = render1(wd, raw, raw_size, npixels);
     pinfo->type = PIC8;
 
     pinfo->w = pinfo->normw = width;
@@ -135,7 +141,7 @@ int LoadWBMP(char *fname, PICINFO *pinfo)
 
     close(fd);
 
-    myfree();
+    myfree(wd);
     return 1;
 }
 
@@ -217,7 +223,7 @@ static void write_mb(uint32 data, FILE *f)
 }
 
 
-static int read_mb(int *dst, int fd)
+static int read_mb(WBMPDEC *wd, int *dst, int fd)
 {
     int ac = 0;
     int ct = 0;
@@ -225,12 +231,12 @@ static int read_mb(int *dst, int fd)
     while (1) {
 	uint8 bt;
 	if ((ct++)==6) {
-	    st_err = err_inmb;
+	    wd->err = err_inmb;
 	    return 0;
 	}
 
 	if ((read(fd, &bt, 1)) < 1) {
-	    st_err = err_ueof;
+	    wd->err = err_ueof;
 	    return 0;
 	}
 	ac = (ac << 7) | (bt & 0x7f);   /* accumulates up to 42 bits?? FIXME */
@@ -242,7 +248,7 @@ static int read_mb(int *dst, int fd)
 }
 
 
-static int read_ext(int fd, int fixed)
+static int read_ext(WBMPDEC *wd, int fd, int fixed)
 {
     XV_UNUSED(fd);
 
@@ -257,7 +263,7 @@ static int read_ext(int fd, int fixed)
      * have extensions.
      */
 
-    st_err = err_extf;
+    wd->err = err_extf;
     return 0;
 
     /*
@@ -285,32 +291,32 @@ static int read_ext(int fd, int fixed)
 }
 
 
-static void *mymalloc(int numbytes)
+static void *mymalloc(WBMPDEC *wd, int numbytes)
 {
-    mymem = (void**)realloc(mymem, (mymems+1)*sizeof(void *));
-    if (!mymem)
+    wd->mem = (void**)realloc(wd->mem, (wd->mems+1)*sizeof(void *));
+    if (!wd->mem)
 	FatalError("LoadWBMP: can't realloc buffer");
-    return (mymem[mymems++] = malloc(numbytes));
+    return (wd->mem[wd->mems++] = malloc(numbytes));
 }
 
 
-static void myfree(void)
+static void myfree(WBMPDEC *wd)
 {
     int i;
 
-    if (mymem) {
-	for (i=0; i<mymems; i++) {
-	    if (mymem[i])
-	        free(mymem[i]);
+    if (wd->mem) {
+	for (i=0; i<wd->mems; i++) {
+	    if (wd->mem[i])
+	        free(wd->mem[i]);
 	}
-	free(mymem);
+	free(wd->mem);
     }
-    mymem = (void**)NULL;
-    mymems = 0;
+    wd->mem = (void**)NULL;
+    wd->mems = 0;
 }
 
 
-static uint8 *render1(uint8 *data, int size, int npixels)
+static uint8 *render1(WBMPDEC *wd, uint8 *data, int size, int npixels)
 {
     byte * pic;
     int i;
@@ -321,7 +327,7 @@ static uint8 *render1(uint8 *data, int size, int npixels)
 
     pic = calloc(npixels,1);   /* checked for overflow by caller */
     if (!pic) {
-	myfree();
+	myfree(wd);
 	FatalError("LoadWBMP: can't allocate 'pic' buffer");
     }
 
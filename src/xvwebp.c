@@ -108,6 +108,11 @@ static void writeWEBP(void)
 
   WaitCursor();
   inpix = GenSavePic(&ptype, &w, &h, &pfree, &nc, &rmap, &gmap, &bmap);
+  if (!inpix) {
+    CloseOutFileWhy(fp, filename, 1, "not enough memory");
+    SetCursors(-1);
+    return;
+  }
 
   unused_numcols = 0;
   rv = WriteWEBP(fp, inpix, ptype, w, h, rmap, gmap, bmap, unused_numcols, colorType);
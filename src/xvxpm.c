@@ -39,22 +39,24 @@ typedef struct hent {
 
 
 
-/* Local (Global) Variables */
-static byte	hex[256];
-static hentry **hashtab;        /* Hash table */
-static int      hash_len;       /* number of hash buckets */
-static int	bufchar;	/* Buffered character from XpmGetc */
-static short	in_quote;	/* Is the current point in the file in */
+/* Per-call state of LoadXPM() */
+typedef struct {
+  hentry **hashtab;             /* Hash table */
+  int      hash_len;            /* number of hash buckets */
+  int      bufchar;             /* Buffered character from XpmGetc */
+  short    in_quote;            /* Is the current point in the file in */
                                 /*  a quoted string? */
+} XPMDEC;
 
 /* Local Functions */
 static int     XpmLoadError  PARM((const char *, const char *));
-static int     XpmGetc	     PARM((FILE *));
-static int     hash          PARM((char *));
-static int     hash_init     PARM((int));
-static int     hash_insert   PARM((hentry *));
-static hentry *hash_search   PARM((char *));
-static void    hash_destroy  PARM((void));
+static int     XpmGetc	     PARM((XPMDEC *, FILE *));
+static int     xpmParseColor PARM((char *, XColor *));
+static int     hash          PARM((XPMDEC *, char *));
+static int     hash_init     PARM((XPMDEC *, int));
+static int     hash_insert   PARM((XPMDEC *, hentry *));
+static hentry *hash_search   PARM((XPMDEC *, char *));
+static void    hash_destroy  PARM((XPMDEC *));
 
 
 /**************************************/
@@ -76,6 +78,7 @@ int LoadXPM(char *fname, PICINFO *pinfo)
   hentry  *clmp;		/* colormap hash-table */
   hentry  *c_sptr;		/* cmap hash-table search pointer*/
   XColor   col;
+  XPMDEC   xpmdec, *xd = &xpmdec;
 
   bname = BaseName(fname);
   fp = fopen(fname, "r");
@@ -89,19 +92,19 @@ int LoadXPM(char *fname, PICINFO *pinfo)
   filesize = ftell(fp);
   fseek(fp, 0L, 0);
 
-  bufchar = -2;
-  in_quote = FALSE;
+  xd->bufchar = -2;
+  xd->in_quote = FALSE;
 
   /* Read in the values line.  It is the first string in the
    * xpm, and contains four numbers.  w, h, num_colors, and
    * chars_per_pixel. */
 
   /* First, get to the first string */
-  while (((c = XpmGetc(fp))!=EOF) && (c != '"')) ;
+  while (((c = XpmGetc(xd, fp))!=EOF) && (c != '"')) ;
   line_pos = 0;
 
   /* Now, read in the string */
-  while (((c = XpmGetc(fp))!=EOF) && (line_pos < VALUES_LEN) && (c != '"')) {
+  while (((c = XpmGetc(xd, fp))!=EOF) && (line_pos < VALUES_LEN) && (c != '"')) {
     values[line_pos++] = c;
   }
   if (c != '"')
@@ -127,7 +130,7 @@ int LoadXPM(char *fname, PICINFO *pinfo)
   /* We got this far... */
   WaitCursor();
 
-  if (!hash_init(nc))
+  if (!hash_init(xd, nc))
     return (XpmLoadError(bname, "Not enough memory to hash colormap"));
 
   clmp = (hentry *) malloc(nc * sizeof(hentry)); /* Holds the colormap */
@@ -146,28 +149,21 @@ int LoadXPM(char *fname, PICINFO *pinfo)
   c_sptr = clmp;
   i_sptr = pic;
 
-  /* initialize the 'hex' array for zippy ASCII-hex -> int conversion */
-
-  for (i = 0 ; i < 256 ; i++)   hex[i] = 0;
-  for (i = '0'; i <= '9' ; i++) hex[i] = i - '0';
-  for (i = 'a'; i <= 'f' ; i++) hex[i] = i - 'a' + 10;
-  for (i = 'A'; i <= 'F' ; i++) hex[i] = i - 'A' + 10;
-
   /* Again, we've made progress. */
   WaitCursor();
 
   /* Now, we need to read the colormap. */
   pinfo->colType = F_BWDITHER;
   for (i = 0 ; i < nc ; i++) {
-    while (((c = XpmGetc(fp))!=EOF) && (c != '"')) ;
+    while (((c = XpmGetc(xd, fp))!=EOF) && (c != '"')) ;
     if (c != '"')
       return (XpmLoadError(bname, "Error reading colormap"));
 
     for (j = 0 ; j < cpp ; j++)
-      c_sptr->token[j] = XpmGetc(fp);
+      c_sptr->token[j] = XpmGetc(xd, fp);
     c_sptr->token[j] = '\0';
 
-    while (((c = XpmGetc(fp))!=EOF) && ((c == ' ') || (c == '\t'))) ;
+    while (((c = XpmGetc(xd, fp))!=EOF) && ((c == ' ') || (c == '\t'))) ;
     if (c == EOF)		/* The failure condition of getc() */
       return (XpmLoadError(bname, "Error parsing colormap line"));
 
@@ -185,22 +181,22 @@ int LoadXPM(char *fname, PICINFO *pinfo)
 
       for (j=0; j<2 && (c != ' ') && (c != '\t') && (c != EOF); j++) {
 	key[j] = c;
-	c = XpmGetc(fp);
+	c = XpmGetc(xd, fp);
       }
       key[j] = '\0';
 
-      while (((c = XpmGetc(fp))!=EOF) && ((c == ' ') || (c == '\t'))) ;
+      while (((c = XpmGetc(xd, fp))!=EOF) && ((c == ' ') || (c == '\t'))) ;
       if (c == EOF)	/* The failure condition of getc() */
 	return (XpmLoadError(bname, "Error parsing colormap line"));
 
       for (j=0; j<79 && (c!=' ') && (c!='\t') && (c!='"') && c!=EOF; j++) {
 	color[j] = c;
-	c = XpmGetc(fp);
+	c = XpmGetc(xd, fp);
       }
       color[j]='\0';
 
       while ((c == ' ') || (c == '\t'))
-	c = XpmGetc(fp);
+	c = XpmGetc(xd, fp);
 
       if (DEBUG > 1)
 	printf("LoadXPM(): Got color key '%s', color '%s'\n",
@@ -209,7 +205,7 @@ int LoadXPM(char *fname, PICINFO *pinfo)
       if (key[0] == 's')	/* Don't find a color for a symbolic name */
 	continue;
 
-      if (XParseColor(theDisp,theCmap,color,&col)) {
+      if (xpmParseColor(color, &col)) {
 	if (pinfo->type == PIC8) {
 	  pinfo->r[i] = col.red >> 8;
 	  pinfo->g[i] = col.green >> 8;
@@ -276,14 +272,14 @@ int LoadXPM(char *fname, PICINFO *pinfo)
 
 
       bcopy((char *) c_sptr, (char *) &item, sizeof(item));
-      hash_insert(&item);
+      hash_insert(xd, &item);
 
       if (DEBUG > 1)
 	printf("LoadXPM():  Cmap entry %d, 0x%02x 0x%02x 0x%02x, token '%s'\n",
 	       i, pinfo->r[i], pinfo->g[i], pinfo->b[i], c_sptr->token);
 
       if (*key == 'c') {	/* This is the color entry, keep it. */
-	while (c!='"' && c!=EOF) c = XpmGetc(fp);
+	while (c!='"' && c!=EOF) c = XpmGetc(xd, fp);
 	break;
       }
 
@@ -299,7 +295,7 @@ int LoadXPM(char *fname, PICINFO *pinfo)
 
   /* Now, read the pixmap. */
   for (i = 0 ; i < h ; i++) {
-    while (((c = XpmGetc(fp))!=EOF) && (c != '"')) ;
+    while (((c = XpmGetc(xd, fp))!=EOF) && (c != '"')) ;
     if (c != '"')
       return (XpmLoadError(bname, "Error reading colormap"));
 
@@ -308,10 +304,10 @@ int LoadXPM(char *fname, PICINFO *pinfo)
       hentry *mapentry;
 
       for (k = 0 ; k < cpp ; k++)
-	pixel[k] = XpmGetc(fp);
+	pixel[k] = XpmGetc(xd, fp);
       pixel[k] = '\0';
 
-      if (!(mapentry = (hentry *) hash_search(pixel))) {
+      if (!(mapentry = (hentry *) hash_search(xd, pixel))) {
 	/* No colormap entry found.  What do we do?  Bail for now */
 	if (DEBUG)
 	  printf("LoadXPM(): Found token '%s', can't find entry in colormap\n",
@@ -327,7 +323,7 @@ int LoadXPM(char *fname, PICINFO *pinfo)
 	*i_sptr++ = mapentry->cv_rgb[2];
       }
     }  /* for ( j < w ) */
-    while (((c = XpmGetc(fp))!=EOF) &&		/* Throw away the close " and */
+    while (((c = XpmGetc(xd, fp))!=EOF) &&		/* Throw away the close " and */
 	(c != '"'));				/* erase all remaining pixels */
 
     if (!(i%7)) WaitCursor();
@@ -344,7 +340,7 @@ int LoadXPM(char *fname, PICINFO *pinfo)
   sprintf(pinfo->shrtInfo, "%dx%d Xpm.", w, h);
   pinfo->comment = (char *)NULL;
 
-  hash_destroy();
+  hash_destroy(xd);
   free(clmp);
 
   if (fp != stdin)
@@ -363,14 +359,50 @@ static int XpmLoadError(const char *fname, const char *st)
 
 
 /***************************************/
-static int XpmGetc(FILE *f)
+static int xpmParseColor(char *spec, XColor *col)
+{
+  /* XParseColor(), or, in batch mode (no display, so no color database),
+     just the '#rgb' forms and black and white.  returns '1' on success */
+
+  int i, n, d, v[3];
+
+  if (theDisp) return XParseColor(theDisp, theCmap, spec, col);
+
+  if (strcasecmp(spec, "black") == 0) v[0] = v[1] = v[2] = 0;
+  else if (strcasecmp(spec, "white") == 0) v[0] = v[1] = v[2] = 0xffff;
+  else {
+    if (spec[0] != '#') return 0;
+    n = strlen(spec+1);
+    if (n != 3 && n != 6 && n != 9 && n != 12) return 0;
+    d = n/3;
+
+    for (i=0; i<n; i++)
+      if (!isxdigit((unsigned char) spec[1+i])) return 0;
+
+    for (i=0; i<3; i++) {
+      int j;
+      for (j=0, v[i]=0; j<d; j++) {
+	int c = (byte) spec[1+i*d+j];
+	v[i] = (v[i]<<4) | (isdigit(c) ? c - '0' : tolower(c) - 'a' + 10);
+      }
+      v[i] <<= 16 - 4*d;
+    }
+  }
+
+  col->red = v[0];  col->green = v[1];  col->blue = v[2];
+  return 1;
+}
+
+
+/***************************************/
+static int XpmGetc(XPMDEC *xd, FILE *f)
 {
   int	c, d, lastc;
 
-  if (bufchar != -2) {
+  if (xd->bufchar != -2) {
     /* The last invocation of this routine read the character... */
-    c = bufchar;
-    bufchar = -2;
+    c = xd->bufchar;
+    xd->bufchar = -2;
     return(c);
   }
 
@@ -378,8 +410,8 @@ static int XpmGetc(FILE *f)
     return(EOF);
 
   if (c == '"')
-    in_quote = !in_quote;
-  else if (!in_quote && c == '/') {	/* might be a C-style comment */
+    xd->in_quote = !xd->in_quote;
+  else if (!xd->in_quote && c == '/') {	/* might be a C-style comment */
     if ((d = getc(f)) == EOF)
       return(EOF);
     if (d == '*') {				/* yup, it *is* a comment */
@@ -394,7 +426,7 @@ static int XpmGetc(FILE *f)
       if ((c = getc(f)) == EOF)
 	return(EOF);
     } else					/* nope, not a comment */
-      bufchar = d;
+      xd->bufchar = d;
   }
   return(c);
 }
@@ -406,20 +438,20 @@ static int XpmGetc(FILE *f)
 
 
 /***************************************/
-static int hash(char *token)
+static int hash(XPMDEC *xd, char *token)
 {
   int i, sum;
 
   for (i=sum=0; token[i] != '\0'; i++)
     sum += token[i];
 
-  sum = sum % hash_len;
+  sum = sum % xd->hash_len;
   return (sum);
 }
 
 
 /***************************************/
-static int hash_init(int hsize)
+static int hash_init(XPMDEC *xd, int hsize)
 {
   /*
    * hash_init() - This function takes an arg, but doesn't do anything with
@@ -432,28 +464,28 @@ static int hash_init(int hsize)
 
   XV_UNUSED(hsize);
 
-  hash_len = 257;
+  xd->hash_len = 257;
 
-  hashtab = (hentry **) malloc(sizeof(hentry *) * hash_len);
-  if (!hashtab) {
+  xd->hashtab = (hentry **) malloc(sizeof(hentry *) * xd->hash_len);
+  if (!xd->hashtab) {
     SetISTR(ISTR_WARNING, "Couldn't malloc hashtable in LoadXPM()!\n");
     return 0;
   }
 
-  for (i = 0 ; i < hash_len ; i++)
-    hashtab[i] = NULL;
+  for (i = 0 ; i < xd->hash_len ; i++)
+    xd->hashtab[i] = NULL;
 
   return 1;
 }
 
 
 /***************************************/
-static int hash_insert(hentry *entry)
+static int hash_insert(XPMDEC *xd, hentry *entry)
 {
   int     key;
   hentry *tmp;
 
-  key = hash(entry->token);
+  key = hash(xd, entry->token);
 
   tmp = (hentry *) malloc(sizeof(hentry));
   if (!tmp) {
@@ -463,24 +495,24 @@ static int hash_insert(hentry *entry)
 
   bcopy((char *)entry, (char *)tmp, sizeof(hentry));
 
-  if (hashtab[key]) tmp->next = hashtab[key];
+  if (xd->hashtab[key]) tmp->next = xd->hashtab[key];
                else tmp->next = NULL;
 
-  hashtab[key] = tmp;
+  xd->hashtab[key] = tmp;
 
   return 1;
 }
 
 
 /***************************************/
-static hentry *hash_search(char *token)
+static hentry *hash_search(XPMDEC *xd, char *token)
 {
   int     key;
   hentry *tmp;
 
-  key = hash(token);
+  key = hash(xd, token);
 
-  tmp = hashtab[key];
+  tmp = xd->hashtab[key];
   while (tmp && strcmp(token, tmp->token)) {
     tmp = tmp->next;
   }
@@ -490,20 +522,20 @@ static hentry *hash_search(char *token)
 
 
 /***************************************/
-static void hash_destroy(void)
+static void hash_destroy(XPMDEC *xd)
 {
   int     i;
   hentry *tmp;
 
-  for (i=0; i<hash_len; i++) {
-    while (hashtab[i]) {
-      tmp = hashtab[i]->next;
-      free(hashtab[i]);
-      hashtab[i] = tmp;
+  for (i=0; i<xd->hash_len; i++) {
+    while (xd->hashtab[i]) {
+      tmp = xd->hashtab[i]->next;
+      free(xd->hashtab[i]);
+      xd->hashtab[i] = tmp;
     }
   }
 
-  free(hashtab);
+  free(xd->hashtab);
   return;
 }
 
@@ -72,12 +72,32 @@ typedef struct {
 
 typedef byte pixel;
 
+/* everything one LoadXWD() call keeps between its helpers */
+typedef struct {
+  const char *bname;
+  byte   *pic8, *pic24;
+
+  /* SJT: for 16bpp and 24bpp shifts */
+  int     red_shift_right, red_justify_left,
+          grn_shift_right, grn_justify_left,
+          blu_shift_right, blu_justify_left;
+  CARD32  red_mask, grn_mask, blu_mask;
+  int     bits_per_item, bits_used, bit_shift,
+          bits_per_pixel, bits_per_rgb;
+  CARD32  buf[1];                 /* current item, seen through these: */
+  char   *byteP;
+  CARD16 *shortP;
+  CARD32 *longP;
+  CARD32  pixel_mask;
+  int     byte_swap, byte_order, bit_order, filesize;
+} XWDDEC;
+
 /* local functions */
-static int    getinit         PARM((FILE *, int*, int*, int*, CARD32 *,
+static int    getinit         PARM((XWDDEC *, FILE *, int*, int*, int*, CARD32 *,
 			                          CARD32, PICINFO *));
-static CARD32 getpixnum       PARM((FILE *));
-static int    xwdError        PARM((const char *));
-static void   xwdWarning      PARM((const char *));
+static CARD32 getpixnum       PARM((XWDDEC *, FILE *));
+static int    xwdError        PARM((XWDDEC *, const char *));
+static void   xwdWarning      PARM((XWDDEC *, const char *));
 static int    bs_short        PARM((int));
 static CARD32 bs_long         PARM((CARD32));
 static int    readbigshort    PARM((FILE *, CARD16 *));
@@ -91,22 +111,6 @@ static int    writebiglong    PARM((FILE *, CARD32));
 
 static void   getcolorshift   PARM((CARD32, int *, int *)); /* SJT */
 
-/* SJT: for 16bpp and 24bpp shifts */
-static int    red_shift_right, red_justify_left,
-              grn_shift_right, grn_justify_left,
-              blu_shift_right, blu_justify_left;
-static byte  *pic8, *pic24;
-static CARD32 red_mask, grn_mask, blu_mask;
-static int    bits_per_item, bits_used, bit_shift,
-              bits_per_pixel, bits_per_rgb;
-static char   buf[4];
-static char   *byteP;
-static CARD16 *shortP;
-static CARD32 *longP;
-static CARD32 pixel_mask;
-static int    byte_swap, byte_order, bit_order, filesize;
-
-static const char  *bname;
 
 
 
@@ -120,26 +124,28 @@ int LoadXWD(char *fname, PICINFO *pinfo)
   int    rows=0, cols=0, padright=0, row, npixels, bufsize;
   CARD32 maxval=0, visualclass=0;
   FILE  *ifp;
+  XWDDEC xwddec, *xd = &xwddec;
 
-  bname          = BaseName(fname);
+  xd->bname      = BaseName(fname);
+  xd->pic8       = xd->pic24 = (byte *) NULL;
   pinfo->pic     = (byte *) NULL;
   pinfo->comment = (char *) NULL;
 
   ifp = xv_fopen(fname, "r");
-  if (!ifp) return (xwdError("can't open file"));
+  if (!ifp) return (xwdError(xd, "can't open file"));
 
   /* figure out the file size (used to check colormap size) */
   fseek(ifp, 0L, 2);
-  filesize = ftell(ifp);
+  xd->filesize = ftell(ifp);
   fseek(ifp, 0L, 0);
 
 
-  if (getinit(ifp, &cols, &rows, &padright, &visualclass, maxval, pinfo))
+  if (getinit(xd, ifp, &cols, &rows, &padright, &visualclass, maxval, pinfo))
     return 0;
 
   npixels = cols * rows;
   if (cols <= 0 || rows <= 0 || npixels/cols != rows) {
-    xwdError("Image dimensions out of range");
+    xwdError(xd, "Image dimensions out of range");
     return 0;
   }
 
@@ -148,40 +154,40 @@ int LoadXWD(char *fname, PICINFO *pinfo)
   case StaticGray:
   case GrayScale:
     pinfo->colType = F_GREYSCALE;
-    pic8 = (byte *) calloc((size_t) npixels, (size_t) 1);
-    if (!pic8) {
-      xwdError("couldn't malloc 'pic'");
+    xd->pic8 = (byte *) calloc((size_t) npixels, (size_t) 1);
+    if (!xd->pic8) {
+      xwdError(xd, "couldn't malloc 'pic'");
       return 0;
     }
 
     for (row=0; row<rows; row++) {
-      for (col=0, xP=pic8+(row*cols); col<cols; col++, xP++)
-	*xP = getpixnum(ifp);
+      for (col=0, xP=xd->pic8+(row*cols); col<cols; col++, xP++)
+	*xP = getpixnum(xd, ifp);
 
-      for (col=0; col<padright; col++) getpixnum(ifp);
+      for (col=0; col<padright; col++) getpixnum(xd, ifp);
     }
 
     pinfo->type = PIC8;
-    pinfo->pic  = pic8;
+    pinfo->pic  = xd->pic8;
     break;
 
   case StaticColor:
   case PseudoColor:
     pinfo->colType = F_FULLCOLOR;
-    pic8 = (byte *) calloc((size_t) npixels, (size_t) 1);
-    if (!pic8) {
-      xwdError("couldn't malloc 'pic'");
+    xd->pic8 = (byte *) calloc((size_t) npixels, (size_t) 1);
+    if (!xd->pic8) {
+      xwdError(xd, "couldn't malloc 'pic'");
       return 0;
     }
 
     for (row=0; row<rows; row++) {
-      for (col=0, xP=pic8+(row*cols); col<cols; col++, xP++)
-	*xP = getpixnum(ifp);
-      for (col=0; col<padright; col++) getpixnum(ifp);
+      for (col=0, xP=xd->pic8+(row*cols); col<cols; col++, xP++)
+	*xP = getpixnum(xd, ifp);
+      for (col=0; col<padright; col++) getpixnum(xd, ifp);
     }
 
     pinfo->type = PIC8;
-    pinfo->pic  = pic8;
+    pinfo->pic  = xd->pic8;
     break;
 
   case TrueColor:
@@ -189,21 +195,21 @@ int LoadXWD(char *fname, PICINFO *pinfo)
     pinfo->colType = F_FULLCOLOR;
     bufsize = 3*npixels;
     if (bufsize/3 != npixels) {
-      xwdError("Image dimensions out of range");
+      xwdError(xd, "Image dimensions out of range");
       return 0;
     }
-    pic24 = (byte *) calloc((size_t) bufsize, (size_t) 1);
-    if (!pic24) {
-      xwdError("couldn't malloc 'pic24'");
+    xd->pic24 = (byte *) calloc((size_t) bufsize, (size_t) 1);
+    if (!xd->pic24) {
+      xwdError(xd, "couldn't malloc 'pic24'");
       return 0;
     }
 
     for (row=0; row<rows; row++) {
-      for (col=0, xP=pic24+(row*cols*3); col<cols; col++) {
+      for (col=0, xP=xd->pic24+(row*cols*3); col<cols; col++) {
 	CARD32 ul;
 
-	ul = getpixnum(ifp);
-	switch (bits_per_pixel) {
+	ul = getpixnum(xd, ifp);
+	switch (xd->bits_per_pixel) {
         case 16:
         case 24:
         case 32:
@@ -214,38 +220,38 @@ int LoadXWD(char *fname, PICINFO *pinfo)
              have a complex set of tests. I believe this is independent of
              byte order but I have no way to test.
            */
-          *xP++ = ((ul & red_mask) >> red_shift_right) << red_justify_left;
-          *xP++ = ((ul & grn_mask) >> grn_shift_right) << grn_justify_left;
-          *xP++ = ((ul & blu_mask) >> blu_shift_right) << blu_justify_left;
+          *xP++ = ((ul & xd->red_mask) >> xd->red_shift_right) << xd->red_justify_left;
+          *xP++ = ((ul & xd->grn_mask) >> xd->grn_shift_right) << xd->grn_justify_left;
+          *xP++ = ((ul & xd->blu_mask) >> xd->blu_shift_right) << xd->blu_justify_left;
           break;
 
 	default:
-	  xwdError("True/Direct supports only 16, 24, and 32 bits");
+	  xwdError(xd, "True/Direct supports only 16, 24, and 32 bits");
 	  return 0;
 	}
       }
 
-      for (col=0; col<padright; col++) getpixnum(ifp);
+      for (col=0; col<padright; col++) getpixnum(xd, ifp);
     }
 
     pinfo->type = PIC24;
-    pinfo->pic  = pic24;
+    pinfo->pic  = xd->pic24;
     break;
 
   default:
-    xwdError("unknown visual class");
+    xwdError(xd, "unknown visual class");
     return 0;
   }
 
   sprintf(pinfo->fullInfo, "XWD, %d-bit %s.  (%d bytes)",
-	  bits_per_pixel,
+	  xd->bits_per_pixel,
 	  ((visualclass == StaticGray ) ? "StaticGray"  :
 	   (visualclass == GrayScale  ) ? "GrayScale"   :
 	   (visualclass == StaticColor) ? "StaticColor" :
 	   (visualclass == PseudoColor) ? "PseudoColor" :
 	   (visualclass == TrueColor  ) ? "TrueColor"   :
 	   (visualclass == DirectColor) ? "DirectColor" : "<unknown>"),
-	  filesize);
+	  xd->filesize);
 
   sprintf(pinfo->shrtInfo, "%dx%d XWD.", cols, rows);
 
@@ -258,7 +264,7 @@ int LoadXWD(char *fname, PICINFO *pinfo)
 
 
 /*********************/
-static int getinit(FILE *file, int *colsP, int *rowsP, int *padrightP, CARD32 *visualclassP, CARD32 maxv, PICINFO *pinfo)
+static int getinit(XWDDEC *xd, FILE *file, int *colsP, int *rowsP, int *padrightP, CARD32 *visualclassP, CARD32 maxv, PICINFO *pinfo)
 {
   int              i;
   int              grayscale;
@@ -271,16 +277,16 @@ static int getinit(FILE *file, int *colsP, int *rowsP, int *padrightP, CARD32 *v
 
   x11colors = (X11XColor *) NULL;
 
-  byte_swap = 0;
+  xd->byte_swap = 0;
   maxv = 255L;
 
   h11P = (X11WDFileHeader*) header;
 
   if (fread(&header[0], sizeof(*h11P), (size_t) 1, file) != 1)
-    return(xwdError("couldn't read X11 XWD file header"));
+    return(xwdError(xd, "couldn't read X11 XWD file header"));
 
   if (h11P->file_version != X11WD_FILE_VERSION) {
-    byte_swap = 1;
+    xd->byte_swap = 1;
     h11P->header_size      = bs_long(h11P->header_size);
     h11P->file_version     = bs_long(h11P->file_version);
     h11P->pixmap_format    = bs_long(h11P->pixmap_format);
@@ -310,26 +316,26 @@ static int getinit(FILE *file, int *colsP, int *rowsP, int *padrightP, CARD32 *v
 
   for (i=0; i<h11P->header_size - sizeof(*h11P); i++)
     if (getc(file) == EOF)
-      return(xwdError("couldn't read rest of X11 XWD file header"));
+      return(xwdError(xd, "couldn't read rest of X11 XWD file header"));
 
   /* Check whether we can handle this dump. */
   if (h11P->pixmap_depth > 24)
-    return(xwdError("can't handle X11 pixmap_depth > 24"));
+    return(xwdError(xd, "can't handle X11 pixmap_depth > 24"));
 
   if (h11P->bits_per_rgb > 24)
-    return(xwdError("can't handle X11 bits_per_rgb > 24"));
+    return(xwdError(xd, "can't handle X11 bits_per_rgb > 24"));
 
   if (h11P->pixmap_format != ZPixmap && h11P->pixmap_depth != 1)  {
     sprintf(errstr, "can't handle X11 pixmap_format %ld with depth != 1",
 	    (long)h11P->pixmap_format);
-    return(xwdError(errstr));
+    return(xwdError(xd, errstr));
   }
 
   if (h11P->bitmap_unit != 8 && h11P->bitmap_unit != 16 &&
       h11P->bitmap_unit != 32)  {
     sprintf(errstr, "X11 bitmap_unit (%ld) is non-standard - can't handle",
 	    (long)h11P->bitmap_unit);
-    return(xwdError(errstr));
+    return(xwdError(xd, errstr));
   }
 
   grayscale = 1;
@@ -337,31 +343,31 @@ static int getinit(FILE *file, int *colsP, int *rowsP, int *padrightP, CARD32 *v
     int bufsize = h11P->ncolors * sizeof(X11XColor);
 
     if (bufsize/sizeof(X11XColor) != h11P->ncolors)
-      return(xwdError("too many colors"));
+      return(xwdError(xd, "too many colors"));
     x11colors = (X11XColor*) malloc(bufsize);
-    if (!x11colors) return(xwdError("out of memory"));
+    if (!x11colors) return(xwdError(xd, "out of memory"));
 
     if (h11P->header_size + bufsize
 	+ h11P->pixmap_height * h11P->bytes_per_line + h11P->ncolors * 4
-	== filesize ) word64 = 1;
+	== xd->filesize ) word64 = 1;
 
     if (word64) {
       for (i = 0; i < h11P->ncolors; ++i) {
 	if (fread(&pad, sizeof(pad), (size_t) 1, file ) != 1)
-	  return(xwdError("couldn't read X11 XWD colormap"));
+	  return(xwdError(xd, "couldn't read X11 XWD colormap"));
 
 	if (fread( &x11colors[i], sizeof(X11XColor), (size_t) 1, file) != 1)
-	  return(xwdError("couldn't read X11 XWD colormap"));
+	  return(xwdError(xd, "couldn't read X11 XWD colormap"));
       }
     }
     else {
       if (fread(x11colors, sizeof(X11XColor), (size_t) h11P->ncolors, file)
 	  != h11P->ncolors)
-	return(xwdError("couldn't read X11 XWD colormap"));
+	return(xwdError(xd, "couldn't read X11 XWD colormap"));
     }
 
     for (i = 0; i < h11P->ncolors; ++i) {
-      if (byte_swap) {
+      if (xd->byte_swap) {
 	x11colors[i].red   = (CARD16) bs_short(x11colors[i].red);
 	x11colors[i].green = (CARD16) bs_short(x11colors[i].green);
 	x11colors[i].blue  = (CARD16) bs_short(x11colors[i].blue);
@@ -419,23 +425,23 @@ static int getinit(FILE *file, int *colsP, int *rowsP, int *padrightP, CARD32 *v
   *padrightP = h11P->bytes_per_line * 8 / h11P->bits_per_pixel -
     h11P->pixmap_width;
 
-  bits_per_item  = h11P->bitmap_unit;
-  bits_per_pixel = h11P->bits_per_pixel;
-  byte_order     = h11P->byte_order;
-  bit_order      = h11P->bitmap_bit_order;
-  bits_per_rgb   = h11P->bits_per_rgb;
+  xd->bits_per_item  = h11P->bitmap_unit;
+  xd->bits_per_pixel = h11P->bits_per_pixel;
+  xd->byte_order     = h11P->byte_order;
+  xd->bit_order      = h11P->bitmap_bit_order;
+  xd->bits_per_rgb   = h11P->bits_per_rgb;
 
 
   /* add sanity-code for freako 'exceed' server, where bitmapunit = 8
      and bitsperpix = 32 (and depth=24)... */
 
-  if (bits_per_item < bits_per_pixel) {
-    bits_per_item = bits_per_pixel;
+  if (xd->bits_per_item < xd->bits_per_pixel) {
+    xd->bits_per_item = xd->bits_per_pixel;
 
-    /* round bits_per_item up to next legal value, if necc */
-    if      (bits_per_item <  8) bits_per_item = 8;
-    else if (bits_per_item < 16) bits_per_item = 16;
-    else                         bits_per_item = 32;
+    /* round xd->bits_per_item up to next legal value, if necc */
+    if      (xd->bits_per_item <  8) xd->bits_per_item = 8;
+    else if (xd->bits_per_item < 16) xd->bits_per_item = 16;
+    else                         xd->bits_per_item = 32;
   }
 
 
@@ -443,22 +449,22 @@ static int getinit(FILE *file, int *colsP, int *rowsP, int *padrightP, CARD32 *v
      (i.e., 3 bytes, no alpha/padding) */
 
 
-  bits_used  = bits_per_item;
+  xd->bits_used  = xd->bits_per_item;
 
-  if (bits_per_pixel == sizeof(pixel_mask) * 8)  pixel_mask = (CARD32) -1;
-  else pixel_mask = (1 << bits_per_pixel) - 1;
+  if (xd->bits_per_pixel == sizeof(xd->pixel_mask) * 8)  xd->pixel_mask = (CARD32) -1;
+  else xd->pixel_mask = (1 << xd->bits_per_pixel) - 1;
 
-  red_mask = h11P->red_mask;
-  grn_mask = h11P->grn_mask;
-  blu_mask = h11P->blu_mask;
+  xd->red_mask = h11P->red_mask;
+  xd->grn_mask = h11P->grn_mask;
+  xd->blu_mask = h11P->blu_mask;
 
-  getcolorshift(red_mask, &red_shift_right, &red_justify_left);
-  getcolorshift(grn_mask, &grn_shift_right, &grn_justify_left);
-  getcolorshift(blu_mask, &blu_shift_right, &blu_justify_left);
+  getcolorshift(xd->red_mask, &xd->red_shift_right, &xd->red_justify_left);
+  getcolorshift(xd->grn_mask, &xd->grn_shift_right, &xd->grn_justify_left);
+  getcolorshift(xd->blu_mask, &xd->blu_shift_right, &xd->blu_justify_left);
 
-  byteP  = (char   *) buf;
-  shortP = (CARD16 *) buf;
-  longP  = (CARD32 *) buf;
+  xd->byteP  = (char   *) xd->buf;
+  xd->shortP = (CARD16 *) xd->buf;
+  xd->longP  = (CARD32 *) xd->buf;
 
   return 0;
 }
@@ -504,91 +510,91 @@ static void getcolorshift (CARD32 mask, int *rightshift, int *leftshift)
 
 
 /******************************/
-static CARD32 getpixnum(FILE *file)
+static CARD32 getpixnum(XWDDEC *xd, FILE *file)
 {
   int n;
 
-  if (bits_used == bits_per_item) {
-    switch (bits_per_item) {
+  if (xd->bits_used == xd->bits_per_item) {
+    switch (xd->bits_per_item) {
     case 8:
-      *byteP = getc(file);
+      *xd->byteP = getc(file);
       break;
 
     case 16:
-      if (byte_order == MSBFirst) {
-	if (readbigshort(file, shortP) == -1)
-	  xwdWarning("unexpected EOF");
+      if (xd->byte_order == MSBFirst) {
+	if (readbigshort(file, xd->shortP) == -1)
+	  xwdWarning(xd, "unexpected EOF");
       }
       else {
-	if (readlittleshort(file, shortP) == -1)
-	  xwdWarning("unexpected EOF");
+	if (readlittleshort(file, xd->shortP) == -1)
+	  xwdWarning(xd, "unexpected EOF");
       }
       break;
 
     case 32:
-      if (byte_order == MSBFirst) {
-	if (readbiglong(file, longP) == -1)
-	  xwdWarning("unexpected EOF");
+      if (xd->byte_order == MSBFirst) {
+	if (readbiglong(file, xd->longP) == -1)
+	  xwdWarning(xd, "unexpected EOF");
       }
       else {
-	if (readlittlelong(file, longP) == -1)
-	  xwdWarning("unexpected EOF");
+	if (readlittlelong(file, xd->longP) == -1)
+	  xwdWarning(xd, "unexpected EOF");
       }
       break;
 
     default:
-      xwdWarning("can't happen");
+      xwdWarning(xd, "can't happen");
     }
-    bits_used = 0;
+    xd->bits_used = 0;
 
-    if (bit_order == MSBFirst)
-      bit_shift = bits_per_item - bits_per_pixel;
+    if (xd->bit_order == MSBFirst)
+      xd->bit_shift = xd->bits_per_item - xd->bits_per_pixel;
     else
-      bit_shift = 0;
+      xd->bit_shift = 0;
   }
 
-  switch (bits_per_item) {
+  switch (xd->bits_per_item) {
   case 8:
-    n = (*byteP >> bit_shift) & pixel_mask;
+    n = (*xd->byteP >> xd->bit_shift) & xd->pixel_mask;
     break;
 
   case 16:
-    n = (*shortP >> bit_shift) & pixel_mask;
+    n = (*xd->shortP >> xd->bit_shift) & xd->pixel_mask;
     break;
 
   case 32:
-    n = (*longP >> bit_shift) & pixel_mask;
+    n = (*xd->longP >> xd->bit_shift) & xd->pixel_mask;
     break;
 
   default:
     n = 0;
-    xwdWarning("can't happen");
+    xwdWarning(xd, "can't happen");
   }
 
-  if (bit_order == MSBFirst) bit_shift -= bits_per_pixel;
-                        else bit_shift += bits_per_pixel;
+  if (xd->bit_order == MSBFirst) xd->bit_shift -= xd->bits_per_pixel;
+                        else xd->bit_shift += xd->bits_per_pixel;
 
-  bits_used += bits_per_pixel;
+  xd->bits_used += xd->bits_per_pixel;
 
   return n;
 }
 
 
 /***************************/
-static int xwdError(const char *st)
+static int xwdError(XWDDEC *xd, const char *st)
 {
-  if (pic8  != NULL) free(pic8);
-  if (pic24 != NULL) free(pic24);
+  if (xd->pic8  != NULL) free(xd->pic8);
+  if (xd->pic24 != NULL) free(xd->pic24);
 
-  SetISTR(ISTR_WARNING,"%s:  %s", bname, st);
+  SetISTR(ISTR_WARNING,"%s:  %s", xd->bname, st);
   return 0;
 }
 
 
 /***************************/
-static void xwdWarning(const char *st)
+static void xwdWarning(XWDDEC *xd, const char *st)
 {
-  SetISTR(ISTR_WARNING,"%s:  %s", bname, st);
+  SetISTR(ISTR_WARNING,"%s:  %s", xd->bname, st);
 }
 
 
@@ -29,8 +29,6 @@ static void CellZX PARM((byte *pic, int w, int h, byte *rmap, byte *gmap, byte *
 
 static int zxError PARM((const char *, const char *));
 
-static const char *bname;
-
 /*******************************************/
 int LoadZX(char *fname, PICINFO *pinfo)
 /*******************************************/
@@ -41,6 +39,7 @@ int LoadZX(char *fname, PICINFO *pinfo)
   unsigned int    c, c1;
   int   x,y;
   byte  *zxfile;
+  const char *bname;
 
   bname = BaseName(fname);
 